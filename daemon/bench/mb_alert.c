@@ -0,0 +1,94 @@
+/*
+ * mb_alert.c — alert_broadcast() fan-out versus connected clients.
+ *
+ * Plugs K socketpairs straight into the IPC client table (no listener or
+ * reactor needed) with a thread per client draining the far end, then
+ * times alert_broadcast() of a typical scan_clean event.  One op is one
+ * broadcast to all K clients.  alert.c is included for the client table.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "microbench.h"
+
+#include "../src/alert.c"
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static const int CLIENTS[] = { 0, 1, 2, 4, ALERT_MAX_CLIENTS };
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void *drain_main(void *arg)
+{
+    int fd = (int)(intptr_t)arg;
+    char buf[65536];
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+    return NULL;
+}
+
+static void run(int k)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "alert/broadcast/clients=%d", k);
+    if (!mb_enabled(name)) return;
+
+    int peers[ALERT_MAX_CLIENTS];
+    pthread_t tids[ALERT_MAX_CLIENTS];
+
+    for (int i = 0; i < ALERT_MAX_CLIENTS; i++) s_clients[i].fd = -1;
+    for (int i = 0; i < k; i++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+            mb_skip(name, "socketpair failed");
+            return;
+        }
+        int sndbuf = 1 << 20;
+        setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        set_nonblocking(sv[0]);
+        s_clients[i].fd = sv[0];
+        peers[i] = sv[1];
+        pthread_create(&tids[i], NULL, drain_main, (void *)(intptr_t)sv[1]);
+    }
+    s_client_count = k;
+
+    uint64_t ops = mb_ops(200000);
+    uint64_t drops0 = metrics_counter_value(s_m_dropped);
+    uint64_t a0 = mb_allocs();
+    uint64_t t0 = mb_now_ns();
+    for (uint64_t i = 0; i < ops; i++)
+        alert_broadcast(ALERT_TYPE_SCAN_CLEAN,
+                        "/home/user/Downloads/report-2024.pdf", NULL,
+                        "File is clean");
+    uint64_t ns = mb_now_ns() - t0;
+    uint64_t allocs = mb_allocs() - a0;
+    uint64_t drops = metrics_counter_value(s_m_dropped) - drops0;
+
+    for (int i = 0; i < k; i++) {
+        close(s_clients[i].fd);
+        s_clients[i].fd = -1;
+        pthread_join(tids[i], NULL);
+        close(peers[i]);
+    }
+    s_client_count = 0;
+
+    mb_report(name, ops, ns, allocs);
+    if (drops)
+        fprintf(stderr, "  (%llu messages dropped on full sockets)\n",
+                (unsigned long long)drops);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void mb_alert(void)
+{
+    /* Registered in alert_server_init() in the daemon. */
+    if (s_m_dropped < 0)
+        s_m_dropped = metrics_counter("sentinel_ipc_dropped_messages_total",
+                                      "GUI messages dropped because a "
+                                      "client's socket was full");
+
+    for (size_t i = 0; i < sizeof(CLIENTS) / sizeof(CLIENTS[0]); i++)
+        run(CLIENTS[i]);
+}
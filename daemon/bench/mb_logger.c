@@ -0,0 +1,86 @@
+/*
+ * mb_logger.c — logger_log() throughput under contention.
+ *
+ * T threads each log distinct lines (so duplicate folding never kicks
+ * in) through log_info(), and through log_info_rl() where almost every
+ * call is suppressed by the per-site rate limit.  Output goes to a
+ * scratch log file with size rotation pushed out of the way; syslog(3)
+ * is still called, so the numbers include the host's syslog cost.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "microbench.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <pthread.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+typedef struct {
+    uint64_t ops;
+    int      rate_limited;
+} logger_arg_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static const int THREADS[] = { 1, 2, 4, 8 };
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void *logger_main(void *arg)
+{
+    const logger_arg_t *a = arg;
+    for (uint64_t i = 0; i < a->ops; i++) {
+        if (a->rate_limited)
+            log_info_rl("[worker] File clean: /home/user/file-%llu.dat",
+                        (unsigned long long)i);
+        else
+            log_info("[worker] File clean: /home/user/file-%llu.dat",
+                     (unsigned long long)i);
+    }
+    return NULL;
+}
+
+static void run(int threads, int rate_limited)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "logger/%s/t=%d",
+             rate_limited ? "info_rl" : "info", threads);
+    if (!mb_enabled(name)) return;
+
+    logger_arg_t arg = {
+        .ops = mb_ops(rate_limited ? 2000000 : 200000) / (uint64_t)threads,
+        .rate_limited = rate_limited,
+    };
+    pthread_t tids[8];
+
+    uint64_t a0 = mb_allocs();
+    uint64_t t0 = mb_now_ns();
+    for (int i = 0; i < threads; i++)
+        pthread_create(&tids[i], NULL, logger_main, &arg);
+    for (int i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+    uint64_t ns = mb_now_ns() - t0;
+    uint64_t allocs = mb_allocs() - a0;
+    allocs = allocs > (uint64_t)threads ? allocs - (uint64_t)threads : 0;
+
+    logger_flush_suppressed();
+    mb_report(name, arg.ops * (uint64_t)threads, ns, allocs);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void mb_logger(void)
+{
+    logger_set_rotation((size_t)1 << 40, 0, 0, 0);
+
+    for (int rl = 0; rl <= 1; rl++) {
+        for (size_t i = 0; i < sizeof(THREADS) / sizeof(THREADS[0]); i++)
+            run(THREADS[i], rl);
+    }
+
+    logger_set_rotation(SENTINEL_LOG_MAX_SIZE, SENTINEL_LOG_MAX_AGE,
+                        SENTINEL_LOG_GENERATIONS, SENTINEL_LOG_RETAIN_BYTES);
+}
@@ -0,0 +1,108 @@
+/*
+ * mb_manifest.c — Quarantine manifest lookup and save versus vault size.
+ *
+ * Fills the in-memory manifest with N entries shaped like the ones
+ * quarantine_file() adds, then times manifest_find() for random present
+ * IDs and for an absent ID (a full scan), and manifest_save() writing the
+ * whole array to a scratch file.  quarantine.c is included so its static
+ * helpers can be called directly.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "microbench.h"
+
+#include "../src/quarantine.c"
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static const int VAULT_SIZES[] = { 10, 100, 1000, 10000 };
+
+static volatile int s_sink;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void fill_manifest(int n, char (*ids)[64])
+{
+    if (s_manifest) json_object_put(s_manifest);
+    s_manifest = json_object_new_array();
+
+    for (int i = 0; i < n; i++) {
+        char orig[128], qpath[QR_MAX_PATH];
+        generate_uuid(ids[i], sizeof(ids[i]));
+        snprintf(orig, sizeof(orig), "/home/user/Downloads/invoice-%d.exe", i);
+        snprintf(qpath, sizeof(qpath), "%s/%s_invoice-%d.exe",
+                 s_dir, ids[i], i);
+
+        json_object *entry = json_object_new_object();
+        json_object_object_add(entry, "id", json_object_new_string(ids[i]));
+        json_object_object_add(entry, "original_path",
+                               json_object_new_string(orig));
+        json_object_object_add(entry, "quarantine_path",
+                               json_object_new_string(qpath));
+        json_object_object_add(entry, "threat_name",
+                               json_object_new_string("Win.Test.EICAR_HDB-1"));
+        json_object_object_add(entry, "timestamp",
+                               json_object_new_int64((int64_t)time(NULL)));
+        json_object_array_add(s_manifest, entry);
+    }
+}
+
+static void run(int n)
+{
+    char hit[64], miss[64], save[64];
+    snprintf(hit, sizeof(hit), "manifest/find_hit/n=%d", n);
+    snprintf(miss, sizeof(miss), "manifest/find_miss/n=%d", n);
+    snprintf(save, sizeof(save), "manifest/save/n=%d", n);
+    if (!mb_enabled(hit) && !mb_enabled(miss) && !mb_enabled(save)) return;
+
+    char (*ids)[64] = malloc((size_t)n * sizeof(*ids));
+    if (!ids) return;
+    fill_manifest(n, ids);
+
+    /* Keep each row around a second on a typical box. */
+    uint64_t find_ops = mb_ops((uint64_t)(20000000 / n));
+    uint64_t save_ops = mb_ops((uint64_t)(n < 20000 ? 20000 / n : 1));
+    uint64_t rng = 42, a0, t0;
+
+    if (mb_enabled(hit)) {
+        a0 = mb_allocs();
+        t0 = mb_now_ns();
+        for (uint64_t i = 0; i < find_ops; i++)
+            s_sink = manifest_find(ids[mb_rand(&rng) % (uint64_t)n]);
+        mb_report(hit, find_ops, mb_now_ns() - t0, mb_allocs() - a0);
+    }
+
+    if (mb_enabled(miss)) {
+        a0 = mb_allocs();
+        t0 = mb_now_ns();
+        for (uint64_t i = 0; i < find_ops; i++)
+            s_sink = manifest_find("00000000-0000-0000-0000-000000000000");
+        mb_report(miss, find_ops, mb_now_ns() - t0, mb_allocs() - a0);
+    }
+
+    if (mb_enabled(save)) {
+        a0 = mb_allocs();
+        t0 = mb_now_ns();
+        for (uint64_t i = 0; i < save_ops; i++)
+            manifest_save();
+        mb_report(save, save_ops, mb_now_ns() - t0, mb_allocs() - a0);
+    }
+
+    free(ids);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void mb_manifest(void)
+{
+    snprintf(s_dir, sizeof(s_dir), "%s", mb_tmpdir());
+    snprintf(s_manifest_path, sizeof(s_manifest_path), "%s/%s",
+             s_dir, QUARANTINE_MANIFEST_NAME);
+
+    for (size_t i = 0; i < sizeof(VAULT_SIZES) / sizeof(VAULT_SIZES[0]); i++)
+        run(VAULT_SIZES[i]);
+
+    if (s_manifest) json_object_put(s_manifest);
+    s_manifest = NULL;
+}
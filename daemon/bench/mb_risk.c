@@ -0,0 +1,74 @@
+/*
+ * mb_risk.c — Risk triage on a file head versus its content.
+ *
+ * Times risk_assess() on one RISK_HEAD_BYTES head of random bytes (a
+ * packed body), of text, and of a PE header followed by random bytes:
+ * the cost the scanner, or the queue's triage thread, adds to every file.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "microbench.h"
+#include "risk.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static uint8_t s_head[RISK_HEAD_BYTES];
+
+/* Defeats dead-code elimination of the scores. */
+static volatile unsigned s_sink;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void fill(const char *kind)
+{
+    uint64_t rng = 42;
+    for (size_t i = 0; i < sizeof(s_head); i++)
+        s_head[i] = (uint8_t)mb_rand(&rng);
+
+    if (strcmp(kind, "text") == 0) {
+        static const char words[] = "the quick brown fox jumps over a lazy dog\n";
+        for (size_t i = 0; i < sizeof(s_head); i++)
+            s_head[i] = (uint8_t)words[i % (sizeof(words) - 1)];
+    } else if (strcmp(kind, "pe") == 0) {
+        memset(s_head, 0, 0x400);
+        memcpy(s_head, "MZ", 2);
+        s_head[0x3c] = 0x80;
+        memcpy(s_head + 0x80, "PE\0\0", 4);
+        s_head[0x80 + 4 + 2]  = 2;           /* Two sections */
+        s_head[0x80 + 4 + 16] = 0xe0;        /* SizeOfOptionalHeader */
+        s_head[0x80 + 4 + 18] = 0x02;        /* EXECUTABLE_IMAGE */
+        memcpy(s_head + 0x80 + 24 + 0xe0, "UPX0", 4);
+        memcpy(s_head + 0x80 + 24 + 0xe0 + 40, "UPX1", 4);
+    }
+}
+
+static void run(const char *kind)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "risk/assess/%s", kind);
+    if (!mb_enabled(name)) return;
+
+    fill(kind);
+    risk_t   r;
+    uint64_t ops = mb_ops(200000);
+    uint64_t a0  = mb_allocs();
+    uint64_t t0  = mb_now_ns();
+    for (uint64_t i = 0; i < ops; i++) {
+        risk_assess(s_head, sizeof(s_head), &r);
+        s_sink = r.score;
+    }
+    mb_report(name, ops, mb_now_ns() - t0, mb_allocs() - a0);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void mb_risk(void)
+{
+    run("random");
+    run("text");
+    run("pe");
+}
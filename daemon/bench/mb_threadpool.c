@@ -0,0 +1,101 @@
+/*
+ * mb_threadpool.c — Submit → dequeue throughput of the scan thread pool.
+ *
+ * P producer threads push paths with threadpool_submit() into a pool of
+ * C workers whose work function only counts the job.  One op is one job
+ * from submit to the end of its (empty) work function, so ns/op is the
+ * inverse of the pool's peak throughput at that P×C, and allocs/op is
+ * the per-job allocation cost.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "microbench.h"
+#include "threadpool.h"
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+typedef struct {
+    threadpool_t *pool;
+    uint64_t      ops;
+} producer_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static _Atomic uint64_t s_done = 0;
+
+static const int PRODUCERS[] = { 1, 2, 4 };
+static const int CONSUMERS[] = { 1, 2, 4, 8 };
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void count_job(scan_job_t *job, void *user_data)
+{
+    (void)job;
+    (void)user_data;
+    atomic_fetch_add_explicit(&s_done, 1, memory_order_relaxed);
+}
+
+static void *producer_main(void *arg)
+{
+    producer_t *p = arg;
+    for (uint64_t i = 0; i < p->ops; i++)
+        threadpool_submit(p->pool, "/home/user/Downloads/report-2024.pdf",
+                          NULL);
+    return NULL;
+}
+
+static void run(int producers, int consumers)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "threadpool/submit/p=%d/c=%d",
+             producers, consumers);
+    if (!mb_enabled(name)) return;
+
+    threadpool_t *pool = threadpool_create(consumers,
+                                           THREADPOOL_DEFAULT_CAPACITY,
+                                           count_job, NULL);
+    if (!pool) {
+        mb_skip(name, "threadpool_create failed");
+        return;
+    }
+
+    uint64_t per = mb_ops(200000) / (uint64_t)producers;
+    uint64_t total = per * (uint64_t)producers;
+    producer_t arg = { pool, per };
+    pthread_t tids[8];
+
+    atomic_store(&s_done, 0);
+    uint64_t a0 = mb_allocs();
+    uint64_t t0 = mb_now_ns();
+
+    for (int i = 0; i < producers; i++)
+        pthread_create(&tids[i], NULL, producer_main, &arg);
+    for (int i = 0; i < producers; i++)
+        pthread_join(tids[i], NULL);
+    while (atomic_load_explicit(&s_done, memory_order_relaxed) < total)
+        sched_yield();
+
+    uint64_t ns = mb_now_ns() - t0;
+    /* Thread creation allocates too; charge only the jobs. */
+    uint64_t allocs = mb_allocs() - a0;
+    allocs = allocs > (uint64_t)producers ? allocs - (uint64_t)producers : 0;
+
+    threadpool_shutdown(pool);
+    mb_report(name, total, ns, allocs);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void mb_threadpool(void)
+{
+    for (size_t p = 0; p < sizeof(PRODUCERS) / sizeof(PRODUCERS[0]); p++) {
+        for (size_t c = 0; c < sizeof(CONSUMERS) / sizeof(CONSUMERS[0]); c++)
+            run(PRODUCERS[p], CONSUMERS[c]);
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ * mb_wdmap.c — Watch-descriptor map insert and lookup versus watch count.
+ *
+ * Builds the monitor's wd → path map with N watches (10^3 … 10^6) and
+ * times wd_map_put() for the build and wd_map_get() for random hits.
+ * monitor.c is included so its static helpers can be called directly.
+ * Sizes whose entries would not fit in half of RAM are skipped.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "microbench.h"
+
+#include "../src/monitor.c"
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static const int WATCHES[] = { 1000, 10000, 100000, 1000000 };
+
+/* Defeats dead-code elimination of the lookups. */
+static volatile uintptr_t s_sink;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void run(int n)
+{
+    char put_name[64], get_name[64];
+    snprintf(put_name, sizeof(put_name), "wdmap/put/n=%d", n);
+    snprintf(get_name, sizeof(get_name), "wdmap/get/n=%d", n);
+    if (!mb_enabled(put_name) && !mb_enabled(get_name)) return;
+
+    double need = (double)n * (double)sizeof(wd_entry_t);
+    double ram  = (double)sysconf(_SC_PHYS_PAGES) *
+                  (double)sysconf(_SC_PAGESIZE);
+    if (need > ram / 2) {
+        char why[64];
+        snprintf(why, sizeof(why), "needs %.1f GiB", need / (1 << 30));
+        if (mb_enabled(put_name)) mb_skip(put_name, why);
+        if (mb_enabled(get_name)) mb_skip(get_name, why);
+        return;
+    }
+
+    monitor_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) return;
+
+    char path[128];
+    uint64_t a0 = mb_allocs();
+    uint64_t t0 = mb_now_ns();
+    for (int wd = 1; wd <= n; wd++) {
+        snprintf(path, sizeof(path), "/home/user/src/project/module-%d", wd);
+        wd_map_put(ctx, wd, path);
+    }
+    uint64_t ns = mb_now_ns() - t0;
+    if (mb_enabled(put_name))
+        mb_report(put_name, (uint64_t)n, ns, mb_allocs() - a0);
+
+    if (mb_enabled(get_name)) {
+        uint64_t ops = mb_ops(1000000), rng = 42;
+        a0 = mb_allocs();
+        t0 = mb_now_ns();
+        for (uint64_t i = 0; i < ops; i++) {
+            int wd = (int)(mb_rand(&rng) % (uint64_t)n) + 1;
+            s_sink = (uintptr_t)wd_map_get(ctx, wd);
+        }
+        mb_report(get_name, ops, mb_now_ns() - t0, mb_allocs() - a0);
+    }
+
+    wd_map_free(ctx);
+    free(ctx);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void mb_wdmap(void)
+{
+    for (size_t i = 0; i < sizeof(WATCHES) / sizeof(WATCHES[0]); i++)
+        run(WATCHES[i]);
+}
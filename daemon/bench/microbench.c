@@ -0,0 +1,198 @@
+/*
+ * microbench.c — Subsystem microbenchmark driver (see microbench.h).
+ *
+ * Usage:
+ *   sentinel-microbench [-q] [-j] [FILTER ...]
+ *     -q       quick run (a tenth of the ops; for smoke-testing)
+ *     -j       one JSON object per result instead of the table
+ *     FILTER   run only benchmarks whose name contains FILTER
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "microbench.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <ftw.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ── Allocation counting ────────────────────────────────────────────────── */
+
+/*
+ * glibc lets the executable replace malloc; forward to its own allocator
+ * so memalign()/free() pairs from code we do not wrap stay consistent.
+ */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void  __libc_free(void *ptr);
+
+static _Atomic uint64_t s_allocs = 0;
+
+void *malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&s_allocs, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static void (*const SUITES[])(void) = {
+    mb_threadpool,
+    mb_wdmap,
+    mb_manifest,
+    mb_logger,
+    mb_alert,
+    mb_risk,
+};
+
+#define NSUITES (sizeof(SUITES) / sizeof(SUITES[0]))
+
+int mb_quick = 0;
+
+static int          s_json     = 0;
+static char       **s_filters  = NULL;
+static int          s_nfilters = 0;
+static char         s_tmpdir[64];
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static int rm_entry(const char *path, const struct stat *st, int flag,
+                    struct FTW *ftw)
+{
+    (void)st;
+    (void)ftw;
+    return flag == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void remove_tmpdir(void)
+{
+    if (s_tmpdir[0]) nftw(s_tmpdir, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+uint64_t mb_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t mb_allocs(void)
+{
+    return atomic_load_explicit(&s_allocs, memory_order_relaxed);
+}
+
+uint64_t mb_ops(uint64_t full)
+{
+    if (!mb_quick) return full;
+    return full / 10 ? full / 10 : 1;
+}
+
+uint64_t mb_rand(uint64_t *state)
+{
+    uint64_t x = *state ? *state : 0x9e3779b97f4a7c15ull;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 2685821657736338717ull;
+}
+
+int mb_enabled(const char *name)
+{
+    if (s_nfilters == 0) return 1;
+    for (int i = 0; i < s_nfilters; i++) {
+        if (strstr(name, s_filters[i])) return 1;
+    }
+    return 0;
+}
+
+void mb_report(const char *name, uint64_t ops, uint64_t ns, uint64_t allocs)
+{
+    double ns_op     = ops ? (double)ns / (double)ops : 0.0;
+    double allocs_op = ops ? (double)allocs / (double)ops : 0.0;
+
+    if (s_json)
+        printf("{\"name\":\"%s\",\"ops\":%llu,\"ns_per_op\":%.1f,"
+               "\"allocs_per_op\":%.3f}\n", name,
+               (unsigned long long)ops, ns_op, allocs_op);
+    else
+        printf("%-40s %10llu ops %12.1f ns/op %9.2f allocs/op\n", name,
+               (unsigned long long)ops, ns_op, allocs_op);
+    fflush(stdout);
+}
+
+void mb_skip(const char *name, const char *why)
+{
+    if (s_json)
+        printf("{\"name\":\"%s\",\"skipped\":\"%s\"}\n", name, why);
+    else
+        printf("%-40s skipped: %s\n", name, why);
+    fflush(stdout);
+}
+
+const char *mb_tmpdir(void)
+{
+    if (!s_tmpdir[0]) {
+        snprintf(s_tmpdir, sizeof(s_tmpdir), "/tmp/sentinel-mb.XXXXXX");
+        if (!mkdtemp(s_tmpdir)) {
+            perror("mkdtemp");
+            exit(1);
+        }
+        atexit(remove_tmpdir);
+    }
+    return s_tmpdir;
+}
+
+/* ── Main ───────────────────────────────────────────────────────────────── */
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "qj")) != -1) {
+        switch (opt) {
+        case 'q': mb_quick = 1; break;
+        case 'j': s_json   = 1; break;
+        default:
+            fprintf(stderr, "Usage: %s [-q] [-j] [FILTER ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    s_filters  = argv + optind;
+    s_nfilters = argc - optind;
+
+    /* Modules log as they work; send it to the scratch dir. */
+    char log_path[128];
+    snprintf(log_path, sizeof(log_path), "%s/sentinel.log", mb_tmpdir());
+    logger_init(log_path);
+
+    /* Suites check mb_enabled() per row before any setup. */
+    for (size_t i = 0; i < NSUITES; i++) SUITES[i]();
+
+    logger_shutdown();
+    return 0;
+}
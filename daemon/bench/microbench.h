@@ -0,0 +1,75 @@
+/*
+ * microbench.h — Harness for the subsystem microbenchmarks.
+ *
+ * Each suite (mb_*.c) times one daemon hot path and reports a row per
+ * parameter set through mb_report():
+ *
+ *   threadpool/submit/p=2/c=4       200000 ops     412.3 ns/op    1.00 allocs/op
+ *
+ * Allocations are counted by interposing malloc/calloc/realloc for the
+ * whole process (json-c and libc included), so allocs/op is exact as long
+ * as nothing else runs while a benchmark is timed.
+ *
+ * Suites that need a module's private helpers (wd_map_get, manifest_find,
+ * the alert client table) #include that module's .c file; the Makefile
+ * leaves the matching object out of the link.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_MICROBENCH_H
+#define SENTINEL_MICROBENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ── Harness state ──────────────────────────────────────────────────────── */
+
+/* Non-zero with -q: suites divide their op counts by 10. */
+extern int mb_quick;
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/** CLOCK_MONOTONIC in nanoseconds. */
+uint64_t mb_now_ns(void);
+
+/** Allocation calls (malloc, calloc, realloc) made so far, process-wide. */
+uint64_t mb_allocs(void);
+
+/** Op count for a run: `full`, or full/10 (at least 1) with -q. */
+uint64_t mb_ops(uint64_t full);
+
+/** Cheap PRNG (xorshift64*) for lookup keys; per-caller state. */
+uint64_t mb_rand(uint64_t *state);
+
+/**
+ * Whether a benchmark should run, given the command-line filters.
+ * @param name  Full benchmark name, e.g. "wdmap/get/n=1000".
+ */
+int mb_enabled(const char *name);
+
+/**
+ * Print one result row.
+ * @param name    Full benchmark name.
+ * @param ops     Operations performed in the timed region.
+ * @param ns      Elapsed time of the timed region.
+ * @param allocs  mb_allocs() delta over the timed region.
+ */
+void mb_report(const char *name, uint64_t ops, uint64_t ns, uint64_t allocs);
+
+/** Print a skipped row with a reason. */
+void mb_skip(const char *name, const char *why);
+
+/** Scratch directory for the run (created on first use, removed at exit). */
+const char *mb_tmpdir(void);
+
+/* ── Suites ─────────────────────────────────────────────────────────────── */
+
+void mb_threadpool(void);
+void mb_wdmap(void);
+void mb_manifest(void);
+void mb_logger(void);
+void mb_alert(void);
+void mb_risk(void);
+
+#endif /* SENTINEL_MICROBENCH_H */
@@ -13,6 +13,9 @@
 
 #include <stddef.h>
 
+#include "reactor.h"
+#include "handover.h"
+
 /* ── Socket path & permissions ──────────────────────────────────────────── */
 
 /* Default UNIX socket path.  Placed in /tmp so the desktop user's Electron
@@ -26,6 +29,12 @@
 /* Maximum JSON message length (including newline delimiter) */
 #define ALERT_MSG_MAX      4096
 
+/* Output queued for one client (socket full) before it is disconnected */
+#define ALERT_CLIENT_OUT_MAX   (16u << 20)
+
+/* Quarantine entries per "list" reply (and per write for long replies) */
+#define ALERT_LIST_PAGE        512
+
 /* ── Alert event types ──────────────────────────────────────────────────── */
 
 typedef enum {
@@ -53,6 +62,13 @@ typedef void (*alert_command_handler_t)(int client_fd,
                                        const char *id,
                                        void *user_data);
 
+/**
+ * Callback invoked when a client connection is closed, before its file
+ * descriptor is released.  Called with the IPC lock held: it must not
+ * call back into alert_*().
+ */
+typedef void (*alert_disconnect_handler_t)(int client_fd, void *user_data);
+
 /* ── Public API ─────────────────────────────────────────────────────────── */
 
 /**
@@ -68,11 +84,19 @@ int alert_server_init(const char *socket_path);
 void alert_set_command_handler(alert_command_handler_t handler, void *user_data);
 
 /**
- * Service pending socket events (accept new clients, read commands, etc.).
- * Call this from the main event loop.  Non-blocking with select() timeout.
- * @param timeout_ms  Maximum time to block in milliseconds.
+ * Register the listening socket with the daemon's reactor.  Accepted
+ * clients are registered too, and commands are dispatched from the
+ * reactor thread as soon as a complete line arrives.
+ * @return 0 on success, -1 on error.
+ */
+int alert_server_attach(reactor_t *r);
+
+/**
+ * Register a handler told about every client that goes away, so work
+ * done on its behalf can be cancelled.
  */
-void alert_server_service(int timeout_ms);
+void alert_set_disconnect_handler(alert_disconnect_handler_t handler,
+                                  void *user_data);
 
 /**
  * Broadcast a JSON alert to ALL connected clients.
@@ -86,6 +110,7 @@ void alert_broadcast(alert_type_t type,
 /**
  * Send a raw JSON string to a SINGLE client (used for targeted sync replies).
  * The string must NOT include a trailing newline — one is appended automatically.
+ * Never blocks: what the socket does not take is queued for the reactor.
  * @param client_fd  Target client file descriptor.
  * @param json_str   Null-terminated JSON string.
  * @return 0 on success, -1 on error.
@@ -97,6 +122,25 @@ int alert_send_to_client(int client_fd, const char *json_str);
  */
 void alert_server_shutdown(void);
 
+/**
+ * Append the listener and every client, with its partly received command,
+ * to a handover (see handover.h).
+ */
+void alert_server_export(handover_msg_t *msg);
+
+/**
+ * Take over a handed-over server, in place of alert_server_init().
+ * alert_server_attach() then registers the clients as well.
+ * @return 0 on success, -1 on error.
+ */
+int alert_server_adopt(handover_msg_t *msg);
+
+/**
+ * Close every connection but leave the socket path: it belongs to a
+ * successor now.
+ */
+void alert_server_release(void);
+
 /**
  * Broadcast a raw pre-formatted JSON string to ALL connected clients.
  * Use this for one-off event types that don't fit the standard schema.
@@ -109,4 +153,11 @@ void alert_broadcast_raw(const char *json_str);
  */
 int alert_get_client_count(void);
 
+/**
+ * Whether the peer on `client_fd` runs as root or as the daemon's own
+ * user.  The socket is world-writable (ALERT_SOCKET_PERMS), so commands
+ * that change how files are judged, or restart the daemon, check this.
+ */
+int alert_client_privileged(int client_fd);
+
 #endif /* SENTINEL_ALERT_H */
@@ -0,0 +1,97 @@
+/*
+ * catchup.h — Scan what changed while the daemon was not running.
+ *
+ * inotify only reports changes made while it watches, so files written
+ * while the daemon was stopped, crashed or not yet started at boot would
+ * never be scanned.  The daemon therefore keeps a "last good" stamp: the
+ * wall-clock time up to which every change has been seen and either
+ * scanned or journaled.  It is written on a clean shutdown and, while the
+ * pending-work journal is active, checkpointed periodically, so a crash
+ * only costs the time since the last checkpoint.
+ *
+ * On the next start a low-priority parallel sweep of the watch roots
+ * queues every file whose mtime or ctime is newer than the stamp (minus
+ * CATCHUP_SLACK_MS for clock and timestamp granularity).  It runs in the
+ * background after the watches are in place and only feeds the queue
+ * while it is less than half full, so live events keep priority.
+ *
+ * Optional pruning trusts directory timestamps: a directory whose mtime
+ * and ctime predate the stamp has had no entry created, removed or
+ * renamed, so its files are not stat()ed (its subdirectories still are).
+ * Files rewritten in place are then missed, hence opt-in.
+ *
+ * The stamp file holds the time and a state: "clean", "running" (a
+ * checkpoint) or "sweeping" (a sweep since that time is still pending).
+ * A sweep interrupted by a stop, crash or live upgrade is thus redone by
+ * whichever daemon starts next.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_CATCHUP_H
+#define SENTINEL_CATCHUP_H
+
+#include <stdint.h>
+
+#include "journal.h"
+#include "threadpool.h"
+
+/* ── Limits ─────────────────────────────────────────────────────────────── */
+
+#define CATCHUP_STAMP_PATH     JOURNAL_DIR "/last-good"
+
+/* Changes this much older than the stamp are still caught. */
+#define CATCHUP_SLACK_MS       2000
+
+/* Sweep threads (low priority). */
+#define CATCHUP_THREADS        2
+
+/* Sweep back-off while the scan queue is at least half full. */
+#define CATCHUP_THROTTLE_MS    10
+
+/**
+ * Return 1 if the daemon scans files like `path` (name, size), else 0.
+ * Called on the sweep threads.
+ */
+typedef int (*catchup_filter_fn)(const char *path, int64_t size);
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Load the stamp left by the previous run.
+ * @param stamp_path  NULL for CATCHUP_STAMP_PATH.
+ * @return 0 on success, -1 on error.
+ */
+int catchup_init(const char *stamp_path);
+
+/**
+ * Start the background sweep of the NULL-terminated `roots` (copied).
+ * Does nothing without a stamp from a previous run.
+ * @param prune     Skip the files of directories unchanged since the stamp.
+ * @param takeover  After a live upgrade: only finish a sweep the previous
+ *                  daemon left unfinished (there was no downtime).
+ * @return 0 on success (or nothing to do), -1 on error.
+ */
+int catchup_start(const char *const *roots, int prune, threadpool_t *pool,
+                  catchup_filter_fn filter, int takeover);
+
+/**
+ * Stop a running sweep and wait for it.  The sweep stays pending: the
+ * stamp is not advanced, so a successor or the next start redoes it.
+ */
+void catchup_stop(void);
+
+/** Restart a sweep stopped by catchup_stop() from the beginning. */
+void catchup_resume(void);
+
+/**
+ * Record that every change up to `good_ns` (CLOCK_REALTIME) was handled.
+ * `clean` marks a clean shutdown.  While a sweep is pending the previous
+ * stamp is kept.  Written atomically (fdatasync + rename).
+ */
+void catchup_checkpoint(uint64_t good_ns, int clean);
+
+/** catchup_stop() and free everything. */
+void catchup_shutdown(void);
+
+#endif /* SENTINEL_CATCHUP_H */
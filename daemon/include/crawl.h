@@ -0,0 +1,97 @@
+/*
+ * crawl.h — Parallel directory crawler.
+ *
+ * Walks one or more directory trees with a small team of threads that
+ * share a stack of directories still to read.  Every entry is examined
+ * with one statx() relative to its directory fd, asking only for the
+ * fields the caller needs; directories are recognised from d_type and
+ * are never stat()ed unless the caller wants to see them.  Symlinks are
+ * not followed and hidden entries (".name") are skipped, like the
+ * monitor's recursive watch.
+ *
+ * Callbacks run on the crawler threads, concurrently.  The crawl runs in
+ * the background from crawl_start() until it finishes or is cancelled.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_CRAWL_H
+#define SENTINEL_CRAWL_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+/* Default crawler threads. */
+#define CRAWL_THREADS          4
+
+/* Most threads a crawl may use. */
+#define CRAWL_MAX_THREADS      32
+
+/* Return values of crawl_dir_fn. */
+#define CRAWL_ENTER            0   /* Examine the directory's entries      */
+#define CRAWL_SKIP_FILES       1   /* Descend into subdirectories only     */
+#define CRAWL_PRUNE            2   /* Skip the directory entirely          */
+
+/**
+ * A directory is about to be read.  `stx` holds at least STATX_TYPE and
+ * the `dir_mask` fields.  @return CRAWL_ENTER, CRAWL_SKIP_FILES or
+ * CRAWL_PRUNE.
+ */
+typedef int (*crawl_dir_fn)(const char *path, const struct statx *stx,
+                            void *arg);
+
+/**
+ * A regular file.  `stx` holds at least STATX_TYPE and the `file_mask`
+ * fields.  @return 0 to go on, -1 to cancel the whole crawl.
+ */
+typedef int (*crawl_file_fn)(const char *path, const struct statx *stx,
+                             void *arg);
+
+/* Called once, on the last crawler thread, when the crawl has ended. */
+typedef struct crawl_stats crawl_stats_t;
+typedef void (*crawl_done_fn)(const crawl_stats_t *st, void *arg);
+
+typedef struct {
+    int            threads;       /* 0 for CRAWL_THREADS                   */
+    int            low_priority;  /* Nice 19 + idle I/O class per thread   */
+    unsigned int   file_mask;     /* STATX_* wanted for files              */
+    unsigned int   dir_mask;      /* STATX_* wanted for dirs (0: no stat)  */
+    crawl_dir_fn   on_dir;        /* May be NULL (enter everything)        */
+    crawl_file_fn  on_file;
+    crawl_done_fn  on_done;       /* May be NULL                           */
+    void          *arg;
+} crawl_opts_t;
+
+struct crawl_stats {
+    uint64_t dirs;                /* Directories read                      */
+    uint64_t pruned;              /* Dirs pruned or files skipped (on_dir) */
+    uint64_t files;               /* Regular files passed to on_file       */
+    uint64_t errors;              /* Unreadable dirs, failed statx()       */
+    uint64_t elapsed_ns;
+    int      cancelled;
+};
+
+/* Opaque crawl handle */
+typedef struct crawl crawl_t;
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Start crawling the NULL-terminated `roots` in the background.
+ * @return handle, or NULL on error.
+ */
+crawl_t *crawl_start(const char *const *roots, const crawl_opts_t *opts);
+
+/** Ask the crawl to stop soon.  Safe from any thread, including callbacks. */
+void crawl_cancel(crawl_t *c);
+
+/** 1 once crawl_cancel() was called (lets blocking callbacks bail out). */
+int crawl_cancelled(const crawl_t *c);
+
+/** Snapshot of the running totals. */
+void crawl_get_stats(crawl_t *c, crawl_stats_t *out);
+
+/** Wait for the crawl to end (after on_done) and free it.  NULL is a no-op. */
+void crawl_join(crawl_t *c);
+
+#endif /* SENTINEL_CRAWL_H */
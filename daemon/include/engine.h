@@ -0,0 +1,147 @@
+/*
+ * engine.h — Scan engine backends.
+ *
+ * An engine is one way of reaching a verdict on a file: clamd, a hash
+ * allowlist or blocklist, a verdict cache, an IOC pattern list.  Each is a table of
+ * operations (engine_ops_t) plus the state its init() returns.  The
+ * scanner (scanner.h) runs files through a chain of engines, in order,
+ * until one of them decides; an engine that has no opinion passes the
+ * file on.  Engines joined with '|' in the spec race each other on
+ * helper threads instead (see scanner.c).  A new backend is one more
+ * engine_ops_t registered in scanner.c — the worker pipeline does not
+ * change.
+ *
+ * Engines run on worker and race threads, several at once, and must be
+ * thread-safe.  They read the file through the shared engine_file_t
+ * (one open fd per file for the whole chain) with pread() only — racing
+ * engines share the fd, and with it the file offset.  A racing engine
+ * should poll engine_cancelled() between chunks of work and return
+ * ENGINE_PASS once another engine has decided.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_ENGINE_H
+#define SENTINEL_ENGINE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "scanner.h"
+#include "sha256.h"
+
+struct json_object;
+
+/* What one engine made of a file. */
+typedef enum {
+    ENGINE_PASS,                 /* No opinion: ask the next engine        */
+    ENGINE_CLEAN,
+    ENGINE_INFECTED,             /* report->threat_name is set             */
+    ENGINE_ERROR,                /* Engine answered "cannot scan this"     */
+    ENGINE_OFFLINE,              /* Engine unreachable: retry later        */
+    ENGINE_VERDICTS
+} engine_verdict_t;
+
+/* Engine kinds that can decide on any file (a chain should end in one). */
+#define ENGINE_F_TERMINAL  0x1u
+
+/* The file being scanned, shared along the chain. */
+typedef struct {
+    const char  *path;
+    int          fd;             /* Open read-only                         */
+    struct stat  st;             /* fstat() of fd when the chain started   */
+    int          want_sha256;    /* Some engine learns verdicts: fill
+                                    report->sha256 if the bytes pass by    */
+
+    /* Content hash, computed on first use (engine_file_sha256). */
+    int          hashed;         /* 0 not yet, 1 done, -1 read error       */
+    uint8_t      sha256[SHA256_DIGEST_LEN];
+
+    /* Set while engines race; NULL otherwise. */
+    const int       *cancel;     /* Atomic, non-zero: the race is decided  */
+    pthread_mutex_t *hash_lock;  /* Guards hashed / sha256                 */
+} engine_file_t;
+
+typedef struct engine_ops {
+    const char *name;            /* As written in a chain spec             */
+    unsigned    flags;           /* ENGINE_F_*                             */
+
+    /**
+     * Create an instance.  `arg` is the text after "name:" in the spec
+     * (NULL if none).  On failure write a reason to `err`.
+     * @return instance state (non-NULL), or NULL on error.
+     */
+    void *(*init)(const char *arg, char *err, size_t errlen);
+
+    /** Decide on `file`, filling `report` on CLEAN / INFECTED / ERROR. */
+    engine_verdict_t (*scan)(void *self, engine_file_t *file,
+                             scan_report_t *report);
+
+    /** Optional: the chain's final verdict, decided by another engine. */
+    void (*learn)(void *self, engine_file_t *file, const scan_report_t *report);
+
+    /** Optional: 1 if the backend is reachable. */
+    int (*ping)(void *self);
+
+    /** Optional: signature database version, 0 if unknown. */
+    uint32_t (*version)(void *self);
+
+    /**
+     * Optional: re-read the engine's data (e.g. its pattern file) in
+     * place, without disturbing scans in flight.
+     * @return 0, or -1 with a reason in `err` (the old data stays).
+     */
+    int (*reload)(void *self, char *err, size_t errlen);
+
+    /** Optional: add engine-specific figures to a JSON object. */
+    void (*stats)(void *self, struct json_object *out);
+
+    void (*shutdown)(void *self);
+} engine_ops_t;
+
+/* ── Built-in engines ───────────────────────────────────────────────────── */
+
+/* Verdict cache: default entries, and how often it re-reads the
+ * signature version its entries are checked against. */
+#define ENGINE_CACHE_ENTRIES    65536
+#define ENGINE_CACHE_SIGVER_MS  60000
+
+/* IOC engine: pattern limits, compiled automaton limit, read size. */
+#define ENGINE_IOC_MAX_PATTERN   256
+#define ENGINE_IOC_MAX_PATTERNS  100000
+#define ENGINE_IOC_MAX_TABLE_MB  256
+#define ENGINE_IOC_CHUNK         65536
+
+extern const engine_ops_t engine_clamd;       /* clamd:[SOCKET]         */
+extern const engine_ops_t engine_allowlist;   /* allowlist:FILE         */
+extern const engine_ops_t engine_blocklist;   /* blocklist:FILE         */
+extern const engine_ops_t engine_cache;       /* cache[:ENTRIES]        */
+extern const engine_ops_t engine_ioc;         /* ioc:FILE               */
+
+/* ── Helpers for engines ────────────────────────────────────────────────── */
+
+/** 1 once another engine in the race has decided: stop and PASS. */
+static inline int engine_cancelled(const engine_file_t *file)
+{
+    return file->cancel && __atomic_load_n(file->cancel, __ATOMIC_RELAXED);
+}
+
+/**
+ * SHA-256 of the whole file, computed once per chain run (racing
+ * engines share the result).
+ * @return the digest, or NULL on a read error or cancelled race.
+ */
+const uint8_t *engine_file_sha256(engine_file_t *file);
+
+/** Socket used by "clamd" without an argument (scanner_init()). */
+const char *engine_clamd_default_socket(void);
+
+/** Counters shared by every clamd instance, for scanner_get_stats(). */
+void engine_clamd_get_stats(scanner_stats_t *out);
+
+/** Hit and miss counters of every cache instance (survive reloads). */
+void engine_cache_get_stats(scanner_stats_t *out);
+
+#endif /* SENTINEL_ENGINE_H */
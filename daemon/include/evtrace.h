@@ -0,0 +1,98 @@
+/*
+ * evtrace.h — Record and read back the monitor's raw event stream.
+ *
+ * With `--record FILE` the monitor appends every inotify event it
+ * handles (time read, full path, mask, st_size) to a compact binary
+ * trace.  `--replay FILE` (see replay.h) feeds such a trace back into
+ * the pipeline, so a production event storm can be re-run against a
+ * new build.
+ *
+ * File layout: an evtrace_hdr_t, then records of LEB128 varints:
+ *
+ *   dt_ns    time since the previous record (the first: since mono0_ns)
+ *   mask     inotify mask
+ *   size1    st_size + 1, or 0 when the path was not a regular file
+ *   keep     leading bytes shared with the previous record's path
+ *   add      length of the path suffix that follows
+ *   suffix   `add` bytes
+ *
+ * Events arrive in per-directory bursts, so prefix sharing keeps a
+ * typical record to 10–30 bytes.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_EVTRACE_H
+#define SENTINEL_EVTRACE_H
+
+#include <stdint.h>
+
+/* ── Limits & format ────────────────────────────────────────────────────── */
+
+#define EVTRACE_MAGIC      0x31564553u       /* "SEV1" little-endian      */
+#define EVTRACE_VERSION    1
+#define EVTRACE_PATH_MAX   4096
+#define EVTRACE_MAX_BYTES  (512u << 20)      /* Recording stops here      */
+#define EVTRACE_BUF_SIZE   (64u << 10)       /* Write-behind buffer       */
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint64_t mono0_ns;       /* CLOCK_MONOTONIC when recording started    */
+    uint64_t real0_ns;       /* CLOCK_REALTIME at the same instant        */
+} evtrace_hdr_t;
+
+/* One decoded record; `path` is valid until the next evtrace_next(). */
+typedef struct {
+    uint64_t    ts_ns;       /* CLOCK_MONOTONIC of the recording process  */
+    uint32_t    mask;
+    int64_t     size;        /* -1 when not a regular file                */
+    const char *path;
+} evtrace_rec_t;
+
+typedef struct evtrace_reader evtrace_reader_t;
+
+/* ── Recording (reactor thread only) ────────────────────────────────────── */
+
+/**
+ * Start recording to `path` (truncated).
+ * @return 0 on success, -1 on error.
+ */
+int evtrace_start(const char *path);
+
+/** 1 while a recording is open. */
+int evtrace_active(void);
+
+/**
+ * Append one event.  A no-op unless recording; stops the recording with
+ * a warning once EVTRACE_MAX_BYTES have been written.
+ */
+void evtrace_record(uint64_t ts_ns, const char *path, uint32_t mask,
+                    int64_t size);
+
+/** Write out buffered records. */
+void evtrace_flush(void);
+
+/** Flush and close the recording. */
+void evtrace_stop(void);
+
+/* ── Reading ────────────────────────────────────────────────────────────── */
+
+/**
+ * Open a trace for reading.
+ * @param hdr  Receives the header, may be NULL.
+ * @return Reader, or NULL on error (bad magic / version, I/O).
+ */
+evtrace_reader_t *evtrace_open(const char *path, evtrace_hdr_t *hdr);
+
+/**
+ * Decode the next record.
+ * @return 1 with `rec` filled, 0 at end of trace, -1 on a corrupt or
+ *         truncated record.
+ */
+int evtrace_next(evtrace_reader_t *r, evtrace_rec_t *rec);
+
+void evtrace_close(evtrace_reader_t *r);
+
+#endif /* SENTINEL_EVTRACE_H */
@@ -0,0 +1,109 @@
+/*
+ * flightrec.h — Always-on binary flight recorder for pipeline events.
+ *
+ * Every thread that records gets its own fixed-size ring of 64-byte
+ * records, so recording is a handful of stores with no locks and no
+ * shared cache lines.  The rings are dumped to disk on SIGUSR2 or on a
+ * fatal signal and decoded offline with `sentinel-frdecode`.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_FLIGHTREC_H
+#define SENTINEL_FLIGHTREC_H
+
+#include <stdint.h>
+
+/* Records per thread ring (power of two). 4096 × 64 B = 256 KB/thread. */
+#define FR_RING_RECORDS   4096
+
+/* Maximum number of live threads that can own a ring (an exited
+ * thread's ring passes to the next new one). */
+#define FR_MAX_RINGS      64
+
+/* Bytes of the path tail kept in each record. */
+#define FR_PATH_TAIL      40
+
+/* Dump destinations. */
+#define FR_DUMP_PATH       "/var/log/sentinel-flightrec.bin"
+#define FR_CRASH_DUMP_PATH "/var/log/sentinel-flightrec.crash.bin"
+
+/* ── Pipeline events ────────────────────────────────────────────────────── */
+
+typedef enum {
+    FR_EV_NONE = 0,
+    FR_EV_EVENT_RECEIVED,    /* inotify event read       (arg = mask)       */
+    FR_EV_ENQUEUED,          /* threadpool_submit()      (arg = depth)      */
+    FR_EV_DEQUEUED,          /* worker took the item     (arg = depth)      */
+    FR_EV_SCAN_START,        /* scanner_scan_file() in   (arg unused)       */
+    FR_EV_SCAN_END,          /* clamd replied            (arg = bytes sent) */
+    FR_EV_VERDICT,           /* worker decided (arg = scan_result_t, or
+                              * FR_VERDICT_OFFLINE for scanner lockdown)  */
+    FR_EV_QUARANTINE,        /* quarantine_file() done   (arg = 0 ok, 1 err)*/
+    FR_EV_COUNT
+} fr_event_t;
+
+/* FR_EV_VERDICT argument when clamd stayed unreachable after all retries. */
+#define FR_VERDICT_OFFLINE 0xff
+
+/* ── Binary formats (shared with tools/fr_decode.c) ─────────────────────── */
+
+/* One ring record — exactly one cache line. */
+typedef struct {
+    uint64_t ts;                     /* TSC ticks or CLOCK_MONOTONIC ns   */
+    uint64_t arg;                    /* Event-specific argument           */
+    uint32_t path_hash;              /* Hash of the full path             */
+    uint16_t event;                  /* fr_event_t                        */
+    uint16_t path_len;               /* Full path length (may exceed tail)*/
+    char     path_tail[FR_PATH_TAIL];/* Last bytes of the path, not NUL'd */
+} fr_record_t;
+
+#define FR_DUMP_MAGIC   0x31524653u  /* "SFR1" little-endian */
+#define FR_CLOCK_MONO   0            /* ts is CLOCK_MONOTONIC ns          */
+#define FR_CLOCK_TSC    1            /* ts is TSC ticks, see calibration  */
+
+/* Dump file header, followed by `nrings` × (fr_ring_hdr_t + records). */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;                /* 1                                 */
+    uint16_t clock;                  /* FR_CLOCK_*                        */
+    uint32_t record_size;            /* sizeof(fr_record_t)               */
+    uint32_t ring_records;           /* FR_RING_RECORDS                   */
+    uint32_t nrings;
+    uint32_t pid;
+    /* Calibration pairs: (ts, CLOCK_MONOTONIC ns, CLOCK_REALTIME ns) at
+     * recorder start and at dump time.  Lets the decoder turn TSC ticks
+     * into nanoseconds and monotonic time into wall-clock time. */
+    uint64_t ts0, mono0_ns, real0_ns;
+    uint64_t ts1, mono1_ns, real1_ns;
+} fr_dump_hdr_t;
+
+typedef struct {
+    uint32_t tid;                    /* Kernel thread ID of the owner     */
+    uint32_t reserved;
+    uint64_t head;                   /* Records written by the owner      */
+} fr_ring_hdr_t;
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Initialise the recorder (calibration, fatal-signal handlers).  SIGUSR2
+ * is not handled here: the daemon's reactor routes it to fr_dump().
+ * Recording before fr_init() is harmless but timestamps are uncalibrated.
+ */
+void fr_init(void);
+
+/**
+ * Append one record to the calling thread's ring.  Lock-free, never
+ * blocks, never fails (silently no-ops if the ring cannot be allocated).
+ */
+void fr_record(fr_event_t event, const char *path, uint64_t arg);
+
+/**
+ * Write all rings to `path`.  Async-signal-safe (open/write/close only),
+ * so it may be called from a signal handler.
+ * @return 0 on success, -1 on error.
+ */
+int fr_dump(const char *path);
+
+#endif /* SENTINEL_FLIGHTREC_H */
@@ -0,0 +1,118 @@
+/*
+ * fsindex.h — Persistent file-state index.
+ *
+ * One record per file the daemon has found clean, keyed by (dev, ino):
+ * size, mtime, ctime, the clamd signature version of the verdict, an
+ * optional SHA-256 of the content and the full-scan sweep that last
+ * covered it.  A scheduled full scan (fullscan.h) uses it to skip files
+ * that have not changed since a verdict from current signatures.
+ *
+ * The index lives in memory (an open-addressing hash table) and is
+ * saved whole, atomically (write ".tmp", fdatasync, rename), during and
+ * after sweeps and on shutdown.  Losing recent records only costs
+ * rescans.  The header also carries the sweep schedule, so an
+ * interrupted sweep resumes after a restart.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_FSINDEX_H
+#define SENTINEL_FSINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "journal.h"
+#include "sha256.h"
+
+#define FSINDEX_PATH           JOURNAL_DIR "/fsindex"
+
+#define FSINDEX_MAGIC          0x31495346u      /* "FSI1" little-endian   */
+#define FSINDEX_VERSION        1
+
+/* Initial hash table slots (power of two); grows at 70% load. */
+#define FSINDEX_INITIAL_SLOTS  (1u << 14)
+
+/* One file.  Also the on-disk record. */
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;                /* 0: empty slot                          */
+    int64_t  size;
+    uint64_t mtime_ns;
+    uint64_t ctime_ns;
+    uint32_t sigver;             /* clamd database version of the verdict  */
+    uint32_t sweep;              /* Last sweep that covered the file       */
+    uint8_t  sha256[SHA256_DIGEST_LEN];
+    uint8_t  has_hash;
+    uint8_t  reserved[7];
+} fsindex_rec_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;              /* Records that follow                    */
+    uint32_t sweep;              /* Current (or last) sweep number         */
+    uint32_t sweeping;           /* 1 while that sweep is unfinished       */
+    uint64_t last_done_ns;       /* CLOCK_REALTIME end of the last sweep   */
+} fsindex_hdr_t;
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Load the index (an empty one if the file does not exist yet).
+ * @param path  NULL for FSINDEX_PATH.
+ * @return 0 on success, -1 on error (the daemon runs without an index).
+ */
+int fsindex_init(const char *path);
+
+/** 1 while an index is loaded. */
+int fsindex_active(void);
+
+/** Copy the record for (dev, ino) into `out`.  @return 1 found, 0 not. */
+int fsindex_lookup(uint64_t dev, uint64_t ino, fsindex_rec_t *out);
+
+/** Insert or replace the record for (rec->dev, rec->ino). */
+void fsindex_put(const fsindex_rec_t *rec);
+
+/**
+ * Record a clean verdict for `path` from signatures `sigver`.  `before`
+ * is the file's stat from before the scan: if its size or mtime has
+ * changed since, the verdict is about old content and is not recorded.
+ * A known hash is kept while size and mtime match.  Any thread.
+ */
+void fsindex_record_clean(const char *path, const struct stat *before,
+                          uint32_t sigver);
+
+/**
+ * Attach a content hash to the record for (dev, ino) if it still
+ * describes a file of that size and mtime.
+ */
+void fsindex_set_hash(uint64_t dev, uint64_t ino, int64_t size,
+                      uint64_t mtime_ns,
+                      const uint8_t hash[SHA256_DIGEST_LEN]);
+
+/** Sweep schedule, as stored in the header. */
+void fsindex_get_sweep(uint32_t *sweep, int *sweeping,
+                       uint64_t *last_done_ns);
+
+/** Start sweep number sweep + 1.  @return its number. */
+uint32_t fsindex_begin_sweep(void);
+
+/**
+ * Finish the current sweep at `now_ns`: records it did not cover (files
+ * deleted or no longer eligible) are dropped.
+ * @return number of records dropped.
+ */
+size_t fsindex_end_sweep(uint64_t now_ns);
+
+/** Number of records. */
+size_t fsindex_count(void);
+
+/** Write the index to disk.  @return 0 on success, -1 on error. */
+int fsindex_save(void);
+
+/** Free the index, saving it first if `save`. */
+void fsindex_shutdown(int save);
+
+#endif /* SENTINEL_FSINDEX_H */
@@ -0,0 +1,93 @@
+/*
+ * fullscan.h — Scheduled incremental full scans of the watch roots.
+ *
+ * Every `interval` hours one low-priority thread walks the watch roots
+ * and decides per file from the file-state index (fsindex.h):
+ *
+ *   - covered by this sweep already (resumed sweep, or a live scan)  skip
+ *   - same size, mtime and ctime, verdict from current signatures    skip
+ *   - metadata changed but same SHA-256, current signatures          skip
+ *   - anything else (new, changed, or signatures updated since)      scan
+ *
+ * Scans run one at a time on the sweep thread, through the daemon's own
+ * pipeline (so threats are quarantined exactly as for live events), and
+ * are paced by two budgets: bytes read per second (hashing + scanning)
+ * and the fraction of one CPU spent hashing and waiting for clamd.
+ *
+ * The sweep number and whether it is finished are kept in the index, so
+ * a sweep cut short by a stop, crash or live upgrade resumes where its
+ * files are not yet marked, instead of starting over.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_FULLSCAN_H
+#define SENTINEL_FULLSCAN_H
+
+#include <stdint.h>
+
+/* ── Defaults ───────────────────────────────────────────────────────────── */
+
+/* Hours between the end of one sweep and the start of the next. */
+#define FULLSCAN_INTERVAL_H    24
+
+/* I/O budget: MiB read per second.  0 = unlimited. */
+#define FULLSCAN_IO_MBPS       16
+
+/* CPU budget: percent of one core.  0 or 100 = unlimited. */
+#define FULLSCAN_CPU_PCT       25
+
+/* How often the daemon checks whether a sweep is due. */
+#define FULLSCAN_CHECK_MS      60000
+
+/* Index checkpoint interval during a sweep. */
+#define FULLSCAN_SAVE_MS       300000
+
+/* Budget left unused for this long is forfeited (no catch-up bursts). */
+#define FULLSCAN_BURST_MS      1000
+
+/* Before the first sweep, how often a worker may ask clamd for the
+ * signature version live verdicts are recorded under. */
+#define FULLSCAN_SIGVER_RETRY_MS 60000
+
+/** Return 1 if the daemon scans files like `path` (name, size). */
+typedef int (*fullscan_filter_fn)(const char *path, int64_t size);
+
+/**
+ * Scan `path` now, on the calling thread, through the full verdict
+ * pipeline (quarantine, alerts, index update on a clean verdict).
+ */
+typedef void (*fullscan_scan_fn)(const char *path, void *arg);
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Configure the scheduler.  Needs an active file-state index.
+ * @param roots     NULL-terminated watch roots (copied).
+ * @param interval_h  Hours between sweeps; 0 disables scheduling.
+ * @param io_mbps   I/O budget, MiB/s (0 = unlimited).
+ * @param cpu_pct   CPU budget, percent of one core (0 = unlimited).
+ * @return 0 on success, -1 on error.
+ */
+int fullscan_init(const char *const *roots, unsigned interval_h,
+                  unsigned io_mbps, unsigned cpu_pct,
+                  fullscan_filter_fn filter, fullscan_scan_fn scan,
+                  void *arg);
+
+/** Reactor tick: start or resume a sweep when due, reap a finished one. */
+void fullscan_tick(void);
+
+/**
+ * Signature version verdicts are recorded under (refreshed from clamd
+ * at the start of every sweep).  0 until known; before the first sweep
+ * a call may ask clamd itself, so call it from workers, not the reactor.
+ */
+uint32_t fullscan_sigver(void);
+
+/** Stop a running sweep, wait for it and save the index. */
+void fullscan_stop(void);
+
+/** Stop and free; the index is saved unless `save` is 0. */
+void fullscan_shutdown(int save);
+
+#endif /* SENTINEL_FULLSCAN_H */
@@ -0,0 +1,183 @@
+/*
+ * handover.h — Zero-downtime upgrade: hand the live daemon's state over.
+ *
+ * A running daemon listens on a private control socket.  A new daemon
+ * started with --takeover first does its slow initialisation (manifest,
+ * scanner, pool) while the old one keeps protecting, then connects and
+ * asks for the rest:
+ *
+ *   1. The old daemon freezes: stops reading inotify, stops serving IPC,
+ *      pauses its workers and waits for in-flight scans to finish.  The
+ *      kernel keeps queueing inotify events meanwhile.
+ *   2. It sends its fds (inotify, IPC listener and clients, metrics
+ *      listener, this control socket) via SCM_RIGHTS, with the state
+ *      that goes with them: wd → path map, inotify events read but not
+ *      yet delivered, queued scan paths.
+ *   3. The new daemon adopts all of it and acknowledges.  The old one
+ *      drops its queue, tells systemd the new main PID and exits without
+ *      unlinking any socket.  Without the acknowledgement (the new daemon
+ *      failed or died) the old one resumes where it stopped.
+ *
+ * Nothing is walked or re-bound, and no inotify event is lost: the watch
+ * set lives in the kernel with the inotify fd.
+ *
+ * The state travels as one message: a handover_hdr_t carrying the fds,
+ * then `payload_len` bytes of sections written with the handover_put_*()
+ * helpers.  Each module exports and adopts its own section; the order is
+ * fixed and every section starts with its tag.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_HANDOVER_H
+#define SENTINEL_HANDOVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "reactor.h"
+
+/* ── Socket & limits ────────────────────────────────────────────────────── */
+
+/* Control socket.  Root only: whoever connects gets every fd. */
+#define HANDOVER_SOCKET_PATH   "/tmp/sentinel_handover.sock"
+#define HANDOVER_SOCKET_PERMS  0600
+
+#define HANDOVER_MAGIC         0x4f564853u      /* "SHVO" little-endian   */
+#define HANDOVER_VERSION       2
+
+/* inotify, metrics, control socket, IPC listener and clients. */
+#define HANDOVER_MAX_FDS       32
+
+/* Upper bound on the state message (1M watches at 4 KiB paths). */
+#define HANDOVER_MAX_PAYLOAD   (256u << 20)
+
+/* Old daemon: longest wait for in-flight scans before refusing. */
+#define HANDOVER_DRAIN_MS      30000
+
+/* Either side: longest wait for the peer's next message. */
+#define HANDOVER_TIMEOUT_MS    30000
+
+/* Section tags, in payload order (the order the new daemon adopts in). */
+#define HANDOVER_TAG_IPC       0x20435049u      /* "IPC " */
+#define HANDOVER_TAG_METRICS   0x5254454du      /* "METR" */
+#define HANDOVER_TAG_CONTROL   0x4c525443u      /* "CTRL" */
+#define HANDOVER_TAG_MONITOR   0x544e4f4du      /* "MONT" */
+#define HANDOVER_TAG_QUEUE     0x45555551u      /* "QUEU" */
+
+/* ── Wire format ────────────────────────────────────────────────────────── */
+
+/* New → old: the takeover request. */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} handover_req_t;
+
+/* Old → new: sent with the fds attached; `status` 0 or an errno. */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t  status;
+    uint32_t nfds;
+    uint64_t payload_len;
+} handover_hdr_t;
+
+/* ── State message ──────────────────────────────────────────────────────── */
+
+/*
+ * Built by the old daemon with handover_put_*(), consumed in the same
+ * order by the new one with handover_get_*().  Getters fail (return -1)
+ * once the message is exhausted or malformed and stay failed, so an
+ * adopter can check once at the end of its section.
+ */
+typedef struct {
+    uint8_t *data;
+    size_t   len;
+    size_t   cap;
+    size_t   pos;                       /* Read cursor                   */
+    int      fds[HANDOVER_MAX_FDS];     /* -1 once claimed or closed     */
+    int      nfds;
+    int      nfds_read;                 /* Read cursor into fds          */
+    int      owns_fds;                  /* Received, not borrowed        */
+    int      error;                     /* Sticky: overflow / bad input  */
+} handover_msg_t;
+
+void handover_put_u32(handover_msg_t *m, uint32_t v);
+void handover_put_u64(handover_msg_t *m, uint64_t v);
+void handover_put_bytes(handover_msg_t *m, const void *p, size_t n);
+/** Length-prefixed string. */
+void handover_put_str(handover_msg_t *m, const char *s);
+/** Attach an fd.  The caller keeps it; the peer receives a duplicate. */
+void handover_put_fd(handover_msg_t *m, int fd);
+
+int handover_get_u32(handover_msg_t *m, uint32_t *v);
+int handover_get_u64(handover_msg_t *m, uint64_t *v);
+/** Point `*p` at the next `n` bytes inside the message. */
+int handover_get_bytes(handover_msg_t *m, const void **p, size_t n);
+/** Copy a string into `out`; fails if it does not fit. */
+int handover_get_str(handover_msg_t *m, char *out, size_t outlen);
+/** Claim the next fd; the caller owns it from now on. */
+int handover_get_fd(handover_msg_t *m, int *fd);
+/** Read a section tag and check it.  @return 0 or -1. */
+int handover_expect(handover_msg_t *m, uint32_t tag);
+
+/** Close unclaimed fds and free the buffer. */
+void handover_msg_free(handover_msg_t *m);
+
+/* ── Old daemon ─────────────────────────────────────────────────────────── */
+
+/**
+ * Freeze and describe the daemon.  Append every section (in tag order)
+ * to `msg`.  @return 0, or -1 to refuse.
+ */
+typedef int (*handover_export_fn)(handover_msg_t *msg, void *arg);
+
+/**
+ * Outcome of a handover; called once after every export, even a refused
+ * one.  committed == 1: `peer` now owns everything; drop queued work and
+ * stop.  committed == 0: unfreeze and carry on.
+ */
+typedef void (*handover_done_fn)(int committed, pid_t peer, void *arg);
+
+/**
+ * Bind the control socket (NULL for HANDOVER_SOCKET_PATH) and serve
+ * takeover requests on the reactor.  The whole exchange runs inside the
+ * reactor callback: the daemon is frozen for its duration anyway.
+ * @return 0 on success, -1 on error.
+ */
+int handover_listen(reactor_t *r, const char *socket_path,
+                    handover_export_fn export_fn, handover_done_fn done_fn,
+                    void *arg);
+
+/** Append the control socket section (the listener itself). */
+void handover_export(handover_msg_t *msg);
+
+/** Close the control socket; with `unlink_path`, remove its path too. */
+void handover_close(int unlink_path);
+
+/* ── New daemon ─────────────────────────────────────────────────────────── */
+
+/**
+ * Connect to the running daemon and receive its state.
+ * @return 0 with `msg` filled (the connection stays open until
+ *         handover_commit() / handover_abort()), 1 if no daemon is
+ *         listening, -1 on error.
+ */
+int handover_request(const char *socket_path, handover_msg_t *msg);
+
+/**
+ * Adopt the control socket section and serve future takeovers from it.
+ * @return 0 on success, -1 on error.
+ */
+int handover_adopt(handover_msg_t *msg, reactor_t *r,
+                   handover_export_fn export_fn, handover_done_fn done_fn,
+                   void *arg);
+
+/** Acknowledge: the old daemon exits.  @return 0, or -1 if it is gone. */
+int handover_commit(void);
+
+/** Drop the connection without acknowledging: the old daemon resumes. */
+void handover_abort(void);
+
+#endif /* SENTINEL_HANDOVER_H */
@@ -0,0 +1,118 @@
+/*
+ * journal.h — Persistent pending-work journal.
+ *
+ * Every path the thread pool accepts gets a work ID and an ADD record;
+ * every job a worker finishes gets a DONE record.  Work that is ADDed
+ * but not DONE when the daemon stops — queued, in flight, or lost to a
+ * crash — is handed back on the next start and re-queued at the front,
+ * so a restart costs only the unfinished work.
+ *
+ * Records are appended to an in-memory buffer and written by a commit
+ * thread every JOURNAL_COMMIT_MS with one write() + fdatasync() for the
+ * whole batch (group commit).  A crash can therefore lose the records of
+ * the last commit interval; work queued in that window is covered by the
+ * downtime catch-up on the next start, like events that arrive while the
+ * daemon is down.
+ *
+ * File layout: a journal_hdr_t, then journal_rec_t records, each ADD
+ * followed by `len` path bytes.  A record whose CRC does not match ends
+ * the file (torn write).  On open, and whenever the file grows past
+ * JOURNAL_COMPACT_BYTES, it is rewritten with only the outstanding ADDs
+ * (write to ".tmp", fsync, rename), so its size tracks the backlog, not
+ * the uptime.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_JOURNAL_H
+#define SENTINEL_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* ── Limits & format ────────────────────────────────────────────────────── */
+
+#define JOURNAL_DIR            "/var/lib/sentinel"
+#define JOURNAL_PATH           JOURNAL_DIR "/pending.journal"
+
+#define JOURNAL_MAGIC          0x314a5053u      /* "SPJ1" little-endian   */
+#define JOURNAL_VERSION        1
+
+/* Group-commit interval. */
+#define JOURNAL_COMMIT_MS      20
+
+/* Compact once the file is this large and mostly DONE work. */
+#define JOURNAL_COMPACT_BYTES  (1u << 20)
+
+/* Buckets in the outstanding-work map (ID → path). */
+#define JOURNAL_BUCKETS        1024
+
+#define JOURNAL_REC_ADD        1
+#define JOURNAL_REC_DONE       2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} journal_hdr_t;
+
+typedef struct {
+    uint32_t crc;            /* CRC-32 of the rest of the record + path   */
+    uint8_t  type;           /* JOURNAL_REC_*                             */
+    uint8_t  reserved;
+    uint16_t len;            /* ADD: path bytes that follow               */
+    uint64_t id;
+} journal_rec_t;
+
+/* Work left over from the previous run, oldest first. */
+typedef struct {
+    uint64_t id;
+    char    *path;
+} journal_entry_t;
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Open (creating if needed) and replay the journal, compact it and start
+ * the commit thread.
+ * @param path  NULL for JOURNAL_PATH.
+ * @return 0 on success, -1 on error (the daemon runs without a journal).
+ */
+int journal_init(const char *path);
+
+/** 1 while a journal is open. */
+int journal_active(void);
+
+/**
+ * Take the work left over from the previous run (still outstanding: the
+ * caller re-queues each entry under its ID and the pool marks it DONE).
+ * @return number of entries; free with journal_free_entries().
+ */
+size_t journal_take_recovered(journal_entry_t **out);
+
+void journal_free_entries(journal_entry_t *entries, size_t n);
+
+/**
+ * Record newly accepted work.  Thread-safe; never blocks on I/O.
+ * @return the work ID, or 0 when no journal is open.
+ */
+uint64_t journal_add(const char *path);
+
+/** Record finished work.  No-op for ID 0. */
+void journal_done(uint64_t id);
+
+/**
+ * Commit everything recorded so far and wait for it to be durable.
+ * @return 0, or -1 if the journal is closed or the commit failed.
+ */
+int journal_sync(void);
+
+/** Number of outstanding work items. */
+size_t journal_outstanding(void);
+
+/**
+ * Commit, stop the commit thread and close.  Outstanding work stays in
+ * the file for the next start.
+ */
+void journal_shutdown(void);
+
+#endif /* SENTINEL_JOURNAL_H */
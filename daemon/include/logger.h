@@ -7,20 +7,55 @@
 #define SENTINEL_LOGGER_H
 
 #include <stdio.h>
+#include <stddef.h>
 
 /* Log severity levels */
 typedef enum {
     LOG_LVL_INFO,
     LOG_LVL_WARN,
-    LOG_LVL_ERROR
+    LOG_LVL_ERROR,
+    LOG_LVL_COUNT            /* Number of levels (not a real level) */
 } log_level_t;
 
 /* Default log file path */
 #define SENTINEL_LOG_FILE "/var/log/sentinel.log"
 
-/* Maximum log file size before rotation (5 MB) */
+/* Maximum log file size before rotation (5 MB).  The daemon reads an
+ * override of this and of the generation count from SENTINEL_LOG_ROTATE. */
 #define SENTINEL_LOG_MAX_SIZE (5 * 1024 * 1024)
 
+/* Maximum age of the live log file before rotation (24 h, 0 = never) */
+#define SENTINEL_LOG_MAX_AGE (24 * 3600)
+
+/* Number of archived generations kept (sentinel.log.1.gz ... .N.gz) */
+#define SENTINEL_LOG_GENERATIONS 10
+
+/* Total bytes allowed across archived generations (0 = unbounded) */
+#define SENTINEL_LOG_RETAIN_BYTES (64 * 1024 * 1024)
+
+/* Longest formatted message body; longer messages are truncated. */
+#define SENTINEL_LOG_LINE_MAX 4096
+
+/* Default token-bucket policy for rate-limited call sites (per level);
+ * the daemon reads an override from SENTINEL_LOG_RATE_LIMIT. */
+#define SENTINEL_LOG_RL_PER_SEC 10
+#define SENTINEL_LOG_RL_BURST   20
+
+/*
+ * Per-call-site rate-limit state.  One static instance lives at each
+ * log_*_rl() call site (see the macros below); zero-initialised storage
+ * is a valid starting state.  All fields are owned by logger.c.
+ */
+typedef struct log_ratelimit {
+    const char            *fmt;         /* Call-site format, for summaries  */
+    log_level_t            level;
+    double                 tokens;      /* Remaining burst budget           */
+    long long              last_ns;     /* Last refill (CLOCK_MONOTONIC)    */
+    unsigned long          suppressed;  /* Dropped since last emitted line  */
+    int                    registered;
+    struct log_ratelimit  *next;        /* Registry of known call sites     */
+} log_ratelimit_t;
+
 /**
  * Initialise the logging subsystem.
  * Opens syslog and the log file.
@@ -28,6 +63,43 @@ typedef enum {
  */
 int logger_init(const char *log_path);
 
+/**
+ * Override the rotation policy.  Zero max_bytes / generations keep the
+ * current value; zero max_age_s disables time-based rotation and zero
+ * retain_bytes disables the total-bytes budget.
+ */
+void logger_set_rotation(size_t max_bytes, unsigned max_age_s,
+                         int generations, size_t retain_bytes);
+
+/**
+ * Enable or disable a monotonic "+sec.usec" field on every file line.
+ * Useful for latency analysis — wall-clock seconds alone cannot order
+ * events inside the same second.  Off by default.
+ */
+void logger_set_monotonic(int enable);
+
+/**
+ * Set the token-bucket policy applied to rate-limited call sites at the
+ * given level.  per_sec == 0 disables rate limiting for that level.
+ */
+void logger_set_rate_limit(log_level_t level, unsigned per_sec, unsigned burst);
+
+/**
+ * Apply a comma-separated rate-limit spec: "PER_SEC[:BURST]" sets every
+ * level, "LEVEL=PER_SEC[:BURST]" (info, warn, error) one level, later
+ * items override earlier ones, e.g. "10,warn=20,error=50:100".  BURST
+ * defaults to twice PER_SEC.
+ * @return 0, or -1 if the spec is malformed (nothing is applied).
+ */
+int logger_set_rate_limits(const char *spec);
+
+/**
+ * Emit "message repeated N times" summaries for every call site (and the
+ * duplicate-line collapser) that has suppressed output since its last
+ * line.  Called from logger_shutdown(); safe to call periodically.
+ */
+void logger_flush_suppressed(void);
+
 /**
  * Shut down the logging subsystem.
  * Closes syslog and the log file handle.
@@ -41,9 +113,29 @@ void logger_shutdown(void);
 void logger_log(log_level_t level, const char *fmt, ...)
     __attribute__((format(printf, 2, 3)));
 
+/**
+ * Rate-limited variant of logger_log() for a single call site.
+ * Lines over the site's token budget are counted, not formatted, and
+ * reported later as one "repeated N times" summary.
+ */
+void logger_log_ratelimited(log_ratelimit_t *rl, log_level_t level,
+                            const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
 /* Convenience macros */
 #define log_info(...)  logger_log(LOG_LVL_INFO,  __VA_ARGS__)
 #define log_warn(...)  logger_log(LOG_LVL_WARN,  __VA_ARGS__)
 #define log_error(...) logger_log(LOG_LVL_ERROR, __VA_ARGS__)
 
+/* Rate-limited macros — use on paths that can fire in a storm. */
+#define logger_log_rl(level, ...)                                   \
+    do {                                                            \
+        static log_ratelimit_t rl_site_;                            \
+        logger_log_ratelimited(&rl_site_, (level), __VA_ARGS__);    \
+    } while (0)
+
+#define log_info_rl(...)  logger_log_rl(LOG_LVL_INFO,  __VA_ARGS__)
+#define log_warn_rl(...)  logger_log_rl(LOG_LVL_WARN,  __VA_ARGS__)
+#define log_error_rl(...) logger_log_rl(LOG_LVL_ERROR, __VA_ARGS__)
+
 #endif /* SENTINEL_LOGGER_H */
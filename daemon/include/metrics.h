@@ -0,0 +1,135 @@
+/*
+ * metrics.h — In-process metrics registry with Prometheus text exposition.
+ *
+ * Counters and latency histograms are sharded per thread: the hot path
+ * is a plain load/add/store on the calling thread's own cache lines, with
+ * no locks and no locked instructions.  Shards are summed only when the
+ * registry is scraped.  Values the daemon already tracks elsewhere
+ * (queue depth, watch count, …) are exported through sampling callbacks.
+ *
+ * The registry is served on a dedicated UNIX socket.  A client may send a
+ * plain HTTP GET (curl --unix-socket) or any single line; the reply is the
+ * Prometheus text format (version 0.0.4).
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_METRICS_H
+#define SENTINEL_METRICS_H
+
+#include <stdint.h>
+
+#include "reactor.h"
+#include "handover.h"
+
+/* ── Limits & defaults ──────────────────────────────────────────────────── */
+
+#define METRICS_SOCKET_PATH    "/tmp/sentinel_metrics.sock"
+#define METRICS_SOCKET_PERMS   0660
+
+#define METRICS_MAX_COUNTERS   64
+#define METRICS_MAX_HISTOGRAMS 16
+#define METRICS_MAX_SAMPLED    32
+
+/* Threads that get a private shard; later threads share an atomic one. */
+#define METRICS_MAX_THREADS    64
+
+/*
+ * Histogram layout (HDR-style log-linear): values are nanoseconds; every
+ * power of two is split into 2^METRICS_HIST_SUB_BITS equal sub-buckets,
+ * i.e. ≤ 12.5 % relative error.  Values ≥ 2^(METRICS_HIST_MAX_MSB+1) ns
+ * (~36 min) land in the last bucket.
+ */
+#define METRICS_HIST_SUB_BITS  3
+#define METRICS_HIST_MAX_MSB   40
+#define METRICS_HIST_BUCKETS \
+    ((METRICS_HIST_MAX_MSB - METRICS_HIST_SUB_BITS + 2) << METRICS_HIST_SUB_BITS)
+
+/* ── Types ──────────────────────────────────────────────────────────────── */
+
+typedef enum {
+    METRICS_COUNTER,
+    METRICS_GAUGE
+} metrics_type_t;
+
+/** Sampling callback for values owned by another module. */
+typedef double (*metrics_sample_fn)(void *arg);
+
+/** Merged view of one histogram across all threads. */
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t buckets[METRICS_HIST_BUCKETS];
+} metrics_hist_snapshot_t;
+
+/* ── Registration ───────────────────────────────────────────────────────── */
+
+/*
+ * `name` and `help` must be string literals (they are not copied).  A name
+ * may carry labels, e.g. "sentinel_scans_total{result=\"clean\"}"; series
+ * of one family must be registered back to back so HELP/TYPE is emitted
+ * once.  All registration functions return an ID >= 0, or -1 if the
+ * registry is full — recording with ID -1 is a harmless no-op, so call
+ * sites need no error handling.
+ */
+
+int metrics_counter(const char *name, const char *help);
+int metrics_histogram(const char *name, const char *help);
+int metrics_sampled(const char *name, const char *help,
+                    metrics_type_t type, metrics_sample_fn fn, void *arg);
+
+/* ── Recording (lock-free, any thread) ──────────────────────────────────── */
+
+void metrics_add(int counter_id, uint64_t n);
+void metrics_observe_ns(int hist_id, uint64_t ns);
+
+static inline void metrics_inc(int counter_id) { metrics_add(counter_id, 1); }
+
+/** CLOCK_MONOTONIC in nanoseconds, for timing observations. */
+uint64_t metrics_now_ns(void);
+
+/* ── Reading ────────────────────────────────────────────────────────────── */
+
+/** Sum a counter across all threads. */
+uint64_t metrics_counter_value(int counter_id);
+
+/** Merge a histogram across all threads.  @return 0, or -1 on bad ID. */
+int metrics_hist_snapshot(int hist_id, metrics_hist_snapshot_t *out);
+
+/** Value (ns) at quantile q ∈ [0,1] of a snapshot; 0 if empty. */
+uint64_t metrics_hist_quantile(const metrics_hist_snapshot_t *snap, double q);
+
+/**
+ * Render the whole registry in Prometheus text format.
+ * @return malloc()'d NUL-terminated string (caller frees), or NULL.
+ */
+char *metrics_render(void);
+
+/* ── Exposition server ──────────────────────────────────────────────────── */
+
+/**
+ * Create the metrics listening socket.
+ * @param socket_path  NULL for METRICS_SOCKET_PATH.
+ * @return 0 on success, -1 on error.
+ */
+int metrics_server_init(const char *socket_path);
+
+/** Register the listening socket with the daemon's reactor. */
+int metrics_server_attach(reactor_t *r);
+
+/** Close the socket and unlink its path. */
+void metrics_server_shutdown(void);
+
+/** Append the listener to a handover (see handover.h). */
+void metrics_server_export(handover_msg_t *msg);
+
+/**
+ * Take over a handed-over listener, in place of metrics_server_init().
+ * @return 0 on success, -1 on error.
+ */
+int metrics_server_adopt(handover_msg_t *msg);
+
+/** Close the socket but leave its path: it belongs to a successor now. */
+void metrics_server_release(void);
+
+#endif /* SENTINEL_METRICS_H */
@@ -8,10 +8,29 @@
 
 #include <stdint.h>
 
+#include "handover.h"
+
+/* Return values for monitor_callback_t. */
+#define MONITOR_CB_OK    0   /* Event consumed (queued or filtered out)     */
+#define MONITOR_CB_BUSY  1   /* Downstream full — redeliver this event later */
+
+/* Return value of monitor_process_events() when a callback pushed back. */
+#define MONITOR_BUSY     1
+
+/* A regular-file event, as handed to the callback. */
+typedef struct {
+    const char *path;        /* Full absolute path to the file            */
+    uint32_t    mask;        /* inotify mask (IN_CLOSE_WRITE, …)          */
+    uint64_t    ts_ns;       /* CLOCK_MONOTONIC time the event was read   */
+    int64_t     size;        /* st_size at dispatch time                  */
+} monitor_event_t;
+
 /* Callback invoked when a file event is detected.
- * @param filepath  Full absolute path to the new/modified file.
- * @param user_data Opaque pointer passed during monitor_start(). */
-typedef void (*monitor_callback_t)(const char *filepath, void *user_data);
+ * @param ev        The event; valid only for the duration of the call.
+ * @param user_data Opaque pointer passed during monitor_create().
+ * @return MONITOR_CB_OK, or MONITOR_CB_BUSY to have the same event
+ *         redelivered on the next monitor_process_events() call. */
+typedef int (*monitor_callback_t)(const monitor_event_t *ev, void *user_data);
 
 /* Opaque monitor context */
 typedef struct monitor_ctx monitor_ctx_t;
@@ -28,16 +47,43 @@ monitor_ctx_t *monitor_create(const char **dirs,
                               void *user_data);
 
 /**
- * Enter the blocking event loop.
- * Returns only on error or when monitor_stop() is called from another thread.
- * @return 0 on clean shutdown, -1 on error.
+ * Return the (non-blocking) inotify fd so the caller can register it with
+ * its event loop for EPOLLIN.
+ */
+int monitor_get_fd(monitor_ctx_t *ctx);
+
+/** Number of directory watches registered so far. */
+int monitor_get_watch_count(monitor_ctx_t *ctx);
+
+/**
+ * Read and dispatch every pending inotify event.  Never blocks.
+ *
+ * If the callback returns MONITOR_CB_BUSY, processing stops and the
+ * undelivered events are kept; the caller should stop polling the fd and
+ * call this function again later (e.g. from a retry timer).  The kernel
+ * keeps queueing new events meanwhile, which is the backpressure we want.
+ *
+ * @return 0 when drained, MONITOR_BUSY on pushback, -1 on error.
+ */
+int monitor_process_events(monitor_ctx_t *ctx);
+
+/**
+ * Append the monitor section to a handover: the inotify fd, the wd → path
+ * map and any events read but not yet delivered.  The context stays
+ * usable; the caller just must not read the fd again if the handover
+ * commits.
  */
-int monitor_run(monitor_ctx_t *ctx);
+void monitor_export(monitor_ctx_t *ctx, handover_msg_t *msg);
 
 /**
- * Signal the monitor loop to exit.  Thread-safe.
+ * Rebuild a monitor from a handover section, in place of monitor_create().
+ * Nothing is walked: the watches already exist on the received fd.
+ * Pending events are delivered by the next monitor_process_events().
+ * @return          Allocated context, or NULL on failure.
  */
-void monitor_stop(monitor_ctx_t *ctx);
+monitor_ctx_t *monitor_adopt(handover_msg_t *msg,
+                             monitor_callback_t callback,
+                             void *user_data);
 
 /**
  * Free all resources held by the monitor context.
@@ -0,0 +1,101 @@
+/*
+ * ondemand.h — On-demand scans requested over IPC ("scan_path").
+ *
+ * A client names a directory (or one file); the daemon crawls it with a
+ * team of threads (crawl.h) and feeds every eligible file to the worker
+ * pool's background lane (threadpool_try_submit_bg), so requested scans
+ * go through the normal scan → quarantine → alert pipeline but never
+ * hold up live events.  The requesting client receives, as
+ * newline-delimited JSON on its IPC connection:
+ *
+ *   {"event":"scan_started","scan_id":N,"path":…}
+ *   {"event":"scan_progress","scan_id":N,…}        every ONDEMAND_PROGRESS_MS
+ *   {"event":"scan_complete","scan_id":N,"status":"done"|"cancelled",…}
+ *   {"event":"scan_error","path":…,"error":…}      request refused
+ *
+ * Progress carries files and bytes discovered and scanned, detections,
+ * errors, whether the crawl is still running and an ETA.  A scan ends
+ * early on "scan_cancel" (from any client that names its ID), when its
+ * client disconnects, and on shutdown or live upgrade.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_ONDEMAND_H
+#define SENTINEL_ONDEMAND_H
+
+#include <stdint.h>
+
+#include "threadpool.h"
+#include "crawl.h"
+
+/* Scans that may run at once (all clients together). */
+#define ONDEMAND_MAX_SCANS     4
+
+/* Crawler threads per scan. */
+#define ONDEMAND_THREADS       CRAWL_THREADS
+
+/* Interval between progress events (and completion checks). */
+#define ONDEMAND_PROGRESS_MS   500
+
+/* Back-off while the background lane is full. */
+#define ONDEMAND_THROTTLE_MS   5
+
+/* How a queued file ended, for ondemand_file_done(). */
+typedef enum {
+    ONDEMAND_CLEAN,
+    ONDEMAND_INFECTED,
+    ONDEMAND_ERROR,              /* Scan error or scanner offline          */
+    ONDEMAND_GONE,               /* File vanished before it was scanned    */
+    ONDEMAND_SKIPPED             /* Scan cancelled before the file's turn  */
+} ondemand_outcome_t;
+
+/** Return 1 if the daemon scans files like `path` (name, size). */
+typedef int (*ondemand_filter_fn)(const char *path, int64_t size);
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Set up on-demand scans on `pool`.
+ * @return 0 on success, -1 on error.
+ */
+int ondemand_init(threadpool_t *pool, ondemand_filter_fn filter);
+
+/**
+ * Start scanning `path` for `client_fd`.  Replies (scan_started or
+ * scan_error) go to the client.  Reactor thread.
+ * @return the scan ID, or -1 if the request was refused.
+ */
+int ondemand_start(int client_fd, const char *path);
+
+/**
+ * Cancel scan `id`, or all scans if `id` is 0 — only ever those started
+ * by `client_fd`: IDs are small and sequential, easy to guess.
+ * @return number of scans cancelled.
+ */
+int ondemand_cancel(int client_fd, uint32_t id);
+
+/** A client went away: cancel its scans silently.  Any thread. */
+void ondemand_client_gone(int client_fd);
+
+/** 1 if jobs tagged `id` should be skipped (scan cancelled). */
+int ondemand_cancelled(uint32_t id);
+
+/**
+ * A job tagged `id` has finished (worker thread).  `bytes` is the file
+ * size the worker saw.  A tag of 0 (live work) is ignored.
+ */
+void ondemand_file_done(uint32_t id, ondemand_outcome_t outcome,
+                        int64_t bytes);
+
+/** Reactor tick: progress events, completion, cleanup. */
+void ondemand_tick(void);
+
+/**
+ * Cancel every scan and tell each client why ("shutdown", "upgrade"),
+ * then wait for the crawlers.  Scans still draining from the pool are
+ * reaped by later ticks.
+ */
+void ondemand_stop_all(const char *reason);
+
+#endif /* SENTINEL_ONDEMAND_H */
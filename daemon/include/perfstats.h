@@ -0,0 +1,50 @@
+/*
+ * perfstats.h — Periodic live performance status for GUI clients.
+ *
+ * Every PERFSTATS_INTERVAL_MS the reactor samples the pipeline (scan
+ * rate, throughput, queue depth and its peak, time-to-verdict quantiles,
+ * clamd health, watch count) and broadcasts one "perf_stats" event:
+ *
+ *   {"event":"perf_stats","interval_ms":2000,"scans_per_sec":41.5,
+ *    "bytes_per_sec":1843200,"queue_depth":3,"queue_high_water":17,
+ *    "queue_capacity":256,"workers_busy":4,"workers":4,
+ *    "verdict_p50_ms":2.1,"verdict_p99_ms":38.0,"clamd":"ok",
+ *    "clamd_errors":0,"cache_hits":30,"cache_misses":53,
+ *    "cache_hit_ratio":0.361,"watches":1532}
+ *
+ * Rates, the high-water mark, the quantiles and clamd_errors cover the
+ * last interval only.  The quantiles are null when no file finished in
+ * the interval.  "clamd" is one of "ok", "degraded" (some exchanges
+ * failed), "down" (the last exchange failed) or "unknown".
+ *
+ * The verdict cache's hits and misses also cover the last interval;
+ * cache_hit_ratio is null when nothing was looked up.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_PERFSTATS_H
+#define SENTINEL_PERFSTATS_H
+
+#include "reactor.h"
+#include "threadpool.h"
+#include "monitor.h"
+
+/* Broadcast period. */
+#define PERFSTATS_INTERVAL_MS 2000
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Start the periodic broadcast on the reactor.  Nothing is sent while
+ * no GUI client is connected, but interval baselines keep advancing.
+ * @param r            The daemon's reactor.
+ * @param pool         Scan thread pool (queue depth / workers).
+ * @param mon          Monitor (watch count), may be NULL.
+ * @param interval_ms  Period, or 0 for PERFSTATS_INTERVAL_MS.
+ * @return 0 on success, -1 on error.
+ */
+int perfstats_attach(reactor_t *r, threadpool_t *pool, monitor_ctx_t *mon,
+                     unsigned interval_ms);
+
+#endif /* SENTINEL_PERFSTATS_H */
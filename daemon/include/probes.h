@@ -0,0 +1,62 @@
+/*
+ * probes.h — USDT static tracepoints (provider "sentinel").
+ *
+ * Thin wrappers over <sys/sdt.h> (systemtap-sdt-dev).  Each probe site
+ * compiles to a single NOP plus an ELF note describing where its
+ * arguments live, so an unattached probe costs nothing and evaluates
+ * nothing beyond values already in registers.  bpftrace / perf attach
+ * by name, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/local/bin/sentinel-daemon:sentinel:scan_end
+ *                { @[arg3] = hist(arg2 / 1000); }'
+ *
+ * Sample scripts live in tools/bpftrace/.  Without <sys/sdt.h>, or with
+ * -DSENTINEL_NO_USDT, every probe compiles to nothing.
+ *
+ * Probe                 Arguments
+ * ─────────────────     ──────────────────────────────────────────────
+ * event_received        path, inotify mask, file size
+ * enqueue               path, queue depth after insert
+ * dequeue               path, queue depth after removal, queue wait ns
+ * scan_start            path
+ * scan_end              path, bytes streamed, clamd round trip ns,
+ *                       scan_result_t (-1 on communication error)
+ * quarantine            path, threat name, 0 ok / -1 error, duration ns
+ * restore               quarantine ID, 0 ok / -1 error
+ * delete                quarantine ID, 0 ok / -1 error
+ * ipc_broadcast         event name, message bytes, clients written
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_PROBES_H
+#define SENTINEL_PROBES_H
+
+#if !defined(SENTINEL_NO_USDT) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define SENTINEL_HAVE_USDT 1
+#  endif
+#endif
+
+#ifdef SENTINEL_HAVE_USDT
+#  define SENTINEL_PROBE1(name, a)          DTRACE_PROBE1(sentinel, name, a)
+#  define SENTINEL_PROBE2(name, a, b)       DTRACE_PROBE2(sentinel, name, a, b)
+#  define SENTINEL_PROBE3(name, a, b, c)    DTRACE_PROBE3(sentinel, name, a, b, c)
+#  define SENTINEL_PROBE4(name, a, b, c, d) DTRACE_PROBE4(sentinel, name, a, b, c, d)
+#else
+/* sizeof: arguments count as used but are never evaluated (the + 0
+ * decays arrays, including flexible array members). */
+#  define SENTINEL_PROBE1(name, a) \
+    do { (void)sizeof((a) + 0); } while (0)
+#  define SENTINEL_PROBE2(name, a, b) \
+    do { (void)sizeof((a) + 0); (void)sizeof((b) + 0); } while (0)
+#  define SENTINEL_PROBE3(name, a, b, c) \
+    do { (void)sizeof((a) + 0); (void)sizeof((b) + 0); \
+         (void)sizeof((c) + 0); } while (0)
+#  define SENTINEL_PROBE4(name, a, b, c, d) \
+    do { (void)sizeof((a) + 0); (void)sizeof((b) + 0); (void)sizeof((c) + 0); \
+         (void)sizeof((d) + 0); } while (0)
+#endif
+
+#endif /* SENTINEL_PROBES_H */
@@ -11,8 +11,8 @@
 /* Default quarantine directory */
 #define QUARANTINE_DIR "/opt/quarantine"
 
-/* Manifest file (JSON array) tracking quarantined items */
-#define QUARANTINE_MANIFEST QUARANTINE_DIR "/.manifest.json"
+/* Manifest file (JSON array) tracking quarantined items, inside the dir */
+#define QUARANTINE_MANIFEST_NAME ".manifest.json"
 
 /* Maximum path length */
 #define QR_MAX_PATH 4096
@@ -29,9 +29,16 @@ typedef struct {
 /**
  * Initialise the quarantine subsystem.
  * Creates the quarantine directory and loads the manifest.
+ * @param dir  Quarantine directory, or NULL for QUARANTINE_DIR.
  * @return 0 on success, -1 on error.
  */
-int quarantine_init(void);
+int quarantine_init(const char *dir);
+
+/** The active quarantine directory. */
+const char *quarantine_get_dir(void);
+
+/** Number of entries in the manifest. */
+int quarantine_count(void);
 
 /**
  * Quarantine a file: chmod 000, move to /opt/quarantine/, update manifest.
@@ -48,6 +55,13 @@ int quarantine_file(const char *filepath, const char *threat_name);
  */
 int quarantine_restore(const char *quarantine_id);
 
+/**
+ * Restore several entries, writing the manifest once.
+ * @param ok  If not NULL, receives 1 or 0 per ID.
+ * @return number restored, -1 on bad arguments.
+ */
+int quarantine_restore_many(const char *const *ids, int n, int *ok);
+
 /**
  * Permanently delete a quarantined file.
  * @param quarantine_id The UUID of the quarantined entry.
@@ -55,6 +69,13 @@ int quarantine_restore(const char *quarantine_id);
  */
 int quarantine_delete(const char *quarantine_id);
 
+/**
+ * Permanently delete several entries, writing the manifest once.
+ * @param ok  If not NULL, receives 1 or 0 per ID.
+ * @return number deleted, -1 on bad arguments.
+ */
+int quarantine_delete_many(const char *const *ids, int n, int *ok);
+
 /**
  * List all quarantined entries.
  * Caller must free the returned array with free().
@@ -64,6 +85,19 @@ int quarantine_delete(const char *quarantine_id);
  */
 int quarantine_list(quarantine_entry_t **entries, int *count);
 
+/** Called by quarantine_foreach() for each entry (valid for the call). */
+typedef void (*quarantine_visit_fn)(const quarantine_entry_t *entry,
+                                    void *arg);
+
+/**
+ * Visit up to `max` entries starting at position `offset`, in manifest
+ * order, under the quarantine lock: `fn` must not call back into this
+ * module or block.  Lets callers page through large vaults without
+ * copying them.  Positions shift as entries are restored or deleted.
+ * @return number of entries visited, -1 on error.
+ */
+int quarantine_foreach(int offset, int max, quarantine_visit_fn fn, void *arg);
+
 /**
  * Shut down quarantine subsystem, flush manifest.
  */
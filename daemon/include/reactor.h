@@ -0,0 +1,92 @@
+/*
+ * reactor.h — Single-threaded epoll event loop.
+ *
+ * Drives every event source of the daemon from one thread: the inotify
+ * fd, the IPC listen and client sockets, timers (timerfd) and signals
+ * (signalfd).  epoll_wait() blocks with no timeout, so an idle daemon
+ * only wakes up for real work or an armed timer.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_REACTOR_H
+#define SENTINEL_REACTOR_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+/* Opaque reactor handle */
+typedef struct reactor reactor_t;
+
+/**
+ * Callback for fd readiness.
+ * @param fd      The ready file descriptor.
+ * @param events  EPOLLIN / EPOLLOUT / EPOLLHUP / EPOLLERR bits.
+ * @param arg     Opaque pointer given at registration.
+ */
+typedef void (*reactor_fd_cb)(int fd, uint32_t events, void *arg);
+
+/** Callback for timer expiry and for delivered signals. */
+typedef void (*reactor_timer_cb)(void *arg);
+typedef void (*reactor_signal_cb)(int signo, void *arg);
+
+/**
+ * Create a reactor.
+ * @return Allocated handle, or NULL on failure.
+ */
+reactor_t *reactor_create(void);
+
+/**
+ * Watch an fd.  Readiness may be reported spuriously (e.g. after the fd
+ * number was closed and reused), so callbacks must use non-blocking I/O.
+ * Safe to call from any thread.
+ * @return 0 on success, -1 on error.
+ */
+int reactor_add_fd(reactor_t *r, int fd, uint32_t events,
+                   reactor_fd_cb cb, void *arg);
+
+/** Change the event mask of a watched fd (0 pauses it).  Thread-safe. */
+int reactor_mod_fd(reactor_t *r, int fd, uint32_t events);
+
+/** Stop watching an fd.  Does not close it.  Thread-safe. */
+void reactor_del_fd(reactor_t *r, int fd);
+
+/**
+ * Create a timer.  `initial_ms` == 0 leaves it disarmed; `interval_ms`
+ * == 0 makes it one-shot.
+ * @return Timer ID (>= 0) on success, -1 on error.
+ */
+int reactor_add_timer(reactor_t *r, unsigned initial_ms, unsigned interval_ms,
+                      reactor_timer_cb cb, void *arg);
+
+/** Re-arm (or with initial_ms == 0, disarm) an existing timer. */
+int reactor_arm_timer(reactor_t *r, int timer_id,
+                      unsigned initial_ms, unsigned interval_ms);
+
+/**
+ * Route a signal to `cb` through signalfd.  The signal must already be
+ * blocked in EVERY thread — block it in main() before spawning threads
+ * (see reactor_block_signals()).
+ * @return 0 on success, -1 on error.
+ */
+int reactor_add_signal(reactor_t *r, int signo, reactor_signal_cb cb, void *arg);
+
+/**
+ * Block the given 0-terminated list of signals in the calling thread.
+ * Threads created afterwards inherit the mask.
+ */
+void reactor_block_signals(const int *signals);
+
+/**
+ * Run the loop until reactor_stop() is called.
+ * @return 0 on clean stop, -1 on fatal epoll error.
+ */
+int reactor_run(reactor_t *r);
+
+/** Ask the loop to exit after the current dispatch.  Thread-safe. */
+void reactor_stop(reactor_t *r);
+
+/** Free the reactor and close its internal fds (timers, signalfd). */
+void reactor_destroy(reactor_t *r);
+
+#endif /* SENTINEL_REACTOR_H */
@@ -0,0 +1,52 @@
+/*
+ * replay.h — Feed a recorded event trace back into the scan pipeline.
+ *
+ * The replay runs on the reactor in place of (or next to) inotify: each
+ * recorded regular-file event is handed to the same monitor callback the
+ * live monitor uses, at the recorded pace divided by `speed`.  Pushback
+ * (MONITOR_CB_BUSY) pauses the replay exactly as it pauses inotify reads.
+ *
+ * With a `root`, every recorded path is recreated under it first
+ * (ROOT/home/alice/x.pdf for /home/alice/x.pdf): directories for
+ * directory events, files of the recorded size for file events, so the
+ * workers scan real data.  Without a root the original paths are used
+ * as-is, which only exercises the pipeline up to the scanner unless the
+ * files still exist.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_REPLAY_H
+#define SENTINEL_REPLAY_H
+
+#include "reactor.h"
+#include "monitor.h"
+
+/* Events dispatched per timer tick before yielding to the reactor. */
+#define REPLAY_BATCH        256
+
+/* Wait after the callback pushed back. */
+#define REPLAY_RETRY_MS     10
+
+/* Recreated files larger than this are sparse (the daemon skips them). */
+#define REPLAY_MAX_WRITE    (100u << 20)
+
+/* Called on the reactor thread once the trace is exhausted. */
+typedef void (*replay_done_fn)(void *arg);
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Start replaying `trace_path` on the reactor.
+ * @param speed    Time scale: 1 = recorded pace, 10 = ten times faster,
+ *                 0 = as fast as the pipeline accepts events.
+ * @param root     Directory to recreate files under, or NULL.
+ * @param cb       Receives each file event (the daemon's on_file_event).
+ * @param done     Called when the trace ends, may be NULL.
+ * @return 0 on success, -1 on error.
+ */
+int replay_attach(reactor_t *r, const char *trace_path, double speed,
+                  const char *root, monitor_callback_t cb, void *user_data,
+                  replay_done_fn done, void *done_arg);
+
+#endif /* SENTINEL_REPLAY_H */
@@ -0,0 +1,75 @@
+/*
+ * risk.h — Cheap static risk score from a file's first bytes.
+ *
+ * Packed or encrypted executables are far more often malicious than
+ * other files.  risk_assess() looks at the first RISK_HEAD_BYTES of a
+ * file (the first chunk the scanner reads anyway): a byte histogram and
+ * its Shannon entropy, plus the ELF or PE headers — file type, packer
+ * section names and marks, writable+executable segments.  The score
+ * decides which queued files are scanned first and is shown in alerts.
+ * It never decides a verdict.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_RISK_H
+#define SENTINEL_RISK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bytes examined: clamd's first zINSTREAM chunk. */
+#define RISK_HEAD_BYTES      8192
+
+/* Entropy (bits per byte) past the headers above which an executable
+ * counts as packed or encrypted.  Compiled code is typically 5.5–6.5. */
+#define RISK_PACKED_ENTROPY  7.2
+
+/* Fewest bytes past the headers worth an entropy figure of their own;
+ * below this the whole head is measured. */
+#define RISK_MIN_BODY_BYTES  1024
+
+/* Live events scoring this much jump ahead of the scan queue. */
+#define RISK_PRIORITY_SCORE  50
+
+typedef enum {
+    RISK_FMT_OTHER,
+    RISK_FMT_ELF,
+    RISK_FMT_PE,
+} risk_format_t;
+
+/* risk_t.flags */
+#define RISK_F_EXEC     0x1u     /* ELF or PE executable / shared object */
+#define RISK_F_PACKED   0x2u     /* Executable with packed-looking body  */
+#define RISK_F_WX       0x4u     /* Writable and executable segment      */
+#define RISK_F_NOSECT   0x8u     /* ELF without section headers          */
+
+typedef struct {
+    float          entropy;      /* Bits per byte, 0..8                  */
+    uint8_t        score;        /* 0..100                               */
+    uint8_t        format;       /* risk_format_t                        */
+    uint16_t       flags;        /* RISK_F_*                             */
+    const char    *packer;       /* Known packer (static name) or NULL   */
+} risk_t;
+
+/**
+ * Score `len` leading bytes of a file (any length; only the first
+ * RISK_HEAD_BYTES are used).  Thread-safe, no I/O.
+ */
+void risk_assess(const void *buf, size_t len, risk_t *out);
+
+/**
+ * Read the first RISK_HEAD_BYTES of `path` (without blocking on FIFOs
+ * or updating atime) and score them.
+ * @return 0, or -1 if the file could not be read (`out` zeroed).
+ */
+int risk_assess_path(const char *path, risk_t *out);
+
+/**
+ * Short description for alerts and logs, e.g.
+ * "packed PE executable, UPX, entropy 7.91, risk 100".
+ * @return `buf`.
+ */
+const char *risk_describe(const risk_t *r, char *buf, size_t len);
+
+#endif /* SENTINEL_RISK_H */
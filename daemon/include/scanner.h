@@ -1,17 +1,46 @@
 /*
- * scanner.h — ClamAV clamd socket scanner interface.
- * Communicates with clamd over its UNIX domain socket.
+ * scanner.h — File scanner interface.
+ *
+ * Runs each file through a chain of scan engines (engine.h), e.g.
+ * "allowlist:/etc/sentinel/allow.sha256,cache,clamd": the first engine
+ * that reaches a verdict decides.  The chain is given as a spec string
+ * at start-up and can be replaced at run time; scans in flight finish on
+ * the chain they started with.  Engines joined with '|' race each other
+ * ("cache,blocklist:/etc/sentinel/block.sha256|clamd"): the first to
+ * find a threat decides at once.  Each engine keeps its own counters and
+ * latency histogram (sentinel_engine_*).
  */
 
 #ifndef SENTINEL_SCANNER_H
 #define SENTINEL_SCANNER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "risk.h"
+#include "sha256.h"
+
+struct json_object;
+
 /* Default clamd socket path on Ubuntu */
 #define CLAMD_SOCKET_PATH "/var/run/clamav/clamd.ctl"
 
 /* Maximum length for a threat/signature name */
 #define SCANNER_MAX_THREAT_NAME 256
 
+/* Chain used when none is configured. */
+#define SCANNER_DEFAULT_ENGINES "cache,clamd"
+
+/* Engines in one chain, and the longest chain spec. */
+#define SCANNER_MAX_ENGINES 8
+#define SCANNER_SPEC_MAX    1024
+
+/* Most helper threads for racing engines ("a|b" in a chain spec). */
+#define SCANNER_RACE_THREADS 64
+
+/* Leading file bytes kept in the report for file-type detection */
+#define SCANNER_HEAD_BYTES 512
+
 /* Scan result codes */
 typedef enum {
     SCAN_RESULT_CLEAN,       /* File is clean                   */
@@ -23,29 +52,101 @@ typedef enum {
 typedef struct {
     scan_result_t result;
     char          threat_name[SCANNER_MAX_THREAT_NAME];  /* e.g. "Win.Test.EICAR_HDB-1" */
+
+    /* CLOCK_MONOTONIC stage stamps in ns (0 = stage not reached). */
+    uint64_t      t_connected;   /* clamd connection established     */
+    uint64_t      t_streamed;    /* end-of-data marker sent          */
+    uint64_t      t_verdict;     /* reply read                       */
+
+    uint64_t      bytes;         /* File bytes streamed to clamd     */
+    unsigned char head[SCANNER_HEAD_BYTES];  /* First bytes of the file */
+    size_t        head_len;
+
+    const char   *engine;        /* Engine that decided (static name) */
+
+    /* SHA-256 of exactly the bytes the verdict is about, if known. */
+    uint8_t       sha256[SHA256_DIGEST_LEN];
+    int           has_sha256;
+
+    risk_t        risk;          /* Static triage of the first bytes  */
 } scan_report_t;
 
+/* Cumulative clamd and verdict cache counters, see scanner_get_stats(). */
+typedef struct {
+    uint64_t exchanges;          /* Files streamed to clamd (any outcome) */
+    uint64_t connect_errors;     /* Failed connects                       */
+    uint64_t failures;           /* I/O errors / no reply after connect   */
+    uint64_t bytes;              /* File bytes streamed                   */
+    int      clamd_up;           /* Last exchange: 1 ok, 0 failed, -1 none */
+    uint64_t cache_hits;         /* Verdict cache lookups found clean     */
+    uint64_t cache_misses;       /* Verdict cache lookups not found       */
+} scanner_stats_t;
+
 /**
  * Initialise the scanner module.
- * @param socket_path Path to the clamd UNIX socket.
- * @return 0 on success, -1 if the socket is unreachable.
+ * @param socket_path Path to the clamd UNIX socket ("clamd" engines
+ *                    without an argument).
+ * @param engines     Chain spec; NULL for SCANNER_DEFAULT_ENGINES.
+ * @return 0 on success, -1 if the chain spec is invalid.  An unreachable
+ *         clamd is not an error.
  */
-int scanner_init(const char *socket_path);
+int scanner_init(const char *socket_path, const char *engines);
 
 /**
- * Scan a single file via clamd.
+ * Scan a single file through the engine chain.
  * @param filepath Absolute path to the file.
+ * @param risk     Score of its first bytes if already known (see
+ *                 threadpool.h), or NULL to score them here.
  * @param report   Output parameter filled with the result.
- * @return 0 on success, -1 on communication error.
+ * @return 0 on success, -1 if the file could not be read or an engine
+ *         was unreachable.
  */
-int scanner_scan_file(const char *filepath, scan_report_t *report);
+int scanner_scan_file(const char *filepath, const risk_t *risk,
+                      scan_report_t *report);
 
 /**
- * Check if clamd is alive (ping/pong).
+ * Check if the chain's backends are alive (clamd ping/pong).
  * @return 1 if alive, 0 otherwise.
  */
 int scanner_ping(void);
 
+/**
+ * Ask the chain for its signature database version (for clamd the
+ * daily.cvd number, which only grows).
+ * @return the version, or 0 if unknown or unreachable.
+ */
+uint32_t scanner_db_version(void);
+
+/**
+ * Replace the engine chain with `spec` (comma-separated "name[:arg]").
+ * On error the old chain stays and a reason is written to `err`.
+ * @return 0 on success, -1 on error.
+ */
+int scanner_set_engines(const char *spec, char *err, size_t errlen);
+
+/**
+ * Have the chain's engines re-read their data in place (IOC lists); the
+ * chain itself stays.  An engine that fails keeps its old data.
+ * @return 0, or -1 with the first failure in `err`.
+ */
+int scanner_reload_engines(char *err, size_t errlen);
+
+/** Current chain spec. */
+void scanner_engines_spec(char *out, size_t len);
+
+/**
+ * Per-engine counters of the current chain, as a JSON array of
+ * {"engine","arg","scans","pass","clean","infected","error","offline",
+ * "mean_ms", …engine-specific…}.  Caller puts the reference.
+ */
+struct json_object *scanner_engines_json(void);
+
+/**
+ * Read the clamd and verdict cache counters (cheap enough to call every
+ * few seconds).
+ */
+void scanner_get_stats(scanner_stats_t *out);
+
 /**
  * Shut down the scanner module.
  */
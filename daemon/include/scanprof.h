@@ -0,0 +1,86 @@
+/*
+ * scanprof.h — Scan cost profiler.
+ *
+ * Accumulates clamd time, bytes, detections and errors per file category
+ * so exclusions and routing can be decided from evidence.  Every scan is
+ * counted under three keys:
+ *
+ *   ext    lower-cased extension ("pdf", "so", "(none)")
+ *   magic  type sniffed from the first bytes ("elf", "pe", "zip", "text")
+ *   dir    first SCANPROF_DIR_DEPTH path components ("/home/alice")
+ *
+ * Rows live in one fixed-size open-addressed table.  Once a dimension
+ * has SCANPROF_DIM_KEYS keys, new ones are folded into its "(other)"
+ * row, so memory stays bounded however many distinct paths are seen.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_SCANPROF_H
+#define SENTINEL_SCANPROF_H
+
+#include <stdint.h>
+
+#include "scanner.h"
+
+/* ── Limits & defaults ──────────────────────────────────────────────────── */
+
+#define SCANPROF_SLOTS      1024    /* Table size (power of two)           */
+#define SCANPROF_DIM_KEYS   256     /* Distinct keys per dimension         */
+#define SCANPROF_KEY_MAX    48      /* Longest key kept, including NUL     */
+#define SCANPROF_DIR_DEPTH  2       /* "/home/alice/x/y.pdf" → /home/alice */
+
+/* Written on SIGUSR1 and on the "profile_dump" IPC command. */
+#define SCANPROF_CSV_PATH   "/var/log/sentinel-profile.csv"
+
+/* ── Types ──────────────────────────────────────────────────────────────── */
+
+typedef enum {
+    SCANPROF_EXT,
+    SCANPROF_MAGIC,
+    SCANPROF_DIR,
+    SCANPROF_DIM_COUNT
+} scanprof_dim_t;
+
+typedef struct {
+    scanprof_dim_t dim;
+    char           key[SCANPROF_KEY_MAX];
+    uint64_t       scans;        /* clamd verdicts received               */
+    uint64_t       bytes;        /* File bytes streamed                   */
+    uint64_t       scan_ns;      /* clamd time (connect → verdict)        */
+    uint64_t       detections;   /* SCAN_RESULT_INFECTED                  */
+    uint64_t       errors;       /* SCAN_RESULT_ERROR                     */
+} scanprof_row_t;
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/** Account one completed clamd exchange (any worker thread). */
+void scanprof_record(const char *path, const scan_report_t *report);
+
+/**
+ * Copy the table, most expensive (scan_ns) first.
+ * Caller must free the returned array with free().
+ * @param dim    Only rows of this dimension, or -1 for all.
+ * @param rows   Receives the array (NULL when empty).
+ * @param count  Receives the number of rows.
+ * @return 0 on success, -1 on error.
+ */
+int scanprof_snapshot(int dim, scanprof_row_t **rows, int *count);
+
+/**
+ * Write the table as CSV (header row first, atomically replaced).
+ * @param path  Output file, or NULL for SCANPROF_CSV_PATH.
+ * @return 0 on success, -1 on error.
+ */
+int scanprof_dump_csv(const char *path);
+
+/** Forget all rows. */
+void scanprof_reset(void);
+
+/** "ext", "magic" or "dir". */
+const char *scanprof_dim_name(scanprof_dim_t dim);
+
+/** Parse a dimension name.  @return the dimension, or -1. */
+int scanprof_dim_parse(const char *name);
+
+#endif /* SENTINEL_SCANPROF_H */
@@ -0,0 +1,36 @@
+/*
+ * sha256.h — SHA-256 (FIPS 180-4), incremental.
+ *
+ * Used for content hashes in the file-state index, where it lets a full
+ * scan tell a file that was only touched from one that was rewritten.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_SHA256_H
+#define SENTINEL_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_LEN 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t bytes;              /* Total bytes hashed                    */
+    uint8_t  buf[64];            /* Partial block                         */
+    size_t   buf_len;
+} sha256_ctx_t;
+
+void sha256_init(sha256_ctx_t *ctx);
+void sha256_update(sha256_ctx_t *ctx, const void *data, size_t len);
+void sha256_final(sha256_ctx_t *ctx, uint8_t out[SHA256_DIGEST_LEN]);
+
+/**
+ * Hash an open file from its current offset to EOF.
+ * @param bytes  Receives the number of bytes read (may be NULL).
+ * @return 0 on success, -1 on read error.
+ */
+int sha256_fd(int fd, uint8_t out[SHA256_DIGEST_LEN], uint64_t *bytes);
+
+#endif /* SENTINEL_SHA256_H */
@@ -2,8 +2,12 @@
  * threadpool.h — Thread pool with bounded work queue.
  *
  * Provides asynchronous file-scanning dispatch so the inotify monitor
- * never blocks on ClamAV I/O.  Workers dequeue file paths and run the
- * scan → quarantine → alert pipeline independently.
+ * never blocks on ClamAV I/O.  Workers dequeue jobs (a file path plus its
+ * latency trace) and run the scan → quarantine → alert pipeline
+ * independently.
+ *
+ * While jobs wait, a triage thread scores them from their first bytes
+ * (risk.h) and moves risky ones to the front of the queue.
  *
  * Part of the Sentinel Endpoint Security daemon.
  */
@@ -12,22 +16,61 @@
 #define SENTINEL_THREADPOOL_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "risk.h"
+#include "trace.h"
 
 /* Default number of worker threads */
 #define THREADPOOL_DEFAULT_THREADS  4
 
-/* Default work-queue capacity (paths). Beyond this, oldest entries are dropped. */
+/* Default work-queue capacity (paths). Beyond this, producers wait. */
 #define THREADPOOL_DEFAULT_CAPACITY 256
 
+/*
+ * Capacity of the background lane (on-demand scans).  Workers take
+ * background jobs only while the main queue is empty, and at most
+ * threads - 1 at a time, so one worker always stays free for live events.
+ */
+#define THREADPOOL_BG_CAPACITY      64
+
 /* Opaque thread pool handle */
 typedef struct threadpool threadpool_t;
 
+/* Point-in-time counters, see threadpool_get_stats(). */
+typedef struct {
+    int           depth;         /* Items waiting in the queue          */
+    int           capacity;      /* Queue capacity                      */
+    int           threads;       /* Worker threads                      */
+    int           active;        /* Workers currently running work_fn   */
+    int           bg_depth;      /* Items waiting in the background lane */
+    int           bg_active;     /* Workers running a background job    */
+    unsigned long submitted;     /* Total paths submitted               */
+    unsigned long processed;     /* Total paths dequeued                */
+} threadpool_stats_t;
+
+/* scan_job_t.triage */
+#define JOB_TRIAGE_PENDING  0    /* Not scored yet                      */
+#define JOB_TRIAGE_DONE     1    /* `risk` holds the score of its head  */
+#define JOB_TRIAGE_SKIP     2    /* Not scored while queued             */
+
+/* One unit of work.  Owned by the pool; freed after work_fn returns. */
+typedef struct {
+    trace_t  trace;              /* Stage timestamps (see trace.h)      */
+    uint64_t jid;                /* Journal work ID, 0 if not journaled */
+    uint64_t seq;                /* Pool-unique job number              */
+    uint32_t tag;                /* On-demand scan ID, 0 for live work  */
+    int      triage;             /* JOB_TRIAGE_*                        */
+    risk_t   risk;               /* Valid when triage is DONE           */
+    char     path[];             /* Absolute path, stored inline        */
+} scan_job_t;
+
 /**
- * Callback executed by each worker for every dequeued file path.
- * @param filepath  Heap-allocated path string — the callback MUST free() it.
+ * Callback executed by each worker for every dequeued job.
+ * @param job       The job — valid only for the duration of the call.
  * @param user_data Opaque pointer registered at creation time.
  */
-typedef void (*threadpool_work_fn)(char *filepath, void *user_data);
+typedef void (*threadpool_work_fn)(scan_job_t *job, void *user_data);
 
 /**
  * Create a thread pool.
@@ -46,32 +89,99 @@ threadpool_t *threadpool_create(int num_threads,
 /**
  * Submit a file path for asynchronous processing.
  *
- * The path is strdup()'d internally — the caller retains ownership of
- * the original string.  If the queue is full the oldest entry is dropped
- * and a warning is logged.
- *
- * This function is thread-safe and non-blocking.
+ * The path is copied internally — the caller retains ownership of the
+ * original string.  If the queue is full the caller blocks until a
+ * worker frees a slot.
  *
  * @param pool     Pool handle.
  * @param filepath Absolute file path to enqueue.
+ * @param trace    Trace to continue, or NULL to start one now.
  * @return 0 on success, -1 on error.
  */
-int threadpool_submit(threadpool_t *pool, const char *filepath);
+int threadpool_submit(threadpool_t *pool, const char *filepath,
+                      const trace_t *trace);
+
+/**
+ * Enqueue a file path without blocking.
+ *
+ * Used by the event loop, which must not stall: when the queue is full
+ * the caller stops reading inotify and retries later, letting the kernel
+ * queue absorb the burst.
+ *
+ * @param pool     Pool handle.
+ * @param filepath Absolute file path to enqueue.
+ * @param trace    Trace to continue, or NULL to start one now.
+ * @return 0 if queued, 1 if the queue is full, -1 on error or shutdown.
+ */
+int threadpool_try_submit(threadpool_t *pool, const char *filepath,
+                          const trace_t *trace);
+
+/**
+ * Re-queue work left over from a previous run at the FRONT of the queue,
+ * ahead of new events, under its existing journal ID.  Non-blocking.
+ *
+ * @return 0 if queued, 1 if the queue is full, -1 on error or shutdown.
+ */
+int threadpool_try_requeue(threadpool_t *pool, const char *filepath,
+                           uint64_t jid);
+
+/**
+ * Enqueue a file in the background lane under scan ID `tag`.  Background
+ * jobs are not journaled.  Non-blocking.
+ *
+ * @return 0 if queued, 1 if the lane is full, -1 on error or shutdown.
+ */
+int threadpool_try_submit_bg(threadpool_t *pool, const char *filepath,
+                             uint32_t tag);
 
 /**
  * Gracefully shut down the pool.
  *
  * Sets the shutdown flag, broadcasts the condition variable so all
  * sleeping workers wake up, then pthread_join()s every thread.
- * Any paths still in the queue are freed.
+ * Any jobs still in the queue are freed; the background lane is not
+ * drained.
  *
  * @param pool Pool handle (freed after this call — do not reuse).
  */
 void threadpool_shutdown(threadpool_t *pool);
 
+/**
+ * Pause or resume dequeuing.  While paused, workers finish the job they
+ * hold and then take nothing new; submissions still queue.  Shutdown
+ * overrides a pause (the queue is drained as usual).
+ */
+void threadpool_pause(threadpool_t *pool, int paused);
+
+/**
+ * Call `fn` for every queued job, oldest first, under the pool lock.
+ * `fn` must not call back into the pool.
+ */
+void threadpool_foreach_queued(threadpool_t *pool,
+                               void (*fn)(const scan_job_t *job, void *arg),
+                               void *arg);
+
+/**
+ * Discard every queued job without running it (they were handed to a
+ * successor).  @return the number of jobs dropped.
+ */
+int threadpool_drop_queued(threadpool_t *pool);
+
 /**
  * Return the number of items currently queued (approximate, lock-free read).
  */
 int threadpool_queue_size(threadpool_t *pool);
 
+/**
+ * Take a consistent snapshot of the pool's counters (under the pool lock).
+ */
+void threadpool_get_stats(threadpool_t *pool, threadpool_stats_t *out);
+
+/**
+ * Peak queue depth since the previous call (or since creation).  The
+ * mark is reset to the current depth, so periodic callers see the peak
+ * of each interval rather than of the whole run.
+ */
+int threadpool_take_high_water(threadpool_t *pool);
+
 #endif /* SENTINEL_THREADPOOL_H */
@@ -0,0 +1,86 @@
+/*
+ * trace.h — Per-file latency tracing across the scan pipeline.
+ *
+ * Every work item carries a trace_t: one CLOCK_MONOTONIC timestamp per
+ * pipeline stage, stamped as the item moves from the inotify read to the
+ * final verdict.  When the item finishes, the gaps between stamps feed
+ * per-stage latency histograms (exported through metrics.h as
+ * sentinel_stage_duration_seconds{stage="…"}).
+ *
+ * A 1-in-N sample of items is also written as Chrome trace events
+ * (chrome://tracing, Perfetto), one row per file.  Sampling is off by
+ * default; enable it with SENTINEL_TRACE_SAMPLE=N.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#ifndef SENTINEL_TRACE_H
+#define SENTINEL_TRACE_H
+
+#include <stdint.h>
+
+#include "metrics.h"
+
+/* Default Chrome-trace output file (JSON array format). */
+#define TRACE_DEFAULT_PATH "/var/log/sentinel-trace.json"
+
+/* ── Stage timestamps ───────────────────────────────────────────────────── */
+
+typedef enum {
+    TRACE_TS_EVENT = 0,      /* inotify event read by the monitor         */
+    TRACE_TS_FILTERED,       /* on_file_event() accepted the path         */
+    TRACE_TS_ENQUEUED,       /* placed on the thread-pool queue           */
+    TRACE_TS_DEQUEUED,       /* picked up by a worker                     */
+    TRACE_TS_CONNECTED,      /* clamd connection established              */
+    TRACE_TS_STREAMED,       /* last byte (end marker) sent to clamd      */
+    TRACE_TS_VERDICT,        /* clamd reply read                          */
+    TRACE_TS_DONE,           /* quarantine / alerts finished              */
+    TRACE_TS_COUNT
+} trace_stamp_t;
+
+/* How an item left the pipeline. */
+typedef enum {
+    TRACE_OUT_VERDICT = 0,   /* Scanned: clean or infected                */
+    TRACE_OUT_OFFLINE,       /* Scanner unreachable, file locked down     */
+    TRACE_OUT_VANISHED,      /* File gone before it could be scanned      */
+    TRACE_OUT_COUNT
+} trace_outcome_t;
+
+typedef struct {
+    uint64_t id;                        /* Monotonic item ID             */
+    uint64_t ts[TRACE_TS_COUNT];        /* ns; 0 = stage not reached     */
+    int      sampled;                   /* Write a Chrome trace for it   */
+} trace_t;
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+/**
+ * Register the stage histograms and open the sample file.
+ * @param sample_every  Trace 1 item in N to the file (0 = none).
+ * @param path          Output file, or NULL for TRACE_DEFAULT_PATH.
+ * @return 0 on success, -1 if the sample file cannot be opened (the
+ *         histograms still work).
+ */
+int trace_init(unsigned sample_every, const char *path);
+
+/** Start a trace for a new item whose event was read at `event_ns`. */
+void trace_begin(trace_t *t, uint64_t event_ns);
+
+/** Stamp `stage` with the current time (no-op if t is NULL). */
+void trace_stamp(trace_t *t, trace_stamp_t stage);
+
+/**
+ * Feed the stage histograms and, if sampled, write the item's trace.
+ * Every item is counted by outcome; only items that reached a decision
+ * (not TRACE_OUT_VANISHED) feed sentinel_file_latency_seconds.
+ */
+void trace_finish(const trace_t *t, const char *path,
+                  trace_outcome_t outcome);
+
+/** Merged sentinel_file_latency_seconds histogram.  @return 0 or -1. */
+int trace_latency_snapshot(metrics_hist_snapshot_t *out);
+
+/** Terminate the JSON array and close the sample file. */
+void trace_shutdown(void);
+
+#endif /* SENTINEL_TRACE_H */
@@ -2,8 +2,9 @@
  * alert.c — UNIX domain socket IPC server.
  *
  * Replaces the insecure TCP WebSocket (libwebsockets) with a
- * permission-controlled UNIX stream socket.  Uses select() for
- * non-blocking multiplexed I/O across all connected GUI clients.
+ * permission-controlled UNIX stream socket.  The listen socket and every
+ * client are registered with the daemon's reactor (epoll); commands are
+ * dispatched from the reactor thread.
  *
  * Protocol: newline-delimited JSON.  Each message is a complete JSON
  * object terminated by '\n'.  Both directions use the same framing.
@@ -19,6 +20,8 @@
 
 #include "alert.h"
 #include "logger.h"
+#include "metrics.h"
+#include "probes.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -30,17 +33,24 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <sys/stat.h>
-#include <sys/select.h>
 #include <pthread.h>
 #include <json-c/json.h>     /* Fix 3: robust JSON parsing */
 
 /* ── Internal types ─────────────────────────────────────────────────────── */
 
-/* Per-client read buffer for line-delimited JSON framing. */
+/*
+ * Per-client read buffer for line-delimited JSON framing, and the output
+ * the socket has not taken yet.  Writers never wait for a client: a full
+ * socket buffer queues the rest, which the reactor drains on EPOLLOUT.
+ */
 typedef struct {
-    int  fd;                          /* Client file descriptor (-1 = unused) */
-    char buf[ALERT_MSG_MAX];          /* Partial-read accumulator             */
-    int  buf_len;                     /* Bytes currently in buf               */
+    int     fd;                       /* Client file descriptor (-1 = unused) */
+    char    buf[ALERT_MSG_MAX];       /* Partial-read accumulator             */
+    int     buf_len;                  /* Bytes currently in buf               */
+    char   *out;                      /* Queued output (NULL when drained)    */
+    size_t  out_off;                  /* Bytes of out already sent            */
+    size_t  out_len;                  /* Bytes of out still to send           */
+    size_t  out_cap;
 } client_slot_t;
 
 /* ── Private state ──────────────────────────────────────────────────────── */
@@ -50,11 +60,20 @@ static char          s_socket_path[108];   /* Matches sizeof(sun_path) */
 static client_slot_t s_clients[ALERT_MAX_CLIENTS];
 static int           s_client_count = 0;
 static pthread_mutex_t s_alert_mutex = PTHREAD_MUTEX_INITIALIZER;
+static reactor_t     *s_reactor     = NULL;
+
+/* Metric IDs (registered in alert_server_init). */
+static int           s_m_dropped    = -1;
+static int           s_m_commands   = -1;
 
 /* Command handler registered by main.c */
 static alert_command_handler_t s_cmd_handler  = NULL;
 static void                   *s_cmd_userdata = NULL;
 
+/* Disconnect handler registered by main.c */
+static alert_disconnect_handler_t s_disc_handler  = NULL;
+static void                      *s_disc_userdata = NULL;
+
 /* ── Helpers ────────────────────────────────────────────────────────────── */
 
 static const char *alert_type_str(alert_type_t type)
@@ -92,13 +111,114 @@ static client_slot_t *find_free_slot(void)
 static void close_client(client_slot_t *c)
 {
     if (!c || c->fd < 0) return;
+    /* Before close(): the fd number must not be reused yet. */
+    if (s_disc_handler) s_disc_handler(c->fd, s_disc_userdata);
+    reactor_del_fd(s_reactor, c->fd);
     close(c->fd);
     c->fd = -1;
     c->buf_len = 0;
+    free(c->out);
+    c->out = NULL;
+    c->out_off = c->out_len = c->out_cap = 0;
     s_client_count--;
     log_info("IPC client disconnected (total: %d)", s_client_count);
 }
 
+/** Append to a client's output queue.  Caller holds s_alert_mutex. */
+static int queue_append(client_slot_t *c, const char *p, size_t len)
+{
+    if (c->out_off + c->out_len + len > c->out_cap) {
+        if (c->out_off > 0) {
+            memmove(c->out, c->out + c->out_off, c->out_len);
+            c->out_off = 0;
+        }
+        if (c->out_len + len > c->out_cap) {
+            size_t cap = c->out_cap ? c->out_cap * 2 : ALERT_MSG_MAX;
+            while (cap < c->out_len + len) cap *= 2;
+            char *out = realloc(c->out, cap);
+            if (!out) return -1;
+            c->out     = out;
+            c->out_cap = cap;
+        }
+    }
+    memcpy(c->out + c->out_off + c->out_len, p, len);
+    c->out_len += len;
+    return 0;
+}
+
+/**
+ * Send what the socket takes of the queued output.  Caller holds
+ * s_alert_mutex.  Returns 1 once drained, 0 if output remains, -1 on a
+ * write error (errno set).
+ */
+static int flush_client(client_slot_t *c)
+{
+    while (c->out_len > 0) {
+        ssize_t w = send(c->fd, c->out + c->out_off, c->out_len,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->out_off += (size_t)w;
+        c->out_len -= (size_t)w;
+    }
+    free(c->out);
+    c->out = NULL;
+    c->out_off = c->out_cap = 0;
+    return 1;
+}
+
+/**
+ * Send one complete line to a client without ever waiting on it.  While
+ * nothing is queued the line goes straight to the socket; what does not
+ * fit is queued and EPOLLOUT armed.  A client more than
+ * ALERT_CLIENT_OUT_MAX behind is disconnected (it resyncs on reconnect).
+ * Caller holds s_alert_mutex.  Returns 0, or -1 if the client was closed.
+ */
+static int client_send(client_slot_t *c, const char *p, size_t len)
+{
+    int was_empty = c->out_len == 0;
+
+    if (queue_append(c, p, len) != 0) {
+        log_warn("IPC: out of memory queueing for client fd=%d — closing",
+                 c->fd);
+        metrics_inc(s_m_dropped);
+        close_client(c);
+        return -1;
+    }
+
+    if (was_empty) {
+        int rc = flush_client(c);
+        if (rc < 0) {
+            if (errno == EPIPE || errno == ECONNRESET)
+                log_warn("IPC: broken pipe to client fd=%d — closing slot",
+                         c->fd);
+            else
+                log_warn("IPC: write failed to client fd=%d (%s) — closing",
+                         c->fd, strerror(errno));
+            close_client(c);
+            return -1;
+        }
+        if (rc == 0 &&
+            reactor_mod_fd(s_reactor, c->fd,
+                           EPOLLIN | EPOLLOUT | EPOLLRDHUP) != 0) {
+            close_client(c);
+            return -1;
+        }
+    }
+
+    if (c->out_len > ALERT_CLIENT_OUT_MAX) {
+        log_warn("IPC: client fd=%d is %zu bytes behind — closing",
+                 c->fd, c->out_len);
+        metrics_inc(s_m_dropped);
+        close_client(c);
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * Process a single complete JSON message from a client.
  * Expected format: { "action": "...", "id": "..." }
@@ -107,7 +227,7 @@ static void close_client(client_slot_t *c)
  * Replaces the fragile strstr()/strchr() hand-parsing that could silently
  * misinterpret nested quotes, escaped characters, or malformed payloads.
  */
-static void process_client_message(client_slot_t *c, const char *msg)
+static void process_client_message(int fd, const char *msg)
 {
     if (!s_cmd_handler) {
         log_warn("IPC: received command but no handler registered: %s", msg);
@@ -117,7 +237,7 @@ static void process_client_message(client_slot_t *c, const char *msg)
     /* Parse the JSON string using json-c's tokenizer. */
     struct json_object *root = json_tokener_parse(msg);
     if (!root) {
-        log_warn("IPC: failed to parse JSON from client fd=%d: %s", c->fd, msg);
+        log_warn("IPC: failed to parse JSON from client fd=%d: %s", fd, msg);
         return;
     }
 
@@ -139,30 +259,32 @@ static void process_client_message(client_slot_t *c, const char *msg)
         id = json_object_get_string(id_obj);
     }
 
+    metrics_inc(s_m_commands);
     log_info("IPC command from client fd=%d: action=%s id=%s",
-             c->fd, action, id ? id : "(none)");
+             fd, action, id ? id : "(none)");
 
     /* Dispatch to the registered command handler.
      * NOTE: The handler must NOT hold references to action/id beyond
      * this call, as they are owned by the json_object and freed below. */
-    s_cmd_handler(c->fd, action, id, s_cmd_userdata);
+    s_cmd_handler(fd, action, id, s_cmd_userdata);
 
     /* Free the parsed JSON object (and all child objects). */
     json_object_put(root);
 }
 
 /**
- * Read available data from a client and dispatch complete messages.
- * Returns 0 normally, -1 if the client should be closed.
+ * Read available data from a client and copy every complete line into
+ * `out` (NUL-terminated).  Caller holds s_alert_mutex.
+ * Returns the number of bytes copied, or -1 if the client should be closed.
  */
-static int handle_client_data(client_slot_t *c)
+static int read_client_lines(client_slot_t *c, char *out)
 {
     int space = ALERT_MSG_MAX - c->buf_len - 1;
     if (space <= 0) {
         /* Buffer overflow — discard and reset. */
         log_warn("IPC: client buffer overflow, resetting (fd=%d)", c->fd);
         c->buf_len = 0;
-        return 0;
+        space = ALERT_MSG_MAX - 1;
     }
 
     ssize_t n = read(c->fd, c->buf + c->buf_len, (size_t)space);
@@ -172,27 +294,150 @@ static int handle_client_data(client_slot_t *c)
         return -1;
     }
     c->buf_len += (int)n;
-    c->buf[c->buf_len] = '\0';
+
+    /* Everything up to the last newline is complete. */
+    char *last_nl = memrchr(c->buf, '\n', (size_t)c->buf_len);
+    if (!last_nl) return 0;
+
+    int complete = (int)(last_nl - c->buf) + 1;
+    memcpy(out, c->buf, (size_t)complete);
+    out[complete] = '\0';
+
+    /* Move any remaining partial data to the front of the buffer. */
+    int remaining = c->buf_len - complete;
+    if (remaining > 0) {
+        memmove(c->buf, c->buf + complete, (size_t)remaining);
+    }
+    c->buf_len = remaining;
+
+    return complete;
+}
+
+/**
+ * Reactor callback for a client socket.  Queued output is drained on
+ * EPOLLOUT.  Lines are copied out under the lock and dispatched after
+ * releasing it, because command handlers reply through
+ * alert_send_to_client(), which takes the same lock.
+ */
+static void on_client_ready(int fd, uint32_t events, void *arg)
+{
+    client_slot_t *c = arg;
+    char lines[ALERT_MSG_MAX];
+    int  len = 0;
+
+    pthread_mutex_lock(&s_alert_mutex);
+    if (c->fd != fd) {
+        /* Slot was closed (or reused) by a writer thread meanwhile. */
+        pthread_mutex_unlock(&s_alert_mutex);
+        return;
+    }
+    if (events & EPOLLOUT) {
+        int rc = flush_client(c);
+        if (rc < 0 ||
+            (rc > 0 && reactor_mod_fd(s_reactor, fd, EPOLLIN | EPOLLRDHUP) != 0)) {
+            close_client(c);
+            pthread_mutex_unlock(&s_alert_mutex);
+            return;
+        }
+    }
+    if (events & ~EPOLLOUT) {
+        len = read_client_lines(c, lines);
+        if (len < 0) close_client(c);
+    }
+    pthread_mutex_unlock(&s_alert_mutex);
 
     /* Process all complete lines (newline-delimited JSON). */
-    char *line_start = c->buf;
+    char *line_start = lines;
     char *nl;
-    while ((nl = strchr(line_start, '\n')) != NULL) {
+    while (len > 0 && (nl = strchr(line_start, '\n')) != NULL) {
         *nl = '\0';
         if (nl > line_start) {
-            process_client_message(c, line_start);
+            process_client_message(fd, line_start);
         }
         line_start = nl + 1;
     }
+}
 
-    /* Move any remaining partial data to the front of the buffer. */
-    int remaining = c->buf_len - (int)(line_start - c->buf);
-    if (remaining > 0 && line_start != c->buf) {
-        memmove(c->buf, line_start, (size_t)remaining);
+/** Reactor callback for the listening socket: accept every pending client. */
+static void on_listen_ready(int fd, uint32_t events, void *arg)
+{
+    (void)events;
+    (void)arg;
+
+    for (;;) {
+        int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                log_warn_rl("IPC: accept(): %s", strerror(errno));
+            return;
+        }
+
+        pthread_mutex_lock(&s_alert_mutex);
+        client_slot_t *slot = find_free_slot();
+        if (slot &&
+            reactor_add_fd(s_reactor, client_fd, EPOLLIN | EPOLLRDHUP,
+                           on_client_ready, slot) == 0) {
+            slot->fd = client_fd;
+            slot->buf_len = 0;
+            slot->out_off = slot->out_len = 0;
+            s_client_count++;
+            log_info("IPC client connected (fd=%d, total: %d)",
+                     client_fd, s_client_count);
+        } else {
+            if (!slot)
+                log_warn("IPC: max clients reached — rejecting connection");
+            close(client_fd);
+        }
+        pthread_mutex_unlock(&s_alert_mutex);
     }
-    c->buf_len = remaining;
+}
 
-    return 0;
+/** Register metrics and empty every client slot. */
+static void reset_state(void)
+{
+    s_m_dropped  = metrics_counter("sentinel_ipc_dropped_messages_total",
+                       "GUI messages lost to clients disconnected for falling behind");
+    s_m_commands = metrics_counter("sentinel_ipc_commands_total",
+                       "Commands received from GUI clients");
+
+    /* Initialise all client slots to empty. */
+    for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
+        s_clients[i].fd = -1;
+        s_clients[i].buf_len = 0;
+        s_clients[i].out = NULL;
+        s_clients[i].out_off = s_clients[i].out_len = s_clients[i].out_cap = 0;
+    }
+    s_client_count = 0;
+}
+
+/** Close every client and the listener; with `unlink_path`, the path too. */
+static void close_all(int unlink_path)
+{
+    pthread_mutex_lock(&s_alert_mutex);
+
+    /* Close all client connections. */
+    for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
+        if (s_clients[i].fd >= 0) {
+            reactor_del_fd(s_reactor, s_clients[i].fd);
+            close(s_clients[i].fd);
+            s_clients[i].fd = -1;
+        }
+        free(s_clients[i].out);
+        s_clients[i].out = NULL;
+        s_clients[i].out_off = s_clients[i].out_len = s_clients[i].out_cap = 0;
+    }
+    s_client_count = 0;
+
+    /* Close the listener and, unless handed over, remove the socket file. */
+    if (s_listen_fd >= 0) {
+        reactor_del_fd(s_reactor, s_listen_fd);
+        close(s_listen_fd);
+        s_listen_fd = -1;
+    }
+    if (unlink_path) unlink(s_socket_path);
+
+    pthread_mutex_unlock(&s_alert_mutex);
 }
 
 /* ── Public API ─────────────────────────────────────────────────────────── */
@@ -202,17 +447,14 @@ int alert_server_init(const char *socket_path)
     const char *path = socket_path ? socket_path : ALERT_SOCKET_PATH;
     snprintf(s_socket_path, sizeof(s_socket_path), "%s", path);
 
-    /* Initialise all client slots to empty. */
-    for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
-        s_clients[i].fd = -1;
-        s_clients[i].buf_len = 0;
-    }
+    reset_state();
 
     /* Remove stale socket file if it exists. */
     unlink(s_socket_path);
 
-    /* Create the UNIX domain socket. */
-    s_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    /* Create the UNIX domain socket.  CLOEXEC: a successor started for a
+     * live upgrade receives it through the handover, not by inheritance. */
+    s_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (s_listen_fd < 0) {
         log_error("socket(AF_UNIX): %s", strerror(errno));
         return -1;
@@ -264,58 +506,31 @@ void alert_set_command_handler(alert_command_handler_t handler, void *user_data)
     s_cmd_userdata = user_data;
 }
 
-void alert_server_service(int timeout_ms)
+void alert_set_disconnect_handler(alert_disconnect_handler_t handler,
+                                  void *user_data)
 {
-    if (s_listen_fd < 0) return;
-
-    fd_set readfds;
-    FD_ZERO(&readfds);
-    FD_SET(s_listen_fd, &readfds);
-    int maxfd = s_listen_fd;
-
-    /* Add all connected clients to the select set. */
-    for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
-        if (s_clients[i].fd >= 0) {
-            FD_SET(s_clients[i].fd, &readfds);
-            if (s_clients[i].fd > maxfd) maxfd = s_clients[i].fd;
-        }
-    }
+    s_disc_handler  = handler;
+    s_disc_userdata = user_data;
+}
 
-    struct timeval tv = {
-        .tv_sec  = timeout_ms / 1000,
-        .tv_usec = (timeout_ms % 1000) * 1000
-    };
-
-    int ready = select(maxfd + 1, &readfds, NULL, NULL, &tv);
-    if (ready <= 0) return;
-
-    /* Check for new connections. */
-    if (FD_ISSET(s_listen_fd, &readfds)) {
-        int client_fd = accept(s_listen_fd, NULL, NULL);
-        if (client_fd >= 0) {
-            client_slot_t *slot = find_free_slot();
-            if (slot) {
-                set_nonblocking(client_fd);
-                slot->fd = client_fd;
-                slot->buf_len = 0;
-                s_client_count++;
-                log_info("IPC client connected (fd=%d, total: %d)",
-                         client_fd, s_client_count);
-            } else {
-                log_warn("IPC: max clients reached — rejecting connection");
-                close(client_fd);
-            }
-        }
-    }
+int alert_server_attach(reactor_t *r)
+{
+    if (!r || s_listen_fd < 0) return -1;
+    s_reactor = r;
 
-    /* Check each client for incoming data. */
+    /* Clients exist already only when adopted from a handover. */
     for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
-        if (s_clients[i].fd >= 0 && FD_ISSET(s_clients[i].fd, &readfds)) {
-            if (handle_client_data(&s_clients[i]) < 0) {
-                close_client(&s_clients[i]);
-            }
+        if (s_clients[i].fd < 0) continue;
+        uint32_t ev = EPOLLIN | EPOLLRDHUP;
+        if (s_clients[i].out_len > 0) ev |= EPOLLOUT;
+        if (reactor_add_fd(r, s_clients[i].fd, ev,
+                           on_client_ready, &s_clients[i]) != 0) {
+            close(s_clients[i].fd);
+            s_clients[i].fd = -1;
+            s_client_count--;
         }
     }
+    return reactor_add_fd(r, s_listen_fd, EPOLLIN, on_listen_ready, NULL);
 }
 
 void alert_broadcast(alert_type_t type,
@@ -347,35 +562,16 @@ void alert_broadcast(alert_type_t type,
 
     if (n <= 0 || (size_t)n >= sizeof(msg)) return;
 
-    pthread_mutex_lock(&s_alert_mutex);
+    int written = 0;
 
+    pthread_mutex_lock(&s_alert_mutex);
     for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
-        if (s_clients[i].fd >= 0) {
-            ssize_t w = write(s_clients[i].fd, msg, (size_t)n);
-            if (w < 0) {
-                /*
-                 * SIGPIPE is ignored (SIG_IGN in main.c), so a write to a
-                 * broken socket yields EPIPE instead of killing the daemon.
-                 * EAGAIN/EWOULDBLOCK means the send buffer is full — we
-                 *   silently drop this message for that client.
-                 * EPIPE/ECONNRESET mean the client has disconnected — we
-                 *   reclaim the slot cleanly to prevent use-after-close.
-                 */
-                if (errno == EPIPE || errno == ECONNRESET) {
-                    log_warn("IPC: broken pipe to client fd=%d — closing slot",
-                             s_clients[i].fd);
-                    close_client(&s_clients[i]);
-                } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                    log_warn("IPC: write failed to client fd=%d (%s) — closing",
-                             s_clients[i].fd, strerror(errno));
-                    close_client(&s_clients[i]);
-                }
-                /* EAGAIN/EWOULDBLOCK: silently skip this message. */
-            }
-        }
+        if (s_clients[i].fd >= 0 &&
+            client_send(&s_clients[i], msg, (size_t)n) == 0)
+            written++;
     }
-
     pthread_mutex_unlock(&s_alert_mutex);
+    SENTINEL_PROBE3(ipc_broadcast, alert_type_str(type), n, written);
 }
 
 /* Broadcast a raw pre-formatted JSON string to all connected clients. */
@@ -388,26 +584,16 @@ void alert_broadcast_raw(const char *json_str)
     int n = snprintf(msg, sizeof(msg), "%s\n", json_str);
     if (n <= 0 || (size_t)n >= sizeof(msg)) return;
 
-    pthread_mutex_lock(&s_alert_mutex);
+    int written = 0;
 
+    pthread_mutex_lock(&s_alert_mutex);
     for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
-        if (s_clients[i].fd >= 0) {
-            ssize_t w = write(s_clients[i].fd, msg, (size_t)n);
-            if (w < 0) {
-                if (errno == EPIPE || errno == ECONNRESET) {
-                    log_warn("IPC: broken pipe to client fd=%d — closing slot",
-                             s_clients[i].fd);
-                    close_client(&s_clients[i]);
-                } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                    log_warn("IPC: write failed to client fd=%d (%s) — closing",
-                             s_clients[i].fd, strerror(errno));
-                    close_client(&s_clients[i]);
-                }
-            }
-        }
+        if (s_clients[i].fd >= 0 &&
+            client_send(&s_clients[i], msg, (size_t)n) == 0)
+            written++;
     }
-
     pthread_mutex_unlock(&s_alert_mutex);
+    SENTINEL_PROBE3(ipc_broadcast, "raw", n, written);
 }
 
 int alert_send_to_client(int client_fd, const char *json_str)
@@ -422,65 +608,101 @@ int alert_send_to_client(int client_fd, const char *json_str)
     buf[len]     = '\n';
     buf[len + 1] = '\0';
 
+    /*
+     * Replies can be long streams (state sync, scan progress).  The line
+     * is queued whole under the lock, so broadcasts cannot interleave
+     * with it, and whatever the socket does not take now is drained by
+     * the reactor.
+     */
+    int rc = -1;
     pthread_mutex_lock(&s_alert_mutex);
-    ssize_t w = write(client_fd, buf, len + 1);
-    int write_errno = errno;   /* Capture errno before any other call. */
+    for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
+        if (s_clients[i].fd == client_fd) {
+            rc = client_send(&s_clients[i], buf, len + 1);
+            break;
+        }
+    }
     pthread_mutex_unlock(&s_alert_mutex);
 
     free(buf);
-
-    if (w < 0) {
-        /*
-         * EPIPE/ECONNRESET: the client disconnected between command receipt
-         * and our reply.  Log a warning and close the slot if we can find it.
-         * This is non-fatal — the daemon must keep running.
-         */
-        if (write_errno == EPIPE || write_errno == ECONNRESET) {
-            log_warn("alert_send_to_client: broken pipe to fd=%d — client gone",
-                     client_fd);
-        } else {
-            log_error("alert_send_to_client: write to fd=%d failed: %s",
-                      client_fd, strerror(write_errno));
-        }
-
-        /* Best-effort cleanup: find and close the slot for this fd. */
-        pthread_mutex_lock(&s_alert_mutex);
-        for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
-            if (s_clients[i].fd == client_fd) {
-                close_client(&s_clients[i]);
-                break;
-            }
-        }
-        pthread_mutex_unlock(&s_alert_mutex);
-
-        return -1;
-    }
-    return 0;
+    return rc;
 }
 
 void alert_server_shutdown(void)
+{
+    close_all(1);
+    log_info("IPC server shut down, socket removed: %s", s_socket_path);
+}
+
+void alert_server_export(handover_msg_t *msg)
 {
     pthread_mutex_lock(&s_alert_mutex);
 
-    /* Close all client connections. */
+    handover_put_u32(msg, HANDOVER_TAG_IPC);
+    handover_put_str(msg, s_socket_path);
+    handover_put_fd(msg, s_listen_fd);
+    handover_put_u32(msg, (uint32_t)s_client_count);
     for (int i = 0; i < ALERT_MAX_CLIENTS; i++) {
-        if (s_clients[i].fd >= 0) {
-            close(s_clients[i].fd);
-            s_clients[i].fd = -1;
-        }
+        if (s_clients[i].fd < 0) continue;
+        /* With any half-received command, so the line completes later. */
+        handover_put_fd(msg, s_clients[i].fd);
+        handover_put_u32(msg, (uint32_t)s_clients[i].buf_len);
+        handover_put_bytes(msg, s_clients[i].buf, (size_t)s_clients[i].buf_len);
+        /* And any reply not yet sent, so no line is cut short. */
+        handover_put_u32(msg, (uint32_t)s_clients[i].out_len);
+        if (s_clients[i].out_len > 0)
+            handover_put_bytes(msg, s_clients[i].out + s_clients[i].out_off,
+                               s_clients[i].out_len);
     }
-    s_client_count = 0;
 
-    /* Close the listener and remove the socket file. */
-    if (s_listen_fd >= 0) {
-        close(s_listen_fd);
-        s_listen_fd = -1;
+    pthread_mutex_unlock(&s_alert_mutex);
+}
+
+int alert_server_adopt(handover_msg_t *msg)
+{
+    reset_state();
+
+    uint32_t nclients = 0;
+    if (handover_expect(msg, HANDOVER_TAG_IPC) != 0 ||
+        handover_get_str(msg, s_socket_path, sizeof(s_socket_path)) != 0 ||
+        handover_get_fd(msg, &s_listen_fd) != 0 ||
+        handover_get_u32(msg, &nclients) != 0 ||
+        nclients > ALERT_MAX_CLIENTS)
+        goto fail;
+
+    for (uint32_t i = 0; i < nclients; i++) {
+        client_slot_t *c = &s_clients[i];
+        uint32_t    len;
+        const void *buf;
+        if (handover_get_fd(msg, &c->fd) != 0 ||
+            handover_get_u32(msg, &len) != 0 ||
+            len >= sizeof(c->buf) ||
+            handover_get_bytes(msg, &buf, len) != 0)
+            goto fail;
+        memcpy(c->buf, buf, len);
+        c->buf_len = (int)len;
+        s_client_count++;
+
+        if (handover_get_u32(msg, &len) != 0 ||
+            len > ALERT_CLIENT_OUT_MAX ||
+            (len > 0 && (handover_get_bytes(msg, &buf, len) != 0 ||
+                         queue_append(c, buf, len) != 0)))
+            goto fail;
     }
-    unlink(s_socket_path);
 
-    pthread_mutex_unlock(&s_alert_mutex);
+    log_info("IPC server adopted on %s with %d client(s)",
+             s_socket_path, s_client_count);
+    return 0;
 
-    log_info("IPC server shut down, socket removed: %s", s_socket_path);
+fail:
+    log_error("Malformed IPC state in handover");
+    close_all(0);
+    return -1;
+}
+
+void alert_server_release(void)
+{
+    close_all(0);
 }
 
 int alert_get_client_count(void)
@@ -490,3 +712,12 @@ int alert_get_client_count(void)
     pthread_mutex_unlock(&s_alert_mutex);
     return c;
 }
+
+int alert_client_privileged(int client_fd)
+{
+    struct ucred cred;
+    socklen_t    len = sizeof(cred);
+    if (getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+        return 0;
+    return cred.uid == 0 || cred.uid == geteuid();
+}
@@ -0,0 +1,309 @@
+/*
+ * catchup.c — Downtime catch-up sweep and last-good stamp (see catchup.h).
+ *
+ * The sweep is a crawl (crawl.h) with a file callback that compares
+ * statx() timestamps against the cutoff and feeds matches to the pool
+ * with threadpool_try_submit(), backing off while the queue is half
+ * full.  It never blocks on the pool, so stopping it is always quick.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "catchup.h"
+#include "crawl.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define STATE_CLEAN     "clean"
+#define STATE_RUNNING   "running"
+#define STATE_SWEEPING  "sweeping"
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static char               s_path[4096];
+static int                s_inited     = 0;
+
+/* The previous run's stamp. */
+static int                s_have_stamp = 0;
+static uint64_t           s_stamp_ns   = 0;
+static char               s_prev_state[16];
+
+/* Serialises stamp writes (reactor checkpoints vs. sweep completion). */
+static pthread_mutex_t    s_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Sweep parameters, kept for catchup_resume(). */
+static char             **s_roots      = NULL;
+static int                s_prune      = 0;
+static threadpool_t      *s_pool       = NULL;
+static catchup_filter_fn  s_filter     = NULL;
+
+static crawl_t           *s_crawl      = NULL;
+static int                s_stopping   = 0;     /* catchup_stop() waiting */
+static int                s_pending    = 0;     /* Sweep not finished yet */
+static uint64_t           s_cutoff_ns  = 0;
+static uint64_t           s_queued     = 0;
+
+static int                s_m_files    = -1;
+static int                s_m_queued   = -1;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static uint64_t stx_ns(const struct statx_timestamp *t)
+{
+    return (uint64_t)t->tv_sec * 1000000000ull + t->tv_nsec;
+}
+
+/* Latest of mtime and ctime: ctime also moves on rename and chmod. */
+static uint64_t changed_ns(const struct statx *stx)
+{
+    uint64_t m = stx_ns(&stx->stx_mtime);
+    uint64_t c = stx_ns(&stx->stx_ctime);
+    return m > c ? m : c;
+}
+
+static void format_time(uint64_t ns, char *out, size_t outlen)
+{
+    time_t    secs = (time_t)(ns / 1000000000ull);
+    struct tm tm;
+    localtime_r(&secs, &tm);
+    strftime(out, outlen, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+static void write_stamp(uint64_t ns, const char *state)
+{
+    char tmp[sizeof(s_path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", s_path);
+
+    pthread_mutex_lock(&s_write_mutex);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        log_error_rl("catchup: cannot write %s: %s", tmp, strerror(errno));
+        pthread_mutex_unlock(&s_write_mutex);
+        return;
+    }
+    char line[64];
+    int  n  = snprintf(line, sizeof(line), "%llu %s\n",
+                       (unsigned long long)ns, state);
+    int  ok = write(fd, line, (size_t)n) == n && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp, s_path) != 0) {
+        log_error_rl("catchup: cannot update %s: %s", s_path,
+                     strerror(errno));
+        unlink(tmp);
+    }
+    pthread_mutex_unlock(&s_write_mutex);
+}
+
+static int load_stamp(void)
+{
+    FILE *fp = fopen(s_path, "re");
+    if (!fp) {
+        if (errno != ENOENT)
+            log_warn("catchup: cannot read %s: %s", s_path, strerror(errno));
+        return -1;
+    }
+    unsigned long long ns;
+    char state[sizeof(s_prev_state)];
+    int  n = fscanf(fp, "%llu %15s", &ns, state);
+    fclose(fp);
+    if (n != 2 || ns == 0) {
+        log_warn("catchup: %s is malformed — ignoring it.", s_path);
+        return -1;
+    }
+    s_stamp_ns = ns;
+    snprintf(s_prev_state, sizeof(s_prev_state), "%s", state);
+    return 0;
+}
+
+/* ── Sweep callbacks (crawler threads) ──────────────────────────────────── */
+
+static int on_dir(const char *path, const struct statx *stx, void *arg)
+{
+    (void)path;
+    (void)arg;
+    return changed_ns(stx) < s_cutoff_ns ? CRAWL_SKIP_FILES : CRAWL_ENTER;
+}
+
+static int on_file(const char *path, const struct statx *stx, void *arg)
+{
+    (void)arg;
+    metrics_inc(s_m_files);
+
+    if (changed_ns(stx) < s_cutoff_ns) return 0;
+    if (!s_filter(path, (int64_t)stx->stx_size)) return 0;
+
+    /* Live events first: only feed the queue while it is half empty. */
+    for (;;) {
+        if (__atomic_load_n(&s_stopping, __ATOMIC_RELAXED)) return -1;
+
+        threadpool_stats_t st;
+        threadpool_get_stats(s_pool, &st);
+        if (st.depth * 2 < st.capacity) {
+            int rc = threadpool_try_submit(s_pool, path, NULL);
+            if (rc < 0)  return -1;            /* Pool shutting down */
+            if (rc == 0) break;
+        }
+        struct timespec ts = { 0, CATCHUP_THROTTLE_MS * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    __atomic_fetch_add(&s_queued, 1, __ATOMIC_RELAXED);
+    metrics_inc(s_m_queued);
+    return 0;
+}
+
+static void on_done(const crawl_stats_t *st, void *arg)
+{
+    (void)arg;
+
+    uint64_t queued = __atomic_load_n(&s_queued, __ATOMIC_RELAXED);
+    if (st->cancelled) {
+        log_info("Catch-up sweep stopped after %.1f s (%llu files queued "
+                 "so far).", st->elapsed_ns / 1e9,
+                 (unsigned long long)queued);
+        return;
+    }
+
+    log_info("Catch-up sweep done in %.1f s: %llu dirs (%llu unchanged), "
+             "%llu files, %llu changed and queued, %llu errors.",
+             st->elapsed_ns / 1e9, (unsigned long long)st->dirs,
+             (unsigned long long)st->pruned, (unsigned long long)st->files,
+             (unsigned long long)queued, (unsigned long long)st->errors);
+
+    /* Nothing pending any more; the cutoff only moves on a checkpoint. */
+    __atomic_store_n(&s_pending, 0, __ATOMIC_RELEASE);
+    write_stamp(s_stamp_ns, STATE_RUNNING);
+}
+
+static int launch(void)
+{
+    crawl_opts_t o = {
+        .threads      = CATCHUP_THREADS,
+        .low_priority = 1,
+        .file_mask    = STATX_MTIME | STATX_CTIME | STATX_SIZE,
+        .dir_mask     = s_prune ? STATX_MTIME | STATX_CTIME : 0,
+        .on_dir       = s_prune ? on_dir : NULL,
+        .on_file      = on_file,
+        .on_done      = on_done,
+    };
+    s_queued = 0;
+    s_crawl  = crawl_start((const char *const *)s_roots, &o);
+    if (!s_crawl) {
+        log_error("Cannot start the catch-up sweep.");
+        return -1;
+    }
+    return 0;
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+int catchup_init(const char *stamp_path)
+{
+    if (!stamp_path) {
+        if (mkdir(JOURNAL_DIR, 0700) != 0 && errno != EEXIST) {
+            log_error("catchup: mkdir %s: %s", JOURNAL_DIR, strerror(errno));
+            return -1;
+        }
+        stamp_path = CATCHUP_STAMP_PATH;
+    }
+    snprintf(s_path, sizeof(s_path), "%s", stamp_path);
+
+    if (s_m_files < 0) {
+        s_m_files  = metrics_counter("sentinel_catchup_files_total",
+                         "Files examined by the downtime catch-up sweep");
+        s_m_queued = metrics_counter("sentinel_catchup_queued_total",
+                         "Files changed during downtime and queued");
+    }
+
+    s_have_stamp = load_stamp() == 0;
+    s_inited     = 1;
+    return 0;
+}
+
+int catchup_start(const char *const *roots, int prune, threadpool_t *pool,
+                  catchup_filter_fn filter, int takeover)
+{
+    if (!s_inited || !roots || !roots[0] || !pool || !filter) return -1;
+
+    if (!s_have_stamp) {
+        log_info("No record of a previous run in %s — skipping the "
+                 "catch-up sweep.", s_path);
+        return 0;
+    }
+    int unfinished = strcmp(s_prev_state, STATE_SWEEPING) == 0;
+    if (takeover && !unfinished) return 0;
+
+    int n = 0;
+    while (roots[n]) n++;
+    s_roots = calloc((size_t)n + 1, sizeof(*s_roots));
+    if (!s_roots) return -1;
+    for (int i = 0; i < n; i++) {
+        if (!(s_roots[i] = strdup(roots[i]))) {
+            catchup_shutdown();
+            return -1;
+        }
+    }
+    s_prune     = prune;
+    s_pool      = pool;
+    s_filter    = filter;
+    s_cutoff_ns = s_stamp_ns - (uint64_t)CATCHUP_SLACK_MS * 1000000ull;
+
+    char when[32];
+    format_time(s_stamp_ns, when, sizeof(when));
+    log_info("Catch-up sweep for changes since %s (%s)%s.", when,
+             unfinished ? "unfinished sweep"
+             : strcmp(s_prev_state, STATE_CLEAN) == 0 ? "clean shutdown"
+             : "last checkpoint before an unclean stop",
+             prune ? ", pruning unchanged directories" : "");
+
+    /* Pending until done: a stop or crash from here on redoes it. */
+    s_pending = 1;
+    write_stamp(s_stamp_ns, STATE_SWEEPING);
+    return launch();
+}
+
+void catchup_stop(void)
+{
+    if (!s_crawl) return;
+    __atomic_store_n(&s_stopping, 1, __ATOMIC_RELAXED);
+    crawl_cancel(s_crawl);
+    crawl_join(s_crawl);
+    s_crawl = NULL;
+    __atomic_store_n(&s_stopping, 0, __ATOMIC_RELAXED);
+}
+
+void catchup_resume(void)
+{
+    if (s_crawl || !s_roots || !__atomic_load_n(&s_pending, __ATOMIC_ACQUIRE))
+        return;
+    log_info("Restarting the catch-up sweep.");
+    launch();
+}
+
+void catchup_checkpoint(uint64_t good_ns, int clean)
+{
+    if (!s_inited) return;
+    if (__atomic_load_n(&s_pending, __ATOMIC_ACQUIRE))
+        write_stamp(s_stamp_ns, STATE_SWEEPING);
+    else
+        write_stamp(good_ns, clean ? STATE_CLEAN : STATE_RUNNING);
+}
+
+void catchup_shutdown(void)
+{
+    catchup_stop();
+    if (s_roots) {
+        for (int i = 0; s_roots[i]; i++) free(s_roots[i]);
+        free(s_roots);
+        s_roots = NULL;
+    }
+}
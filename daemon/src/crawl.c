@@ -0,0 +1,302 @@
+/*
+ * crawl.c — Parallel directory crawler (see crawl.h).
+ *
+ * The threads share one LIFO stack of directory paths.  A thread pops a
+ * directory, reads it without the lock, then pushes the subdirectories
+ * it found in one go; depth-first order keeps the stack short on wide
+ * trees.  The crawl is over when the stack is empty and no thread is
+ * still reading (a reader may yet push more).
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "crawl.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+struct crawl {
+    crawl_opts_t     o;
+    pthread_t        threads[CRAWL_MAX_THREADS];
+    int              nthreads;
+
+    pthread_mutex_t  mutex;
+    pthread_cond_t   cond;
+    char           **stack;            /* Directories still to read      */
+    size_t           n;
+    size_t           cap;
+    int              busy;             /* Threads reading a directory    */
+    int              running;          /* Threads not yet finished       */
+    int              cancel;
+
+    uint64_t         t0_ns;
+    crawl_stats_t    st;               /* Updated with __atomic ops      */
+};
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void count(uint64_t *ctr)
+{
+    __atomic_fetch_add(ctr, 1, __ATOMIC_RELAXED);
+}
+
+/* Push `paths` (ownership moves to the stack).  Call with the lock held. */
+static int push_locked(crawl_t *c, char **paths, size_t n)
+{
+    if (c->n + n > c->cap) {
+        size_t ncap = c->cap ? c->cap : 256;
+        while (ncap < c->n + n) ncap *= 2;
+        char **ns = realloc(c->stack, ncap * sizeof(*ns));
+        if (!ns) return -1;
+        c->stack = ns;
+        c->cap   = ncap;
+    }
+    memcpy(c->stack + c->n, paths, n * sizeof(*paths));
+    c->n += n;
+    return 0;
+}
+
+/* "dir" + "/" + "name", without doubling the root's slash. */
+static int join_path(char *out, const char *dir, size_t dlen,
+                     const char *name)
+{
+    const char *sep = (dlen && dir[dlen - 1] == '/') ? "" : "/";
+    int n = snprintf(out, PATH_MAX, "%s%s%s", dir, sep, name);
+    return (n < 0 || n >= PATH_MAX) ? -1 : 0;
+}
+
+/*
+ * Read one directory: hand its files to on_file and collect its
+ * subdirectories in *subs (grown as needed).
+ */
+static void read_dir(crawl_t *c, const char *path,
+                     char ***subs, size_t *nsubs, size_t *subs_cap)
+{
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != ENOENT) count(&c->st.errors);
+        return;
+    }
+
+    int skip_files = 0;
+    if (c->o.on_dir) {
+        struct statx stx;
+        if (c->o.dir_mask &&
+            statx(fd, "", AT_EMPTY_PATH | AT_STATX_DONT_SYNC,
+                  STATX_TYPE | c->o.dir_mask, &stx) != 0) {
+            count(&c->st.errors);
+            close(fd);
+            return;
+        }
+        if (!c->o.dir_mask) memset(&stx, 0, sizeof(stx));
+        int act = c->o.on_dir(path, &stx, c->o.arg);
+        if (act == CRAWL_PRUNE) {
+            count(&c->st.pruned);
+            close(fd);
+            return;
+        }
+        skip_files = act == CRAWL_SKIP_FILES;
+        if (skip_files) count(&c->st.pruned);
+    }
+
+    DIR *dp = fdopendir(fd);
+    if (!dp) {
+        count(&c->st.errors);
+        close(fd);
+        return;
+    }
+    count(&c->st.dirs);
+
+    size_t         dlen = strlen(path);
+    char           child[PATH_MAX];
+    struct dirent *de;
+    while ((de = readdir(dp)) != NULL &&
+           !__atomic_load_n(&c->cancel, __ATOMIC_RELAXED)) {
+        if (de->d_name[0] == '.') continue;    /* ".", ".." and hidden */
+
+        unsigned int type = de->d_type;
+        if (type != DT_DIR && type != DT_REG && type != DT_UNKNOWN)
+            continue;                          /* Symlinks, devices, … */
+        if (type == DT_REG && skip_files) continue;
+        if (join_path(child, path, dlen, de->d_name) != 0) {
+            count(&c->st.errors);
+            continue;
+        }
+
+        struct statx stx;
+        if (type != DT_DIR) {
+            if (statx(dirfd(dp), de->d_name,
+                      AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC,
+                      STATX_TYPE | c->o.file_mask, &stx) != 0) {
+                if (errno != ENOENT) count(&c->st.errors);
+                continue;                      /* Gone since readdir() */
+            }
+            if (S_ISDIR(stx.stx_mode))      type = DT_DIR;
+            else if (!S_ISREG(stx.stx_mode)) continue;
+        }
+
+        if (type == DT_DIR) {
+            if (*nsubs == *subs_cap) {
+                size_t ncap = *subs_cap ? *subs_cap * 2 : 64;
+                char **ns = realloc(*subs, ncap * sizeof(*ns));
+                if (!ns) { count(&c->st.errors); continue; }
+                *subs     = ns;
+                *subs_cap = ncap;
+            }
+            char *dup = strdup(child);
+            if (!dup) { count(&c->st.errors); continue; }
+            (*subs)[(*nsubs)++] = dup;
+            continue;
+        }
+
+        if (skip_files) continue;
+        count(&c->st.files);
+        if (c->o.on_file(child, &stx, c->o.arg) != 0)
+            crawl_cancel(c);
+    }
+    closedir(dp);
+}
+
+static void *crawl_main(void *arg)
+{
+    crawl_t *c = arg;
+
+    if (c->o.low_priority) {
+        pid_t tid = (pid_t)syscall(SYS_gettid);
+        setpriority(PRIO_PROCESS, (id_t)tid, 19);
+#ifdef SYS_ioprio_set
+        syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, tid,
+                3 << 13 /* IOPRIO_CLASS_IDLE */);
+#endif
+    }
+
+    char  **subs = NULL;
+    size_t  nsubs = 0, subs_cap = 0;
+
+    pthread_mutex_lock(&c->mutex);
+    for (;;) {
+        while (c->n == 0 && c->busy > 0 && !c->cancel)
+            pthread_cond_wait(&c->cond, &c->mutex);
+        if (c->n == 0 || c->cancel) break;
+
+        char *path = c->stack[--c->n];
+        c->busy++;
+        pthread_mutex_unlock(&c->mutex);
+
+        nsubs = 0;
+        read_dir(c, path, &subs, &nsubs, &subs_cap);
+        free(path);
+
+        pthread_mutex_lock(&c->mutex);
+        c->busy--;
+        if (nsubs && push_locked(c, subs, nsubs) != 0) {
+            for (size_t i = 0; i < nsubs; i++) free(subs[i]);
+            count(&c->st.errors);
+            nsubs = 0;
+        }
+        if (nsubs || (c->n == 0 && c->busy == 0))
+            pthread_cond_broadcast(&c->cond);
+    }
+    pthread_cond_broadcast(&c->cond);
+    int last = --c->running == 0;
+    pthread_mutex_unlock(&c->mutex);
+    free(subs);
+
+    if (last) {
+        c->st.elapsed_ns = metrics_now_ns() - c->t0_ns;
+        c->st.cancelled  = __atomic_load_n(&c->cancel, __ATOMIC_RELAXED);
+        if (c->o.on_done) c->o.on_done(&c->st, c->o.arg);
+    }
+    return NULL;
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+crawl_t *crawl_start(const char *const *roots, const crawl_opts_t *opts)
+{
+    if (!roots || !opts || !opts->on_file) return NULL;
+
+    crawl_t *c = calloc(1, sizeof(*c));
+    if (!c) return NULL;
+    c->o        = *opts;
+    c->nthreads = opts->threads > 0 ? opts->threads : CRAWL_THREADS;
+    if (c->nthreads > CRAWL_MAX_THREADS) c->nthreads = CRAWL_MAX_THREADS;
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->cond, NULL);
+
+    for (int i = 0; roots[i]; i++) {
+        char *dup = strdup(roots[i]);
+        if (!dup || push_locked(c, &dup, 1) != 0) {
+            free(dup);
+            crawl_join(c);
+            return NULL;
+        }
+    }
+
+    c->t0_ns   = metrics_now_ns();
+    c->running = c->nthreads;
+    for (int i = 0; i < c->nthreads; i++) {
+        int rc = pthread_create(&c->threads[i], NULL, crawl_main, c);
+        if (rc != 0) {
+            log_error("crawl: pthread_create: %s", strerror(rc));
+            pthread_mutex_lock(&c->mutex);
+            c->running -= c->nthreads - i;
+            c->nthreads = i;
+            c->cancel   = 1;
+            pthread_cond_broadcast(&c->cond);
+            pthread_mutex_unlock(&c->mutex);
+            crawl_join(c);
+            return NULL;
+        }
+    }
+    return c;
+}
+
+void crawl_cancel(crawl_t *c)
+{
+    if (!c) return;
+    pthread_mutex_lock(&c->mutex);
+    c->cancel = 1;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+int crawl_cancelled(const crawl_t *c)
+{
+    return c ? __atomic_load_n(&c->cancel, __ATOMIC_RELAXED) : 1;
+}
+
+void crawl_get_stats(crawl_t *c, crawl_stats_t *out)
+{
+    if (!c || !out) return;
+    out->dirs       = __atomic_load_n(&c->st.dirs, __ATOMIC_RELAXED);
+    out->pruned     = __atomic_load_n(&c->st.pruned, __ATOMIC_RELAXED);
+    out->files      = __atomic_load_n(&c->st.files, __ATOMIC_RELAXED);
+    out->errors     = __atomic_load_n(&c->st.errors, __ATOMIC_RELAXED);
+    out->elapsed_ns = metrics_now_ns() - c->t0_ns;
+    out->cancelled  = crawl_cancelled(c);
+}
+
+void crawl_join(crawl_t *c)
+{
+    if (!c) return;
+    for (int i = 0; i < c->nthreads; i++)
+        pthread_join(c->threads[i], NULL);
+
+    for (size_t i = 0; i < c->n; i++) free(c->stack[i]);
+    free(c->stack);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mutex);
+    free(c);
+}
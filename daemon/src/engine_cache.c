@@ -0,0 +1,247 @@
+/*
+ * engine_cache.c — Verdict cache engine.
+ *
+ * Remembers the SHA-256 of content a later engine (clamd) found clean,
+ * together with the signature version of that verdict, and calls the
+ * same content clean again while the signatures have not changed.  It
+ * is keyed by content, not by inode or timestamps: metadata can be
+ * forged and copies of one file share an entry.  Only the hash of the
+ * bytes the deciding engine actually scanned is recorded, so a file
+ * swapped between hashing and scanning cannot launder a verdict.
+ *
+ * The table is 4-way set-associative with per-set LRU, sized by the
+ * spec argument ("cache:ENTRIES", default ENGINE_CACHE_ENTRIES), and
+ * locked in stripes.  It lives in memory only.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "engine.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <json-c/json.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_WAYS   4
+#define CACHE_LOCKS  64
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+/* Metric IDs, shared by every cache instance (registered once). */
+static int s_m_hits   = -1;
+static int s_m_misses = -1;
+
+typedef struct {
+    uint8_t  sha256[SHA256_DIGEST_LEN];
+    uint32_t sigver;                     /* 0: empty way                  */
+    uint32_t used;                       /* LRU clock of the last hit     */
+} cache_way_t;
+
+typedef struct {
+    cache_way_t     *ways;               /* nsets * CACHE_WAYS            */
+    size_t           nsets;              /* Power of two                  */
+    pthread_mutex_t  locks[CACHE_LOCKS];
+    uint32_t         clock;              /* Atomic: LRU stamps            */
+
+    uint32_t         sigver;             /* Atomic: current signatures    */
+    uint64_t         sigver_at;          /* Atomic: when it was read (ns) */
+
+    uint64_t         hits, misses, stored;   /* Atomic                    */
+} cache_t;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static size_t set_of(const cache_t *c, const uint8_t *digest)
+{
+    uint64_t h;
+    memcpy(&h, digest, sizeof(h));       /* SHA-256 bits are uniform */
+    return (size_t)h & (c->nsets - 1);
+}
+
+/*
+ * Signature version verdicts must match, re-read every
+ * ENGINE_CACHE_SIGVER_MS by whichever worker notices first.  0 (clamd
+ * unreachable) disables the cache until the next read.
+ */
+static uint32_t current_sigver(cache_t *c)
+{
+    uint64_t now = metrics_now_ns();
+    uint64_t at  = __atomic_load_n(&c->sigver_at, __ATOMIC_RELAXED);
+    if (at && now - at < (uint64_t)ENGINE_CACHE_SIGVER_MS * 1000000ull)
+        return __atomic_load_n(&c->sigver, __ATOMIC_RELAXED);
+
+    if (__atomic_compare_exchange_n(&c->sigver_at, &at, now, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        uint32_t v = scanner_db_version();
+        if (v != __atomic_load_n(&c->sigver, __ATOMIC_RELAXED))
+            log_info("Verdict cache: signature version %u.", v);
+        __atomic_store_n(&c->sigver, v, __ATOMIC_RELAXED);
+        return v;
+    }
+    return __atomic_load_n(&c->sigver, __ATOMIC_RELAXED);
+}
+
+/* ── Engine operations ──────────────────────────────────────────────────── */
+
+static void *cache_init(const char *arg, char *err, size_t errlen)
+{
+    long entries = ENGINE_CACHE_ENTRIES;
+    if (arg && *arg) {
+        char *end;
+        entries = strtol(arg, &end, 10);
+        if (*end || entries < CACHE_WAYS || entries > (1L << 26)) {
+            snprintf(err, errlen, "cache size must be %d..%ld entries",
+                     CACHE_WAYS, 1L << 26);
+            return NULL;
+        }
+    }
+
+    cache_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        snprintf(err, errlen, "out of memory");
+        return NULL;
+    }
+    c->nsets = 1;
+    while (c->nsets * CACHE_WAYS < (size_t)entries) c->nsets <<= 1;
+    c->ways = calloc(c->nsets * CACHE_WAYS, sizeof(*c->ways));
+    if (!c->ways) {
+        free(c);
+        snprintf(err, errlen, "out of memory");
+        return NULL;
+    }
+    for (int i = 0; i < CACHE_LOCKS; i++)
+        pthread_mutex_init(&c->locks[i], NULL);
+
+    if (s_m_hits < 0) {
+        s_m_hits   = metrics_counter("sentinel_cache_hits_total",
+                         "Files the verdict cache found clean");
+        s_m_misses = metrics_counter("sentinel_cache_misses_total",
+                         "Files looked up in the verdict cache and not found");
+    }
+
+    log_info("Verdict cache: %zu entries.", c->nsets * CACHE_WAYS);
+    return c;
+}
+
+static engine_verdict_t cache_scan(void *self, engine_file_t *file,
+                                   scan_report_t *report)
+{
+    cache_t *c = self;
+
+    uint32_t sigver = current_sigver(c);
+    if (sigver == 0) return ENGINE_PASS;
+
+    const uint8_t *digest = engine_file_sha256(file);
+    if (!digest) return ENGINE_PASS;
+
+    size_t           set  = set_of(c, digest);
+    cache_way_t     *ways = &c->ways[set * CACHE_WAYS];
+    pthread_mutex_t *lock = &c->locks[set % CACHE_LOCKS];
+    int              hit  = 0;
+
+    pthread_mutex_lock(lock);
+    for (int w = 0; w < CACHE_WAYS; w++) {
+        if (ways[w].sigver >= sigver &&
+            memcmp(ways[w].sha256, digest, SHA256_DIGEST_LEN) == 0) {
+            ways[w].used = __atomic_add_fetch(&c->clock, 1, __ATOMIC_RELAXED);
+            hit = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(lock);
+
+    if (!hit) {
+        __atomic_add_fetch(&c->misses, 1, __ATOMIC_RELAXED);
+        metrics_inc(s_m_misses);
+        return ENGINE_PASS;
+    }
+    __atomic_add_fetch(&c->hits, 1, __ATOMIC_RELAXED);
+    metrics_inc(s_m_hits);
+    memcpy(report->sha256, digest, SHA256_DIGEST_LEN);
+    report->has_sha256 = 1;
+    return ENGINE_CLEAN;
+}
+
+static void cache_learn(void *self, engine_file_t *file,
+                        const scan_report_t *report)
+{
+    (void)file;
+    cache_t *c = self;
+    if (report->result != SCAN_RESULT_CLEAN || !report->has_sha256) return;
+
+    uint32_t sigver = __atomic_load_n(&c->sigver, __ATOMIC_RELAXED);
+    if (sigver == 0) return;
+
+    size_t           set  = set_of(c, report->sha256);
+    cache_way_t     *ways = &c->ways[set * CACHE_WAYS];
+    pthread_mutex_t *lock = &c->locks[set % CACHE_LOCKS];
+
+    pthread_mutex_lock(lock);
+    int victim = -1;
+    for (int w = 0; w < CACHE_WAYS && victim < 0; w++)
+        if (ways[w].sigver &&
+            memcmp(ways[w].sha256, report->sha256, SHA256_DIGEST_LEN) == 0)
+            victim = w;                  /* Refresh in place */
+    if (victim < 0) {                    /* Empty way, else least recent */
+        victim = 0;
+        for (int w = 0; w < CACHE_WAYS; w++) {
+            if (ways[w].sigver == 0) {
+                victim = w;
+                break;
+            }
+            if (ways[w].used < ways[victim].used) victim = w;
+        }
+    }
+    memcpy(ways[victim].sha256, report->sha256, SHA256_DIGEST_LEN);
+    ways[victim].sigver = sigver;
+    ways[victim].used   = __atomic_add_fetch(&c->clock, 1,
+                                             __ATOMIC_RELAXED);
+    pthread_mutex_unlock(lock);
+
+    __atomic_add_fetch(&c->stored, 1, __ATOMIC_RELAXED);
+}
+
+static void cache_stats(void *self, struct json_object *out)
+{
+    cache_t *c = self;
+    json_object_object_add(out, "capacity",
+        json_object_new_int64((int64_t)(c->nsets * CACHE_WAYS)));
+    json_object_object_add(out, "hits", json_object_new_int64(
+        (int64_t)__atomic_load_n(&c->hits, __ATOMIC_RELAXED)));
+    json_object_object_add(out, "misses", json_object_new_int64(
+        (int64_t)__atomic_load_n(&c->misses, __ATOMIC_RELAXED)));
+    json_object_object_add(out, "stored", json_object_new_int64(
+        (int64_t)__atomic_load_n(&c->stored, __ATOMIC_RELAXED)));
+    json_object_object_add(out, "sigver", json_object_new_int64(
+        __atomic_load_n(&c->sigver, __ATOMIC_RELAXED)));
+}
+
+static void cache_shutdown(void *self)
+{
+    cache_t *c = self;
+    for (int i = 0; i < CACHE_LOCKS; i++)
+        pthread_mutex_destroy(&c->locks[i]);
+    free(c->ways);
+    free(c);
+}
+
+const engine_ops_t engine_cache = {
+    .name     = "cache",
+    .init     = cache_init,
+    .scan     = cache_scan,
+    .learn    = cache_learn,
+    .stats    = cache_stats,
+    .shutdown = cache_shutdown,
+};
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void engine_cache_get_stats(scanner_stats_t *out)
+{
+    out->cache_hits   = metrics_counter_value(s_m_hits);
+    out->cache_misses = metrics_counter_value(s_m_misses);
+}
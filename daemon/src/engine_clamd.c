@@ -0,0 +1,368 @@
+/*
+ * engine_clamd.c — ClamAV clamd UNIX-socket engine.
+ *
+ * Streams file contents to the running clamd daemon (zINSTREAM) and
+ * parses its verdict.  Spec: "clamd" for the scanner's default socket,
+ * "clamd:/path/to/clamd.ctl" for another one.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "engine.h"
+#include "logger.h"
+#include "metrics.h"
+
+#include <json-c/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+typedef struct {
+    char socket_path[108];       /* Matches sizeof(sun_path) */
+} clamd_t;
+
+/* Metric IDs, shared by all instances (registered on first init). */
+static int  s_m_scan_seconds   = -1;
+static int  s_m_connect_errors = -1;
+static int  s_m_bytes          = -1;
+static int  s_m_failures       = -1;
+
+/* Outcome of the last clamd exchange: 1 answered, 0 failed, -1 none yet.
+ * Written by workers and read by the status broadcaster (relaxed). */
+static int  s_clamd_up         = -1;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void note_clamd(int up)
+{
+    __atomic_store_n(&s_clamd_up, up, __ATOMIC_RELAXED);
+}
+
+/* A scan died after the connection was made (I/O error, no reply). */
+static void note_failure(void)
+{
+    metrics_inc(s_m_failures);
+    note_clamd(0);
+}
+
+/**
+ * Open a UNIX-domain connection to clamd.
+ * Returns the fd on success, -1 on failure.
+ */
+static int clamd_connect(const clamd_t *c)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        log_error("socket(): %s", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", c->socket_path);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        log_error_rl("connect(%s): %s", c->socket_path, strerror(errno));
+        metrics_inc(s_m_connect_errors);
+        note_clamd(0);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Send a command to clamd and read the response.
+ * @param fd    Connected socket fd.
+ * @param cmd   Command string (e.g. "PING\n" or "SCAN /path\n").
+ * @param resp  Buffer for the response.
+ * @param rlen  Size of resp buffer.
+ * @return Number of bytes read, or -1 on error.
+ */
+static ssize_t clamd_command(int fd, const char *cmd, char *resp, size_t rlen)
+{
+    size_t cmd_len = strlen(cmd);
+    ssize_t sent = write(fd, cmd, cmd_len);
+    if (sent < 0 || (size_t)sent != cmd_len) {
+        log_error("clamd write error: %s", strerror(errno));
+        return -1;
+    }
+
+    /* Shutdown write side so clamd knows the command is complete. */
+    shutdown(fd, SHUT_WR);
+
+    ssize_t total = 0;
+    while ((size_t)total < rlen - 1) {
+        ssize_t n = read(fd, resp + total, rlen - 1 - (size_t)total);
+        if (n <= 0) break;
+        total += n;
+    }
+    resp[total] = '\0';
+
+    return total;
+}
+
+/* ── Engine operations ──────────────────────────────────────────────────── */
+
+static void *clamd_init(const char *arg, char *err, size_t errlen)
+{
+    const char *path = arg && *arg ? arg : engine_clamd_default_socket();
+    if (strlen(path) >= sizeof(((clamd_t *)0)->socket_path)) {
+        snprintf(err, errlen, "clamd socket path too long");
+        return NULL;
+    }
+
+    clamd_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        snprintf(err, errlen, "out of memory");
+        return NULL;
+    }
+    snprintf(c->socket_path, sizeof(c->socket_path), "%s", path);
+
+    if (s_m_scan_seconds < 0) {
+        s_m_scan_seconds   = metrics_histogram("sentinel_clamd_scan_duration_seconds",
+                                 "clamd round trip per file (connect to verdict)");
+        s_m_connect_errors = metrics_counter("sentinel_clamd_connect_errors_total",
+                                 "Failed connections to clamd");
+        s_m_bytes          = metrics_counter("sentinel_clamd_streamed_bytes_total",
+                                 "File bytes streamed to clamd via zINSTREAM");
+        s_m_failures       = metrics_counter("sentinel_clamd_failures_total",
+                                 "Scans aborted by a clamd I/O error or missing reply");
+    }
+
+    log_info("clamd engine using socket: %s", c->socket_path);
+    return c;
+}
+
+static engine_verdict_t clamd_scan(void *self, engine_file_t *file,
+                                   scan_report_t *report)
+{
+    clamd_t *c = self;
+
+    /*
+     * Use clamd's zINSTREAM protocol instead of SCAN.
+     *
+     * SCAN requires clamd (which runs as the unprivileged user "clamav")
+     * to open the target file itself.  On most Linux systems the user's
+     * home directory has mode 700, so clamd gets "Permission denied".
+     *
+     * zINSTREAM solves this: our daemon (running as root) reads the file
+     * (the chain has it open already) and streams the raw bytes to clamd
+     * over the socket.  clamd never touches the filesystem — it scans
+     * pure byte content.
+     *
+     * Protocol:
+     *   1. Send "zINSTREAM\0"  (null-terminated z-prefix command).
+     *   2. For each chunk: send 4-byte big-endian length + chunk data.
+     *   3. Send 4-byte zero (0x00000000) to signal end-of-data.
+     *   4. Read the response (same format as SCAN: "... OK\n" / "... FOUND\n").
+     */
+
+    uint64_t t0 = metrics_now_ns();
+    int sock_fd = clamd_connect(c);
+    if (sock_fd < 0) return ENGINE_OFFLINE;
+    report->t_connected = metrics_now_ns();
+
+    /* Step 1: Send the zINSTREAM command (null-terminated). */
+    const char cmd[] = "zINSTREAM";
+    if (write(sock_fd, cmd, sizeof(cmd)) < 0) {  /* sizeof includes the '\0' */
+        log_error("clamd write zINSTREAM cmd error: %s", strerror(errno));
+        note_failure();
+        close(sock_fd);
+        return ENGINE_OFFLINE;
+    }
+
+    /*
+     * Step 2: Stream file contents in 8 KB chunks.  The hash of what was
+     * streamed is what a verdict cache may remember: the file can change
+     * between another engine's read and this one.
+     */
+    #define CHUNK_SIZE 8192
+    char buf[CHUNK_SIZE];
+    ssize_t nread;
+    int stream_ok = 1, cancelled = 0;
+    uint64_t streamed = 0;
+    sha256_ctx_t hash;
+    sha256_init(&hash);
+
+    while ((nread = pread(file->fd, buf, sizeof(buf), (off_t)streamed)) > 0) {
+        if (engine_cancelled(file)) {
+            cancelled = 1;
+            break;
+        }
+        /* 4-byte big-endian chunk length. */
+        uint32_t chunk_len = htonl((uint32_t)nread);
+        if (write(sock_fd, &chunk_len, 4) < 0 ||
+            write(sock_fd, buf, (size_t)nread) < 0) {
+            log_error("clamd INSTREAM write error: %s", strerror(errno));
+            stream_ok = 0;
+            break;
+        }
+        if (streamed == 0) {
+            report->head_len = (size_t)nread < sizeof(report->head)
+                             ? (size_t)nread : sizeof(report->head);
+            memcpy(report->head, buf, report->head_len);
+        }
+        if (file->want_sha256) sha256_update(&hash, buf, (size_t)nread);
+        streamed += (uint64_t)nread;
+    }
+
+    if (cancelled) {                      /* Lost a race: hang up */
+        close(sock_fd);
+        return ENGINE_PASS;
+    }
+    if (!stream_ok) {
+        note_failure();
+        close(sock_fd);
+        return ENGINE_OFFLINE;
+    }
+    if (nread == 0 && file->want_sha256) {
+        sha256_final(&hash, report->sha256);
+        report->has_sha256 = 1;
+    }
+
+    /* Step 3: Send end-of-data marker (4 zero bytes). */
+    uint32_t zero = 0;
+    if (write(sock_fd, &zero, 4) < 0) {
+        log_error("clamd INSTREAM end marker error: %s", strerror(errno));
+        note_failure();
+        close(sock_fd);
+        return ENGINE_OFFLINE;
+    }
+
+    report->t_streamed = metrics_now_ns();
+
+    /* Step 4: Read the response. */
+    char resp[1024];
+    ssize_t total = 0;
+    while ((size_t)total < sizeof(resp) - 1) {
+        ssize_t n = read(sock_fd, resp + total, sizeof(resp) - 1 - (size_t)total);
+        if (n <= 0) break;
+        total += n;
+    }
+    resp[total] = '\0';
+    close(sock_fd);
+    report->t_verdict = metrics_now_ns();
+    report->bytes = streamed;
+    metrics_observe_ns(s_m_scan_seconds, report->t_verdict - t0);
+    metrics_add(s_m_bytes, streamed);
+
+    if (total <= 0) {
+        log_error("No response from clamd for file: %s", file->path);
+        note_failure();
+        return ENGINE_OFFLINE;
+    }
+
+    note_clamd(1);
+    log_info("clamd response: %s", resp);
+
+    /*
+     * Response format:
+     *   stream: OK\n                          → clean
+     *   stream: <signature> FOUND\n           → infected
+     *   stream: <reason> ERROR\n              → error
+     *
+     * With INSTREAM the prefix is "stream:" instead of the filepath.
+     */
+    char *found_ptr = strstr(resp, " FOUND");
+    char *ok_ptr    = strstr(resp, " OK");
+
+    if (found_ptr) {
+        /* Extract threat name: text between ": " and " FOUND" */
+        char *colon = strstr(resp, ": ");
+        if (colon) {
+            colon += 2; /* skip ": " */
+            size_t len = (size_t)(found_ptr - colon);
+            if (len >= sizeof(report->threat_name))
+                len = sizeof(report->threat_name) - 1;
+            memcpy(report->threat_name, colon, len);
+            report->threat_name[len] = '\0';
+        }
+
+        log_warn("THREAT DETECTED in %s: %s", file->path, report->threat_name);
+        return ENGINE_INFECTED;
+    }
+    if (ok_ptr) return ENGINE_CLEAN;
+
+    log_error("clamd error scanning %s: %s", file->path, resp);
+    return ENGINE_ERROR;
+}
+
+static int clamd_ping(void *self)
+{
+    int fd = clamd_connect(self);
+    if (fd < 0) return 0;
+
+    char resp[64];
+    ssize_t n = clamd_command(fd, "PING\n", resp, sizeof(resp));
+    close(fd);
+
+    if (n > 0 && strstr(resp, "PONG")) {
+        note_clamd(1);
+        return 1;
+    }
+    note_clamd(0);
+    return 0;
+}
+
+static uint32_t clamd_version(void *self)
+{
+    int fd = clamd_connect(self);
+    if (fd < 0) return 0;
+
+    /* "ClamAV 1.0.1/26900/Mon Jan  1 00:00:00 2024" */
+    char resp[256];
+    ssize_t n = clamd_command(fd, "VERSION\n", resp, sizeof(resp));
+    close(fd);
+
+    const char *p = n > 0 ? strchr(resp, '/') : NULL;
+    return p ? (uint32_t)strtoul(p + 1, NULL, 10) : 0;
+}
+
+static void clamd_stats(void *self, struct json_object *out)
+{
+    clamd_t *c = self;
+    json_object_object_add(out, "socket", json_object_new_string(c->socket_path));
+    json_object_object_add(out, "clamd_up", json_object_new_int(
+        __atomic_load_n(&s_clamd_up, __ATOMIC_RELAXED)));
+}
+
+static void clamd_shutdown(void *self)
+{
+    free(self);
+}
+
+const engine_ops_t engine_clamd = {
+    .name     = "clamd",
+    .flags    = ENGINE_F_TERMINAL,
+    .init     = clamd_init,
+    .scan     = clamd_scan,
+    .ping     = clamd_ping,
+    .version  = clamd_version,
+    .stats    = clamd_stats,
+    .shutdown = clamd_shutdown,
+};
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void engine_clamd_get_stats(scanner_stats_t *out)
+{
+    metrics_hist_snapshot_t snap;
+    memset(out, 0, sizeof(*out));
+    if (metrics_hist_snapshot(s_m_scan_seconds, &snap) == 0)
+        out->exchanges = snap.count;
+    out->connect_errors = metrics_counter_value(s_m_connect_errors);
+    out->failures       = metrics_counter_value(s_m_failures);
+    out->bytes          = metrics_counter_value(s_m_bytes);
+    out->clamd_up       = __atomic_load_n(&s_clamd_up, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,248 @@
+/*
+ * engine_hashlist.c — SHA-256 allowlist and blocklist engines.
+ *
+ * Both load a text file of content hashes, one per line:
+ *
+ *   # comment
+ *   e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855  name
+ *
+ * "allowlist:FILE" calls a file with a listed hash clean, "blocklist:FILE"
+ * calls it infected (threat name from the line, or "Sentinel.Blocklist"),
+ * and both pass every other file on.  The list is a sorted array searched
+ * with bsearch(); the hash itself is computed once per file and shared
+ * with the rest of the chain.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "engine.h"
+#include "logger.h"
+
+#include <json-c/json.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+
+#define HASHLIST_DEFAULT_THREAT "Sentinel.Blocklist"
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+typedef struct {
+    uint8_t  sha256[SHA256_DIGEST_LEN];
+    char    *name;                       /* Blocklist threat name or NULL */
+} hashlist_entry_t;
+
+typedef struct {
+    char              path[512];
+    int               block;             /* 1: blocklist, 0: allowlist    */
+    hashlist_entry_t *entries;           /* Sorted by hash                */
+    size_t            count;
+    uint64_t          hits;              /* Atomic                        */
+} hashlist_t;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static int cmp_entry(const void *a, const void *b)
+{
+    return memcmp(((const hashlist_entry_t *)a)->sha256,
+                  ((const hashlist_entry_t *)b)->sha256, SHA256_DIGEST_LEN);
+}
+
+static int hexval(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    c = tolower(c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/* Parse 64 hex digits at `s`.  @return 0, or -1 if malformed. */
+static int parse_hex(const char *s, uint8_t out[SHA256_DIGEST_LEN])
+{
+    for (int i = 0; i < SHA256_DIGEST_LEN; i++) {
+        int hi = hexval((unsigned char)s[2 * i]);
+        int lo = hi < 0 ? -1 : hexval((unsigned char)s[2 * i + 1]);
+        if (lo < 0) return -1;
+        out[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return isspace((unsigned char)s[2 * SHA256_DIGEST_LEN]) ||
+           s[2 * SHA256_DIGEST_LEN] == '\0' ? 0 : -1;
+}
+
+static void free_list(hashlist_t *h)
+{
+    for (size_t i = 0; i < h->count; i++) free(h->entries[i].name);
+    free(h->entries);
+    free(h);
+}
+
+static int load(hashlist_t *h, char *err, size_t errlen)
+{
+    FILE *fp = fopen(h->path, "r");
+    if (!fp) {
+        snprintf(err, errlen, "%s: %s", h->path, strerror(errno));
+        return -1;
+    }
+
+    char   *line = NULL;
+    size_t  cap  = 0, alloc = 0;
+    unsigned lineno = 0, bad = 0;
+    int     rc = 0;
+
+    while (getline(&line, &cap, fp) > 0) {
+        lineno++;
+        char *p = line;
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') continue;
+
+        hashlist_entry_t e = { .name = NULL };
+        if (strlen(p) < 2 * SHA256_DIGEST_LEN || parse_hex(p, e.sha256) != 0) {
+            if (bad++ < 3)
+                log_warn("%s:%u: not a SHA-256 — line skipped", h->path, lineno);
+            continue;
+        }
+
+        if (h->block) {
+            char *n = p + 2 * SHA256_DIGEST_LEN;
+            while (isspace((unsigned char)*n)) n++;
+            n[strcspn(n, "\r\n")] = '\0';
+            if (*n && !(e.name = strndup(n, SCANNER_MAX_THREAT_NAME - 1))) {
+                rc = -1;
+                break;
+            }
+        }
+
+        if (h->count == alloc) {
+            size_t na = alloc ? alloc * 2 : 256;
+            hashlist_entry_t *ne = realloc(h->entries, na * sizeof(*ne));
+            if (!ne) {
+                free(e.name);
+                rc = -1;
+                break;
+            }
+            h->entries = ne;
+            alloc      = na;
+        }
+        h->entries[h->count++] = e;
+    }
+    free(line);
+    fclose(fp);
+
+    if (rc != 0) {
+        snprintf(err, errlen, "%s: out of memory", h->path);
+        return -1;
+    }
+    if (bad)
+        log_warn("%s: %u malformed line(s) skipped", h->path, bad);
+
+    qsort(h->entries, h->count, sizeof(*h->entries), cmp_entry);
+
+    /* Drop duplicates (first name wins). */
+    size_t out = 0;
+    for (size_t i = 0; i < h->count; i++) {
+        if (out && cmp_entry(&h->entries[out - 1], &h->entries[i]) == 0) {
+            free(h->entries[i].name);
+            continue;
+        }
+        h->entries[out++] = h->entries[i];
+    }
+    h->count = out;
+    return 0;
+}
+
+static void *init_list(const char *arg, int block, char *err, size_t errlen)
+{
+    if (!arg || !*arg) {
+        snprintf(err, errlen, "%s needs a file: %s:/path/to/hashes",
+                 block ? "blocklist" : "allowlist",
+                 block ? "blocklist" : "allowlist");
+        return NULL;
+    }
+
+    hashlist_t *h = calloc(1, sizeof(*h));
+    if (!h) {
+        snprintf(err, errlen, "out of memory");
+        return NULL;
+    }
+    snprintf(h->path, sizeof(h->path), "%s", arg);
+    h->block = block;
+
+    if (load(h, err, errlen) != 0) {
+        free_list(h);
+        return NULL;
+    }
+    log_info("%s: %zu hash(es) loaded from %s",
+             block ? "Blocklist" : "Allowlist", h->count, h->path);
+    return h;
+}
+
+/* ── Engine operations ──────────────────────────────────────────────────── */
+
+static void *allow_init(const char *arg, char *err, size_t errlen)
+{
+    return init_list(arg, 0, err, errlen);
+}
+
+static void *block_init(const char *arg, char *err, size_t errlen)
+{
+    return init_list(arg, 1, err, errlen);
+}
+
+static engine_verdict_t list_scan(void *self, engine_file_t *file,
+                                  scan_report_t *report)
+{
+    hashlist_t *h = self;
+    if (h->count == 0) return ENGINE_PASS;
+
+    const uint8_t *digest = engine_file_sha256(file);
+    if (!digest) return ENGINE_PASS;     /* Let the next engine try */
+
+    hashlist_entry_t key;
+    memcpy(key.sha256, digest, SHA256_DIGEST_LEN);
+    const hashlist_entry_t *e = bsearch(&key, h->entries, h->count,
+                                        sizeof(*h->entries), cmp_entry);
+    if (!e) return ENGINE_PASS;
+
+    __atomic_add_fetch(&h->hits, 1, __ATOMIC_RELAXED);
+    memcpy(report->sha256, digest, SHA256_DIGEST_LEN);
+    report->has_sha256 = 1;
+    if (!h->block) return ENGINE_CLEAN;
+
+    snprintf(report->threat_name, sizeof(report->threat_name), "%s",
+             e->name ? e->name : HASHLIST_DEFAULT_THREAT);
+    log_warn("THREAT DETECTED in %s: %s (blocklisted hash)", file->path,
+             report->threat_name);
+    return ENGINE_INFECTED;
+}
+
+static void list_stats(void *self, struct json_object *out)
+{
+    hashlist_t *h = self;
+    json_object_object_add(out, "file", json_object_new_string(h->path));
+    json_object_object_add(out, "entries",
+                           json_object_new_int64((int64_t)h->count));
+    json_object_object_add(out, "hits", json_object_new_int64(
+        (int64_t)__atomic_load_n(&h->hits, __ATOMIC_RELAXED)));
+}
+
+static void list_shutdown(void *self)
+{
+    free_list(self);
+}
+
+const engine_ops_t engine_allowlist = {
+    .name     = "allowlist",
+    .init     = allow_init,
+    .scan     = list_scan,
+    .stats    = list_stats,
+    .shutdown = list_shutdown,
+};
+
+const engine_ops_t engine_blocklist = {
+    .name     = "blocklist",
+    .init     = block_init,
+    .scan     = list_scan,
+    .stats    = list_stats,
+    .shutdown = list_shutdown,
+};
@@ -0,0 +1,594 @@
+/*
+ * engine_ioc.c — Multi-pattern IOC engine.
+ *
+ * Hunts for byte strings (domains, URLs, mutex names, shellcode) given
+ * by incident responders, without a clamd signature push.  Spec
+ * "ioc:FILE", one pattern per line:
+ *
+ *   # comment
+ *   evil.example.com
+ *   hex:fce8820000006089e5<TAB>Shellcode.Stager
+ *
+ * A pattern is literal text up to the end of the line or a TAB; "hex:"
+ * gives raw bytes.  Text after the TAB is the threat name (default
+ * "Sentinel.IOC").  A file containing any pattern is infected; others
+ * are passed on.
+ *
+ * The list is compiled into an Aho-Corasick automaton, stored as a full
+ * DFA over byte classes (bytes no pattern uses share one column), so
+ * each input byte costs one table load whatever the number of patterns.
+ * While the automaton is at its root — no partial match in progress —
+ * a Teddy prefilter (SSSE3 nibble lookups on the first one or two bytes
+ * of every pattern) skips 16 bytes at a time to the next place a match
+ * could start.  It is turned off when the patterns' leading bytes are too
+ * common for it to pay, and on CPUs without SSSE3.
+ *
+ * The file is read through the chain's fd in ENGINE_IOC_CHUNK pieces,
+ * matching across chunk boundaries.  "sentinelctl engines reload"
+ * re-reads the list in place: scans in flight finish on the automaton
+ * they started with.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "engine.h"
+#include "logger.h"
+
+#include <json-c/json.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define IOC_TEDDY 1
+#else
+#define IOC_TEDDY 0
+#endif
+
+#define IOC_DEFAULT_THREAT "Sentinel.IOC"
+
+/* DFA entry flag: the target state ends a pattern. */
+#define IOC_MATCH 0x80000000u
+
+/* Prefilter only if at most this many of the 65536 byte pairs pass it. */
+#define IOC_PREFILTER_MAX_PASS 8192
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+/* One compiled list, shared by the scans that started on it. */
+typedef struct {
+    int        refs;                     /* Atomic: engine + scans        */
+    uint32_t  *delta;                    /* nstates * ncls; entries are
+                                            target row offsets | MATCH    */
+    uint32_t  *match;                    /* Per state: pattern + 1, or 0  */
+    char     **names;                    /* Per pattern, NULL: default    */
+    size_t     npatterns;
+    size_t     nstates;
+    unsigned   ncls;
+    uint8_t    cls[256];                 /* Byte → column                 */
+    int        width;                    /* Prefilter bytes: 0 (off), 1, 2 */
+    uint8_t    teddy[4][16];             /* lo/hi nibble masks, byte 0, 1 */
+} ioc_set_t;
+
+typedef struct {
+    char             path[512];
+    pthread_mutex_t  lock;               /* Guards set                    */
+    ioc_set_t       *set;
+    uint64_t         hits, bytes, reloads;   /* Atomic                    */
+} ioc_t;
+
+typedef struct {
+    uint8_t *bytes;
+    size_t   len;
+    char    *name;
+} ioc_pattern_t;
+
+#if IOC_TEDDY
+static int s_have_ssse3 = -1;            /* Set by the first init         */
+#endif
+
+/* ── Loading ────────────────────────────────────────────────────────────── */
+
+static int hexval(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    c = tolower(c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/* Parse one pattern line (end of line stripped).  @return 0, or -1. */
+static int parse_line(char *p, ioc_pattern_t *out)
+{
+    char *tab = strchr(p, '\t');
+    if (tab) {
+        *tab++ = '\0';
+        while (isspace((unsigned char)*tab)) tab++;
+    }
+
+    size_t len = strlen(p);
+    if (strncmp(p, "hex:", 4) == 0) {
+        const char *h = p + 4;
+        len = strlen(h);
+        if (len % 2) return -1;
+        len /= 2;
+        if (len == 0 || len > ENGINE_IOC_MAX_PATTERN) return -1;
+        for (size_t i = 0; i < len; i++) {
+            int hi = hexval((unsigned char)h[2 * i]);
+            int lo = hi < 0 ? -1 : hexval((unsigned char)h[2 * i + 1]);
+            if (lo < 0) return -1;
+            p[i] = (char)(hi << 4 | lo);     /* In place: never longer */
+        }
+    } else if (len == 0 || len > ENGINE_IOC_MAX_PATTERN) {
+        return -1;
+    }
+
+    out->bytes = malloc(len);
+    out->len   = len;
+    out->name  = tab && *tab ? strndup(tab, SCANNER_MAX_THREAT_NAME - 1) : NULL;
+    if (!out->bytes || (tab && *tab && !out->name)) {
+        free(out->bytes);
+        free(out->name);
+        return -2;
+    }
+    memcpy(out->bytes, p, len);
+    return 0;
+}
+
+static void free_patterns(ioc_pattern_t *pats, size_t n)
+{
+    for (size_t i = 0; i < n; i++) free(pats[i].bytes);
+    free(pats);
+}
+
+static int load(const char *path, ioc_pattern_t **out, size_t *count,
+                char *err, size_t errlen)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        snprintf(err, errlen, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    ioc_pattern_t *pats = NULL;
+    char    *line = NULL;
+    size_t   cap  = 0, n = 0, alloc = 0;
+    unsigned lineno = 0, bad = 0;
+    int      rc = 0;
+
+    while (getline(&line, &cap, fp) > 0) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+
+        if (n == ENGINE_IOC_MAX_PATTERNS) {
+            snprintf(err, errlen, "%s: more than %d patterns", path,
+                     ENGINE_IOC_MAX_PATTERNS);
+            rc = -1;
+            break;
+        }
+        if (n == alloc) {
+            size_t na = alloc ? alloc * 2 : 256;
+            ioc_pattern_t *np = realloc(pats, na * sizeof(*np));
+            if (!np) {
+                snprintf(err, errlen, "%s: out of memory", path);
+                rc = -1;
+                break;
+            }
+            pats  = np;
+            alloc = na;
+        }
+
+        int prc = parse_line(line, &pats[n]);
+        if (prc == -2) {
+            snprintf(err, errlen, "%s: out of memory", path);
+            rc = -1;
+            break;
+        }
+        if (prc != 0) {
+            if (bad++ < 3)
+                log_warn("%s:%u: not a pattern (1..%d bytes) — line skipped",
+                         path, lineno, ENGINE_IOC_MAX_PATTERN);
+            continue;
+        }
+        n++;
+    }
+    free(line);
+    fclose(fp);
+
+    if (rc != 0) {
+        for (size_t i = 0; i < n; i++) free(pats[i].name);
+        free_patterns(pats, n);
+        return -1;
+    }
+    if (bad)
+        log_warn("%s: %u malformed line(s) skipped", path, bad);
+    *out   = pats;
+    *count = n;
+    return 0;
+}
+
+/* ── Compiling ──────────────────────────────────────────────────────────── */
+
+static void set_free(ioc_set_t *s)
+{
+    if (!s) return;
+    for (size_t i = 0; i < s->npatterns; i++) free(s->names[i]);
+    free(s->names);
+    free(s->match);
+    free(s->delta);
+    free(s);
+}
+
+/* Teddy masks for the patterns' leading bytes, bucketed by first byte. */
+static void build_prefilter(ioc_set_t *s, const ioc_pattern_t *pats)
+{
+    s->width = 2;
+    for (size_t i = 0; i < s->npatterns; i++)
+        if (pats[i].len < 2) s->width = 1;
+
+    for (size_t i = 0; i < s->npatterns; i++) {
+        const uint8_t *b   = pats[i].bytes;
+        uint8_t        bit = (uint8_t)(1u << (b[0] & 7));
+        s->teddy[0][b[0] & 15] |= bit;
+        s->teddy[1][b[0] >> 4] |= bit;
+        if (s->width == 2) {
+            s->teddy[2][b[1] & 15] |= bit;
+            s->teddy[3][b[1] >> 4] |= bit;
+        }
+    }
+
+    /* How many byte pairs would it let through? */
+    unsigned pass = 0;
+    for (unsigned x = 0; x < 256; x++) {
+        uint8_t m = s->teddy[0][x & 15] & s->teddy[1][x >> 4];
+        if (!m) continue;
+        if (s->width == 1) {
+            pass += 256;
+            continue;
+        }
+        for (unsigned y = 0; y < 256; y++)
+            if (m & s->teddy[2][y & 15] & s->teddy[3][y >> 4]) pass++;
+    }
+    if (pass > IOC_PREFILTER_MAX_PASS) s->width = 0;
+#if IOC_TEDDY
+    if (!s_have_ssse3) s->width = 0;
+#else
+    s->width = 0;
+#endif
+}
+
+/*
+ * Build the Aho-Corasick DFA: a trie of the patterns, failure links by
+ * breadth-first search, then every missing transition filled in from
+ * the failure state's row.  Takes the pattern names.
+ */
+static ioc_set_t *compile(ioc_pattern_t *pats, size_t n,
+                          char *err, size_t errlen)
+{
+    ioc_set_t *s = calloc(1, sizeof(*s));
+    if (!s || !(s->names = calloc(n ? n : 1, sizeof(*s->names)))) {
+        free(s);
+        for (size_t i = 0; i < n; i++) free(pats[i].name);
+        snprintf(err, errlen, "out of memory");
+        return NULL;
+    }
+    s->refs      = 1;
+    s->npatterns = n;
+    for (size_t i = 0; i < n; i++) s->names[i] = pats[i].name;
+
+    /* Byte classes: column 0 for every byte no pattern contains. */
+    uint8_t used[256] = { 0 };
+    size_t  max_states = 1;
+    for (size_t i = 0; i < n; i++) {
+        max_states += pats[i].len;
+        for (size_t j = 0; j < pats[i].len; j++) used[pats[i].bytes[j]] = 1;
+    }
+    unsigned distinct = 0;
+    for (int b = 0; b < 256; b++) distinct += used[b];
+    s->ncls = distinct == 256 ? 0 : 1;   /* No spare column if all used */
+    for (int b = 0; b < 256; b++)
+        if (used[b]) s->cls[b] = (uint8_t)s->ncls++;
+
+    if (max_states * s->ncls >
+            (size_t)ENGINE_IOC_MAX_TABLE_MB * 1024 * 1024 / sizeof(uint32_t)) {
+        snprintf(err, errlen, "patterns too large for a %d MB automaton",
+                 ENGINE_IOC_MAX_TABLE_MB);
+        set_free(s);
+        return NULL;
+    }
+
+    const unsigned k     = s->ncls;
+    uint32_t      *fail  = calloc(max_states, sizeof(*fail));
+    uint32_t      *queue = calloc(max_states, sizeof(*queue));
+    s->delta = calloc(max_states * k, sizeof(*s->delta));
+    s->match = calloc(max_states, sizeof(*s->match));
+    if (!fail || !queue || !s->delta || !s->match) {
+        free(fail);
+        free(queue);
+        set_free(s);
+        snprintf(err, errlen, "out of memory");
+        return NULL;
+    }
+
+    /* Trie.  State 0 is the root; delta entries are state numbers here. */
+    s->nstates = 1;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t st = 0;
+        for (size_t j = 0; j < pats[i].len; j++) {
+            uint32_t *t = &s->delta[(size_t)st * k + s->cls[pats[i].bytes[j]]];
+            if (!*t) *t = (uint32_t)s->nstates++;
+            st = *t;
+        }
+        if (!s->match[st]) s->match[st] = (uint32_t)i + 1;   /* First wins */
+    }
+
+    /* Failure links, breadth first, completing each row as it goes. */
+    size_t head = 0, tail = 0;
+    for (unsigned c = 0; c < k; c++)
+        if (s->delta[c]) queue[tail++] = s->delta[c];
+    while (head < tail) {
+        uint32_t  st  = queue[head++];
+        uint32_t *row = &s->delta[(size_t)st * k];
+        uint32_t *fr  = &s->delta[(size_t)fail[st] * k];
+        for (unsigned c = 0; c < k; c++) {
+            if (row[c]) {
+                uint32_t t = row[c];
+                fail[t] = st ? fr[c] : 0;
+                if (!s->match[t]) s->match[t] = s->match[fail[t]];
+                queue[tail++] = t;
+            } else {
+                row[c] = fr[c];
+            }
+        }
+    }
+    free(queue);
+    free(fail);
+
+    /* Row offsets instead of state numbers, flagged if they match. */
+    for (size_t i = 0; i < s->nstates * k; i++) {
+        uint32_t t = s->delta[i];
+        s->delta[i] = t * k | (s->match[t] ? IOC_MATCH : 0);
+    }
+    uint32_t *shrunk = realloc(s->delta, s->nstates * k * sizeof(*s->delta));
+    if (shrunk) s->delta = shrunk;
+
+    if (n) build_prefilter(s, pats);
+    return s;
+}
+
+static ioc_set_t *build(const char *path, char *err, size_t errlen)
+{
+    ioc_pattern_t *pats;
+    size_t         n;
+    if (load(path, &pats, &n, err, errlen) != 0) return NULL;
+
+    ioc_set_t *s = compile(pats, n, err, errlen);
+    free_patterns(pats, n);
+    if (!s) return NULL;
+
+    log_info("IOC list %s: %zu pattern(s), %zu states x %u classes, "
+             "prefilter %s", path, s->npatterns, s->nstates, s->ncls,
+             s->width == 2 ? "2-byte" : s->width == 1 ? "1-byte" : "off");
+    return s;
+}
+
+static ioc_set_t *set_get(ioc_t *h)
+{
+    pthread_mutex_lock(&h->lock);
+    ioc_set_t *s = h->set;
+    __atomic_add_fetch(&s->refs, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&h->lock);
+    return s;
+}
+
+static void set_put(ioc_set_t *s)
+{
+    if (__atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        set_free(s);
+}
+
+/* ── Matching ───────────────────────────────────────────────────────────── */
+
+#if IOC_TEDDY
+/*
+ * First position at or after `i` where a pattern could start, or where
+ * fewer than 17 bytes remain (the caller goes on byte by byte).
+ */
+__attribute__((target("ssse3")))
+static size_t teddy_skip(const ioc_set_t *s, const uint8_t *p, size_t i,
+                         size_t n)
+{
+    const __m128i nib  = _mm_set1_epi8(0x0f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo0  = _mm_loadu_si128((const __m128i *)s->teddy[0]);
+    const __m128i hi0  = _mm_loadu_si128((const __m128i *)s->teddy[1]);
+    const __m128i lo1  = _mm_loadu_si128((const __m128i *)s->teddy[2]);
+    const __m128i hi1  = _mm_loadu_si128((const __m128i *)s->teddy[3]);
+
+    for (; i + 17 <= n; i += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i m  = _mm_and_si128(
+            _mm_shuffle_epi8(lo0, _mm_and_si128(v0, nib)),
+            _mm_shuffle_epi8(hi0, _mm_and_si128(_mm_srli_epi16(v0, 4), nib)));
+        if (s->width == 2) {
+            __m128i v1 = _mm_loadu_si128((const __m128i *)(p + i + 1));
+            m = _mm_and_si128(m, _mm_and_si128(
+                _mm_shuffle_epi8(lo1, _mm_and_si128(v1, nib)),
+                _mm_shuffle_epi8(hi1, _mm_and_si128(_mm_srli_epi16(v1, 4),
+                                                    nib))));
+        }
+        unsigned hit = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(m, zero))
+                     & 0xffffu;
+        if (hit) return i + (size_t)__builtin_ctz(hit);
+    }
+    return i;
+}
+#endif
+
+/*
+ * Run p[0..n) through the automaton from row `*st`.
+ * @return the offset just past the first match (its pattern in
+ *         `*pattern`), or 0 if none.
+ */
+static size_t run(const ioc_set_t *s, const uint8_t *p, size_t n,
+                  uint32_t *st, size_t *pattern)
+{
+    const uint32_t *delta = s->delta;
+    const uint8_t  *cls   = s->cls;
+    uint32_t        row   = *st;
+    size_t          i     = 0;
+
+    while (i < n) {
+#if IOC_TEDDY
+        if (row == 0 && s->width && n - i >= 17) {
+            i = teddy_skip(s, p, i, n);
+            if (i >= n) break;
+        }
+#endif
+        uint32_t t = delta[row + cls[p[i++]]];
+        row = t & ~IOC_MATCH;
+        if (t & IOC_MATCH) {
+            *st      = row;
+            *pattern = s->match[row / s->ncls] - 1;
+            return i;
+        }
+    }
+    *st = row;
+    return 0;
+}
+
+/* ── Engine operations ──────────────────────────────────────────────────── */
+
+static void *ioc_init(const char *arg, char *err, size_t errlen)
+{
+    if (!arg || !*arg) {
+        snprintf(err, errlen, "ioc needs a file: ioc:/path/to/patterns");
+        return NULL;
+    }
+#if IOC_TEDDY
+    if (s_have_ssse3 < 0)
+        s_have_ssse3 = __builtin_cpu_supports("ssse3") ? 1 : 0;
+#endif
+
+    ioc_t *h = calloc(1, sizeof(*h));
+    if (!h) {
+        snprintf(err, errlen, "out of memory");
+        return NULL;
+    }
+    snprintf(h->path, sizeof(h->path), "%s", arg);
+    if (!(h->set = build(h->path, err, errlen))) {
+        free(h);
+        return NULL;
+    }
+    pthread_mutex_init(&h->lock, NULL);
+    return h;
+}
+
+static engine_verdict_t ioc_scan(void *self, engine_file_t *file,
+                                 scan_report_t *report)
+{
+    ioc_t     *h = self;
+    ioc_set_t *s = set_get(h);
+    if (s->npatterns == 0) {
+        set_put(s);
+        return ENGINE_PASS;
+    }
+
+    uint8_t *buf = malloc(ENGINE_IOC_CHUNK);
+    if (!buf) {
+        set_put(s);
+        return ENGINE_PASS;
+    }
+
+    engine_verdict_t v   = ENGINE_PASS;
+    uint32_t         st  = 0;
+    off_t            off = 0;
+    size_t           pat = 0, end = 0;
+    ssize_t          n;
+    while ((n = pread(file->fd, buf, ENGINE_IOC_CHUNK, off)) > 0 &&
+           !engine_cancelled(file)) {
+        if (off == 0) {
+            report->head_len = (size_t)n < sizeof(report->head)
+                             ? (size_t)n : sizeof(report->head);
+            memcpy(report->head, buf, report->head_len);
+        }
+        end  = run(s, buf, (size_t)n, &st, &pat);
+        off += end ? (off_t)end : n;
+        if (end) break;
+    }
+    __atomic_add_fetch(&h->bytes, (uint64_t)off, __ATOMIC_RELAXED);
+
+    if (end) {
+        __atomic_add_fetch(&h->hits, 1, __ATOMIC_RELAXED);
+        report->bytes = (uint64_t)off;
+        snprintf(report->threat_name, sizeof(report->threat_name), "%s",
+                 s->names[pat] ? s->names[pat] : IOC_DEFAULT_THREAT);
+        log_warn("THREAT DETECTED in %s: %s (IOC pattern %zu ending at "
+                 "offset %lld)", file->path, report->threat_name, pat + 1,
+                 (long long)off);
+        v = ENGINE_INFECTED;
+    } else if (n < 0) {
+        log_error_rl("IOC scan of %s: %s", file->path, strerror(errno));
+    }
+
+    free(buf);
+    set_put(s);
+    return v;
+}
+
+static int ioc_reload(void *self, char *err, size_t errlen)
+{
+    ioc_t     *h = self;
+    ioc_set_t *s = build(h->path, err, errlen);
+    if (!s) return -1;
+
+    pthread_mutex_lock(&h->lock);
+    ioc_set_t *old = h->set;
+    h->set = s;
+    pthread_mutex_unlock(&h->lock);
+
+    set_put(old);
+    __atomic_add_fetch(&h->reloads, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void ioc_stats(void *self, struct json_object *out)
+{
+    ioc_t     *h = self;
+    ioc_set_t *s = set_get(h);
+    json_object_object_add(out, "file", json_object_new_string(h->path));
+    json_object_object_add(out, "patterns",
+                           json_object_new_int64((int64_t)s->npatterns));
+    json_object_object_add(out, "states",
+                           json_object_new_int64((int64_t)s->nstates));
+    json_object_object_add(out, "prefilter", json_object_new_int(s->width));
+    json_object_object_add(out, "hits", json_object_new_int64(
+        (int64_t)__atomic_load_n(&h->hits, __ATOMIC_RELAXED)));
+    json_object_object_add(out, "bytes", json_object_new_int64(
+        (int64_t)__atomic_load_n(&h->bytes, __ATOMIC_RELAXED)));
+    json_object_object_add(out, "reloads", json_object_new_int64(
+        (int64_t)__atomic_load_n(&h->reloads, __ATOMIC_RELAXED)));
+    set_put(s);
+}
+
+static void ioc_shutdown(void *self)
+{
+    ioc_t *h = self;
+    set_put(h->set);
+    pthread_mutex_destroy(&h->lock);
+    free(h);
+}
+
+const engine_ops_t engine_ioc = {
+    .name     = "ioc",
+    .init     = ioc_init,
+    .scan     = ioc_scan,
+    .reload   = ioc_reload,
+    .stats    = ioc_stats,
+    .shutdown = ioc_shutdown,
+};
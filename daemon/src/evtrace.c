@@ -0,0 +1,257 @@
+/*
+ * evtrace.c — Monitor event trace writer and reader (see evtrace.h).
+ *
+ * The writer is only called from the reactor thread (the monitor and
+ * the housekeeping timer), so it needs no locking.  Records are encoded
+ * into a buffer and written in EVTRACE_BUF_SIZE pieces; a crash loses at
+ * most the unflushed tail.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "evtrace.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+struct evtrace_reader {
+    FILE     *fp;
+    uint64_t  ts_ns;
+    char      path[EVTRACE_PATH_MAX];
+    size_t    path_len;
+};
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static int      s_fd = -1;
+static char     s_file[EVTRACE_PATH_MAX];
+static uint8_t  s_buf[EVTRACE_BUF_SIZE];
+static size_t   s_buf_len  = 0;
+static uint64_t s_written  = 0;          /* Bytes in the file so far      */
+static uint64_t s_records  = 0;
+static uint64_t s_prev_ts  = 0;
+static char     s_prev_path[EVTRACE_PATH_MAX];
+static size_t   s_prev_len = 0;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static uint64_t clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static size_t put_varint(uint8_t *out, uint64_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+/* @return 0 on success, -1 at EOF or on an over-long encoding. */
+static int get_varint(FILE *fp, uint64_t *v)
+{
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(fp);
+        if (c == EOF) return -1;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return 0;
+    }
+    return -1;
+}
+
+/* ── Public API: recording ──────────────────────────────────────────────── */
+
+int evtrace_start(const char *path)
+{
+    if (!path || s_fd >= 0) return -1;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        log_error("Cannot record events to %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    evtrace_hdr_t hdr = {
+        .magic    = EVTRACE_MAGIC,
+        .version  = EVTRACE_VERSION,
+        .mono0_ns = clock_ns(CLOCK_MONOTONIC),
+        .real0_ns = clock_ns(CLOCK_REALTIME),
+    };
+    if (write_all(fd, &hdr, sizeof(hdr)) != 0) {
+        log_error("Cannot record events to %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    s_fd       = fd;
+    s_buf_len  = 0;
+    s_written  = sizeof(hdr);
+    s_records  = 0;
+    s_prev_ts  = hdr.mono0_ns;
+    s_prev_len = 0;
+    snprintf(s_file, sizeof(s_file), "%s", path);
+    log_info("Recording monitor events to %s", path);
+    return 0;
+}
+
+int evtrace_active(void)
+{
+    return s_fd >= 0;
+}
+
+void evtrace_flush(void)
+{
+    if (s_fd < 0 || s_buf_len == 0) return;
+
+    if (write_all(s_fd, s_buf, s_buf_len) != 0) {
+        log_error("Event recording to %s failed: %s — stopping",
+                  s_file, strerror(errno));
+        close(s_fd);
+        s_fd = -1;
+    }
+    s_written += s_buf_len;
+    s_buf_len = 0;
+}
+
+void evtrace_record(uint64_t ts_ns, const char *path, uint32_t mask,
+                    int64_t size)
+{
+    if (s_fd < 0 || !path) return;
+
+    size_t len = strnlen(path, EVTRACE_PATH_MAX - 1);
+    size_t keep = 0;
+    while (keep < len && keep < s_prev_len && path[keep] == s_prev_path[keep])
+        keep++;
+
+    /* Five varints of at most 10 bytes each, then the suffix. */
+    if (s_buf_len + 50 + (len - keep) > sizeof(s_buf)) evtrace_flush();
+    if (s_fd < 0) return;
+
+    uint8_t *p = s_buf + s_buf_len;
+    p += put_varint(p, ts_ns > s_prev_ts ? ts_ns - s_prev_ts : 0);
+    p += put_varint(p, mask);
+    p += put_varint(p, size >= 0 ? (uint64_t)size + 1 : 0);
+    p += put_varint(p, keep);
+    p += put_varint(p, len - keep);
+    memcpy(p, path + keep, len - keep);
+    p += len - keep;
+    s_buf_len = (size_t)(p - s_buf);
+
+    if (ts_ns > s_prev_ts) s_prev_ts = ts_ns;
+    memcpy(s_prev_path + keep, path + keep, len - keep);
+    s_prev_len = len;
+    s_records++;
+
+    if (s_written + s_buf_len >= EVTRACE_MAX_BYTES) {
+        log_warn("Event recording reached %u MiB — stopping",
+                 EVTRACE_MAX_BYTES >> 20);
+        evtrace_stop();
+    }
+}
+
+void evtrace_stop(void)
+{
+    if (s_fd < 0) return;
+
+    evtrace_flush();
+    if (s_fd >= 0) {
+        close(s_fd);
+        s_fd = -1;
+    }
+    log_info("Event recording closed: %llu events, %llu bytes in %s",
+             (unsigned long long)s_records, (unsigned long long)s_written,
+             s_file);
+}
+
+/* ── Public API: reading ────────────────────────────────────────────────── */
+
+evtrace_reader_t *evtrace_open(const char *path, evtrace_hdr_t *hdr)
+{
+    FILE *fp = fopen(path, "rbe");
+    if (!fp) {
+        log_error("Cannot open event trace %s: %s", path, strerror(errno));
+        return NULL;
+    }
+
+    evtrace_hdr_t h;
+    if (fread(&h, sizeof(h), 1, fp) != 1 || h.magic != EVTRACE_MAGIC ||
+        h.version != EVTRACE_VERSION) {
+        log_error("%s is not a Sentinel event trace", path);
+        fclose(fp);
+        return NULL;
+    }
+
+    evtrace_reader_t *r = calloc(1, sizeof(*r));
+    if (!r) {
+        fclose(fp);
+        return NULL;
+    }
+    r->fp    = fp;
+    r->ts_ns = h.mono0_ns;
+    if (hdr) *hdr = h;
+    return r;
+}
+
+int evtrace_next(evtrace_reader_t *r, evtrace_rec_t *rec)
+{
+    if (!r || !rec) return -1;
+
+    uint64_t dt, mask, size1, keep, add;
+    int c = getc(r->fp);
+    if (c == EOF) return 0;
+    ungetc(c, r->fp);
+
+    if (get_varint(r->fp, &dt) || get_varint(r->fp, &mask) ||
+        get_varint(r->fp, &size1) || get_varint(r->fp, &keep) ||
+        get_varint(r->fp, &add))
+        return -1;
+    if (keep > r->path_len || keep + add >= sizeof(r->path)) return -1;
+    if (add && fread(r->path + keep, 1, (size_t)add, r->fp) != add) return -1;
+
+    r->path_len = (size_t)(keep + add);
+    r->path[r->path_len] = '\0';
+    r->ts_ns += dt;
+
+    rec->ts_ns = r->ts_ns;
+    rec->mask  = (uint32_t)mask;
+    rec->size  = size1 ? (int64_t)(size1 - 1) : -1;
+    rec->path  = r->path;
+    return 1;
+}
+
+void evtrace_close(evtrace_reader_t *r)
+{
+    if (!r) return;
+    fclose(r->fp);
+    free(r);
+}
@@ -0,0 +1,268 @@
+/*
+ * flightrec.c — Per-thread binary ring buffers for pipeline events.
+ *
+ * Recording path (fr_record):
+ *   1. First call on a thread takes a ring and registers it in a global
+ *      table (the only locked step, once per thread).  A thread that
+ *      exits hands its ring back through a pthread key destructor and
+ *      the next new thread takes it over, emptied, so short-lived
+ *      crawler threads do not use up FR_MAX_RINGS.  Records of an exited
+ *      thread stay in dumps until then.
+ *   2. Every call after that reads the clock (RDTSC on x86, vDSO
+ *      CLOCK_MONOTONIC elsewhere), hashes the path a word at a time,
+ *      copies its tail and bumps the ring head.  Single writer per ring
+ *      → no locked instructions.
+ *
+ * Dumping reads the rings while writers may still be active; a record
+ * being written at that instant can be torn.  That is acceptable for a
+ * flight recorder — the decoder discards records with invalid events.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "flightrec.h"
+#include "logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define FR_HAVE_TSC 1
+#endif
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+typedef struct {
+    fr_ring_hdr_t hdr;
+    fr_record_t   rec[FR_RING_RECORDS];
+} fr_ring_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static fr_ring_t       *s_rings[FR_MAX_RINGS];
+static volatile int     s_nrings = 0;
+static pthread_mutex_t  s_fr_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Rings of exited threads, waiting for a new owner. */
+static fr_ring_t       *s_free[FR_MAX_RINGS];
+static int              s_nfree = 0;
+
+static pthread_key_t    s_ring_key;
+static int              s_ring_key_ok = 0;
+static pthread_once_t   s_ring_once = PTHREAD_ONCE_INIT;
+
+static __thread fr_ring_t *tl_ring        = NULL;
+static __thread int        tl_ring_failed = 0;
+
+/* Calibration taken at fr_init(). */
+static uint64_t s_ts0, s_mono0, s_real0;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static inline uint64_t fr_now(void)
+{
+#ifdef FR_HAVE_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static uint64_t clock_ns(clockid_t id)
+{
+    struct timespec ts;
+    clock_gettime(id, &ts);               /* async-signal-safe */
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* pthread key destructor: the owner exited, its ring is free again. */
+static void ring_release(void *arg)
+{
+    pthread_mutex_lock(&s_fr_mutex);
+    s_free[s_nfree++] = arg;
+    pthread_mutex_unlock(&s_fr_mutex);
+}
+
+static void ring_key_init(void)
+{
+    /* Without the key, rings are simply never handed back. */
+    s_ring_key_ok = pthread_key_create(&s_ring_key, ring_release) == 0;
+}
+
+static fr_ring_t *ring_get(void)
+{
+    if (tl_ring) return tl_ring;
+    if (tl_ring_failed) return NULL;
+
+    pthread_once(&s_ring_once, ring_key_init);
+
+    pthread_mutex_lock(&s_fr_mutex);
+    fr_ring_t *r = NULL;
+    if (s_nfree > 0) {
+        r = s_free[--s_nfree];
+    } else if (s_nrings < FR_MAX_RINGS) {
+        r = calloc(1, sizeof(*r));
+        if (r) {
+            s_rings[s_nrings] = r;
+            __atomic_store_n(&s_nrings, s_nrings + 1, __ATOMIC_RELEASE);
+        }
+    }
+    if (r) {
+        /* A reused ring starts empty: its records were the old owner's. */
+        __atomic_store_n(&r->hdr.head, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&r->hdr.tid, (uint32_t)syscall(SYS_gettid),
+                         __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&s_fr_mutex);
+
+    if (!r) { tl_ring_failed = 1; return NULL; }
+    if (s_ring_key_ok) pthread_setspecific(s_ring_key, r);
+    tl_ring = r;
+    return r;
+}
+
+/*
+ * 32-bit path hash, eight bytes per step.  Only needs to be stable within
+ * one dump (it joins a file's records), so speed wins over portability.
+ */
+static inline uint32_t path_hash(const char *path, size_t len)
+{
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+    size_t   i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, path + i, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    if (i < len) {
+        uint64_t w = 0;
+        memcpy(&w, path + i, len - i);
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+    return (uint32_t)h;
+}
+
+/* Write all of buf, retrying on short writes.  Async-signal-safe. */
+static int write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w <= 0) return -1;
+        p   += w;
+        len -= (size_t)w;
+    }
+    return 0;
+}
+
+static void on_fatal_signal(int sig)
+{
+    /* SA_RESETHAND has restored the default action: dump, then re-raise
+     * so the process still dies with the original signal (and core). */
+    fr_dump(FR_CRASH_DUMP_PATH);
+    raise(sig);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void fr_init(void)
+{
+    s_ts0   = fr_now();
+    s_mono0 = clock_ns(CLOCK_MONOTONIC);
+    s_real0 = clock_ns(CLOCK_REALTIME);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+
+    sa.sa_handler = on_fatal_signal;
+    sa.sa_flags   = SA_RESETHAND;
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS,  &sa, NULL);
+    sigaction(SIGILL,  &sa, NULL);
+    sigaction(SIGFPE,  &sa, NULL);
+    sigaction(SIGABRT, &sa, NULL);
+
+    log_info("Flight recorder armed (%d records/thread, crash dump → %s)",
+             FR_RING_RECORDS, FR_CRASH_DUMP_PATH);
+}
+
+void fr_record(fr_event_t event, const char *path, uint64_t arg)
+{
+    fr_ring_t *r = ring_get();
+    if (!r) return;
+
+    fr_record_t *rec = &r->rec[r->hdr.head & (FR_RING_RECORDS - 1)];
+
+    rec->ts    = fr_now();
+    rec->arg   = arg;
+    rec->event = (uint16_t)event;
+
+    size_t   len = path ? strlen(path) : 0;
+    uint32_t h   = path_hash(path, len);
+    rec->path_hash = h;
+    rec->path_len  = (uint16_t)(len > 0xffff ? 0xffff : len);
+
+    size_t tail = len < FR_PATH_TAIL ? len : FR_PATH_TAIL;
+    if (tail) memcpy(rec->path_tail, path + len - tail, tail);
+    if (tail < FR_PATH_TAIL) memset(rec->path_tail + tail, 0, FR_PATH_TAIL - tail);
+
+    /* Publish after the record body so a dump never sees a head that
+     * points past fully-written data (modulo the wrap-around slot). */
+    __atomic_store_n(&r->hdr.head, r->hdr.head + 1, __ATOMIC_RELEASE);
+}
+
+int fr_dump(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return -1;
+
+    int nrings = __atomic_load_n(&s_nrings, __ATOMIC_ACQUIRE);
+
+    fr_dump_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic        = FR_DUMP_MAGIC;
+    hdr.version      = 1;
+#ifdef FR_HAVE_TSC
+    hdr.clock        = FR_CLOCK_TSC;
+#else
+    hdr.clock        = FR_CLOCK_MONO;
+#endif
+    hdr.record_size  = sizeof(fr_record_t);
+    hdr.ring_records = FR_RING_RECORDS;
+    hdr.nrings       = (uint32_t)nrings;
+    hdr.pid          = (uint32_t)getpid();
+    hdr.ts0          = s_ts0;
+    hdr.mono0_ns     = s_mono0;
+    hdr.real0_ns     = s_real0;
+    hdr.ts1          = fr_now();
+    hdr.mono1_ns     = clock_ns(CLOCK_MONOTONIC);
+    hdr.real1_ns     = clock_ns(CLOCK_REALTIME);
+
+    int rc = write_all(fd, &hdr, sizeof(hdr));
+
+    for (int i = 0; rc == 0 && i < nrings; i++) {
+        fr_ring_t    *r = s_rings[i];
+        fr_ring_hdr_t rh = r->hdr;
+        rh.head = __atomic_load_n(&r->hdr.head, __ATOMIC_ACQUIRE);
+
+        rc = write_all(fd, &rh, sizeof(rh));
+        if (rc == 0) rc = write_all(fd, r->rec, sizeof(r->rec));
+    }
+
+    close(fd);
+    return rc;
+}
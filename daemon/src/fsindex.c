@@ -0,0 +1,374 @@
+/*
+ * fsindex.c — Persistent file-state index (see fsindex.h).
+ *
+ * Linear-probing hash table of fsindex_rec_t keyed by (dev, ino), under
+ * one mutex: lookups and updates are a few hundred nanoseconds, far
+ * below the cost of the scans they stand for.  A save writes the table
+ * under the lock into a stdio buffer and syncs it outside.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "fsindex.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <libgen.h>
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static pthread_mutex_t  s_mutex      = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t  s_save_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char             s_path[4096];
+static int              s_active     = 0;
+static fsindex_rec_t   *s_slots      = NULL;
+static size_t           s_nslots     = 0;        /* Power of two */
+static size_t           s_count      = 0;
+static fsindex_hdr_t    s_hdr;
+
+static int              s_m_entries  = -1;
+
+/* ── Hash table ─────────────────────────────────────────────────────────── */
+
+static size_t slot_of(uint64_t dev, uint64_t ino)
+{
+    uint64_t h = ino * 0x9e3779b97f4a7c15ull ^ dev * 0xc2b2ae3d27d4eb4full;
+    h ^= h >> 29;
+    return (size_t)h & (s_nslots - 1);
+}
+
+/* Slot holding (dev, ino), or the empty slot where it would go. */
+static fsindex_rec_t *find(uint64_t dev, uint64_t ino)
+{
+    for (size_t i = slot_of(dev, ino);; i = (i + 1) & (s_nslots - 1)) {
+        fsindex_rec_t *r = &s_slots[i];
+        if (r->ino == 0 || (r->ino == ino && r->dev == dev)) return r;
+    }
+}
+
+static int rehash(size_t nslots)
+{
+    fsindex_rec_t *old  = s_slots;
+    size_t         oldn = s_nslots;
+
+    fsindex_rec_t *ns = calloc(nslots, sizeof(*ns));
+    if (!ns) return -1;
+    s_slots  = ns;
+    s_nslots = nslots;
+    for (size_t i = 0; i < oldn; i++)
+        if (old[i].ino) *find(old[i].dev, old[i].ino) = old[i];
+    free(old);
+    return 0;
+}
+
+/* Call with s_mutex held. */
+static void put_locked(const fsindex_rec_t *rec)
+{
+    if ((s_count + 1) * 10 > s_nslots * 7 && rehash(s_nslots * 2) != 0) {
+        log_error_rl("fsindex: out of memory at %zu records", s_count);
+        return;
+    }
+    fsindex_rec_t *r = find(rec->dev, rec->ino);
+    if (r->ino == 0) s_count++;
+    *r = *rec;
+}
+
+static uint64_t ts_ns(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000000ull + (uint64_t)ts->tv_nsec;
+}
+
+static double sample_entries(void *arg)
+{
+    (void)arg;
+    return (double)fsindex_count();
+}
+
+/* ── Load ───────────────────────────────────────────────────────────────── */
+
+static int load(void)
+{
+    int fd = open(s_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) return 0;
+        log_error("fsindex: cannot open %s: %s", s_path, strerror(errno));
+        return -1;
+    }
+
+    FILE *fp = fdopen(fd, "r");
+    if (!fp) {
+        close(fd);
+        return -1;
+    }
+
+    fsindex_hdr_t hdr;
+    int rc = -1;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        hdr.magic != FSINDEX_MAGIC || hdr.version != FSINDEX_VERSION) {
+        log_warn("fsindex: %s has an unknown format — starting afresh.",
+                 s_path);
+        rc = 0;
+        goto out;
+    }
+
+    size_t want = FSINDEX_INITIAL_SLOTS;
+    while (hdr.count * 10 > want * 7) want *= 2;
+    if (rehash(want) != 0) goto out;
+
+    fsindex_rec_t rec;
+    uint64_t i;
+    for (i = 0; i < hdr.count && fread(&rec, sizeof(rec), 1, fp) == 1; i++)
+        if (rec.ino) put_locked(&rec);
+    if (i < hdr.count)
+        log_warn("fsindex: %s is truncated (%llu of %llu records).", s_path,
+                 (unsigned long long)i, (unsigned long long)hdr.count);
+
+    s_hdr       = hdr;
+    s_hdr.count = 0;
+    rc = 0;
+out:
+    fclose(fp);
+    return rc;
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+int fsindex_init(const char *path)
+{
+    if (!path) {
+        if (mkdir(JOURNAL_DIR, 0700) != 0 && errno != EEXIST) {
+            log_error("fsindex: mkdir %s: %s", JOURNAL_DIR, strerror(errno));
+            return -1;
+        }
+        path = FSINDEX_PATH;
+    }
+    snprintf(s_path, sizeof(s_path), "%s", path);
+
+    memset(&s_hdr, 0, sizeof(s_hdr));
+    if (rehash(FSINDEX_INITIAL_SLOTS) != 0) return -1;
+
+    uint64_t t0 = metrics_now_ns();
+    if (load() != 0) {
+        free(s_slots);
+        s_slots  = NULL;
+        s_nslots = s_count = 0;
+        return -1;
+    }
+
+    if (s_m_entries < 0)
+        s_m_entries = metrics_sampled("sentinel_fsindex_entries",
+                          "Files in the file-state index",
+                          METRICS_GAUGE, sample_entries, NULL);
+
+    s_active = 1;
+    log_info("File-state index %s: %zu files, sweep %u%s (loaded in "
+             "%.1f ms)", s_path, s_count, s_hdr.sweep,
+             s_hdr.sweeping ? " unfinished" : "",
+             (metrics_now_ns() - t0) / 1e6);
+    return 0;
+}
+
+int fsindex_active(void)
+{
+    return s_active;
+}
+
+int fsindex_lookup(uint64_t dev, uint64_t ino, fsindex_rec_t *out)
+{
+    if (!s_active || ino == 0) return 0;
+
+    pthread_mutex_lock(&s_mutex);
+    fsindex_rec_t *r = find(dev, ino);
+    int found = r->ino != 0;
+    if (found) *out = *r;
+    pthread_mutex_unlock(&s_mutex);
+    return found;
+}
+
+void fsindex_put(const fsindex_rec_t *rec)
+{
+    if (!s_active || rec->ino == 0) return;
+
+    pthread_mutex_lock(&s_mutex);
+    put_locked(rec);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+void fsindex_record_clean(const char *path, const struct stat *before,
+                          uint32_t sigver)
+{
+    if (!s_active || sigver == 0) return;
+
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) ||
+        st.st_ino != before->st_ino || st.st_size != before->st_size ||
+        ts_ns(&st.st_mtim) != ts_ns(&before->st_mtim))
+        return;                             /* Changed while scanned */
+
+    fsindex_rec_t rec = {
+        .dev      = st.st_dev,
+        .ino      = st.st_ino,
+        .size     = st.st_size,
+        .mtime_ns = ts_ns(&st.st_mtim),
+        .ctime_ns = ts_ns(&st.st_ctim),
+        .sigver   = sigver,
+    };
+
+    pthread_mutex_lock(&s_mutex);
+    fsindex_rec_t *r = find(rec.dev, rec.ino);
+    if (r->ino && r->has_hash && r->size == rec.size &&
+        r->mtime_ns == rec.mtime_ns) {
+        memcpy(rec.sha256, r->sha256, sizeof(rec.sha256));
+        rec.has_hash = 1;
+    }
+    rec.sweep = s_hdr.sweep;
+    put_locked(&rec);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+void fsindex_set_hash(uint64_t dev, uint64_t ino, int64_t size,
+                      uint64_t mtime_ns,
+                      const uint8_t hash[SHA256_DIGEST_LEN])
+{
+    if (!s_active) return;
+
+    pthread_mutex_lock(&s_mutex);
+    fsindex_rec_t *r = find(dev, ino);
+    if (r->ino && r->size == size && r->mtime_ns == mtime_ns) {
+        memcpy(r->sha256, hash, SHA256_DIGEST_LEN);
+        r->has_hash = 1;
+    }
+    pthread_mutex_unlock(&s_mutex);
+}
+
+void fsindex_get_sweep(uint32_t *sweep, int *sweeping,
+                       uint64_t *last_done_ns)
+{
+    pthread_mutex_lock(&s_mutex);
+    if (sweep)        *sweep        = s_hdr.sweep;
+    if (sweeping)     *sweeping     = (int)s_hdr.sweeping;
+    if (last_done_ns) *last_done_ns = s_hdr.last_done_ns;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+uint32_t fsindex_begin_sweep(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    s_hdr.sweep++;
+    s_hdr.sweeping = 1;
+    uint32_t n = s_hdr.sweep;
+    pthread_mutex_unlock(&s_mutex);
+    return n;
+}
+
+size_t fsindex_end_sweep(uint64_t now_ns)
+{
+    pthread_mutex_lock(&s_mutex);
+    size_t before = s_count;
+
+    /* Rebuild without the records the sweep did not reach. */
+    fsindex_rec_t *ns = calloc(s_nslots, sizeof(*ns));
+    if (ns) {
+        fsindex_rec_t *old  = s_slots;
+        size_t         oldn = s_nslots;
+        s_slots = ns;
+        s_count = 0;
+        for (size_t i = 0; i < oldn; i++) {
+            if (old[i].ino && old[i].sweep == s_hdr.sweep) {
+                *find(old[i].dev, old[i].ino) = old[i];
+                s_count++;
+            }
+        }
+        free(old);
+    }
+
+    s_hdr.sweeping     = 0;
+    s_hdr.last_done_ns = now_ns;
+    size_t dropped = before - s_count;
+    pthread_mutex_unlock(&s_mutex);
+    return dropped;
+}
+
+size_t fsindex_count(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    size_t n = s_count;
+    pthread_mutex_unlock(&s_mutex);
+    return n;
+}
+
+int fsindex_save(void)
+{
+    if (!s_active) return -1;
+
+    char tmp[sizeof(s_path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", s_path);
+
+    pthread_mutex_lock(&s_save_mutex);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        log_error_rl("fsindex: cannot write %s: %s", tmp, strerror(errno));
+        if (fd >= 0) close(fd);
+        pthread_mutex_unlock(&s_save_mutex);
+        return -1;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+    uint64_t t0 = metrics_now_ns();
+    pthread_mutex_lock(&s_mutex);
+    fsindex_hdr_t hdr = s_hdr;
+    hdr.magic   = FSINDEX_MAGIC;
+    hdr.version = FSINDEX_VERSION;
+    hdr.count   = s_count;
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+    for (size_t i = 0; ok && i < s_nslots; i++)
+        if (s_slots[i].ino)
+            ok = fwrite(&s_slots[i], sizeof(s_slots[i]), 1, fp) == 1;
+    ok = ok && fflush(fp) == 0;
+    pthread_mutex_unlock(&s_mutex);
+
+    ok = ok && fdatasync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok || rename(tmp, s_path) != 0) {
+        log_error_rl("fsindex: cannot save %s: %s", s_path, strerror(errno));
+        unlink(tmp);
+        pthread_mutex_unlock(&s_save_mutex);
+        return -1;
+    }
+
+    /* Make the rename durable too. */
+    char dir[sizeof(s_path)];
+    snprintf(dir, sizeof(dir), "%s", s_path);
+    int dfd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+    pthread_mutex_unlock(&s_save_mutex);
+
+    log_info("File-state index saved: %llu files in %.1f ms.",
+             (unsigned long long)hdr.count, (metrics_now_ns() - t0) / 1e6);
+    return 0;
+}
+
+void fsindex_shutdown(int save)
+{
+    if (!s_active) return;
+    if (save) fsindex_save();
+
+    pthread_mutex_lock(&s_mutex);
+    s_active = 0;
+    free(s_slots);
+    s_slots  = NULL;
+    s_nslots = s_count = 0;
+    pthread_mutex_unlock(&s_mutex);
+}
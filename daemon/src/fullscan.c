@@ -0,0 +1,388 @@
+/*
+ * fullscan.c — Scheduled incremental full scans (see fullscan.h).
+ *
+ * The sweep is a one-thread crawl (crawl.h) whose file callback consults
+ * the index and, when a file needs it, hashes and scans it in place.  The
+ * reactor only starts sweeps and reaps finished ones (fullscan_tick); the
+ * sweep thread asks clamd for its signature version, so a slow or absent
+ * clamd never holds up the event loop.
+ *
+ * Pacing keeps two virtual clocks from the start of the sweep: the time
+ * the bytes read so far may take at the I/O budget, and the busy time so
+ * far scaled up by the CPU budget.  After every file the thread sleeps
+ * until the later of the two, so it averages out at the budget however
+ * file sizes vary.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "fullscan.h"
+#include "fsindex.h"
+#include "crawl.h"
+#include "scanner.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static int                 s_inited     = 0;
+static char              **s_roots      = NULL;
+static unsigned            s_interval_h = 0;
+static unsigned            s_io_mbps    = 0;
+static unsigned            s_cpu_pct    = 0;
+static fullscan_filter_fn  s_filter     = NULL;
+static fullscan_scan_fn    s_scan       = NULL;
+static void               *s_scan_arg   = NULL;
+
+static uint32_t            s_sigver     = 0;    /* __atomic: workers read */
+static uint64_t            s_sigver_asked = 0;  /* __atomic: last worker ask */
+
+/* The running sweep. */
+static crawl_t            *s_crawl      = NULL;
+static int                 s_stopping   = 0;
+static int                 s_finished   = 0;    /* on_done ran            */
+static uint32_t            s_sweep      = 0;
+
+/* Sweep thread only. */
+static int                 s_have_sigver = 0;   /* Read for this sweep    */
+static int                 s_no_sigver   = 0;   /* clamd gave none: retry */
+static uint64_t            s_pace_t0    = 0;
+static uint64_t            s_io_ns      = 0;
+static uint64_t            s_cpu_ns     = 0;
+static uint64_t            s_last_save  = 0;
+static uint64_t            s_covered, s_unchanged, s_same_hash, s_scanned;
+static uint64_t            s_bytes;
+
+static int                 s_m_covered   = -1;
+static int                 s_m_unchanged = -1;
+static int                 s_m_same_hash = -1;
+static int                 s_m_scanned   = -1;
+static int                 s_m_bytes     = -1;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t stx_ns(const struct statx_timestamp *t)
+{
+    return (uint64_t)t->tv_sec * 1000000000ull + t->tv_nsec;
+}
+
+static int stopping(void)
+{
+    return __atomic_load_n(&s_stopping, __ATOMIC_RELAXED);
+}
+
+/* Account for one file's cost and sleep off whatever exceeds the budget. */
+static void pace(uint64_t bytes, uint64_t busy_ns)
+{
+    if (s_io_mbps)
+        s_io_ns += (uint64_t)((double)bytes * 1e9 /
+                              ((double)s_io_mbps * 1048576.0));
+    s_cpu_ns += (s_cpu_pct && s_cpu_pct < 100)
+              ? busy_ns * 100 / s_cpu_pct : busy_ns;
+
+    uint64_t spent  = s_io_ns > s_cpu_ns ? s_io_ns : s_cpu_ns;
+    uint64_t target = s_pace_t0 + spent;
+    uint64_t now    = metrics_now_ns();
+    uint64_t burst  = FULLSCAN_BURST_MS * 1000000ull;
+
+    /* Cheap stretches do not bank budget for later bursts. */
+    if (target + burst < now) s_pace_t0 += now - burst - target;
+
+    while (target > now && !stopping()) {
+        uint64_t left = target - now;
+        if (left > 100000000ull) left = 100000000ull;     /* Stay stoppable */
+        struct timespec ts = { 0, (long)left };
+        nanosleep(&ts, NULL);
+        now = metrics_now_ns();
+    }
+}
+
+static int hash_file(const char *path, uint8_t out[SHA256_DIGEST_LEN],
+                     uint64_t *bytes)
+{
+    int fd = open(path, O_RDONLY | O_NOATIME | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0 && errno == EPERM)            /* O_NOATIME: not the owner */
+        fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return -1;
+    int rc = sha256_fd(fd, out, bytes);
+    close(fd);
+    return rc;
+}
+
+/* ── Sweep callbacks (sweep thread) ─────────────────────────────────────── */
+
+static int on_file(const char *path, const struct statx *stx, void *arg)
+{
+    (void)arg;
+    if (stopping()) return -1;
+
+    /* Verdicts are only current against the signatures of this sweep. */
+    if (!s_have_sigver) {
+        uint32_t v = scanner_db_version();
+        if (v == 0) {
+            s_no_sigver = 1;
+            return -1;
+        }
+        __atomic_store_n(&s_sigver, v, __ATOMIC_RELAXED);
+        s_have_sigver = 1;
+        log_info("Full scan %u: signatures %u.", s_sweep, v);
+    }
+
+    int64_t size = (int64_t)stx->stx_size;
+    if (!s_filter(path, size)) return 0;
+
+    uint64_t dev   = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    uint64_t mtime = stx_ns(&stx->stx_mtime);
+    uint64_t ctime = stx_ns(&stx->stx_ctime);
+    uint32_t sigv  = fullscan_sigver();
+
+    fsindex_rec_t rec;
+    int found  = fsindex_lookup(dev, stx->stx_ino, &rec);
+    int sig_ok = found && rec.sigver >= sigv;
+
+    if (found && rec.sweep == s_sweep) {
+        s_covered++;
+        metrics_inc(s_m_covered);
+        return 0;
+    }
+    if (sig_ok && rec.size == size && rec.mtime_ns == mtime &&
+        rec.ctime_ns == ctime) {
+        rec.sweep = s_sweep;
+        fsindex_put(&rec);
+        s_unchanged++;
+        metrics_inc(s_m_unchanged);
+        return 0;
+    }
+
+    /* Hash first: a touched-but-identical file needs no scan. */
+    uint64_t t0 = metrics_now_ns();
+    uint8_t  hash[SHA256_DIGEST_LEN];
+    uint64_t nread  = 0;
+    int      hashed = hash_file(path, hash, &nread) == 0;
+
+    if (hashed && sig_ok && rec.has_hash && rec.size == size &&
+        memcmp(hash, rec.sha256, sizeof(hash)) == 0) {
+        rec.mtime_ns = mtime;
+        rec.ctime_ns = ctime;
+        rec.sweep    = s_sweep;
+        fsindex_put(&rec);
+        s_same_hash++;
+        s_bytes += nread;
+        metrics_inc(s_m_same_hash);
+        metrics_add(s_m_bytes, nread);
+        pace(nread, metrics_now_ns() - t0);
+        return 0;
+    }
+
+    s_scan(path, s_scan_arg);
+    if (hashed) fsindex_set_hash(dev, stx->stx_ino, size, mtime, hash);
+    s_scanned++;
+    s_bytes += nread + (uint64_t)size;
+    metrics_inc(s_m_scanned);
+    metrics_add(s_m_bytes, nread + (uint64_t)size);
+    pace(nread + (uint64_t)size, metrics_now_ns() - t0);
+
+    if (metrics_now_ns() - s_last_save > FULLSCAN_SAVE_MS * 1000000ull) {
+        fsindex_save();
+        s_last_save = metrics_now_ns();
+    }
+    return stopping() ? -1 : 0;
+}
+
+static void on_done(const crawl_stats_t *st, void *arg)
+{
+    (void)arg;
+
+    if (s_no_sigver) {
+        log_warn_rl("Full scan %u due but clamd does not report its "
+                    "signature version — retrying later.", s_sweep);
+    } else if (st->cancelled) {
+        log_info("Full scan %u paused after %.0f s (%llu scanned so far); "
+                 "it resumes on the next start.", s_sweep,
+                 st->elapsed_ns / 1e9, (unsigned long long)s_scanned);
+    } else {
+        size_t dropped = fsindex_end_sweep(wall_ns());
+        log_info("Full scan %u done in %.0f s: %llu files, %llu scanned, "
+                 "%llu unchanged, %llu touched but identical, %llu already "
+                 "covered, %.1f MiB read; %zu stale index entries dropped.",
+                 s_sweep, st->elapsed_ns / 1e9,
+                 (unsigned long long)st->files,
+                 (unsigned long long)s_scanned,
+                 (unsigned long long)s_unchanged,
+                 (unsigned long long)s_same_hash,
+                 (unsigned long long)s_covered, s_bytes / 1048576.0, dropped);
+        fsindex_save();
+    }
+    __atomic_store_n(&s_finished, 1, __ATOMIC_RELEASE);
+}
+
+/* ── Scheduling (reactor thread) ────────────────────────────────────────── */
+
+/*
+ * Start (or resume) a sweep.  A new one is begun in the index even if
+ * clamd then reports no signature version: the next tick resumes it.
+ */
+static void start_sweep(int resume, uint32_t sweep)
+{
+    s_sweep       = resume ? sweep : fsindex_begin_sweep();
+    s_covered     = s_unchanged = s_same_hash = s_scanned = s_bytes = 0;
+    s_io_ns       = s_cpu_ns = 0;
+    s_pace_t0     = s_last_save = metrics_now_ns();
+    s_finished    = 0;
+    s_have_sigver = s_no_sigver = 0;
+
+    crawl_opts_t o = {
+        .threads      = 1,
+        .low_priority = 1,
+        .file_mask    = STATX_INO | STATX_SIZE | STATX_MTIME | STATX_CTIME,
+        .on_file      = on_file,
+        .on_done      = on_done,
+    };
+    s_crawl = crawl_start((const char *const *)s_roots, &o);
+    if (!s_crawl) {
+        log_error("Cannot start full scan %u.", s_sweep);
+        return;
+    }
+    log_info("Full scan %u %s (budget %u MiB/s, %u%% CPU).",
+             s_sweep, resume ? "resumed" : "started", s_io_mbps, s_cpu_pct);
+}
+
+static void stop_crawl(void)
+{
+    if (!s_crawl) return;
+    __atomic_store_n(&s_stopping, 1, __ATOMIC_RELAXED);
+    crawl_cancel(s_crawl);
+    crawl_join(s_crawl);
+    s_crawl = NULL;
+    __atomic_store_n(&s_stopping, 0, __ATOMIC_RELAXED);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+int fullscan_init(const char *const *roots, unsigned interval_h,
+                  unsigned io_mbps, unsigned cpu_pct,
+                  fullscan_filter_fn filter, fullscan_scan_fn scan,
+                  void *arg)
+{
+    if (!roots || !roots[0] || !filter || !scan || !fsindex_active())
+        return -1;
+
+    int n = 0;
+    while (roots[n]) n++;
+    s_roots = calloc((size_t)n + 1, sizeof(*s_roots));
+    if (!s_roots) return -1;
+    for (int i = 0; i < n; i++) {
+        if (!(s_roots[i] = strdup(roots[i]))) {
+            fullscan_shutdown(0);
+            return -1;
+        }
+    }
+    s_interval_h = interval_h;
+    s_io_mbps    = io_mbps;
+    s_cpu_pct    = cpu_pct;
+    s_filter     = filter;
+    s_scan       = scan;
+    s_scan_arg   = arg;
+
+    if (s_m_covered < 0) {
+        s_m_covered   = metrics_counter(
+            "sentinel_fullscan_files_total{outcome=\"covered\"}",
+            "Files examined by full scans, by outcome");
+        s_m_unchanged = metrics_counter(
+            "sentinel_fullscan_files_total{outcome=\"unchanged\"}",
+            "Files examined by full scans, by outcome");
+        s_m_same_hash = metrics_counter(
+            "sentinel_fullscan_files_total{outcome=\"same_hash\"}",
+            "Files examined by full scans, by outcome");
+        s_m_scanned   = metrics_counter(
+            "sentinel_fullscan_files_total{outcome=\"scanned\"}",
+            "Files examined by full scans, by outcome");
+        s_m_bytes     = metrics_counter("sentinel_fullscan_read_bytes_total",
+            "Bytes read by full scans (hashing + scanning)");
+    }
+
+    /* The version is learnt off the startup path: by the first sweep, or
+     * by the first worker that records a live verdict before one. */
+    __atomic_store_n(&s_sigver, 0, __ATOMIC_RELAXED);
+    s_inited = 1;
+    return 0;
+}
+
+void fullscan_tick(void)
+{
+    if (!s_inited) return;
+
+    if (s_crawl) {
+        if (!__atomic_load_n(&s_finished, __ATOMIC_ACQUIRE)) return;
+        crawl_join(s_crawl);
+        s_crawl = NULL;
+    }
+    if (!s_interval_h) return;
+
+    uint32_t sweep;
+    int      sweeping;
+    uint64_t last_done;
+    fsindex_get_sweep(&sweep, &sweeping, &last_done);
+    if (!sweeping &&
+        wall_ns() < last_done + (uint64_t)s_interval_h * 3600000000000ull)
+        return;
+    start_sweep(sweeping, sweep);
+}
+
+uint32_t fullscan_sigver(void)
+{
+    uint32_t v = __atomic_load_n(&s_sigver, __ATOMIC_RELAXED);
+    if (v || !s_inited) return v;
+
+    /* No sweep yet: one worker asks clamd, now and then. */
+    uint64_t now  = metrics_now_ns();
+    uint64_t last = __atomic_load_n(&s_sigver_asked, __ATOMIC_RELAXED);
+    if (last && now - last < FULLSCAN_SIGVER_RETRY_MS * 1000000ull)
+        return 0;
+    if (!__atomic_compare_exchange_n(&s_sigver_asked, &last, now, 0,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return 0;
+
+    v = scanner_db_version();
+    uint32_t none = 0;
+    if (v && !__atomic_compare_exchange_n(&s_sigver, &none, v, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        v = none;                       /* A sweep got there first */
+    return v;
+}
+
+void fullscan_stop(void)
+{
+    if (!s_inited) return;
+    stop_crawl();
+    fsindex_save();
+}
+
+void fullscan_shutdown(int save)
+{
+    stop_crawl();
+    fsindex_shutdown(save);
+    if (s_roots) {
+        for (int i = 0; s_roots[i]; i++) free(s_roots[i]);
+        free(s_roots);
+        s_roots = NULL;
+    }
+    s_inited = 0;
+}
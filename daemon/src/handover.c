@@ -0,0 +1,594 @@
+/*
+ * handover.c — Control socket and state transfer for live upgrades
+ * (see handover.h).
+ *
+ * The old daemon runs the whole exchange inside one reactor callback on
+ * a blocking connection with send/receive timeouts; the new daemon runs
+ * it from main() before its event loop exists.  The final step is a
+ * two-byte handshake ('A' from the new daemon, 'K' back) so the two can
+ * never both believe they own the fds: the old daemon commits only when
+ * it reads 'A', the new one only when it reads 'K'.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "handover.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static int                s_listen_fd = -1;
+static char               s_socket_path[108];   /* Matches sizeof(sun_path) */
+static reactor_t         *s_reactor   = NULL;
+static handover_export_fn s_export    = NULL;
+static handover_done_fn   s_done      = NULL;
+static void              *s_arg       = NULL;
+
+/* New daemon: connection to the old one until commit / abort. */
+static int                s_conn_fd   = -1;
+
+/* ── Helpers: message buffer ────────────────────────────────────────────── */
+
+static int reserve(handover_msg_t *m, size_t n)
+{
+    if (m->error) return -1;
+    if (m->len + n > HANDOVER_MAX_PAYLOAD) {
+        m->error = 1;
+        return -1;
+    }
+    if (m->len + n <= m->cap) return 0;
+
+    size_t cap = m->cap ? m->cap : 4096;
+    while (cap < m->len + n) cap *= 2;
+    uint8_t *p = realloc(m->data, cap);
+    if (!p) {
+        m->error = 1;
+        return -1;
+    }
+    m->data = p;
+    m->cap  = cap;
+    return 0;
+}
+
+/* ── Helpers: sockets ───────────────────────────────────────────────────── */
+
+static void set_timeout(int fd, int optname, unsigned ms)
+{
+    struct timeval tv = { .tv_sec = ms / 1000,
+                          .tv_usec = (long)(ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, optname, &tv, sizeof(tv));
+}
+
+static int read_full(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n == 0) errno = ECONNRESET;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Only the daemon's own user (root) may take its fds. */
+static int peer_allowed(int fd, pid_t *pid)
+{
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) return 0;
+    if (pid) *pid = cred.pid;
+    return cred.uid == geteuid();
+}
+
+static int send_hdr(int fd, const handover_hdr_t *hdr, const int *fds,
+                    int nfds)
+{
+    union {
+        char           buf[CMSG_SPACE(sizeof(int) * HANDOVER_MAX_FDS)];
+        struct cmsghdr align;
+    } ctl;
+    struct iovec  iov = { .iov_base = (void *)hdr, .iov_len = sizeof(*hdr) };
+    struct msghdr mh  = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+    if (nfds > 0) {
+        memset(&ctl, 0, sizeof(ctl));
+        mh.msg_control    = ctl.buf;
+        mh.msg_controllen = CMSG_SPACE(sizeof(int) * (size_t)nfds);
+        struct cmsghdr *c = CMSG_FIRSTHDR(&mh);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type  = SCM_RIGHTS;
+        c->cmsg_len   = CMSG_LEN(sizeof(int) * (size_t)nfds);
+        memcpy(CMSG_DATA(c), fds, sizeof(int) * (size_t)nfds);
+    }
+
+    for (;;) {
+        ssize_t n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n != (ssize_t)sizeof(*hdr)) return -1;
+        return 0;
+    }
+}
+
+static int recv_hdr(int fd, handover_hdr_t *hdr, handover_msg_t *m)
+{
+    union {
+        char           buf[CMSG_SPACE(sizeof(int) * HANDOVER_MAX_FDS)];
+        struct cmsghdr align;
+    } ctl;
+    struct iovec  iov = { .iov_base = hdr, .iov_len = sizeof(*hdr) };
+    struct msghdr mh  = { .msg_iov = &iov, .msg_iovlen = 1,
+                          .msg_control = ctl.buf,
+                          .msg_controllen = sizeof(ctl.buf) };
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+
+    /* Collect the fds first, so a short read still closes them. */
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(&mh, c)) {
+        if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+            continue;
+        int k = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (int i = 0; i < k && m->nfds < HANDOVER_MAX_FDS; i++)
+            memcpy(&m->fds[m->nfds++], CMSG_DATA(c) + i * sizeof(int),
+                   sizeof(int));
+    }
+    m->owns_fds = 1;
+
+    if (n != (ssize_t)sizeof(*hdr)) {
+        if (n >= 0) errno = ECONNRESET;
+        return -1;
+    }
+    if (mh.msg_flags & MSG_CTRUNC) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    return 0;
+}
+
+/* Tell systemd (Type=simple + NotifyAccess=main) who the main PID is now. */
+static void notify_main_pid(pid_t pid)
+{
+    const char *path = getenv("NOTIFY_SOCKET");
+    if (!path || (path[0] != '/' && path[0] != '@')) return;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    size_t len = strlen(path);
+    if (len >= sizeof(addr.sun_path)) return;
+    memcpy(addr.sun_path, path, len);
+    if (path[0] == '@') addr.sun_path[0] = '\0';   /* Abstract namespace */
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+
+    char msg[32];
+    int n = snprintf(msg, sizeof(msg), "MAINPID=%d\n", (int)pid);
+    if (sendto(fd, msg, (size_t)n, 0, (struct sockaddr *)&addr,
+               (socklen_t)(offsetof(struct sockaddr_un, sun_path) + len)) < 0)
+        log_warn("handover: cannot notify systemd of the new main PID: %s",
+                 strerror(errno));
+    close(fd);
+}
+
+/* ── Old daemon ─────────────────────────────────────────────────────────── */
+
+/* Serve one takeover request.  @return 1 if committed. */
+static int serve(int fd, pid_t peer)
+{
+    set_timeout(fd, SO_RCVTIMEO, HANDOVER_TIMEOUT_MS);
+    set_timeout(fd, SO_SNDTIMEO, HANDOVER_TIMEOUT_MS);
+
+    handover_req_t req;
+    if (read_full(fd, &req, sizeof(req)) != 0 || req.magic != HANDOVER_MAGIC) {
+        log_warn("handover: bad request from pid %d — ignored", (int)peer);
+        return 0;
+    }
+
+    handover_hdr_t hdr = { .magic = HANDOVER_MAGIC,
+                           .version = HANDOVER_VERSION };
+    if (req.version != HANDOVER_VERSION) {
+        log_warn("handover: pid %d speaks version %u, we speak %u — refused",
+                 (int)peer, req.version, HANDOVER_VERSION);
+        hdr.status = EPROTO;
+        send_hdr(fd, &hdr, NULL, 0);
+        return 0;
+    }
+
+    log_info("Handover requested by pid %d — freezing", (int)peer);
+    uint64_t t0 = metrics_now_ns();
+
+    handover_msg_t msg;
+    memset(&msg, 0, sizeof(msg));
+    int committed = 0;
+
+    if (s_export(&msg, s_arg) != 0 || msg.error) {
+        hdr.status = msg.error ? EMSGSIZE : EBUSY;
+        log_warn("handover: cannot export state (%s) — refused",
+                 strerror(hdr.status));
+        send_hdr(fd, &hdr, NULL, 0);
+    } else {
+        hdr.nfds        = (uint32_t)msg.nfds;
+        hdr.payload_len = msg.len;
+
+        char ack = 0;
+        if (send_hdr(fd, &hdr, msg.fds, msg.nfds) != 0 ||
+            write_full(fd, msg.data, msg.len) != 0) {
+            log_warn("handover: sending state to pid %d failed: %s",
+                     (int)peer, strerror(errno));
+        } else if (read_full(fd, &ack, 1) != 0 || ack != 'A') {
+            log_warn("handover: pid %d did not take over (%s) — resuming",
+                     (int)peer, ack ? "bad reply" : strerror(errno));
+        } else {
+            committed = 1;
+            write_full(fd, "K", 1);
+            log_info("Handed over to pid %d: %u fds, %zu bytes of state, "
+                     "frozen for %.1f ms", (int)peer, hdr.nfds, msg.len,
+                     (double)(metrics_now_ns() - t0) / 1e6);
+            notify_main_pid(peer);
+        }
+    }
+
+    handover_msg_free(&msg);
+    s_done(committed, peer, s_arg);
+    return committed;
+}
+
+static void on_control_ready(int fd, uint32_t events, void *arg)
+{
+    (void)events;
+    (void)arg;
+
+    int c = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+    if (c < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            log_warn_rl("handover: accept(): %s", strerror(errno));
+        return;
+    }
+
+    pid_t peer = 0;
+    if (!peer_allowed(c, &peer)) {
+        log_warn("handover: rejected connection from pid %d (uid mismatch)",
+                 (int)peer);
+        close(c);
+        return;
+    }
+
+    serve(c, peer);
+    close(c);
+}
+
+int handover_listen(reactor_t *r, const char *socket_path,
+                    handover_export_fn export_fn, handover_done_fn done_fn,
+                    void *arg)
+{
+    if (!r || !export_fn || !done_fn || s_listen_fd >= 0) return -1;
+
+    const char *path = socket_path ? socket_path : HANDOVER_SOCKET_PATH;
+    if (strlen(path) >= sizeof(s_socket_path)) {
+        log_error("Handover socket path too long: %s", path);
+        return -1;
+    }
+    snprintf(s_socket_path, sizeof(s_socket_path), "%s", path);
+
+    /* Remove stale socket file if it exists. */
+    unlink(s_socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        log_error("socket(AF_UNIX): %s", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    memcpy(addr.sun_path, s_socket_path, strlen(s_socket_path) + 1);
+
+    /* Bind with a tight umask so the path is never world-connectable. */
+    mode_t old = umask(0177);
+    int rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old);
+    if (rc != 0 || listen(fd, 1) != 0) {
+        log_error("handover: bind/listen(%s): %s", s_socket_path,
+                  strerror(errno));
+        close(fd);
+        return -1;
+    }
+    chmod(s_socket_path, HANDOVER_SOCKET_PERMS);
+
+    if (reactor_add_fd(r, fd, EPOLLIN, on_control_ready, NULL) != 0) {
+        close(fd);
+        unlink(s_socket_path);
+        return -1;
+    }
+
+    s_listen_fd = fd;
+    s_reactor   = r;
+    s_export    = export_fn;
+    s_done      = done_fn;
+    s_arg       = arg;
+    log_info("Handover socket listening on %s", s_socket_path);
+    return 0;
+}
+
+void handover_export(handover_msg_t *msg)
+{
+    handover_put_u32(msg, HANDOVER_TAG_CONTROL);
+    handover_put_str(msg, s_socket_path);
+    handover_put_fd(msg, s_listen_fd);
+}
+
+void handover_close(int unlink_path)
+{
+    if (s_listen_fd < 0) return;
+
+    reactor_del_fd(s_reactor, s_listen_fd);
+    close(s_listen_fd);
+    s_listen_fd = -1;
+    if (unlink_path) unlink(s_socket_path);
+}
+
+/* ── New daemon ─────────────────────────────────────────────────────────── */
+
+int handover_request(const char *socket_path, handover_msg_t *msg)
+{
+    const char *path = socket_path ? socket_path : HANDOVER_SOCKET_PATH;
+    memset(msg, 0, sizeof(*msg));
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        int err = errno;
+        close(fd);
+        if (err == ENOENT || err == ECONNREFUSED) return 1;
+        log_error("handover: connect(%s): %s", path, strerror(err));
+        return -1;
+    }
+
+    pid_t peer = 0;
+    if (!peer_allowed(fd, &peer)) {
+        log_error("handover: %s is owned by another user — refusing", path);
+        close(fd);
+        return -1;
+    }
+    log_info("Taking over from pid %d via %s", (int)peer, path);
+
+    /* The old daemon may wait HANDOVER_DRAIN_MS for scans before replying. */
+    set_timeout(fd, SO_RCVTIMEO, HANDOVER_DRAIN_MS + HANDOVER_TIMEOUT_MS);
+    set_timeout(fd, SO_SNDTIMEO, HANDOVER_TIMEOUT_MS);
+
+    handover_req_t req = { HANDOVER_MAGIC, HANDOVER_VERSION };
+    handover_hdr_t hdr;
+    if (write_full(fd, &req, sizeof(req)) != 0 ||
+        recv_hdr(fd, &hdr, msg) != 0) {
+        log_error("handover: no reply from pid %d: %s", (int)peer,
+                  strerror(errno));
+        goto fail;
+    }
+    if (hdr.magic != HANDOVER_MAGIC || hdr.version != HANDOVER_VERSION) {
+        log_error("handover: pid %d sent an unknown reply", (int)peer);
+        goto fail;
+    }
+    if (hdr.status != 0) {
+        log_error("handover: pid %d refused: %s", (int)peer,
+                  strerror(hdr.status));
+        goto fail;
+    }
+    if (hdr.nfds != (uint32_t)msg->nfds ||
+        hdr.payload_len > HANDOVER_MAX_PAYLOAD) {
+        log_error("handover: malformed state header (%u fds announced, "
+                  "%d received)", hdr.nfds, msg->nfds);
+        goto fail;
+    }
+
+    msg->len = msg->cap = (size_t)hdr.payload_len;
+    msg->data = malloc(msg->len ? msg->len : 1);
+    if (!msg->data || read_full(fd, msg->data, msg->len) != 0) {
+        log_error("handover: reading state failed: %s", strerror(errno));
+        goto fail;
+    }
+
+    s_conn_fd = fd;
+    log_info("Received %d fds and %zu bytes of state", msg->nfds, msg->len);
+    return 0;
+
+fail:
+    close(fd);
+    handover_msg_free(msg);
+    return -1;
+}
+
+int handover_adopt(handover_msg_t *msg, reactor_t *r,
+                   handover_export_fn export_fn, handover_done_fn done_fn,
+                   void *arg)
+{
+    char path[sizeof(s_socket_path)];
+    int  fd = -1;
+    if (!r || !export_fn || !done_fn ||
+        handover_expect(msg, HANDOVER_TAG_CONTROL) != 0 ||
+        handover_get_str(msg, path, sizeof(path)) != 0 ||
+        handover_get_fd(msg, &fd) != 0)
+        return -1;
+
+    if (reactor_add_fd(r, fd, EPOLLIN, on_control_ready, NULL) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    snprintf(s_socket_path, sizeof(s_socket_path), "%s", path);
+    s_listen_fd = fd;
+    s_reactor   = r;
+    s_export    = export_fn;
+    s_done      = done_fn;
+    s_arg       = arg;
+    return 0;
+}
+
+int handover_commit(void)
+{
+    if (s_conn_fd < 0) return -1;
+
+    /* No timeout on 'K': the old daemon answers at once or exits. */
+    char k = 0;
+    set_timeout(s_conn_fd, SO_RCVTIMEO, 0);
+    int rc = write_full(s_conn_fd, "A", 1) == 0 &&
+             read_full(s_conn_fd, &k, 1) == 0 && k == 'K' ? 0 : -1;
+
+    close(s_conn_fd);
+    s_conn_fd = -1;
+    return rc;
+}
+
+void handover_abort(void)
+{
+    if (s_conn_fd < 0) return;
+    close(s_conn_fd);
+    s_conn_fd = -1;
+}
+
+/* ── State message ──────────────────────────────────────────────────────── */
+
+void handover_put_bytes(handover_msg_t *m, const void *p, size_t n)
+{
+    if (reserve(m, n) != 0) return;
+    memcpy(m->data + m->len, p, n);
+    m->len += n;
+}
+
+void handover_put_u32(handover_msg_t *m, uint32_t v)
+{
+    handover_put_bytes(m, &v, sizeof(v));
+}
+
+void handover_put_u64(handover_msg_t *m, uint64_t v)
+{
+    handover_put_bytes(m, &v, sizeof(v));
+}
+
+void handover_put_str(handover_msg_t *m, const char *s)
+{
+    size_t n = strlen(s);
+    handover_put_u32(m, (uint32_t)n);
+    handover_put_bytes(m, s, n);
+}
+
+void handover_put_fd(handover_msg_t *m, int fd)
+{
+    if (m->error) return;
+    if (fd < 0 || m->nfds >= HANDOVER_MAX_FDS) {
+        m->error = 1;
+        return;
+    }
+    m->fds[m->nfds++] = fd;
+}
+
+int handover_get_bytes(handover_msg_t *m, const void **p, size_t n)
+{
+    if (m->error || n > m->len - m->pos) {
+        m->error = 1;
+        return -1;
+    }
+    *p = m->data + m->pos;
+    m->pos += n;
+    return 0;
+}
+
+int handover_get_u32(handover_msg_t *m, uint32_t *v)
+{
+    const void *p;
+    if (handover_get_bytes(m, &p, sizeof(*v)) != 0) return -1;
+    memcpy(v, p, sizeof(*v));
+    return 0;
+}
+
+int handover_get_u64(handover_msg_t *m, uint64_t *v)
+{
+    const void *p;
+    if (handover_get_bytes(m, &p, sizeof(*v)) != 0) return -1;
+    memcpy(v, p, sizeof(*v));
+    return 0;
+}
+
+int handover_get_str(handover_msg_t *m, char *out, size_t outlen)
+{
+    uint32_t n;
+    const void *p;
+    if (handover_get_u32(m, &n) != 0) return -1;
+    if (n >= outlen) {
+        m->error = 1;
+        return -1;
+    }
+    if (handover_get_bytes(m, &p, n) != 0) return -1;
+    memcpy(out, p, n);
+    out[n] = '\0';
+    return 0;
+}
+
+int handover_get_fd(handover_msg_t *m, int *fd)
+{
+    if (m->error || m->nfds_read >= m->nfds) {
+        m->error = 1;
+        return -1;
+    }
+    *fd = m->fds[m->nfds_read];
+    m->fds[m->nfds_read++] = -1;
+    return 0;
+}
+
+int handover_expect(handover_msg_t *m, uint32_t tag)
+{
+    uint32_t v;
+    if (handover_get_u32(m, &v) != 0) return -1;
+    if (v != tag) {
+        log_error("handover: expected section %.4s, found %.4s",
+                  (const char *)&tag, (const char *)&v);
+        m->error = 1;
+        return -1;
+    }
+    return 0;
+}
+
+void handover_msg_free(handover_msg_t *m)
+{
+    if (!m) return;
+    if (m->owns_fds) {
+        for (int i = 0; i < m->nfds; i++) {
+            if (m->fds[i] >= 0) close(m->fds[i]);
+        }
+    }
+    free(m->data);
+    memset(m, 0, sizeof(*m));
+}
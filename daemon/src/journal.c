@@ -0,0 +1,628 @@
+/*
+ * journal.c — Persistent pending-work journal (see journal.h).
+ *
+ * Callers (the reactor thread enqueuing, workers finishing) only touch
+ * memory: they update the outstanding map and append a record to the
+ * pending buffer under s_mutex.  The commit thread swaps the buffer out,
+ * writes it with one write() and makes it durable with one fdatasync(),
+ * so the cost of a sync is shared by every record of the interval.
+ *
+ * Compaction needs no file scan: the outstanding map *is* the compacted
+ * journal.  The map is serialised under the lock (the pending buffer is
+ * subsumed by it and discarded), written to ".tmp" and renamed over the
+ * live file.  The same rewrite repairs the file if another process
+ * replaced it under us (a successor that took over and then failed), or
+ * if a commit failed part-way and may have left a torn record that would
+ * hide every later one at replay.  Records count as durable only once a
+ * commit or rewrite holding them succeeded.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "journal.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+/* One outstanding work item, chained per bucket. */
+typedef struct entry {
+    uint64_t      id;
+    struct entry *next;
+    char          path[];
+} entry_t;
+
+/* Bytes of a record header covered by the CRC (everything after it). */
+#define REC_CRC_OFF  offsetof(journal_rec_t, type)
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static pthread_mutex_t s_mutex        = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  s_wake         = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  s_durable_cond = PTHREAD_COND_INITIALIZER;
+
+static int        s_fd          = -1;
+static char       s_path[512];
+
+/* Outstanding work: ID → path. */
+static entry_t   *s_map[JOURNAL_BUCKETS];
+static size_t     s_live        = 0;
+static size_t     s_live_bytes  = 0;     /* Their size as ADD records   */
+static uint64_t   s_next_id     = 1;
+
+/* Records not yet handed to the commit thread. */
+static uint8_t   *s_buf         = NULL;
+static size_t     s_buf_len     = 0;
+static size_t     s_buf_cap     = 0;
+
+static uint64_t   s_seq         = 0;     /* Records appended            */
+static uint64_t   s_durable     = 0;     /* Records known to be on disk */
+static int        s_sync_waiters = 0;
+static int        s_broken      = 0;     /* Last commit failed: rewrite */
+static uint64_t   s_failures    = 0;     /* Failed commits and rewrites */
+static size_t     s_file_bytes  = 0;     /* Commit thread only          */
+
+static pthread_t  s_thread;
+static int        s_thread_up   = 0;
+static int        s_stop        = 0;
+
+/* Left over from the previous run, until taken. */
+static journal_entry_t *s_recovered  = NULL;
+static size_t           s_nrecovered = 0;
+
+static uint32_t   s_crc_table[256];
+
+/* Metric IDs (registered in journal_init). */
+static int        s_m_commits     = -1;
+static int        s_m_compactions = -1;
+static int        s_m_commit_lat  = -1;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void crc_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        s_crc_table[i] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const void *p, size_t n)
+{
+    const uint8_t *b = p;
+    crc = ~crc;
+    while (n--) crc = s_crc_table[(crc ^ *b++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t rec_crc(const journal_rec_t *rec, const void *path)
+{
+    uint32_t crc = crc_update(0, (const uint8_t *)rec + REC_CRC_OFF,
+                              sizeof(*rec) - REC_CRC_OFF);
+    return crc_update(crc, path, rec->len);
+}
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* ── Outstanding map ────────────────────────────────────────────────────── */
+
+static unsigned bucket(uint64_t id)
+{
+    return (unsigned)(id % JOURNAL_BUCKETS);
+}
+
+static int map_put(uint64_t id, const char *path, size_t len)
+{
+    entry_t *e = malloc(sizeof(*e) + len + 1);
+    if (!e) return -1;
+
+    e->id = id;
+    memcpy(e->path, path, len);
+    e->path[len] = '\0';
+    e->next = s_map[bucket(id)];
+    s_map[bucket(id)] = e;
+    s_live++;
+    s_live_bytes += sizeof(journal_rec_t) + len;
+    return 0;
+}
+
+/* @return 1 if `id` was outstanding. */
+static int map_del(uint64_t id)
+{
+    for (entry_t **pp = &s_map[bucket(id)]; *pp; pp = &(*pp)->next) {
+        entry_t *e = *pp;
+        if (e->id != id) continue;
+        *pp = e->next;
+        s_live--;
+        s_live_bytes -= sizeof(journal_rec_t) + strlen(e->path);
+        free(e);
+        return 1;
+    }
+    return 0;
+}
+
+static void map_free(void)
+{
+    for (int i = 0; i < JOURNAL_BUCKETS; i++) {
+        while (s_map[i]) {
+            entry_t *e = s_map[i];
+            s_map[i] = e->next;
+            free(e);
+        }
+    }
+    s_live = s_live_bytes = 0;
+}
+
+/* ── Records ────────────────────────────────────────────────────────────── */
+
+/* Append one record to `*buf`.  @return 0, or -1 if out of memory. */
+static int put_rec(uint8_t **buf, size_t *len, size_t *cap, uint8_t type,
+                   uint64_t id, const char *path, size_t plen)
+{
+    size_t need = *len + sizeof(journal_rec_t) + plen;
+    if (need > *cap) {
+        size_t c = *cap ? *cap : 4096;
+        while (c < need) c *= 2;
+        uint8_t *p = realloc(*buf, c);
+        if (!p) return -1;
+        *buf = p;
+        *cap = c;
+    }
+
+    journal_rec_t rec = { .type = type, .len = (uint16_t)plen, .id = id };
+    rec.crc = rec_crc(&rec, path);
+    memcpy(*buf + *len, &rec, sizeof(rec));
+    if (plen) memcpy(*buf + *len + sizeof(rec), path, plen);
+    *len = need;
+    return 0;
+}
+
+/* Caller holds s_mutex. */
+static void append_locked(uint8_t type, uint64_t id, const char *path,
+                          size_t plen)
+{
+    int was_empty = s_buf_len == 0;
+    if (put_rec(&s_buf, &s_buf_len, &s_buf_cap, type, id, path, plen) != 0) {
+        log_error_rl("journal: out of memory — record for work %llu lost",
+                     (unsigned long long)id);
+        return;
+    }
+    s_seq++;
+    if (was_empty) pthread_cond_signal(&s_wake);
+}
+
+/* Replay `len` bytes of journal into the map.  @return bytes consumed. */
+static size_t replay(const uint8_t *data, size_t len)
+{
+    size_t off = sizeof(journal_hdr_t);
+
+    while (off + sizeof(journal_rec_t) <= len) {
+        journal_rec_t rec;
+        memcpy(&rec, data + off, sizeof(rec));
+        if (off + sizeof(rec) + rec.len > len) break;
+
+        const char *path = (const char *)data + off + sizeof(rec);
+        if (rec.crc != rec_crc(&rec, path)) break;
+
+        if (rec.type == JOURNAL_REC_ADD) {
+            map_put(rec.id, path, rec.len);
+        } else if (rec.type == JOURNAL_REC_DONE) {
+            map_del(rec.id);
+        } else {
+            break;
+        }
+        if (rec.id >= s_next_id) s_next_id = rec.id + 1;
+        off += sizeof(rec) + rec.len;
+    }
+    return off;
+}
+
+/* ── File I/O (init, then commit thread only) ───────────────────────────── */
+
+static int cmp_entry(const void *a, const void *b)
+{
+    uint64_t x = ((const journal_entry_t *)a)->id;
+    uint64_t y = ((const journal_entry_t *)b)->id;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Rewrite the file as just the outstanding ADDs.  The pending buffer is
+ * discarded: every record in it is already reflected in the map.
+ */
+static int compact(void)
+{
+    journal_hdr_t hdr = { JOURNAL_MAGIC, JOURNAL_VERSION };
+
+    pthread_mutex_lock(&s_mutex);
+    size_t   cap = sizeof(hdr) + s_live_bytes;
+    size_t   len = sizeof(hdr);
+    uint8_t *img = malloc(cap);
+    int      ok  = img != NULL;
+    if (ok) memcpy(img, &hdr, sizeof(hdr));
+    for (int i = 0; ok && i < JOURNAL_BUCKETS; i++) {
+        for (entry_t *e = s_map[i]; ok && e; e = e->next)
+            ok = put_rec(&img, &len, &cap, JOURNAL_REC_ADD, e->id, e->path,
+                         strlen(e->path)) == 0;
+    }
+    uint64_t seq = s_seq;
+    if (ok) s_buf_len = 0;
+    pthread_mutex_unlock(&s_mutex);
+
+    if (!ok) {
+        free(img);
+        log_error("journal: out of memory compacting %s", s_path);
+        return -1;
+    }
+
+    char tmp[sizeof(s_path) + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", s_path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC,
+                  0600);
+    if (fd < 0 || write_full(fd, img, len) != 0 || fdatasync(fd) != 0 ||
+        rename(tmp, s_path) != 0) {
+        log_error_rl("journal: cannot rewrite %s: %s", s_path,
+                     strerror(errno));
+        if (fd >= 0) close(fd);
+        unlink(tmp);
+        free(img);
+        return -1;
+    }
+    free(img);
+
+    /* Make the rename itself durable. */
+    char dir[sizeof(s_path)];
+    snprintf(dir, sizeof(dir), "%s", s_path);
+    int dfd = open(dirname(dir), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd >= 0) {
+        fsync(dfd);
+        close(dfd);
+    }
+
+    if (s_fd >= 0) close(s_fd);
+    s_fd         = fd;
+    s_file_bytes = len;
+    metrics_inc(s_m_compactions);
+
+    pthread_mutex_lock(&s_mutex);
+    if (seq > s_durable) s_durable = seq;
+    pthread_cond_broadcast(&s_durable_cond);
+    pthread_mutex_unlock(&s_mutex);
+    return 0;
+}
+
+/* 1 if s_path no longer names the file we append to. */
+static int replaced(void)
+{
+    struct stat a, b;
+    return stat(s_path, &a) != 0 || fstat(s_fd, &b) != 0 ||
+           a.st_ino != b.st_ino || a.st_dev != b.st_dev;
+}
+
+/* 1 if the commit thread has something to do.  Caller holds s_mutex. */
+static int commit_due(void)
+{
+    return s_buf_len > 0 || (s_broken && (s_sync_waiters || s_stop));
+}
+
+static void *commit_main(void *arg)
+{
+    (void)arg;
+    uint8_t *spare = NULL;
+    size_t   spare_cap = 0;
+
+    pthread_mutex_lock(&s_mutex);
+    for (;;) {
+        while (!commit_due() && !s_stop)
+            pthread_cond_wait(&s_wake, &s_mutex);
+        if (!commit_due()) break;                   /* Stop, all committed */
+
+        /* Gather a group for one interval, unless someone is waiting. */
+        if (!s_stop && !s_sync_waiters) {
+            struct timespec dl;
+            clock_gettime(CLOCK_REALTIME, &dl);
+            dl.tv_nsec += JOURNAL_COMMIT_MS * 1000000L;
+            if (dl.tv_nsec >= 1000000000L) {
+                dl.tv_sec++;
+                dl.tv_nsec -= 1000000000L;
+            }
+            while (!s_stop && !s_sync_waiters &&
+                   pthread_cond_timedwait(&s_wake, &s_mutex, &dl) == 0)
+                ;
+        }
+        if (!commit_due()) continue;                /* Compacted meanwhile */
+
+        /* Swap buffers so callers keep appending during the I/O. */
+        uint8_t *buf  = s_buf;
+        size_t   len  = s_buf_len;
+        size_t   cap  = s_buf_cap;
+        uint64_t seq  = s_seq;
+        size_t   live = s_live_bytes;
+        int      torn = s_broken;
+        s_buf     = spare;
+        s_buf_cap = spare_cap;
+        s_buf_len = 0;
+        spare     = buf;
+        spare_cap = cap;
+        pthread_mutex_unlock(&s_mutex);
+
+        /* After a failure nothing is appended: the rewrite covers it. */
+        uint64_t t0 = metrics_now_ns();
+        int      ok = 0;
+        if (torn) {
+            /* Rewritten below. */
+        } else if (write_full(s_fd, buf, len) != 0 || fdatasync(s_fd) != 0) {
+            log_error_rl("journal: commit to %s failed: %s", s_path,
+                         strerror(errno));
+        } else {
+            ok = 1;
+            s_file_bytes += len;
+            metrics_inc(s_m_commits);
+            metrics_observe_ns(s_m_commit_lat, metrics_now_ns() - t0);
+        }
+
+        if (!ok) {
+            ok = compact() == 0;
+            if (ok && torn)
+                log_info("journal: %s rewritten after a failed commit",
+                         s_path);
+        } else if (replaced()) {
+            log_warn("journal: %s was replaced by another process — "
+                     "rewriting it", s_path);
+            ok = compact() == 0;
+        } else if (s_file_bytes > JOURNAL_COMPACT_BYTES &&
+                   s_file_bytes > 4 * live) {
+            compact();                  /* The append is durable anyway */
+        }
+
+        pthread_mutex_lock(&s_mutex);
+        s_broken = !ok;
+        if (ok && seq > s_durable) s_durable = seq;
+        if (!ok) s_failures++;
+        pthread_cond_broadcast(&s_durable_cond);
+        if (!ok && s_stop) break;       /* Left for replay to sort out */
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    free(spare);
+    return NULL;
+}
+
+static double sample_outstanding(void *arg)
+{
+    (void)arg;
+    return (double)journal_outstanding();
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+int journal_init(const char *path)
+{
+    if (s_fd >= 0) return -1;
+
+    const char *p = path ? path : JOURNAL_PATH;
+    if (strlen(p) >= sizeof(s_path)) {
+        log_error("Journal path too long: %s", p);
+        return -1;
+    }
+    snprintf(s_path, sizeof(s_path), "%s", p);
+    if (!path) mkdir(JOURNAL_DIR, 0700);
+
+    crc_init();
+    uint64_t t0 = metrics_now_ns();
+
+    int fd = open(s_path, O_RDONLY | O_CREAT | O_CLOEXEC, 0600);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        log_error("Cannot open journal %s: %s", s_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    size_t   size = (size_t)st.st_size;
+    uint8_t *data = malloc(size ? size : 1);
+    ssize_t  got  = data ? pread(fd, data, size, 0) : -1;
+    close(fd);
+    if (got != (ssize_t)size) {
+        log_error("Cannot read journal %s", s_path);
+        free(data);
+        return -1;
+    }
+
+    journal_hdr_t hdr;
+    size_t used = 0;
+    if (size >= sizeof(hdr)) {
+        memcpy(&hdr, data, sizeof(hdr));
+        if (hdr.magic == JOURNAL_MAGIC && hdr.version == JOURNAL_VERSION)
+            used = replay(data, size);
+        else
+            log_warn("Journal %s has an unknown format — starting empty",
+                     s_path);
+    }
+    free(data);
+    if (used && used < size)
+        log_warn("Journal %s: ignored %zu bytes of torn records at the end",
+                 s_path, size - used);
+
+    /* Hand the leftovers out oldest first; the map keeps them outstanding. */
+    if (s_live) {
+        s_recovered = calloc(s_live, sizeof(*s_recovered));
+        for (int i = 0; s_recovered && i < JOURNAL_BUCKETS; i++) {
+            for (entry_t *e = s_map[i]; e; e = e->next) {
+                journal_entry_t *r = &s_recovered[s_nrecovered];
+                r->id   = e->id;
+                r->path = strdup(e->path);
+                if (r->path) s_nrecovered++;
+            }
+        }
+        qsort(s_recovered, s_nrecovered, sizeof(*s_recovered), cmp_entry);
+    }
+
+    s_m_commits     = metrics_counter("sentinel_journal_commits_total",
+                          "Group commits (write + fdatasync) of the journal");
+    s_m_compactions = metrics_counter("sentinel_journal_compactions_total",
+                          "Journal rewrites down to the outstanding work");
+    s_m_commit_lat  = metrics_histogram("sentinel_journal_commit_seconds",
+                          "Journal group-commit latency");
+    metrics_sampled("sentinel_journal_outstanding",
+                    "Accepted work not finished yet", METRICS_GAUGE,
+                    sample_outstanding, NULL);
+
+    /* Start from a clean file: drops DONE pairs and any torn tail. */
+    if (compact() != 0) {
+        map_free();
+        journal_free_entries(s_recovered, s_nrecovered);
+        s_recovered  = NULL;
+        s_nrecovered = 0;
+        return -1;
+    }
+
+    s_stop = 0;
+    if (pthread_create(&s_thread, NULL, commit_main, NULL) != 0) {
+        log_error("Journal commit thread failed to start");
+        close(s_fd);
+        s_fd = -1;
+        map_free();
+        journal_free_entries(s_recovered, s_nrecovered);
+        s_recovered  = NULL;
+        s_nrecovered = 0;
+        return -1;
+    }
+    s_thread_up = 1;
+
+    log_info("Journal %s: %zu items left over from the previous run "
+             "(loaded in %.1f ms)", s_path, s_nrecovered,
+             (double)(metrics_now_ns() - t0) / 1e6);
+    return 0;
+}
+
+int journal_active(void)
+{
+    return s_fd >= 0;
+}
+
+size_t journal_take_recovered(journal_entry_t **out)
+{
+    pthread_mutex_lock(&s_mutex);
+    size_t n = s_nrecovered;
+    *out = s_recovered;
+    s_recovered  = NULL;
+    s_nrecovered = 0;
+    pthread_mutex_unlock(&s_mutex);
+    return n;
+}
+
+void journal_free_entries(journal_entry_t *entries, size_t n)
+{
+    for (size_t i = 0; entries && i < n; i++) free(entries[i].path);
+    free(entries);
+}
+
+uint64_t journal_add(const char *path)
+{
+    if (s_fd < 0 || !path) return 0;
+
+    size_t len = strlen(path);
+    if (len > UINT16_MAX) return 0;
+
+    pthread_mutex_lock(&s_mutex);
+    uint64_t id = 0;
+    if (s_thread_up && map_put(s_next_id, path, len) == 0) {
+        id = s_next_id++;
+        append_locked(JOURNAL_REC_ADD, id, path, len);
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return id;
+}
+
+void journal_done(uint64_t id)
+{
+    if (!id || s_fd < 0) return;
+
+    pthread_mutex_lock(&s_mutex);
+    if (s_thread_up && map_del(id))
+        append_locked(JOURNAL_REC_DONE, id, NULL, 0);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+int journal_sync(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    if (!s_thread_up) {
+        pthread_mutex_unlock(&s_mutex);
+        return -1;
+    }
+
+    /* Fails if the commit (or rewrite) this wakes fails. */
+    uint64_t target   = s_seq;
+    uint64_t failures = s_failures;
+    s_sync_waiters++;
+    pthread_cond_signal(&s_wake);
+    while (s_durable < target && s_thread_up && s_failures == failures)
+        pthread_cond_wait(&s_durable_cond, &s_mutex);
+    s_sync_waiters--;
+    int rc = s_durable >= target ? 0 : -1;
+    pthread_mutex_unlock(&s_mutex);
+    return rc;
+}
+
+size_t journal_outstanding(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    size_t n = s_live;
+    pthread_mutex_unlock(&s_mutex);
+    return n;
+}
+
+void journal_shutdown(void)
+{
+    if (!s_thread_up) return;
+
+    pthread_mutex_lock(&s_mutex);
+    s_stop = 1;
+    pthread_cond_signal(&s_wake);
+    pthread_mutex_unlock(&s_mutex);
+    pthread_join(s_thread, NULL);
+
+    pthread_mutex_lock(&s_mutex);
+    s_thread_up = 0;
+    size_t left = s_live;
+    map_free();
+    journal_free_entries(s_recovered, s_nrecovered);
+    s_recovered  = NULL;
+    s_nrecovered = 0;
+    free(s_buf);
+    s_buf = NULL;
+    s_buf_len = s_buf_cap = 0;
+    pthread_cond_broadcast(&s_durable_cond);
+    pthread_mutex_unlock(&s_mutex);
+
+    close(s_fd);
+    s_fd = -1;
+    log_info("Journal closed with %zu items outstanding.", left);
+}
@@ -1,6 +1,36 @@
 /*
  * logger.c — Dual-output logging: syslog + rotating log file.
  *
+ * Hot-path notes:
+ *   - The message body is formatted ONCE, outside the log mutex, and the
+ *     same buffer feeds both syslog and the file.
+ *   - The "YYYY-MM-DD HH:MM:SS" prefix is cached per wall-clock second, so
+ *     localtime_r() (which takes glibc's tz lock) and strftime() run at most
+ *     once a second instead of once per line.
+ *   - Rotation is driven by a running byte count of what we have written
+ *     rather than an fstat() per line.
+ *
+ * Rotation keeps N generations:
+ *
+ *     sentinel.log        live file
+ *     sentinel.log.0      just rotated, waiting for the compressor
+ *     sentinel.log.1.gz   newest archived generation
+ *     ...
+ *     sentinel.log.N.gz   oldest archived generation
+ *
+ * A caller that crosses the size or age threshold only renames the live
+ * file to ".0" and reopens — one rename under the mutex.  Shifting the
+ * older generations, gzip'ing ".0" and enforcing the total-bytes budget
+ * all happen on a background thread running at idle CPU and I/O priority.
+ * If gzip is unavailable the generation is kept uncompressed (".k").
+ *
+ * Overload protection:
+ *   - Consecutive identical lines are collapsed into a single
+ *     "Last message repeated N times" entry (classic syslogd behaviour).
+ *   - log_*_rl() call sites carry a token bucket; lines over budget are
+ *     only counted, never formatted or written, so a storm of identical
+ *     warnings cannot turn into a storm of disk I/O.
+ *
  * Part of the Sentinel Endpoint Security daemon.
  */
 
@@ -9,11 +39,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <syslog.h>
 #include <pthread.h>
+#include <signal.h>
+
+extern char **environ;
 
 /* ── Private state ──────────────────────────────────────────────────────── */
 
@@ -21,6 +62,53 @@ static FILE          *s_logfile    = NULL;
 static char           s_logpath[512];
 static pthread_mutex_t s_log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* Bytes written to the current log file (seeded from st_size on open). */
+static size_t         s_log_bytes  = 0;
+static time_t         s_opened_at  = 0;
+
+/* Rotation policy (protected by s_log_mutex). */
+static size_t         s_rot_max_bytes   = SENTINEL_LOG_MAX_SIZE;
+static unsigned       s_rot_max_age_s   = SENTINEL_LOG_MAX_AGE;
+static int            s_rot_generations = SENTINEL_LOG_GENERATIONS;
+static size_t         s_rot_retain      = SENTINEL_LOG_RETAIN_BYTES;
+
+/* Background compressor thread. */
+static pthread_t      s_rot_thread;
+static int            s_rot_thread_up  = 0;
+static pthread_cond_t s_rot_cond       = PTHREAD_COND_INITIALIZER;
+static int            s_rot_pending    = 0;   /* ".0" awaits archiving     */
+static int            s_rot_stop       = 0;
+
+/* Append a monotonic "+sec.usec" field to every file line when set. */
+static volatile int   s_monotonic  = 0;
+
+/*
+ * Per-second timestamp cache.  Both fields are only touched with
+ * s_log_mutex held, so a reader always sees a string that matches
+ * s_ts_sec — the refresh is atomic with respect to every line written.
+ */
+static time_t         s_ts_sec     = (time_t)-1;
+static char           s_ts_buf[32];
+
+/* Duplicate-line collapsing (protected by s_log_mutex). */
+static char           s_last_msg[SENTINEL_LOG_LINE_MAX];
+static log_level_t    s_last_level = LOG_LVL_INFO;
+static unsigned long  s_dup_count  = 0;
+
+/* Rate-limit policy and call-site registry (protected by s_rl_mutex). */
+typedef struct {
+    unsigned per_sec;
+    unsigned burst;
+} rl_policy_t;
+
+static rl_policy_t      s_rl_policy[LOG_LVL_COUNT] = {
+    [LOG_LVL_INFO]  = { SENTINEL_LOG_RL_PER_SEC, SENTINEL_LOG_RL_BURST },
+    [LOG_LVL_WARN]  = { SENTINEL_LOG_RL_PER_SEC, SENTINEL_LOG_RL_BURST },
+    [LOG_LVL_ERROR] = { SENTINEL_LOG_RL_PER_SEC, SENTINEL_LOG_RL_BURST },
+};
+static log_ratelimit_t *s_rl_sites = NULL;
+static pthread_mutex_t  s_rl_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /* ── Helpers ────────────────────────────────────────────────────────────── */
 
 static const char *level_str(log_level_t lvl)
@@ -43,23 +131,274 @@ static int level_to_syslog(log_level_t lvl)
     }
 }
 
-/* Rotate the log file if it exceeds the size limit. */
-static void maybe_rotate(void)
+/* Open (or reopen) the log file and seed the byte counter. */
+static void open_logfile(void)
+{
+    /* "e" → O_CLOEXEC, so gzip children never inherit the log fd. */
+    s_logfile   = fopen(s_logpath, "ae");
+    s_log_bytes = 0;
+    s_opened_at = time(NULL);
+
+    struct stat st;
+    if (s_logfile && fstat(fileno(s_logfile), &st) == 0)
+        s_log_bytes = (size_t)st.st_size;
+}
+
+/* Refresh the cached timestamp string if the second has rolled over.
+ * Caller must hold s_log_mutex. */
+static const char *cached_timestamp(time_t now)
+{
+    if (now != s_ts_sec) {
+        struct tm tm_buf;
+        localtime_r(&now, &tm_buf);
+        strftime(s_ts_buf, sizeof(s_ts_buf), "%Y-%m-%d %H:%M:%S", &tm_buf);
+        s_ts_sec = now;
+    }
+    return s_ts_buf;
+}
+
+static long long monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Path of generation `gen` (0 = pending, uncompressed). */
+static void gen_path(char *buf, size_t len, int gen, int gz)
+{
+    snprintf(buf, len, "%s.%d%s", s_logpath, gen, gz ? ".gz" : "");
+}
+
+/* Rotate the log file if it crossed the size or age threshold.
+ * Caller must hold s_log_mutex. */
+static void maybe_rotate(time_t now)
 {
     if (!s_logfile) return;
 
+    int by_size = s_log_bytes >= s_rot_max_bytes;
+    int by_age  = s_rot_max_age_s > 0 && s_log_bytes > 0 &&
+                  now - s_opened_at >= (time_t)s_rot_max_age_s;
+    if (!by_size && !by_age) return;
+
+    /* The compressor still owns ".0" — keep appending until it is done. */
+    if (s_rot_pending) return;
+
+    fclose(s_logfile);
+
+    char pending[528];
+    gen_path(pending, sizeof(pending), 0, 0);
+    rename(s_logpath, pending);                       /* best-effort */
+
+    open_logfile();
+
+    s_rot_pending = 1;
+    pthread_cond_signal(&s_rot_cond);
+}
+
+/*
+ * Run `gzip -f -q <path>`; returns 0 if <path>.gz was produced.
+ * This thread blocks the daemon's signals and it ignores SIGPIPE; gzip
+ * starts with an empty mask and default dispositions so it can be killed.
+ */
+static int gzip_file(const char *path)
+{
+    char *const argv[] = { "gzip", "-f", "-q", "--", (char *)path, NULL };
+    pid_t pid;
+
+    posix_spawnattr_t attr;
+    sigset_t          none, all;
+    sigemptyset(&none);
+    sigfillset(&all);
+    if (posix_spawnattr_init(&attr) != 0) return -1;
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setsigdefault(&attr, &all);
+    posix_spawnattr_setflags(&attr,
+                             POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    int rc = posix_spawnp(&pid, "gzip", NULL, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    if (rc != 0) return -1;
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+/* Size of generation `gen` (whichever variant exists), or -1 if absent. */
+static off_t gen_size(int gen, int *is_gz)
+{
+    char path[528];
     struct stat st;
-    if (fstat(fileno(s_logfile), &st) == 0 &&
-        st.st_size >= SENTINEL_LOG_MAX_SIZE) {
 
-        fclose(s_logfile);
+    gen_path(path, sizeof(path), gen, 1);
+    if (stat(path, &st) == 0) { *is_gz = 1; return st.st_size; }
+
+    gen_path(path, sizeof(path), gen, 0);
+    if (stat(path, &st) == 0) { *is_gz = 0; return st.st_size; }
+
+    return -1;
+}
+
+/*
+ * Archive ".0": shift every generation up by one, compress ".0" into
+ * ".1.gz" and trim the oldest generations until both the generation
+ * count and the total-bytes budget are met.  Runs on the compressor
+ * thread without s_log_mutex held.
+ */
+static void archive_pending(int generations, size_t retain)
+{
+    char from[528], to[528];
+    int  gz;
+
+    /* Drop whatever sits in the last slot, then shift k → k+1. */
+    for (int k = generations; k >= 1; k--) {
+        if (gen_size(k, &gz) < 0) continue;
+        gen_path(from, sizeof(from), k, gz);
+        if (k == generations) {
+            unlink(from);
+        } else {
+            gen_path(to, sizeof(to), k + 1, gz);
+            rename(from, to);
+        }
+    }
+
+    gen_path(from, sizeof(from), 0, 0);
+    if (gzip_file(from) == 0) {
+        gen_path(from, sizeof(from), 0, 1);
+        gen_path(to, sizeof(to), 1, 1);
+    } else {
+        gen_path(to, sizeof(to), 1, 0);
+    }
+    rename(from, to);
+
+    /* Enforce the total-bytes budget, oldest generation first. */
+    if (retain == 0) return;
+
+    size_t total = 0;
+    int    last  = 0;
+    for (int k = 1; k <= generations; k++) {
+        off_t sz = gen_size(k, &gz);
+        if (sz < 0) break;
+        total += (size_t)sz;
+        last   = k;
+    }
+    for (int k = last; k > 1 && total > retain; k--) {
+        off_t sz = gen_size(k, &gz);
+        if (sz < 0) continue;
+        gen_path(from, sizeof(from), k, gz);
+        if (unlink(from) == 0) total -= (size_t)sz;
+    }
+}
+
+static void *rotate_thread_main(void *arg)
+{
+    (void)arg;
+
+    /* Lowest CPU priority and idle I/O class for this thread only; the
+     * gzip children inherit both. */
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, (id_t)tid, 19);
+#ifdef SYS_ioprio_set
+    syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, tid,
+            3 << 13 /* IOPRIO_CLASS_IDLE */);
+#endif
+
+    pthread_mutex_lock(&s_log_mutex);
+    for (;;) {
+        while (!s_rot_pending && !s_rot_stop)
+            pthread_cond_wait(&s_rot_cond, &s_log_mutex);
+        /* On stop, a pending ".0" is left for the next start to archive
+         * rather than holding up shutdown behind gzip. */
+        if (!s_rot_pending || s_rot_stop) break;
+
+        int    gens   = s_rot_generations;
+        size_t retain = s_rot_retain;
+        pthread_mutex_unlock(&s_log_mutex);
+
+        archive_pending(gens, retain);
+
+        pthread_mutex_lock(&s_log_mutex);
+        s_rot_pending = 0;
+        if (s_rot_stop) break;
+    }
+    pthread_mutex_unlock(&s_log_mutex);
+    return NULL;
+}
+
+/* Write one already-formatted line to the file.  Caller holds s_log_mutex. */
+static void write_file_line(log_level_t level, const char *msg)
+{
+    struct timespec rt, mono = { 0, 0 };
+    clock_gettime(CLOCK_REALTIME_COARSE, &rt);
 
-        char backup[520];
-        snprintf(backup, sizeof(backup), "%s.1", s_logpath);
-        rename(s_logpath, backup);                    /* best-effort */
+    maybe_rotate(rt.tv_sec);
+    if (!s_logfile) return;
+
+    if (s_monotonic) clock_gettime(CLOCK_MONOTONIC, &mono);
+
+    const char *ts = cached_timestamp(rt.tv_sec);
+    int n;
+
+    if (s_monotonic) {
+        n = fprintf(s_logfile, "[%s] [+%lld.%06ld] [%5s] %s\n",
+                    ts, (long long)mono.tv_sec, mono.tv_nsec / 1000,
+                    level_str(level), msg);
+    } else {
+        n = fprintf(s_logfile, "[%s] [%5s] %s\n",
+                    ts, level_str(level), msg);
+    }
+    if (n > 0) s_log_bytes += (size_t)n;
+
+    fflush(s_logfile);
+}
+
+/* Emit the pending duplicate summary, if any.  Caller holds s_log_mutex.
+ * Returns the summary text in `out` (empty if nothing was pending). */
+static void take_dup_summary(char *out, size_t len)
+{
+    out[0] = '\0';
+    if (s_dup_count == 0) return;
+
+    snprintf(out, len, "Last message repeated %lu times", s_dup_count);
+    write_file_line(s_last_level, out);
+    s_dup_count = 0;
+}
+
+static void log_vwrite(log_level_t level, const char *fmt, va_list ap)
+{
+    /* ── Format the body once, outside any lock ─────────────────────── */
+    char msg[SENTINEL_LOG_LINE_MAX];
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+
+    char        summary[64];
+    log_level_t summary_level;
+
+    /* ── file log (and duplicate collapsing) ────────────────────────── */
+    pthread_mutex_lock(&s_log_mutex);
 
-        s_logfile = fopen(s_logpath, "a");
+    if (level == s_last_level && s_last_msg[0] != '\0' &&
+        strcmp(msg, s_last_msg) == 0) {
+        s_dup_count++;
+        pthread_mutex_unlock(&s_log_mutex);
+        return;
     }
+
+    summary_level = s_last_level;
+    take_dup_summary(summary, sizeof(summary));
+
+    snprintf(s_last_msg, sizeof(s_last_msg), "%s", msg);
+    s_last_level = level;
+    write_file_line(level, msg);
+
+    pthread_mutex_unlock(&s_log_mutex);
+
+    /* ── syslog (outside the file lock — it may block on journald) ─── */
+    if (summary[0] != '\0')
+        syslog(level_to_syslog(summary_level), "%s", summary);
+    syslog(level_to_syslog(level), "%s", msg);
 }
 
 /* ── Public API ─────────────────────────────────────────────────────────── */
@@ -71,18 +410,49 @@ int logger_init(const char *log_path)
 
     openlog("sentinel", LOG_PID | LOG_NDELAY, LOG_DAEMON);
 
-    s_logfile = fopen(s_logpath, "a");
+    open_logfile();
     if (!s_logfile) {
         syslog(LOG_ERR, "Failed to open log file: %s", s_logpath);
         /* Non-fatal — we still have syslog. */
     }
 
+    /* A ".0" left behind by an earlier run is archived straight away. */
+    char pending[528];
+    gen_path(pending, sizeof(pending), 0, 0);
+    s_rot_pending = access(pending, F_OK) == 0;
+    s_rot_stop    = 0;
+
+    if (pthread_create(&s_rot_thread, NULL, rotate_thread_main, NULL) == 0) {
+        s_rot_thread_up = 1;
+    } else {
+        syslog(LOG_WARNING, "Log compressor thread failed to start — "
+               "rotated logs will not be archived");
+    }
+
     syslog(LOG_INFO, "Sentinel logger initialised (file: %s)", s_logpath);
     return 0;
 }
 
+void logger_set_rotation(size_t max_bytes, unsigned max_age_s,
+                         int generations, size_t retain_bytes)
+{
+    pthread_mutex_lock(&s_log_mutex);
+    if (max_bytes   > 0) s_rot_max_bytes   = max_bytes;
+    s_rot_max_age_s = max_age_s;
+    if (generations > 0) s_rot_generations = generations;
+    s_rot_retain    = retain_bytes;
+    pthread_mutex_unlock(&s_log_mutex);
+}
+
+void logger_set_monotonic(int enable)
+{
+    s_monotonic = enable ? 1 : 0;
+}
+
 void logger_shutdown(void)
 {
+    logger_flush_suppressed();
+
     pthread_mutex_lock(&s_log_mutex);
 
     if (s_logfile) {
@@ -90,39 +460,181 @@ void logger_shutdown(void)
         s_logfile = NULL;
     }
 
+    /* Let an in-progress archive finish; a pending one waits for next start. */
+    s_rot_stop = 1;
+    pthread_cond_signal(&s_rot_cond);
     pthread_mutex_unlock(&s_log_mutex);
+
+    if (s_rot_thread_up) {
+        pthread_join(s_rot_thread, NULL);
+        s_rot_thread_up = 0;
+    }
+
     closelog();
 }
 
 void logger_log(log_level_t level, const char *fmt, ...)
 {
     va_list ap;
-
-    /* ── syslog ─────────────────────────────────────────────────────── */
     va_start(ap, fmt);
-    vsyslog(level_to_syslog(level), fmt, ap);
+    log_vwrite(level, fmt, ap);
     va_end(ap);
+}
 
-    /* ── file log ───────────────────────────────────────────────────── */
-    pthread_mutex_lock(&s_log_mutex);
-    maybe_rotate();
+void logger_set_rate_limit(log_level_t level, unsigned per_sec, unsigned burst)
+{
+    if ((unsigned)level >= LOG_LVL_COUNT) return;
 
-    if (s_logfile) {
-        time_t     now = time(NULL);
-        struct tm  tm_buf;
-        char       timebuf[32];
-        localtime_r(&now, &tm_buf);
-        strftime(timebuf, sizeof(timebuf), "%Y-%m-%d %H:%M:%S", &tm_buf);
+    pthread_mutex_lock(&s_rl_mutex);
+    s_rl_policy[level].per_sec = per_sec;
+    s_rl_policy[level].burst   = burst ? burst : 1;
+    pthread_mutex_unlock(&s_rl_mutex);
+}
+
+int logger_set_rate_limits(const char *spec)
+{
+    static const char *const names[LOG_LVL_COUNT] = { "info", "warn", "error" };
+    rl_policy_t pol[LOG_LVL_COUNT];
+    char        buf[256];
+
+    if (!spec || strlen(spec) >= sizeof(buf)) return -1;
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    pthread_mutex_lock(&s_rl_mutex);
+    memcpy(pol, s_rl_policy, sizeof(pol));
+    pthread_mutex_unlock(&s_rl_mutex);
+
+    char *save = NULL;
+    for (char *t = strtok_r(buf, ",", &save); t;
+         t = strtok_r(NULL, ",", &save)) {
+        int   lvl = -1;                              /* -1: every level */
+        char *eq  = strchr(t, '=');
+        if (eq) {
+            *eq = '\0';
+            for (int i = 0; i < LOG_LVL_COUNT; i++)
+                if (strcmp(t, names[i]) == 0) lvl = i;
+            if (lvl < 0) return -1;
+            t = eq + 1;
+        }
+
+        char         *end;
+        unsigned long per_sec = strtoul(t, &end, 10);
+        unsigned long burst   = per_sec * 2;
+        if (end == t) return -1;
+        if (*end == ':') {
+            char *b = end + 1;
+            burst = strtoul(b, &end, 10);
+            if (end == b) return -1;
+        }
+        if (*end != '\0' || per_sec > UINT32_MAX / 2 || burst > UINT32_MAX)
+            return -1;
+
+        for (int i = 0; i < LOG_LVL_COUNT; i++) {
+            if (lvl >= 0 && i != lvl) continue;
+            pol[i].per_sec = (unsigned)per_sec;
+            pol[i].burst   = burst ? (unsigned)burst : 1;
+        }
+    }
 
-        fprintf(s_logfile, "[%s] [%5s] ", timebuf, level_str(level));
+    pthread_mutex_lock(&s_rl_mutex);
+    memcpy(s_rl_policy, pol, sizeof(pol));
+    pthread_mutex_unlock(&s_rl_mutex);
+    return 0;
+}
+
+void logger_log_ratelimited(log_ratelimit_t *rl, log_level_t level,
+                            const char *fmt, ...)
+{
+    va_list ap;
 
+    if (!rl || (unsigned)level >= LOG_LVL_COUNT) {
         va_start(ap, fmt);
-        vfprintf(s_logfile, fmt, ap);
+        log_vwrite(level, fmt, ap);
         va_end(ap);
+        return;
+    }
+
+    long long     now = monotonic_ns();
+    unsigned long repeated;
+
+    pthread_mutex_lock(&s_rl_mutex);
+
+    rl_policy_t pol = s_rl_policy[level];
 
-        fputc('\n', s_logfile);
-        fflush(s_logfile);
+    if (!rl->registered) {
+        rl->fmt        = fmt;
+        rl->level      = level;
+        rl->tokens     = (double)pol.burst;
+        rl->last_ns    = now;
+        rl->registered = 1;
+        rl->next       = s_rl_sites;
+        s_rl_sites     = rl;
     }
 
+    if (pol.per_sec > 0) {
+        /* Refill the bucket for the time elapsed since the last call. */
+        rl->tokens += (double)(now - rl->last_ns) * pol.per_sec / 1e9;
+        if (rl->tokens > (double)pol.burst) rl->tokens = (double)pol.burst;
+        rl->last_ns = now;
+
+        if (rl->tokens < 1.0) {
+            rl->suppressed++;
+            pthread_mutex_unlock(&s_rl_mutex);
+            return;                  /* Over budget: count, don't format. */
+        }
+        rl->tokens -= 1.0;
+    }
+
+    repeated       = rl->suppressed;
+    rl->suppressed = 0;
+
+    pthread_mutex_unlock(&s_rl_mutex);
+
+    if (repeated > 0) {
+        logger_log(level, "Message repeated %lu times (rate-limited): %s",
+                   repeated, fmt);
+    }
+
+    va_start(ap, fmt);
+    log_vwrite(level, fmt, ap);
+    va_end(ap);
+}
+
+void logger_flush_suppressed(void)
+{
+    /* Rate-limited call sites first. */
+    for (;;) {
+        const char   *fmt = NULL;
+        log_level_t   lvl = LOG_LVL_INFO;
+        unsigned long n   = 0;
+
+        pthread_mutex_lock(&s_rl_mutex);
+        for (log_ratelimit_t *rl = s_rl_sites; rl; rl = rl->next) {
+            if (rl->suppressed > 0) {
+                fmt = rl->fmt;
+                lvl = rl->level;
+                n   = rl->suppressed;
+                rl->suppressed = 0;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&s_rl_mutex);
+
+        if (!fmt) break;
+        logger_log(lvl, "Message repeated %lu times (rate-limited): %s",
+                   n, fmt);
+    }
+
+    /* Then any pending duplicate-line summary. */
+    char        summary[64];
+    log_level_t summary_level;
+
+    pthread_mutex_lock(&s_log_mutex);
+    summary_level = s_last_level;
+    take_dup_summary(summary, sizeof(summary));
+    s_last_msg[0] = '\0';
     pthread_mutex_unlock(&s_log_mutex);
+
+    if (summary[0] != '\0')
+        syslog(level_to_syslog(summary_level), "%s", summary);
 }
@@ -9,6 +9,15 @@
  *   Fix 4: State sync — on GUI connect ("sync_state"), the daemon reads
  *          the quarantine manifest and sends the full list to that client.
  *
+ * Event loop: one reactor thread (epoll) owns the inotify fd, the IPC
+ * sockets, timers and signals (signalfd).  Worker threads only scan.
+ * When the scan queue is full the inotify fd is paused and retried from
+ * a short timer, so backpressure never blocks the loop.
+ *
+ * Live upgrade: SIGHUP (systemctl reload) starts the installed binary
+ * with --takeover; it takes the sockets, inotify fd and scan queue over
+ * from this process, which then exits (see handover.h).
+ *
  * Part of the Sentinel Endpoint Security daemon.
  */
 
@@ -18,43 +27,186 @@
 #include "quarantine.h"
 #include "alert.h"
 #include "threadpool.h"
+#include "flightrec.h"
+#include "reactor.h"
+#include "metrics.h"
+#include "trace.h"
+#include "perfstats.h"
+#include "scanprof.h"
+#include "evtrace.h"
+#include "replay.h"
+#include "handover.h"
+#include "journal.h"
+#include "catchup.h"
+#include "fsindex.h"
+#include "fullscan.h"
+#include "ondemand.h"
+#include "risk.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <limits.h>
 #include <signal.h>
+#include <time.h>
 #include <unistd.h>
-#include <pthread.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <errno.h>
+#include <getopt.h>
 #include <json-c/json.h>
 
 /* ── Globals ────────────────────────────────────────────────────────────── */
 
-static volatile int      g_running = 1;
+static reactor_t        *g_reactor = NULL;
 static monitor_ctx_t    *g_monitor = NULL;
 static threadpool_t     *g_pool    = NULL;
 
+/* One-shot timer that resumes inotify reads after queue-full pushback. */
+static int               g_inotify_retry_timer = -1;
+
+/*
+ * Wall-clock time (ns) up to which every file event has been read and
+ * queued: the last time the inotify queue was drained.  Becomes the
+ * catch-up stamp (see catchup.h).
+ */
+static uint64_t          g_caught_up_ns  = 0;
+
+/* Work left over from the previous run (journal), re-queued by a timer. */
+static journal_entry_t  *g_recovered      = NULL;
+static size_t            g_recovered_n    = 0;
+static size_t            g_recovered_pos  = 0;
+static size_t            g_recovered_gone = 0;
+static int               g_recover_timer  = -1;
+
+/* Metric IDs (see register_metrics()). */
+static int               g_m_clean      = -1;
+static int               g_m_infected   = -1;
+static int               g_m_error      = -1;
+static int               g_m_offline    = -1;
+static int               g_m_pushback   = -1;
+static int               g_m_packed     = -1;
+
 /*
  * Protection toggle: when 0, on_file_event() returns immediately so no new
  * files are enqueued for scanning.  The daemon, IPC socket, and quarantine
  * vault remain fully operational — the user can still manage quarantined
  * files while monitoring is paused.
  *
- * Written only from the IPC command handler thread (serialised by the alert
- * server lock) and read from the inotify monitor thread, so volatile is
- * sufficient on x86/ARM with their TSO/weakly-ordered memory models given
- * the single-writer pattern.  A full atomic would also work here.
+ * Written by the IPC command handler and read by on_file_event(); both
+ * run on the reactor thread, so volatile is more than sufficient.
  */
 static volatile int      g_monitoring_enabled = 1;
 
-/* Directories to watch (NULL-terminated). */
+/*
+ * Live upgrade state.  g_takeover holds the predecessor's state from
+ * handover_request() until handover_commit(); g_handed_over is set once
+ * a successor owns our sockets.  In both cases the socket paths are not
+ * ours to unlink (see stop_ipc()).
+ */
+static handover_msg_t    g_takeover;
+static int               g_takeover_pending = 0;
+static int               g_handed_over      = 0;
+
+/* SIGHUP: binary and argv to start the successor with, resolved at start. */
+static char              g_self_exe[PATH_MAX];
+static char            **g_successor_argv = NULL;
+static int               g_successor_argc = 0;   /* Before --engines  */
+static pid_t             g_successor_pid  = 0;
+
+/* Default directories to watch (NULL-terminated). */
 static const char *WATCH_DIRS[] = { "/home", "/tmp", NULL };
 
 /* Thread pool sizing */
 #define WORKER_THREADS   4
 #define QUEUE_CAPACITY 256
 
+/* Most --watch options accepted. */
+#define MAX_WATCH_DIRS  32
+
+/*
+ * Command-line overrides (see usage()).  NULL paths mean the owning
+ * module's default, so a bare `sentinel-daemon` behaves as before.
+ */
+typedef struct {
+    const char *watch[MAX_WATCH_DIRS + 1];   /* NULL-terminated      */
+    int         nwatch;
+    const char *clamd_socket;
+    const char *engines;                     /* Scan engine chain     */
+    const char *ipc_socket;
+    const char *metrics_socket;
+    const char *log_file;
+    const char *quarantine_dir;
+    int         workers;
+    int         queue;
+    const char *record;                      /* Event trace to write */
+    const char *replay;                      /* Event trace to feed  */
+    const char *replay_root;
+    double      replay_speed;
+    int         replay_exit;
+    int         takeover;                    /* Live upgrade          */
+    const char *handover_socket;
+    const char *journal;
+    int         no_journal;
+    const char *catchup_stamp;               /* Downtime catch-up     */
+    int         no_catchup;
+    int         catchup_prune;
+    const char *index;                       /* Full scans            */
+    int         fullscan_interval;
+    int         fullscan_io;
+    int         fullscan_cpu;
+} options_t;
+
+static options_t g_opts = {
+    .workers      = WORKER_THREADS,
+    .queue        = QUEUE_CAPACITY,
+    .replay_speed = 1.0,
+    .fullscan_interval = FULLSCAN_INTERVAL_H,
+    .fullscan_io       = FULLSCAN_IO_MBPS,
+    .fullscan_cpu      = FULLSCAN_CPU_PCT,
+};
+
+/* With --replay-exit: poll for an idle pool once the trace has ended. */
+#define REPLAY_IDLE_POLL_MS 200
+
+/* Delay before re-reading inotify after the queue pushed back. */
+#define INOTIFY_RETRY_MS   10
+
+/* Poll interval while waiting for in-flight scans before a handover. */
+#define HANDOVER_DRAIN_POLL_MS 5
+
+/*
+ * Startup phases, timed back to back from the start of main() and
+ * exported as sentinel_startup_seconds{phase=…}.  Files are unprotected
+ * until PHASE_WATCHES ends, so this is the number to watch on big hosts.
+ */
+typedef enum {
+    PHASE_LOGGER,
+    PHASE_TAKEOVER,         /* --takeover: predecessor drains and freezes */
+    PHASE_QUARANTINE,       /* Manifest load                              */
+    PHASE_JOURNAL,          /* Pending-work journal replay + compaction   */
+    PHASE_INDEX,            /* File-state index load                      */
+    PHASE_SCANNER,          /* clamd ping                                 */
+    PHASE_POOL,
+    PHASE_IPC,              /* GUI + metrics sockets, event loop          */
+    PHASE_WATCHES,          /* Recursive inotify walk                     */
+    PHASE_TOTAL,            /* main() to entering the event loop          */
+    PHASE_COUNT
+} startup_phase_t;
+
+static const char *const PHASE_NAMES[PHASE_COUNT] = {
+    "logger", "takeover", "quarantine", "journal", "index", "scanner", "pool",
+    "ipc", "watches", "total",
+};
+
+static uint64_t g_phase_ns[PHASE_COUNT];
+static uint64_t g_start_ns       = 0;
+static uint64_t g_phase_start_ns = 0;
+
+/* Housekeeping tick (flushes rate-limited log summaries). */
+#define HOUSEKEEPING_MS 60000
+
 /* ── Fail-safe scan configuration ───────────────────────────────────────── */
 
 /*
@@ -68,25 +220,94 @@ static const char *WATCH_DIRS[] = { "/home", "/tmp", NULL };
 
 /* ── Signal handling ────────────────────────────────────────────────────── */
 
-static void signal_handler(int sig)
+/* Signals consumed through the reactor's signalfd (0-terminated). */
+static const int REACTOR_SIGNALS[] = {
+    SIGTERM, SIGINT, SIGHUP, SIGUSR1, SIGUSR2, 0
+};
+
+/*
+ * Start the installed binary with --takeover.  It connects back over the
+ * handover socket; this process exits once the successor has committed.
+ * Returns 0 once the successor is started, -1 if it could not be.
+ */
+static int spawn_successor(void)
+{
+    if (g_successor_pid > 0) {
+        log_warn("Upgrade already in progress (pid %d) — SIGHUP ignored.",
+                 (int)g_successor_pid);
+        return -1;
+    }
+    if (!g_successor_argv || !g_self_exe[0]) {
+        log_error("Cannot upgrade: own executable path is unknown.");
+        return -1;
+    }
+
+    /* The successor keeps a chain changed over IPC. */
+    static char engines[SCANNER_SPEC_MAX];
+    scanner_engines_spec(engines, sizeof(engines));
+    g_successor_argv[g_successor_argc]     = "--engines";
+    g_successor_argv[g_successor_argc + 1] = engines;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        log_error("Cannot upgrade: fork(): %s", strerror(errno));
+        return -1;
+    }
+    if (pid == 0) {
+        /* The successor sets up its own signal routing. */
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        execv(g_self_exe, g_successor_argv);
+        _exit(127);
+    }
+
+    g_successor_pid = pid;
+    log_info("SIGHUP: started %s (pid %d) to take over.", g_self_exe, (int)pid);
+    return 0;
+}
+
+/* Reap a successor that failed (one that took over outlives us). */
+static void reap_successor(void)
 {
-    (void)sig;
-    g_running = 0;
-    if (g_monitor) monitor_stop(g_monitor);
+    int status;
+    if (g_successor_pid <= 0 ||
+        waitpid(g_successor_pid, &status, WNOHANG) != g_successor_pid)
+        return;
+
+    if (WIFEXITED(status))
+        log_warn("Upgrade failed: successor pid %d exited with status %d.",
+                 (int)g_successor_pid, WEXITSTATUS(status));
+    else
+        log_warn("Upgrade failed: successor pid %d killed by signal %d.",
+                 (int)g_successor_pid, WTERMSIG(status));
+    g_successor_pid = 0;
 }
 
-static void install_signal_handlers(void)
+static void on_signal(int signo, void *arg)
 {
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = signal_handler;
-    sigemptyset(&sa.sa_mask);
+    (void)arg;
 
-    sigaction(SIGTERM, &sa, NULL);
-    sigaction(SIGINT,  &sa, NULL);
+    if (signo == SIGHUP) {
+        spawn_successor();
+        return;
+    }
 
-    /* Ignore SIGPIPE (broken socket writes). */
-    signal(SIGPIPE, SIG_IGN);
+    if (signo == SIGUSR1) {
+        scanprof_dump_csv(NULL);
+        return;
+    }
+
+    if (signo == SIGUSR2) {
+        if (fr_dump(FR_DUMP_PATH) == 0)
+            log_info("Flight recorder dumped to %s", FR_DUMP_PATH);
+        else
+            log_error("Flight recorder dump to %s failed", FR_DUMP_PATH);
+        return;
+    }
+
+    log_info("Received signal %d — stopping event loop.", signo);
+    reactor_stop(g_reactor);
 }
 
 /* ── Scan worker function (runs in thread pool) ─────────────────────────── */
@@ -107,20 +328,29 @@ static void install_signal_handlers(void)
  *      "fail-open" flaw where malware could execute while the scanner
  *      was down.
  *
- * IMPORTANT: This function takes ownership of `filepath` and MUST free() it.
+ * The job (and its path) belongs to the pool and is freed on return.
  */
-static void scan_worker(char *filepath, void *user_data)
+static void scan_worker(scan_job_t *job, void *user_data)
 {
     (void)user_data;
 
+    const char *filepath = job->path;
+
+    /* On-demand scan cancelled while this job waited in the lane. */
+    if (job->tag && ondemand_cancelled(job->tag)) {
+        ondemand_file_done(job->tag, ONDEMAND_SKIPPED, 0);
+        return;
+    }
     log_info("[worker] Scanning: %s", filepath);
 
     /* ── Step 1: Save original permissions ──────────────────────────── */
     struct stat orig_st;
     mode_t orig_mode = 0644;   /* Sane fallback if stat fails. */
-    if (stat(filepath, &orig_st) == 0) {
+    int    have_st   = stat(filepath, &orig_st) == 0;
+    if (have_st) {
         orig_mode = orig_st.st_mode;
     }
+    int64_t size = have_st ? (int64_t)orig_st.st_size : 0;
 
     /* ── Step 2: Strip execute permission (fail-closed posture) ─────── */
     /*
@@ -154,23 +384,26 @@ static void scan_worker(char *filepath, void *user_data)
             if (stat(filepath, &retry_st) != 0) {
                 log_info("[worker] File vanished before retry: %s — skipping",
                          filepath);
-                free(filepath);
+                ondemand_file_done(job->tag, ONDEMAND_GONE, 0);
+                trace_stamp(&job->trace, TRACE_TS_DONE);
+                trace_finish(&job->trace, filepath, TRACE_OUT_VANISHED);
                 return;
             }
 
-            log_warn("[worker] Retry %d/%d for %s — waiting %ds ...",
-                     attempts, SCAN_MAX_RETRIES, filepath, SCAN_RETRY_DELAY_S);
+            log_warn_rl("[worker] Retry %d/%d for %s — waiting %ds ...",
+                        attempts, SCAN_MAX_RETRIES, filepath, SCAN_RETRY_DELAY_S);
             alert_broadcast(ALERT_TYPE_STATUS, filepath, NULL,
                             "Scanner offline — retrying...");
             sleep(SCAN_RETRY_DELAY_S);
         }
 
-        if (scanner_scan_file(filepath, &report) == 0) {
+        if (scanner_scan_file(filepath, job->triage == JOB_TRIAGE_DONE
+                                        ? &job->risk : NULL, &report) == 0) {
             scan_ok = 1;
             break;
         }
-        log_error("[worker] Scanner communication error (attempt %d) for: %s",
-                  attempts + 1, filepath);
+        log_error_rl("[worker] Scanner communication error (attempt %d) "
+                     "for: %s", attempts + 1, filepath);
     }
 
     /* ── Step 4: Handle the result ──────────────────────────────────── */
@@ -185,6 +418,7 @@ static void scan_worker(char *filepath, void *user_data)
          */
         log_error("[worker] LOCKDOWN: Scanner offline after %d retries — "
                   "locking file: %s", SCAN_MAX_RETRIES, filepath);
+        fr_record(FR_EV_VERDICT, filepath, FR_VERDICT_OFFLINE);
 
         if (chmod(filepath, 0000) != 0) {
             log_error("[worker] CRITICAL: chmod 0000 failed for %s: %s",
@@ -193,30 +427,61 @@ static void scan_worker(char *filepath, void *user_data)
 
         alert_broadcast(ALERT_TYPE_STATUS, filepath, NULL,
                         "Scanner offline. File locked down (chmod 0000).");
-        free(filepath);
+        metrics_inc(g_m_offline);
+        ondemand_file_done(job->tag, ONDEMAND_ERROR, size);
+        trace_stamp(&job->trace, TRACE_TS_DONE);
+        trace_finish(&job->trace, filepath, TRACE_OUT_OFFLINE);
         return;
     }
 
+    job->trace.ts[TRACE_TS_CONNECTED] = report.t_connected;
+    job->trace.ts[TRACE_TS_STREAMED]  = report.t_streamed;
+    job->trace.ts[TRACE_TS_VERDICT]   = report.t_verdict;
+    scanprof_record(filepath, &report);
+
+    /* Packed executables are flagged in the alert, whatever the verdict. */
+    char risky[128] = "";
+    if (report.risk.flags & RISK_F_PACKED) {
+        char desc[96];
+        snprintf(risky, sizeof(risky), " (%s)",
+                 risk_describe(&report.risk, desc, sizeof(desc)));
+        metrics_inc(g_m_packed);
+    }
+    char details[192];
+
+    fr_record(FR_EV_VERDICT, filepath, (uint64_t)report.result);
+
     switch (report.result) {
 
     case SCAN_RESULT_CLEAN:
-        log_info("[worker] File clean: %s", filepath);
-        alert_broadcast(ALERT_TYPE_SCAN_CLEAN, filepath, NULL, "File is clean");
+        log_info("[worker] File clean: %s (%s)%s", filepath, report.engine,
+                 risky);
+        metrics_inc(g_m_clean);
+        snprintf(details, sizeof(details), "File is clean%s", risky);
+        alert_broadcast(ALERT_TYPE_SCAN_CLEAN, filepath, NULL, details);
 
         /* Restore original permissions — the file is safe. */
         if (chmod(filepath, orig_mode) != 0) {
             log_warn("[worker] Failed to restore permissions on %s: %s",
                      filepath, strerror(errno));
         }
+
+        /* Full scans skip it until it changes or signatures update. */
+        if (have_st)
+            fsindex_record_clean(filepath, &orig_st, fullscan_sigver());
+        ondemand_file_done(job->tag, ONDEMAND_CLEAN, size);
         break;
 
     case SCAN_RESULT_INFECTED:
-        log_warn("[worker] THREAT in %s: %s", filepath, report.threat_name);
+        log_warn("[worker] THREAT in %s: %s%s", filepath, report.threat_name,
+                 risky);
+        metrics_inc(g_m_infected);
 
         /* Quarantine the file. */
         if (quarantine_file(filepath, report.threat_name) == 0) {
+            snprintf(details, sizeof(details), "File quarantined%s", risky);
             alert_broadcast(ALERT_TYPE_SCAN_THREAT, filepath,
-                            report.threat_name, "File quarantined");
+                            report.threat_name, details);
         } else {
             /* Quarantine failed — lock the file down as a last resort. */
             log_error("[worker] Quarantine failed for %s — applying lockdown",
@@ -226,6 +491,7 @@ static void scan_worker(char *filepath, void *user_data)
                             report.threat_name,
                             "CRITICAL: quarantine failed — file locked!");
         }
+        ondemand_file_done(job->tag, ONDEMAND_INFECTED, size);
         break;
 
     case SCAN_RESULT_ERROR:
@@ -234,37 +500,35 @@ static void scan_worker(char *filepath, void *user_data)
          * not be read by clamd).  Same fail-safe: lock it down.
          */
         log_error("[worker] Scan error for %s — applying lockdown", filepath);
+        metrics_inc(g_m_error);
         chmod(filepath, 0000);
         alert_broadcast(ALERT_TYPE_STATUS, filepath, NULL,
                         "Scan error — file locked down.");
+        ondemand_file_done(job->tag, ONDEMAND_ERROR, size);
         break;
     }
 
-    free(filepath);  /* Worker owns the strdup'd path. */
+    trace_stamp(&job->trace, TRACE_TS_DONE);
+    trace_finish(&job->trace, filepath, TRACE_OUT_VERDICT);
 }
 
 /* ── File-event callback (inotify → thread pool) ───────────────────────── */
 
-/**
- * Called by the monitor thread whenever a file event is detected.
- * This is now LIGHTWEIGHT: it just filters and enqueues.
- * The actual scanning happens asynchronously in the thread pool.
+/*
+ * Whether a regular file of `size` bytes at `filepath` is worth a scan.
+ * Shared by live events and the catch-up sweep (any thread).
  */
-static void on_file_event(const char *filepath, void *user_data)
+static int scan_wanted(const char *filepath, int64_t size)
 {
-    (void)user_data;
-
-    /* Bail out immediately if the user has paused protection. */
-    if (!g_monitoring_enabled) return;
-
     /* Skip the quarantine directory itself. */
-    if (strncmp(filepath, QUARANTINE_DIR, strlen(QUARANTINE_DIR)) == 0)
-        return;
+    const char *qdir = quarantine_get_dir();
+    if (strncmp(filepath, qdir, strlen(qdir)) == 0)
+        return 0;
 
     /* Skip manifest and log files. */
     const char *base = strrchr(filepath, '/');
     base = base ? base + 1 : filepath;
-    if (base[0] == '.') return;
+    if (base[0] == '.') return 0;
 
     /*
      * Skip transient temporary files that appear and vanish instantly.
@@ -281,24 +545,516 @@ static void on_file_event(const char *filepath, void *user_data)
         strstr(filepath, "chromecrx_") != NULL ||
         strstr(filepath, ".org.chromium.") != NULL ||
         strstr(filepath, ".goutputstream") != NULL) {
+        return 0;
+    }
+
+    /* Skip very small files (< 4 bytes) and very large files (> 100 MB). */
+    return size >= 4 && size <= 100 * 1024 * 1024;
+}
+
+/**
+ * Called on the reactor thread whenever a file event is detected.
+ * This is LIGHTWEIGHT: it just filters and enqueues.
+ * The actual scanning happens asynchronously in the thread pool.
+ * Returns MONITOR_CB_BUSY when the queue is full so the event is kept.
+ */
+static int on_file_event(const monitor_event_t *ev, void *user_data)
+{
+    (void)user_data;
+
+    const char *filepath = ev->path;
+
+    /* Bail out immediately if the user has paused protection. */
+    if (!g_monitoring_enabled) return MONITOR_CB_OK;
+
+    /*
+     * The monitor has just stat()ed the path and confirmed it is a
+     * regular file, so its size is reused here.
+     */
+    if (!scan_wanted(filepath, ev->size))
+        return MONITOR_CB_OK;
+
+    trace_t trace;
+    trace_begin(&trace, ev->ts_ns);
+    trace_stamp(&trace, TRACE_TS_FILTERED);
+
+    /* Enqueue for async scanning — the pool copies the path. */
+    if (threadpool_try_submit(g_pool, filepath, &trace) == 1) {
+        log_warn_rl("Scan queue full (%d) — pausing inotify reads",
+                    g_opts.queue);
+        metrics_inc(g_m_pushback);
+        return MONITOR_CB_BUSY;
+    }
+    return MONITOR_CB_OK;
+}
+
+/* ── Full-scan callbacks (sweep thread) ─────────────────────────────────── */
+
+static int sweep_wanted(const char *filepath, int64_t size)
+{
+    return g_monitoring_enabled && scan_wanted(filepath, size);
+}
+
+/* Run the worker pipeline inline: the sweep paces its own scans. */
+static void sweep_scan(const char *filepath, void *arg)
+{
+    (void)arg;
+
+    size_t len = strlen(filepath);
+    scan_job_t *job = malloc(sizeof(*job) + len + 1);
+    if (!job) return;
+    trace_begin(&job->trace, metrics_now_ns());
+    job->jid    = 0;
+    job->seq    = 0;
+    job->tag    = 0;
+    job->triage = JOB_TRIAGE_SKIP;       /* The scanner scores it itself */
+    memset(&job->risk, 0, sizeof(job->risk));
+    memcpy(job->path, filepath, len + 1);
+
+    scan_worker(job, NULL);
+    free(job);
+}
+
+/* ── Reactor callbacks ──────────────────────────────────────────────────── */
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Drain inotify.  On pushback, stop polling the fd (the kernel keeps
+ * queueing events) and retry from a one-shot timer instead.
+ */
+static void pump_inotify(void)
+{
+    int      fd  = monitor_get_fd(g_monitor);
+    uint64_t now = wall_ns();
+    int      rc  = monitor_process_events(g_monitor);
+
+    if (rc == 0) g_caught_up_ns = now;
+    if (rc == MONITOR_BUSY) {
+        reactor_mod_fd(g_reactor, fd, 0);
+        reactor_arm_timer(g_reactor, g_inotify_retry_timer,
+                          INOTIFY_RETRY_MS, 0);
+    } else {
+        reactor_mod_fd(g_reactor, fd, EPOLLIN);
+    }
+}
+
+static void on_inotify_ready(int fd, uint32_t events, void *arg)
+{
+    (void)fd;
+    (void)events;
+    (void)arg;
+    pump_inotify();
+}
+
+static void on_inotify_retry(void *arg)
+{
+    (void)arg;
+    pump_inotify();
+}
+
+/*
+ * Re-queue leftover work at the front of the queue as room appears.  Each
+ * batch is pushed newest first, so it comes out oldest first.  Paths that
+ * are gone (or no longer regular files) are simply marked done.
+ */
+static void on_recover_tick(void *arg)
+{
+    (void)arg;
+
+    threadpool_stats_t st;
+    threadpool_get_stats(g_pool, &st);
+    size_t room = st.capacity > st.depth ? (size_t)(st.capacity - st.depth) : 0;
+    size_t end  = g_recovered_pos + room;
+    if (end > g_recovered_n) end = g_recovered_n;
+
+    for (size_t i = end; i-- > g_recovered_pos;) {
+        journal_entry_t *e = &g_recovered[i];
+        struct stat fst;
+        if (stat(e->path, &fst) != 0 || !S_ISREG(fst.st_mode)) {
+            journal_done(e->id);
+            g_recovered_gone++;
+        } else {
+            /* On failure it stays outstanding for the next start. */
+            threadpool_try_requeue(g_pool, e->path, e->id);
+        }
+    }
+    g_recovered_pos = end;
+
+    if (g_recovered_pos < g_recovered_n) {
+        reactor_arm_timer(g_reactor, g_recover_timer, INOTIFY_RETRY_MS, 0);
         return;
     }
+    log_info("Re-queued %zu scans left over from the previous run "
+             "(%zu files gone meanwhile).",
+             g_recovered_n - g_recovered_gone, g_recovered_gone);
+    journal_free_entries(g_recovered, g_recovered_n);
+    g_recovered   = NULL;
+    g_recovered_n = g_recovered_pos = 0;
+}
+
+static void on_housekeeping(void *arg)
+{
+    (void)arg;
+    logger_flush_suppressed();
+    evtrace_flush();
+    reap_successor();
+
+    /* Queued work is journaled, so what inotify delivered is safe. */
+    if (journal_active() && !g_handed_over)
+        catchup_checkpoint(g_caught_up_ns, 0);
+}
+
+static void on_ondemand_tick(void *arg)
+{
+    (void)arg;
+    ondemand_tick();
+}
+
+static void on_fullscan_tick(void *arg)
+{
+    (void)arg;
+    fullscan_tick();
+}
+
+static void on_replay_idle_poll(void *arg)
+{
+    (void)arg;
+    threadpool_stats_t st;
+    threadpool_get_stats(g_pool, &st);
+    if (st.depth == 0 && st.active == 0) {
+        log_info("Replay drained — stopping event loop.");
+        reactor_stop(g_reactor);
+    }
+}
+
+static void on_replay_done(void *arg)
+{
+    (void)arg;
+    alert_broadcast(ALERT_TYPE_STATUS, "sentinel", NULL, "Replay complete");
+    if (g_opts.replay_exit)
+        reactor_add_timer(g_reactor, REPLAY_IDLE_POLL_MS, REPLAY_IDLE_POLL_MS,
+                          on_replay_idle_poll, NULL);
+}
+
+/* ── Live upgrade (see handover.h) ──────────────────────────────────────── */
+
+static void put_queued(const scan_job_t *job, void *arg)
+{
+    handover_put_u64(arg, job->jid);
+    handover_put_str(arg, job->path);
+}
+
+/*
+ * Freeze and describe this daemon for a successor.  Runs on the reactor
+ * thread, so inotify and IPC are already stopped for its duration; the
+ * workers are paused and in-flight scans finished, so neither the queue
+ * nor the quarantine manifest changes under the successor.
+ */
+static int export_state(handover_msg_t *msg, void *arg)
+{
+    (void)arg;
+
+    /* The sweep is another producer: stop it (the successor redoes it). */
+    catchup_stop();
+    fullscan_stop();
+    ondemand_stop_all("upgrade");
+    threadpool_pause(g_pool, 1);
+
+    threadpool_stats_t st;
+    uint64_t deadline = metrics_now_ns() + HANDOVER_DRAIN_MS * 1000000ull;
+    for (;;) {
+        threadpool_get_stats(g_pool, &st);
+        if (st.active == 0) break;
+        if (metrics_now_ns() > deadline) {
+            log_warn("Handover: %d scans still running after %d ms.",
+                     st.active, HANDOVER_DRAIN_MS);
+            return -1;
+        }
+        struct timespec ts = { 0, HANDOVER_DRAIN_POLL_MS * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+
+    /* The successor reads the journal next: make our DONEs durable. */
+    journal_sync();
 
-    /* Verify file still exists and is accessible. */
-    struct stat st;
-    if (stat(filepath, &st) != 0 || !S_ISREG(st.st_mode))
+    alert_server_export(msg);
+    metrics_server_export(msg);
+    handover_export(msg);
+    monitor_export(g_monitor, msg);
+
+    /* Paused workers and this thread (the only producer): depth is fixed. */
+    handover_put_u32(msg, HANDOVER_TAG_QUEUE);
+    handover_put_u32(msg, (uint32_t)st.depth);
+    threadpool_foreach_queued(g_pool, put_queued, msg);
+    return 0;
+}
+
+static void on_handover_done(int committed, pid_t peer, void *arg)
+{
+    (void)arg;
+
+    if (!committed) {
+        threadpool_pause(g_pool, 0);
+        catchup_resume();
         return;
+    }
 
-    /* Skip very small files (< 4 bytes) and very large files (> 100 MB). */
-    if (st.st_size < 4 || st.st_size > 100 * 1024 * 1024)
+    int dropped = threadpool_drop_queued(g_pool);
+    log_info("Pid %d has taken over (with %d queued scans) — exiting.",
+             (int)peer, dropped);
+    g_handed_over = 1;
+    reactor_stop(g_reactor);
+}
+
+/*
+ * Re-queue the predecessor's pending scans, oldest first.  Journaled
+ * ones are already among our recovered work, so only the rest is queued.
+ */
+static int adopt_queue(handover_msg_t *msg)
+{
+    uint32_t n, queued = 0;
+    if (handover_expect(msg, HANDOVER_TAG_QUEUE) != 0 ||
+        handover_get_u32(msg, &n) != 0)
+        return -1;
+
+    char path[PATH_MAX];
+    for (uint32_t i = 0; i < n; i++) {
+        uint64_t jid;
+        if (handover_get_u64(msg, &jid) != 0 ||
+            handover_get_str(msg, path, sizeof(path)) != 0)
+            return -1;
+        if (jid && journal_active()) continue;
+        threadpool_submit(g_pool, path, NULL);
+        queued++;
+    }
+    if (queued) log_info("Re-queued %u scans from the previous daemon.", queued);
+    return 0;
+}
+
+/*
+ * Close the IPC endpoints.  While they are shared with another daemon
+ * (takeover not committed yet, or handed over) the socket paths belong
+ * to whichever daemon carries on, so they are released, not unlinked.
+ */
+static void stop_ipc(void)
+{
+    if (g_takeover_pending || g_handed_over) {
+        alert_server_release();
+        metrics_server_release();
+        handover_close(0);
+    } else {
+        alert_server_shutdown();
+        metrics_server_shutdown();
+        handover_close(1);
+    }
+
+    if (g_takeover_pending) {
+        handover_abort();
+        handover_msg_free(&g_takeover);
+        g_takeover_pending = 0;
+    }
+}
+
+/*
+ * Resolve what SIGHUP will exec: this binary's path, argv + --takeover,
+ * with room for the current --engines (spawn_successor()).
+ */
+static void prepare_successor(int argc, char *argv[])
+{
+    if (!realpath("/proc/self/exe", g_self_exe)) {
+        log_warn("Cannot resolve own executable (%s) — SIGHUP upgrades "
+                 "disabled.", strerror(errno));
+        g_self_exe[0] = '\0';
         return;
+    }
 
-    /* Enqueue for async scanning — the pool strdup()s internally. */
-    threadpool_submit(g_pool, filepath);
+    g_successor_argv = calloc((size_t)argc + 4, sizeof(char *));
+    if (!g_successor_argv) return;
+
+    int has_takeover = 0;
+    for (int i = 0; i < argc; i++) {
+        g_successor_argv[i] = argv[i];
+        if (strcmp(argv[i], "--takeover") == 0) has_takeover = 1;
+    }
+    g_successor_argc = argc;
+    if (!has_takeover) g_successor_argv[g_successor_argc++] = "--takeover";
 }
 
 /* ── IPC command handler (Fix 4: state sync + restore/delete) ───────────── */
 
+/*
+ * Replies that can be long (listings) are built as newline-separated
+ * JSON lines in one buffer and sent with a single write per page.
+ */
+typedef struct {
+    char       *data;
+    size_t      len;
+    size_t      cap;
+    int         count;           /* Entries added                       */
+    const char *event;           /* Event name of each entry line       */
+    const char *match;           /* Only entries matching (query), or NULL */
+} reply_buf_t;
+
+static void reply_add(reply_buf_t *rb, const char *line)
+{
+    size_t n = strlen(line);
+    if (rb->len + n + 2 > rb->cap) {
+        size_t cap = rb->cap ? rb->cap : 16384;
+        while (rb->len + n + 2 > cap) cap *= 2;
+        char *d = realloc(rb->data, cap);
+        if (!d) return;
+        rb->data = d;
+        rb->cap  = cap;
+    }
+    if (rb->len) rb->data[rb->len++] = '\n';
+    memcpy(rb->data + rb->len, line, n + 1);
+    rb->len += n;
+}
+
+/* Send and empty the buffer.  The last line gets its '\n' from alert. */
+static void reply_flush(reply_buf_t *rb, int client_fd)
+{
+    if (rb->len) alert_send_to_client(client_fd, rb->data);
+    rb->len = 0;
+}
+
+/* quarantine_foreach() visitor: one JSON line per (matching) entry. */
+static void reply_entry(const quarantine_entry_t *e, void *arg)
+{
+    reply_buf_t *rb = arg;
+    if (rb->match && strcmp(e->id, rb->match) != 0 &&
+        strcmp(e->original_path, rb->match) != 0 &&
+        strcmp(e->threat_name, rb->match) != 0)
+        return;
+
+    struct json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "event", json_object_new_string(rb->event));
+    json_object_object_add(jobj, "id", json_object_new_string(e->id));
+    json_object_object_add(jobj, "filename",
+        json_object_new_string(e->original_path));
+    json_object_object_add(jobj, "quarantine_path",
+        json_object_new_string(e->quarantine_path));
+    json_object_object_add(jobj, "threat", json_object_new_string(e->threat_name));
+    json_object_object_add(jobj, "timestamp",
+        json_object_new_int64((int64_t)e->timestamp));
+    reply_add(rb, json_object_to_json_string(jobj));
+    json_object_put(jobj);
+    rb->count++;
+}
+
+/*
+ * Send every entry (matching rb->match) page by page: the quarantine
+ * lock is never held while a send waits on the client.
+ * @return entries sent.
+ */
+static int reply_entries(reply_buf_t *rb, int client_fd)
+{
+    int total = 0;
+    for (int off = 0;; off += ALERT_LIST_PAGE) {
+        rb->count = 0;
+        int n = quarantine_foreach(off, ALERT_LIST_PAGE, reply_entry, rb);
+        total += rb->count;
+        reply_flush(rb, client_fd);
+        if (n < ALERT_LIST_PAGE) break;
+    }
+    return total;
+}
+
+/*
+ * restore / delete: "id" is one quarantine ID or several separated by
+ * commas (bulk clients batch them, so the manifest is written once per
+ * request).  Each ID gets a broadcast for the GUIs and a
+ * "<action>_result" reply for the requester.
+ */
+static void quarantine_bulk(int client_fd, const char *action, const char *id)
+{
+    int restore = strcmp(action, "restore") == 0;
+    const char *ids[ALERT_MSG_MAX / 2];
+    int  ok[ALERT_MSG_MAX / 2];
+    int  n = 0;
+
+    char *copy = strdup(id);
+    if (!copy) return;
+    char *save = NULL;
+    for (char *t = strtok_r(copy, ",", &save); t && n < ALERT_MSG_MAX / 2;
+         t = strtok_r(NULL, ",", &save))
+        ids[n++] = t;
+
+    log_info("GUI requested %s of %d entr%s: %s", action, n,
+             n == 1 ? "y" : "ies", id);
+    if (restore) quarantine_restore_many(ids, n, ok);
+    else         quarantine_delete_many(ids, n, ok);
+
+    reply_buf_t rb = { 0 };
+    for (int i = 0; i < n; i++) {
+        if (ok[i])
+            alert_broadcast(restore ? ALERT_TYPE_RESTORE : ALERT_TYPE_DELETE,
+                            ids[i], NULL, restore
+                            ? "File restored from quarantine"
+                            : "File permanently deleted");
+        else
+            alert_broadcast(ALERT_TYPE_STATUS, ids[i], NULL,
+                            restore ? "Restore failed" : "Delete failed");
+
+        struct json_object *jobj = json_object_new_object();
+        json_object_object_add(jobj, "event", json_object_new_string(
+            restore ? "restore_result" : "delete_result"));
+        json_object_object_add(jobj, "id", json_object_new_string(ids[i]));
+        json_object_object_add(jobj, "ok", json_object_new_boolean(ok[i]));
+        reply_add(&rb, json_object_to_json_string(jobj));
+        json_object_put(jobj);
+    }
+    reply_flush(&rb, client_fd);
+    free(rb.data);
+    free(copy);
+}
+
+/* stats: one snapshot of the pipeline for scripts. */
+static void reply_stats(int client_fd)
+{
+    threadpool_stats_t st;
+    threadpool_get_stats(g_pool, &st);
+
+    struct json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "event", json_object_new_string("stats"));
+    json_object_object_add(jobj, "pid", json_object_new_int64(getpid()));
+    json_object_object_add(jobj, "uptime_s", json_object_new_int64(
+        (int64_t)((metrics_now_ns() - g_start_ns) / 1000000000ULL)));
+    json_object_object_add(jobj, "monitoring",
+        json_object_new_boolean(g_monitoring_enabled));
+    json_object_object_add(jobj, "queue_depth", json_object_new_int64(st.depth));
+    json_object_object_add(jobj, "queue_capacity",
+        json_object_new_int64(st.capacity));
+    json_object_object_add(jobj, "background_depth",
+        json_object_new_int64(st.bg_depth));
+    json_object_object_add(jobj, "workers", json_object_new_int64(st.threads));
+    json_object_object_add(jobj, "workers_busy", json_object_new_int64(st.active));
+    json_object_object_add(jobj, "submitted",
+        json_object_new_int64((int64_t)st.submitted));
+    json_object_object_add(jobj, "processed",
+        json_object_new_int64((int64_t)st.processed));
+    json_object_object_add(jobj, "clean",
+        json_object_new_int64((int64_t)metrics_counter_value(g_m_clean)));
+    json_object_object_add(jobj, "infected",
+        json_object_new_int64((int64_t)metrics_counter_value(g_m_infected)));
+    json_object_object_add(jobj, "errors",
+        json_object_new_int64((int64_t)metrics_counter_value(g_m_error)));
+    json_object_object_add(jobj, "offline",
+        json_object_new_int64((int64_t)metrics_counter_value(g_m_offline)));
+    json_object_object_add(jobj, "quarantined",
+        json_object_new_int64(quarantine_count()));
+    json_object_object_add(jobj, "clients",
+        json_object_new_int64(alert_get_client_count()));
+    alert_send_to_client(client_fd, json_object_to_json_string(jobj));
+    json_object_put(jobj);
+}
+
 /**
  * Dispatches commands received from GUI clients over the UNIX socket.
  *
@@ -308,6 +1064,27 @@ static void on_file_event(const char *filepath, void *user_data)
  *   "delete"          — Permanently deletes a quarantined file by UUID.
  *   "set_monitoring"  — Pauses (enabled=false) or resumes (enabled=true)
  *                       real-time file monitoring.
+ *   "profile"         — Sends the scan cost profile, most expensive first;
+ *                       "id" may name one dimension (ext / magic / dir).
+ *   "profile_dump"    — Writes the profile to SCANPROF_CSV_PATH.
+ *   "profile_reset"   — Clears the profile.
+ *   "scan_path"       — Scans the directory or file "id" on demand,
+ *                       streaming progress to this client (ondemand.h).
+ *   "scan_cancel"     — Cancels scan "id", or all of this client's scans.
+ *   "list"            — Sends ALERT_LIST_PAGE quarantine entries from
+ *                       position "id" (default 0), then a "list_page"
+ *                       marker with the next position and the total.
+ *   "query"           — Sends the entries whose ID, original path or
+ *                       threat name equals "id", then "query_done".
+ *   "stats"           — Sends counters and queue state.
+ *   "reload"          — Starts a live upgrade, like SIGHUP.
+ *   "engines"         — Replaces the scan engine chain with spec "id"
+ *                       (if given) and sends the chain with per-engine
+ *                       counters.
+ *   "engines_reload"  — Has the engines re-read their data files (IOC
+ *                       lists), then replies like "engines".
+ *
+ * "restore" and "delete" accept several comma-separated IDs.
  */
 static void on_gui_command(int client_fd,
                            const char *action,
@@ -320,31 +1097,10 @@ static void on_gui_command(int client_fd,
     if (strcmp(action, "sync_state") == 0) {
         log_info("GUI requested state sync (fd=%d)", client_fd);
 
-        quarantine_entry_t *entries = NULL;
-        int count = 0;
-
-        if (quarantine_list(&entries, &count) == 0 && count > 0) {
-            for (int i = 0; i < count; i++) {
-                struct json_object *jobj = json_object_new_object();
-                json_object_object_add(jobj, "event",
-                    json_object_new_string("sync_entry"));
-                json_object_object_add(jobj, "id",
-                    json_object_new_string(entries[i].id));
-                json_object_object_add(jobj, "filename",
-                    json_object_new_string(entries[i].original_path));
-                json_object_object_add(jobj, "quarantine_path",
-                    json_object_new_string(entries[i].quarantine_path));
-                json_object_object_add(jobj, "threat",
-                    json_object_new_string(entries[i].threat_name));
-                json_object_object_add(jobj, "timestamp",
-                    json_object_new_int64((int64_t)entries[i].timestamp));
-
-                const char *json_str = json_object_to_json_string(jobj);
-                alert_send_to_client(client_fd, json_str);
-                json_object_put(jobj);  /* Free the JSON object. */
-            }
-            free(entries);
-        }
+        /* Paged: a large vault is never copied or sent in one piece. */
+        reply_buf_t rb = { .event = "sync_entry" };
+        int count = reply_entries(&rb, client_fd);
+        free(rb.data);
 
         /* Send current monitoring state so the GUI toggle is in sync. */
         {
@@ -391,97 +1147,592 @@ static void on_gui_command(int client_fd,
         return;
     }
 
-    /* ── restore: restore a quarantined file ──────────────────────── */
-    if (strcmp(action, "restore") == 0 && id) {
-        log_info("GUI requested restore: %s", id);
+    /* ── profile: scan cost per ext / magic type / directory ─────── */
+    if (strcmp(action, "profile") == 0) {
+        int dim = -1;
+        if (id && *id && (dim = scanprof_dim_parse(id)) < 0) {
+            log_warn("Unknown profile dimension: %s", id);
+            return;
+        }
 
-        if (quarantine_restore(id) == 0) {
-            alert_broadcast(ALERT_TYPE_RESTORE, id, NULL,
-                            "File restored from quarantine");
-        } else {
-            log_error("Failed to restore quarantine entry: %s", id);
-            alert_broadcast(ALERT_TYPE_STATUS, id, NULL,
-                            "Restore failed");
+        scanprof_row_t *rows = NULL;
+        int count = 0;
+        if (scanprof_snapshot(dim, &rows, &count) != 0) {
+            log_error("Scan profile snapshot failed");
+            return;
+        }
+
+        for (int i = 0; i < count; i++) {
+            struct json_object *jobj = json_object_new_object();
+            json_object_object_add(jobj, "event",
+                json_object_new_string("profile_row"));
+            json_object_object_add(jobj, "dimension",
+                json_object_new_string(scanprof_dim_name(rows[i].dim)));
+            json_object_object_add(jobj, "key",
+                json_object_new_string(rows[i].key));
+            json_object_object_add(jobj, "scans",
+                json_object_new_int64((int64_t)rows[i].scans));
+            json_object_object_add(jobj, "bytes",
+                json_object_new_int64((int64_t)rows[i].bytes));
+            json_object_object_add(jobj, "scan_ms",
+                json_object_new_double((double)rows[i].scan_ns / 1e6));
+            json_object_object_add(jobj, "detections",
+                json_object_new_int64((int64_t)rows[i].detections));
+            json_object_object_add(jobj, "errors",
+                json_object_new_int64((int64_t)rows[i].errors));
+
+            alert_send_to_client(client_fd, json_object_to_json_string(jobj));
+            json_object_put(jobj);
         }
+        free(rows);
+
+        char done[64];
+        snprintf(done, sizeof(done),
+                 "{\"event\":\"profile_complete\",\"count\":%d}", count);
+        alert_send_to_client(client_fd, done);
+        return;
+    }
+
+    if (strcmp(action, "profile_dump") == 0) {
+        if (scanprof_dump_csv(NULL) == 0)
+            alert_send_to_client(client_fd,
+                "{\"event\":\"profile_dumped\",\"path\":\"" SCANPROF_CSV_PATH "\"}");
         return;
     }
 
-    /* ── delete: permanently delete a quarantined file ────────────── */
-    if (strcmp(action, "delete") == 0 && id) {
-        log_info("GUI requested delete: %s", id);
+    if (strcmp(action, "profile_reset") == 0) {
+        scanprof_reset();
+        log_info("Scan profile reset by GUI request.");
+        return;
+    }
+
+    /* ── scan_path / scan_cancel: on-demand scans ─────────────────── */
+    if (strcmp(action, "scan_path") == 0) {
+        log_info("GUI requested on-demand scan: %s", id ? id : "");
+        ondemand_start(client_fd, id);
+        return;
+    }
+
+    if (strcmp(action, "scan_cancel") == 0) {
+        uint32_t scan_id = id ? (uint32_t)strtoul(id, NULL, 10) : 0;
+        char reply[80];
+        snprintf(reply, sizeof(reply),
+                 "{\"event\":\"cancel_result\",\"cancelled\":%d}",
+                 ondemand_cancel(client_fd, scan_id));
+        alert_send_to_client(client_fd, reply);
+        return;
+    }
+
+    /* ── list / query: page through the quarantine vault ───────────── */
+    if (strcmp(action, "list") == 0) {
+        int offset = id ? atoi(id) : 0;
+        if (offset < 0) offset = 0;
+
+        reply_buf_t rb = { .event = "quarantine_entry" };
+        int n = quarantine_foreach(offset, ALERT_LIST_PAGE, reply_entry, &rb);
+        if (n < 0) n = 0;
+
+        char tail[128];
+        snprintf(tail, sizeof(tail),
+                 "{\"event\":\"list_page\",\"offset\":%d,\"count\":%d,"
+                 "\"next\":%d,\"total\":%d}",
+                 offset, n, offset + n, quarantine_count());
+        reply_add(&rb, tail);
+        reply_flush(&rb, client_fd);
+        free(rb.data);
+        return;
+    }
+
+    if (strcmp(action, "query") == 0 && id) {
+        reply_buf_t rb = { .event = "quarantine_entry", .match = id };
+        int n = reply_entries(&rb, client_fd);
+        free(rb.data);
+
+        struct json_object *jobj = json_object_new_object();
+        json_object_object_add(jobj, "event", json_object_new_string("query_done"));
+        json_object_object_add(jobj, "key", json_object_new_string(id));
+        json_object_object_add(jobj, "count", json_object_new_int64(n));
+        alert_send_to_client(client_fd, json_object_to_json_string(jobj));
+        json_object_put(jobj);
+        return;
+    }
+
+    if (strcmp(action, "stats") == 0) {
+        reply_stats(client_fd);
+        return;
+    }
 
-        if (quarantine_delete(id) == 0) {
-            alert_broadcast(ALERT_TYPE_DELETE, id, NULL,
-                            "File permanently deleted");
+    if (strcmp(action, "reload") == 0) {
+        if (!alert_client_privileged(client_fd)) {
+            log_warn("Live upgrade refused: client fd=%d is not root",
+                     client_fd);
+            alert_send_to_client(client_fd,
+                "{\"event\":\"reload_result\",\"ok\":false,"
+                "\"error\":\"permission denied\"}");
+            return;
+        }
+        log_info("GUI requested a live upgrade (fd=%d)", client_fd);
+        int rc = spawn_successor();
+        char reply[96];
+        snprintf(reply, sizeof(reply),
+                 "{\"event\":\"reload_result\",\"ok\":%s,\"pid\":%d}",
+                 rc == 0 ? "true" : "false", (int)g_successor_pid);
+        alert_send_to_client(client_fd, reply);
+        return;
+    }
+
+    if (strcmp(action, "engines") == 0 ||
+        strcmp(action, "engines_reload") == 0) {
+        char err[256] = "";
+        int  ok;
+        int  change = strcmp(action, "engines_reload") == 0 || (id && *id);
+        if (change && !alert_client_privileged(client_fd)) {
+            /* A fake clamd socket would let any local user quarantine
+             * arbitrary files; an allowlist-only chain would hide them. */
+            log_warn("Engine change refused: client fd=%d is not root",
+                     client_fd);
+            snprintf(err, sizeof(err), "permission denied");
+            ok = 0;
         } else {
-            log_error("Failed to delete quarantine entry: %s", id);
-            alert_broadcast(ALERT_TYPE_STATUS, id, NULL,
-                            "Delete failed");
+            ok = strcmp(action, "engines_reload") == 0
+               ? scanner_reload_engines(err, sizeof(err)) == 0
+               : !change || scanner_set_engines(id, err, sizeof(err)) == 0;
         }
+        char spec[SCANNER_SPEC_MAX];
+        scanner_engines_spec(spec, sizeof(spec));
+
+        struct json_object *jobj = json_object_new_object();
+        json_object_object_add(jobj, "event", json_object_new_string("engines"));
+        json_object_object_add(jobj, "ok", json_object_new_boolean(ok));
+        if (!ok)
+            json_object_object_add(jobj, "error", json_object_new_string(err));
+        json_object_object_add(jobj, "chain", json_object_new_string(spec));
+        json_object_object_add(jobj, "engines", scanner_engines_json());
+        alert_send_to_client(client_fd, json_object_to_json_string(jobj));
+        json_object_put(jobj);
+        return;
+    }
+
+    /* ── restore / delete: one or more quarantined files ──────────── */
+    if ((strcmp(action, "restore") == 0 || strcmp(action, "delete") == 0) &&
+        id) {
+        quarantine_bulk(client_fd, action, id);
         return;
     }
 
     log_warn("Unknown GUI command: action=%s id=%s", action, id ? id : "");
 }
 
-/* ── Monitor thread ─────────────────────────────────────────────────────── */
+/* A GUI client went away: its on-demand scans have nobody to report to. */
+static void on_gui_disconnect(int client_fd, void *user_data)
+{
+    (void)user_data;
+    ondemand_client_gone(client_fd);
+}
+
+/* ── Startup timing ─────────────────────────────────────────────────────── */
+
+static void phase_done(startup_phase_t phase)
+{
+    uint64_t now = metrics_now_ns();
+    g_phase_ns[phase] = now - g_phase_start_ns;
+    g_phase_start_ns  = now;
+}
+
+static void log_startup_summary(void)
+{
+    g_phase_ns[PHASE_TOTAL] = metrics_now_ns() - g_start_ns;
+
+    char buf[512];
+    size_t off = 0;
+    for (int i = 0; i < PHASE_TOTAL && off < sizeof(buf); i++)
+        off += (size_t)snprintf(buf + off, sizeof(buf) - off, "%s%s %.1f",
+                                i ? ", " : "", PHASE_NAMES[i],
+                                (double)g_phase_ns[i] / 1e6);
+
+    int    dirs = monitor_get_watch_count(g_monitor);
+    double walk = (double)g_phase_ns[PHASE_WATCHES] / 1e9;
+    log_info("Startup complete in %.1f ms (%s ms; %d vault entries, "
+             "%d dirs watched at %.0f dirs/s)",
+             (double)g_phase_ns[PHASE_TOTAL] / 1e6, buf, quarantine_count(),
+             dirs, walk > 0 ? dirs / walk : 0.0);
+}
+
+/* ── Metrics ────────────────────────────────────────────────────────────── */
+
+static double sample_pool(void *arg)
+{
+    threadpool_stats_t st;
+    threadpool_get_stats(g_pool, &st);
+
+    switch ((intptr_t)arg) {
+    case 0:  return st.depth;
+    case 1:  return st.capacity;
+    case 2:  return st.active;
+    case 3:  return (double)st.submitted;
+    default: return (double)st.processed;
+    }
+}
+
+static double sample_watches(void *arg)
+{
+    (void)arg;
+    return monitor_get_watch_count(g_monitor);
+}
+
+static double sample_ipc_clients(void *arg)
+{
+    (void)arg;
+    return alert_get_client_count();
+}
+
+static double sample_monitoring(void *arg)
+{
+    (void)arg;
+    return g_monitoring_enabled;
+}
 
-static void *monitor_thread(void *arg)
+static double sample_phase(void *arg)
 {
-    monitor_ctx_t *ctx = (monitor_ctx_t *)arg;
-    monitor_run(ctx);
-    return NULL;
+    return (double)g_phase_ns[(intptr_t)arg] / 1e9;
+}
+
+static void register_metrics(void)
+{
+    g_m_clean    = metrics_counter("sentinel_scans_total{result=\"clean\"}",
+                                   "Completed scans by verdict");
+    g_m_infected = metrics_counter("sentinel_scans_total{result=\"infected\"}",
+                                   "Completed scans by verdict");
+    g_m_error    = metrics_counter("sentinel_scans_total{result=\"error\"}",
+                                   "Completed scans by verdict");
+    g_m_offline  = metrics_counter("sentinel_scans_total{result=\"offline\"}",
+                                   "Completed scans by verdict");
+    g_m_pushback = metrics_counter("sentinel_queue_full_pauses_total",
+                       "Times inotify reads were paused because the queue was full");
+    g_m_packed   = metrics_counter("sentinel_packed_executables_total",
+                       "Scanned executables that looked packed or encrypted");
+
+    metrics_sampled("sentinel_queue_depth", "Files waiting in the scan queue",
+                    METRICS_GAUGE, sample_pool, (void *)0);
+    metrics_sampled("sentinel_queue_capacity", "Scan queue capacity",
+                    METRICS_GAUGE, sample_pool, (void *)1);
+    metrics_sampled("sentinel_workers_busy", "Workers currently scanning",
+                    METRICS_GAUGE, sample_pool, (void *)2);
+    metrics_sampled("sentinel_files_submitted_total", "Files enqueued for scanning",
+                    METRICS_COUNTER, sample_pool, (void *)3);
+    metrics_sampled("sentinel_files_processed_total", "Files dequeued by workers",
+                    METRICS_COUNTER, sample_pool, (void *)4);
+    metrics_sampled("sentinel_inotify_watches", "Directory watches registered",
+                    METRICS_GAUGE, sample_watches, NULL);
+    metrics_sampled("sentinel_ipc_clients", "Connected GUI clients",
+                    METRICS_GAUGE, sample_ipc_clients, NULL);
+    metrics_sampled("sentinel_monitoring_enabled", "1 if real-time protection is on",
+                    METRICS_GAUGE, sample_monitoring, NULL);
+
+    static const char *const PHASE_METRICS[PHASE_COUNT] = {
+        "sentinel_startup_seconds{phase=\"logger\"}",
+        "sentinel_startup_seconds{phase=\"takeover\"}",
+        "sentinel_startup_seconds{phase=\"quarantine\"}",
+        "sentinel_startup_seconds{phase=\"journal\"}",
+        "sentinel_startup_seconds{phase=\"index\"}",
+        "sentinel_startup_seconds{phase=\"scanner\"}",
+        "sentinel_startup_seconds{phase=\"pool\"}",
+        "sentinel_startup_seconds{phase=\"ipc\"}",
+        "sentinel_startup_seconds{phase=\"watches\"}",
+        "sentinel_startup_seconds{phase=\"total\"}",
+    };
+    for (intptr_t i = 0; i < PHASE_COUNT; i++)
+        metrics_sampled(PHASE_METRICS[i], "Time spent in each startup phase",
+                        METRICS_GAUGE, sample_phase, (void *)i);
+}
+
+/* ── Command line ───────────────────────────────────────────────────────── */
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -w, --watch DIR           watch DIR (repeatable; default /home /tmp)\n"
+        "  -c, --clamd-socket PATH   clamd socket (default %s)\n"
+        "      --engines SPEC        scan engine chain (default \"%s\")\n"
+        "  -i, --ipc-socket PATH     GUI socket (default %s)\n"
+        "  -M, --metrics-socket PATH metrics socket (default %s)\n"
+        "  -l, --log-file PATH       log file (default %s)\n"
+        "  -q, --quarantine-dir DIR  quarantine vault (default %s)\n"
+        "  -j, --workers N           scan threads (default %d)\n"
+        "  -Q, --queue N             scan queue capacity (default %d)\n"
+        "  -r, --record FILE         record monitor events to FILE\n"
+        "  -R, --replay FILE         feed a recorded event trace to the\n"
+        "                            pipeline (watches nothing unless\n"
+        "                            --watch is also given)\n"
+        "      --replay-speed X      1 = recorded pace, 0 = flat out\n"
+        "      --replay-root DIR     recreate replayed files under DIR\n"
+        "      --replay-exit         exit once the replay has drained\n"
+        "      --takeover            take sockets, watches and queue over\n"
+        "                            from the running daemon (live upgrade)\n"
+        "      --handover-socket PATH  upgrade control socket (default %s)\n"
+        "      --journal PATH        pending-work journal (default %s)\n"
+        "      --no-journal          do not persist queued scans\n"
+        "      --catchup-stamp PATH  last-good stamp (default %s)\n"
+        "      --no-catchup          do not sweep for changes made while\n"
+        "                            the daemon was down\n"
+        "      --catchup-prune       skip files of directories whose mtime\n"
+        "                            predates the stamp (misses in-place\n"
+        "                            rewrites)\n"
+        "      --index PATH          file-state index (default %s)\n"
+        "      --full-scan-interval H  hours between full scans (default\n"
+        "                            %d, 0 = off)\n"
+        "      --full-scan-io MIBPS  full-scan read budget (default %d)\n"
+        "      --full-scan-cpu PCT   full-scan CPU budget (default %d%%)\n"
+        "  -h, --help\n",
+        prog, CLAMD_SOCKET_PATH, SCANNER_DEFAULT_ENGINES, ALERT_SOCKET_PATH, METRICS_SOCKET_PATH,
+        SENTINEL_LOG_FILE, QUARANTINE_DIR, WORKER_THREADS, QUEUE_CAPACITY,
+        HANDOVER_SOCKET_PATH, JOURNAL_PATH, CATCHUP_STAMP_PATH, FSINDEX_PATH,
+        FULLSCAN_INTERVAL_H, FULLSCAN_IO_MBPS, FULLSCAN_CPU_PCT);
+}
+
+/** @return 0 to run, 1 to exit successfully (--help), -1 on bad usage. */
+static int parse_args(int argc, char *argv[])
+{
+    enum { OPT_REPLAY_SPEED = 256, OPT_REPLAY_ROOT, OPT_REPLAY_EXIT,
+           OPT_TAKEOVER, OPT_HANDOVER_SOCKET, OPT_JOURNAL, OPT_NO_JOURNAL,
+           OPT_CATCHUP_STAMP, OPT_NO_CATCHUP, OPT_CATCHUP_PRUNE, OPT_INDEX,
+           OPT_FULLSCAN_INTERVAL, OPT_FULLSCAN_IO, OPT_FULLSCAN_CPU,
+           OPT_ENGINES };
+    static const struct option LONG_OPTS[] = {
+        { "watch",          required_argument, NULL, 'w' },
+        { "clamd-socket",   required_argument, NULL, 'c' },
+        { "engines",        required_argument, NULL, OPT_ENGINES },
+        { "ipc-socket",     required_argument, NULL, 'i' },
+        { "metrics-socket", required_argument, NULL, 'M' },
+        { "log-file",       required_argument, NULL, 'l' },
+        { "quarantine-dir", required_argument, NULL, 'q' },
+        { "workers",        required_argument, NULL, 'j' },
+        { "queue",          required_argument, NULL, 'Q' },
+        { "record",         required_argument, NULL, 'r' },
+        { "replay",         required_argument, NULL, 'R' },
+        { "replay-speed",   required_argument, NULL, OPT_REPLAY_SPEED },
+        { "replay-root",    required_argument, NULL, OPT_REPLAY_ROOT },
+        { "replay-exit",    no_argument,       NULL, OPT_REPLAY_EXIT },
+        { "takeover",       no_argument,       NULL, OPT_TAKEOVER },
+        { "handover-socket", required_argument, NULL, OPT_HANDOVER_SOCKET },
+        { "journal",        required_argument, NULL, OPT_JOURNAL },
+        { "no-journal",     no_argument,       NULL, OPT_NO_JOURNAL },
+        { "catchup-stamp",  required_argument, NULL, OPT_CATCHUP_STAMP },
+        { "no-catchup",     no_argument,       NULL, OPT_NO_CATCHUP },
+        { "catchup-prune",  no_argument,       NULL, OPT_CATCHUP_PRUNE },
+        { "index",          required_argument, NULL, OPT_INDEX },
+        { "full-scan-interval", required_argument, NULL, OPT_FULLSCAN_INTERVAL },
+        { "full-scan-io",   required_argument, NULL, OPT_FULLSCAN_IO },
+        { "full-scan-cpu",  required_argument, NULL, OPT_FULLSCAN_CPU },
+        { "help",           no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "w:c:i:M:l:q:j:Q:r:R:h",
+                              LONG_OPTS, NULL)) != -1) {
+        switch (opt) {
+        case 'w':
+            if (g_opts.nwatch >= MAX_WATCH_DIRS) {
+                fprintf(stderr, "At most %d --watch directories\n",
+                        MAX_WATCH_DIRS);
+                return -1;
+            }
+            g_opts.watch[g_opts.nwatch++] = optarg;
+            break;
+        case 'c': g_opts.clamd_socket   = optarg; break;
+        case 'i': g_opts.ipc_socket     = optarg; break;
+        case 'M': g_opts.metrics_socket = optarg; break;
+        case 'l': g_opts.log_file       = optarg; break;
+        case 'q': g_opts.quarantine_dir = optarg; break;
+        case 'j': g_opts.workers        = atoi(optarg); break;
+        case 'Q': g_opts.queue          = atoi(optarg); break;
+        case 'r': g_opts.record         = optarg; break;
+        case 'R': g_opts.replay         = optarg; break;
+        case OPT_REPLAY_SPEED: g_opts.replay_speed = atof(optarg); break;
+        case OPT_REPLAY_ROOT:  g_opts.replay_root  = optarg; break;
+        case OPT_REPLAY_EXIT:  g_opts.replay_exit  = 1; break;
+        case OPT_TAKEOVER:     g_opts.takeover     = 1; break;
+        case OPT_HANDOVER_SOCKET: g_opts.handover_socket = optarg; break;
+        case OPT_JOURNAL:      g_opts.journal      = optarg; break;
+        case OPT_NO_JOURNAL:   g_opts.no_journal   = 1; break;
+        case OPT_CATCHUP_STAMP: g_opts.catchup_stamp = optarg; break;
+        case OPT_NO_CATCHUP:   g_opts.no_catchup   = 1; break;
+        case OPT_CATCHUP_PRUNE: g_opts.catchup_prune = 1; break;
+        case OPT_INDEX:        g_opts.index        = optarg; break;
+        case OPT_FULLSCAN_INTERVAL: g_opts.fullscan_interval = atoi(optarg); break;
+        case OPT_FULLSCAN_IO:  g_opts.fullscan_io  = atoi(optarg); break;
+        case OPT_FULLSCAN_CPU: g_opts.fullscan_cpu = atoi(optarg); break;
+        case OPT_ENGINES:      g_opts.engines      = optarg; break;
+        case 'h': usage(argv[0]); return 1;
+        default:  usage(argv[0]); return -1;
+        }
+    }
+
+    if (optind < argc || g_opts.workers < 1 || g_opts.queue < 1 ||
+        g_opts.replay_speed < 0) {
+        usage(argv[0]);
+        return -1;
+    }
+    return 0;
 }
 
 /* ── Main ───────────────────────────────────────────────────────────────── */
 
 int main(int argc, char *argv[])
 {
-    (void)argc;
-    (void)argv;
+    g_start_ns = g_phase_start_ns = metrics_now_ns();
+
+    int args = parse_args(argc, argv);
+    if (args != 0) return args < 0 ? 2 : 0;
+
+    /* A replay is the event source unless watches are asked for too. */
+    static const char *NO_WATCH_DIRS[] = { NULL };
+    const char **watch_dirs = g_opts.nwatch ? g_opts.watch
+                            : g_opts.replay ? NO_WATCH_DIRS : WATCH_DIRS;
+    const char  *ipc_socket = g_opts.ipc_socket ? g_opts.ipc_socket
+                                                : ALERT_SOCKET_PATH;
+    int          took_over  = 0;
+
+    /*
+     * Block the reactor's signals before any thread exists (the logger
+     * starts one) so every thread inherits the mask and delivery goes
+     * only to the signalfd.
+     */
+    reactor_block_signals(REACTOR_SIGNALS);
+
+    /* Ignore SIGPIPE (broken socket writes). */
+    signal(SIGPIPE, SIG_IGN);
 
     /* ── 1. Logger ──────────────────────────────────────────────────── */
-    if (logger_init(NULL) != 0) {
+    if (logger_init(g_opts.log_file) != 0) {
         fprintf(stderr, "Failed to initialise logger\n");
         return 1;
     }
 
+    /* Optional sub-second monotonic stamps for latency analysis. */
+    const char *mono_env = getenv("SENTINEL_LOG_MONOTONIC");
+    if (mono_env && strcmp(mono_env, "1") == 0) {
+        logger_set_monotonic(1);
+    }
+
+    /* Optional rotation size and archive count, "MAX_MIB[:GENERATIONS]";
+     * age and total-bytes limits keep their defaults. */
+    const char *rot_env = getenv("SENTINEL_LOG_ROTATE");
+    if (rot_env && *rot_env) {
+        char         *end;
+        unsigned long mib  = strtoul(rot_env, &end, 10);
+        unsigned long gens = *end == ':' ? strtoul(end + 1, NULL, 10) : 0;
+        logger_set_rotation((size_t)mib * 1024 * 1024, SENTINEL_LOG_MAX_AGE,
+                            (int)gens, SENTINEL_LOG_RETAIN_BYTES);
+    }
+
+    /* Optional budget for log_*_rl() sites, per level or for all, e.g.
+     * "warn=20,error=50:100"; 0 turns suppression off. */
+    const char *rl_env = getenv("SENTINEL_LOG_RATE_LIMIT");
+    if (rl_env && *rl_env && logger_set_rate_limits(rl_env) != 0)
+        log_warn("Ignoring malformed SENTINEL_LOG_RATE_LIMIT=\"%s\"", rl_env);
+
+    /* Per-stage latency histograms; optional sampled Chrome traces. */
+    const char *sample_env = getenv("SENTINEL_TRACE_SAMPLE");
+    trace_init(sample_env ? (unsigned)strtoul(sample_env, NULL, 10) : 0,
+               getenv("SENTINEL_TRACE_FILE"));
+
     log_info("═══════════════════════════════════════════════════════");
     log_info("  Sentinel Endpoint Security Daemon — Starting");
     log_info("  Thread pool: %d workers, queue: %d",
-             WORKER_THREADS, QUEUE_CAPACITY);
-    log_info("  IPC socket:  %s", ALERT_SOCKET_PATH);
+             g_opts.workers, g_opts.queue);
+    log_info("  IPC socket:  %s", ipc_socket);
     log_info("═══════════════════════════════════════════════════════");
 
-    install_signal_handlers();
+    /* Flight recorder: fatal signals dump then re-raise.  SIGUSR2 dumps
+     * are routed through the reactor (on_signal). */
+    fr_init();
+    prepare_successor(argc, argv);
+    phase_done(PHASE_LOGGER);
+
+    /*
+     * ── 1b. Live upgrade ──────────────────────────────────────────────
+     * Before the manifest is loaded: the predecessor finishes its scans
+     * (and quarantine writes) first, then stays frozen until we commit.
+     */
+    if (g_opts.takeover) {
+        g_caught_up_ns = wall_ns();         /* The predecessor freezes */
+        int rc = handover_request(g_opts.handover_socket, &g_takeover);
+        if (rc < 0) {
+            log_error("Takeover failed — the running daemon carries on.");
+            logger_shutdown();
+            return 1;
+        }
+        if (rc > 0)
+            log_warn("No running daemon to take over from — starting fresh.");
+        g_takeover_pending = rc == 0;
+    }
+    phase_done(PHASE_TAKEOVER);
 
     /* ── 2. Quarantine subsystem ────────────────────────────────────── */
-    if (quarantine_init() != 0) {
+    if (quarantine_init(g_opts.quarantine_dir) != 0) {
         log_error("Failed to initialise quarantine subsystem.");
         logger_shutdown();
         return 1;
     }
+    phase_done(PHASE_QUARANTINE);
+
+    /* ── 2b. Pending-work journal (optional) ────────────────────────── */
+    if (!g_opts.no_journal && journal_init(g_opts.journal) != 0)
+        log_warn("Pending-work journal unavailable — queued scans will not "
+                 "survive a restart.");
+    g_recovered_n = journal_take_recovered(&g_recovered);
+    if (!g_opts.no_catchup && catchup_init(g_opts.catchup_stamp) != 0)
+        log_warn("Catch-up stamp unavailable — changes made while the "
+                 "daemon is down will not be scanned.");
+    phase_done(PHASE_JOURNAL);
+
+    /* ── 2c. File-state index (scheduled full scans) ────────────────── */
+    if (g_opts.fullscan_interval > 0 && watch_dirs[0] &&
+        fsindex_init(g_opts.index) != 0)
+        log_warn("File-state index unavailable — scheduled full scans "
+                 "disabled.");
+    phase_done(PHASE_INDEX);
 
     /* ── 3. ClamAV scanner ──────────────────────────────────────────── */
-    if (scanner_init(NULL) != 0) {
-        log_warn("Scanner init returned error — will retry on first scan.");
+    if (scanner_init(g_opts.clamd_socket, g_opts.engines) != 0) {
+        log_error("Invalid --engines chain.");
+        journal_shutdown();
+        quarantine_shutdown();
+        logger_shutdown();
+        return 1;
     }
+    phase_done(PHASE_SCANNER);
 
     /* ── 4. Thread pool (Fix 1) ─────────────────────────────────────── */
-    g_pool = threadpool_create(WORKER_THREADS, QUEUE_CAPACITY,
+    g_pool = threadpool_create(g_opts.workers, g_opts.queue,
                                scan_worker, NULL);
     if (!g_pool) {
         log_error("Failed to create thread pool.");
+        journal_shutdown();
         quarantine_shutdown();
         scanner_shutdown();
         logger_shutdown();
         return 1;
     }
+    if (fsindex_active() &&
+        fullscan_init(watch_dirs, (unsigned)g_opts.fullscan_interval,
+                      (unsigned)g_opts.fullscan_io,
+                      (unsigned)g_opts.fullscan_cpu, sweep_wanted,
+                      sweep_scan, NULL) != 0)
+        log_warn("Scheduled full scans disabled.");
+    ondemand_init(g_pool, scan_wanted);
+    phase_done(PHASE_POOL);
 
     /* ── 5. UNIX domain socket IPC server (Fix 2) ───────────────────── */
-    if (alert_server_init(ALERT_SOCKET_PATH) != 0) {
+    if ((g_takeover_pending ? alert_server_adopt(&g_takeover)
+                            : alert_server_init(ipc_socket)) != 0) {
         log_error("Failed to start IPC server.");
+        stop_ipc();
         threadpool_shutdown(g_pool);
+        journal_shutdown();
         quarantine_shutdown();
         scanner_shutdown();
         logger_shutdown();
@@ -490,56 +1741,198 @@ int main(int argc, char *argv[])
 
     /* Register the command handler for GUI commands (Fix 4). */
     alert_set_command_handler(on_gui_command, NULL);
+    alert_set_disconnect_handler(on_gui_disconnect, NULL);
+
+    /* Metrics endpoint is optional: failing to bind it is not fatal. */
+    register_metrics();
+    if ((g_takeover_pending ? metrics_server_adopt(&g_takeover)
+                            : metrics_server_init(g_opts.metrics_socket)) != 0) {
+        log_warn("Metrics endpoint unavailable — continuing without it.");
+    }
 
-    /* ── 6. File monitor (on a separate thread) ─────────────────────── */
-    g_monitor = monitor_create(WATCH_DIRS, on_file_event, NULL);
-    if (!g_monitor) {
+    /* ── 6. Event loop ──────────────────────────────────────────────── */
+    g_reactor = reactor_create();
+    if (!g_reactor) {
+        log_error("Failed to create event loop.");
+        stop_ipc();
+        threadpool_shutdown(g_pool);
+        journal_shutdown();
+        quarantine_shutdown();
+        scanner_shutdown();
+        logger_shutdown();
+        return 1;
+    }
+
+    for (int i = 0; REACTOR_SIGNALS[i]; i++) {
+        reactor_add_signal(g_reactor, REACTOR_SIGNALS[i], on_signal, NULL);
+    }
+    if (fsindex_active())
+        reactor_add_timer(g_reactor, FULLSCAN_CHECK_MS, FULLSCAN_CHECK_MS,
+                          on_fullscan_tick, NULL);
+    reactor_add_timer(g_reactor, ONDEMAND_PROGRESS_MS, ONDEMAND_PROGRESS_MS,
+                      on_ondemand_tick, NULL);
+    reactor_add_timer(g_reactor, HOUSEKEEPING_MS, HOUSEKEEPING_MS,
+                      on_housekeeping, NULL);
+    g_inotify_retry_timer = reactor_add_timer(g_reactor, 0, 0,
+                                              on_inotify_retry, NULL);
+    if (g_recovered_n)
+        g_recover_timer = reactor_add_timer(g_reactor, 1, 0,
+                                            on_recover_tick, NULL);
+
+    if (alert_server_attach(g_reactor) != 0) {
+        log_error("Failed to register IPC server with the event loop.");
+        stop_ipc();
+        reactor_destroy(g_reactor);
+        threadpool_shutdown(g_pool);
+        journal_shutdown();
+        quarantine_shutdown();
+        scanner_shutdown();
+        logger_shutdown();
+        return 1;
+    }
+
+    metrics_server_attach(g_reactor);
+
+    /* Upgrade control socket: only a takeover needs it to succeed. */
+    if (g_takeover_pending) {
+        if (handover_adopt(&g_takeover, g_reactor, export_state,
+                           on_handover_done, NULL) != 0) {
+            log_error("Failed to adopt the upgrade control socket.");
+            stop_ipc();
+            reactor_destroy(g_reactor);
+            threadpool_shutdown(g_pool);
+            journal_shutdown();
+            quarantine_shutdown();
+            scanner_shutdown();
+            logger_shutdown();
+            return 1;
+        }
+    } else if (handover_listen(g_reactor, g_opts.handover_socket,
+                               export_state, on_handover_done, NULL) != 0) {
+        log_warn("Upgrade control socket unavailable — live upgrades "
+                 "disabled.");
+    }
+    phase_done(PHASE_IPC);
+
+    /* ── 7. File monitor (driven by the event loop) ─────────────────── */
+    if (!g_takeover_pending) g_caught_up_ns = wall_ns();
+    g_monitor = g_takeover_pending
+              ? monitor_adopt(&g_takeover, on_file_event, NULL)
+              : monitor_create(watch_dirs, on_file_event, NULL);
+    if (!g_monitor ||
+        reactor_add_fd(g_reactor, monitor_get_fd(g_monitor), EPOLLIN,
+                       on_inotify_ready, NULL) != 0 ||
+        (g_takeover_pending && adopt_queue(&g_takeover) != 0)) {
         log_error("Failed to create file monitor.");
-        alert_server_shutdown();
+        if (g_monitor) reactor_del_fd(g_reactor, monitor_get_fd(g_monitor));
+        monitor_destroy(g_monitor);
+        stop_ipc();
+        reactor_destroy(g_reactor);
         threadpool_shutdown(g_pool);
+        journal_shutdown();
         quarantine_shutdown();
         scanner_shutdown();
         logger_shutdown();
         return 1;
     }
+    phase_done(PHASE_WATCHES);
+
+    /* Everything adopted: let the predecessor go, then catch up. */
+    if (g_takeover_pending) {
+        handover_msg_free(&g_takeover);
+        if (handover_commit() != 0) {
+            /* It resumed (timed out) or died: either way, not ours. */
+            log_error("Previous daemon did not confirm the takeover — "
+                      "exiting.");
+            reactor_del_fd(g_reactor, monitor_get_fd(g_monitor));
+            monitor_destroy(g_monitor);
+            stop_ipc();
+            reactor_destroy(g_reactor);
+            threadpool_shutdown(g_pool);
+            journal_shutdown();
+            scanner_shutdown();
+            logger_shutdown();
+            return 1;
+        }
+        g_takeover_pending = 0;
+        took_over = 1;
+        log_info("Takeover complete.");
+        pump_inotify();
+    }
+
+    if (g_opts.record && evtrace_start(g_opts.record) != 0)
+        log_warn("Event recording disabled.");
 
-    pthread_t mon_tid;
-    if (pthread_create(&mon_tid, NULL, monitor_thread, g_monitor) != 0) {
-        log_error("Failed to launch monitor thread.");
+    if (g_opts.replay &&
+        replay_attach(g_reactor, g_opts.replay, g_opts.replay_speed,
+                      g_opts.replay_root, on_file_event, NULL,
+                      on_replay_done, NULL) != 0) {
+        log_error("Cannot replay %s.", g_opts.replay);
+        reactor_del_fd(g_reactor, monitor_get_fd(g_monitor));
         monitor_destroy(g_monitor);
-        alert_server_shutdown();
+        stop_ipc();
+        reactor_destroy(g_reactor);
         threadpool_shutdown(g_pool);
+        journal_shutdown();
         quarantine_shutdown();
         scanner_shutdown();
         logger_shutdown();
         return 1;
     }
 
+    /* Live performance panel in the GUI; not fatal if it cannot start. */
+    perfstats_attach(g_reactor, g_pool, g_monitor, 0);
+
+    /* Scan what changed while nobody watched (watches are in place). */
+    if (!g_opts.no_catchup && watch_dirs[0])
+        catchup_start(watch_dirs, g_opts.catchup_prune, g_pool, scan_wanted,
+                      took_over);
+
+    log_startup_summary();
     log_info("All subsystems initialised.  Entering main event loop.");
-    alert_broadcast(ALERT_TYPE_STATUS, "sentinel", NULL, "Daemon started");
+    alert_broadcast(ALERT_TYPE_STATUS, "sentinel", NULL,
+                    took_over ? "Daemon upgraded" : "Daemon started");
 
-    /* ── 7. Main loop: service IPC socket events ────────────────────── */
-    while (g_running) {
-        alert_server_service(200);  /* 200 ms timeout */
+    /* ── 8. Main loop: everything is dispatched from here ───────────── */
+    if (reactor_run(g_reactor) != 0) {
+        log_error("Event loop failed — shutting down.");
     }
 
-    /* ── 8. Graceful shutdown ───────────────────────────────────────── */
+    /* ── 9. Graceful shutdown ───────────────────────────────────────── */
     log_info("Shutting down Sentinel daemon...");
 
-    /* Stop the monitor thread first. */
-    monitor_stop(g_monitor);
-    pthread_join(mon_tid, NULL);
+    /* Stop watching first so no new work arrives. */
+    reactor_del_fd(g_reactor, monitor_get_fd(g_monitor));
     monitor_destroy(g_monitor);
+    evtrace_stop();
 
-    /* Drain the thread pool (waits for in-flight scans to complete). */
+    /*
+     * With a journal, queued scans stay outstanding for the next start
+     * and only in-flight ones are waited for; without, drain the queue.
+     */
+    catchup_shutdown();
+    ondemand_stop_all("shutdown");
+    fullscan_shutdown(!g_handed_over);   /* The successor owns the index */
+    if (journal_active()) {
+        int left = threadpool_drop_queued(g_pool);
+        if (left)
+            log_info("%d queued scans left in the journal for the next "
+                     "start.", left);
+    }
     threadpool_shutdown(g_pool);
-
-    /* Final broadcast before closing IPC. */
-    alert_broadcast(ALERT_TYPE_STATUS, "sentinel", NULL, "Daemon stopping");
-    alert_server_service(100);
-    alert_server_shutdown();
-
-    quarantine_shutdown();
+    trace_shutdown();
+    if (!g_handed_over) catchup_checkpoint(g_caught_up_ns, 1);
+    journal_shutdown();
+    journal_free_entries(g_recovered, g_recovered_n);
+
+    /* Final broadcast before closing IPC — unless the clients moved on. */
+    if (!g_handed_over)
+        alert_broadcast(ALERT_TYPE_STATUS, "sentinel", NULL, "Daemon stopping");
+    stop_ipc();
+    reactor_destroy(g_reactor);
+
+    /* After a handover the manifest is the successor's: do not save it. */
+    if (!g_handed_over) quarantine_shutdown();
     scanner_shutdown();
 
     log_info("Sentinel daemon stopped.");
@@ -0,0 +1,656 @@
+/*
+ * metrics.c — Sharded counters/histograms and the Prometheus endpoint.
+ *
+ * Recording path (metrics_add / metrics_observe_ns):
+ *   1. First call on a thread allocates its shard and registers it in a
+ *      global table (the only locked step, once per thread).
+ *   2. Every call after that is a relaxed load + store on the thread's
+ *      own shard.  Single writer per shard → no locked instructions.
+ *      Threads beyond METRICS_MAX_THREADS fall back to one shared shard
+ *      updated with atomic adds.
+ *
+ * Scrapes sum every shard with relaxed loads.  A scrape racing a writer
+ * may miss the in-flight increment; it is never torn (64-bit stores).
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+#define HIST_SUB        (1u << METRICS_HIST_SUB_BITS)
+
+/* Smallest `le` bound exported: 2^10 ns ≈ 1 µs. */
+#define HIST_EXPORT_MIN_MSB 10
+
+/* Concurrent scrapers; more are refused at accept(). */
+#define METRICS_MAX_CLIENTS 4
+
+/* Largest reply buffered for one scraper; a bigger one drops the client. */
+#define METRICS_CLIENT_MAX_BYTES (1u << 20)
+
+/* A scraper still draining its reply after this long gives up its slot
+ * to a new connection. */
+#define METRICS_CLIENT_STALL_S   10
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t buckets[METRICS_HIST_BUCKETS];
+} hist_shard_t;
+
+typedef struct {
+    uint64_t     counters[METRICS_MAX_COUNTERS];
+    hist_shard_t hist[METRICS_MAX_HISTOGRAMS];
+} shard_t;
+
+typedef struct {
+    const char *name;
+    const char *help;
+} metric_def_t;
+
+/* A scraper connection and its pending reply. */
+typedef struct {
+    int     used;
+    int     fd;
+    char   *out;                /* Header + body, or NULL    */
+    size_t  len;
+    size_t  off;                /* Bytes already sent        */
+    time_t  since;              /* Accept time (monotonic)   */
+} client_t;
+
+typedef struct {
+    const char        *name;
+    const char        *help;
+    metrics_type_t     type;
+    metrics_sample_fn  fn;
+    void              *arg;
+} sampled_def_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static pthread_mutex_t s_metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static metric_def_t  s_counters[METRICS_MAX_COUNTERS];
+static metric_def_t  s_hists[METRICS_MAX_HISTOGRAMS];
+static sampled_def_t s_sampled[METRICS_MAX_SAMPLED];
+static int           s_ncounters = 0;
+static int           s_nhists    = 0;
+static int           s_nsampled  = 0;
+
+static shard_t      *s_shards[METRICS_MAX_THREADS];
+static int           s_nshards = 0;
+static shard_t       s_shared;                /* Overflow shard (atomic) */
+
+static __thread shard_t *tl_shard = NULL;
+
+static int           s_listen_fd = -1;
+static char          s_socket_path[108];     /* Matches sizeof(sun_path) */
+static reactor_t    *s_reactor   = NULL;
+static client_t      s_clients[METRICS_MAX_CLIENTS];  /* Reactor thread only */
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static shard_t *shard_get(void)
+{
+    if (tl_shard) return tl_shard;
+
+    shard_t *s = calloc(1, sizeof(*s));
+
+    pthread_mutex_lock(&s_metrics_mutex);
+    if (s && s_nshards < METRICS_MAX_THREADS) {
+        s_shards[s_nshards] = s;
+        __atomic_store_n(&s_nshards, s_nshards + 1, __ATOMIC_RELEASE);
+    } else {
+        free(s);
+        s = &s_shared;
+    }
+    pthread_mutex_unlock(&s_metrics_mutex);
+
+    tl_shard = s;
+    return s;
+}
+
+static inline void bump(const shard_t *s, uint64_t *slot, uint64_t n)
+{
+    if (s == &s_shared)
+        __atomic_fetch_add(slot, n, __ATOMIC_RELAXED);
+    else
+        __atomic_store_n(slot, __atomic_load_n(slot, __ATOMIC_RELAXED) + n,
+                         __ATOMIC_RELAXED);
+}
+
+static inline unsigned hist_index(uint64_t v)
+{
+    if (v < HIST_SUB) return (unsigned)v;
+
+    unsigned msb = 63u - (unsigned)__builtin_clzll(v);
+    if (msb > METRICS_HIST_MAX_MSB) return METRICS_HIST_BUCKETS - 1;
+
+    unsigned shift = msb - METRICS_HIST_SUB_BITS;
+    return ((msb - METRICS_HIST_SUB_BITS + 1) << METRICS_HIST_SUB_BITS) |
+           (unsigned)((v >> shift) & (HIST_SUB - 1));
+}
+
+/* Lower bound and width (ns) of bucket i. */
+static void hist_bucket_range(unsigned i, uint64_t *lower, uint64_t *width)
+{
+    if (i < HIST_SUB) {
+        *lower = i;
+        *width = 1;
+        return;
+    }
+    unsigned msb   = (i >> METRICS_HIST_SUB_BITS) + METRICS_HIST_SUB_BITS - 1;
+    unsigned shift = msb - METRICS_HIST_SUB_BITS;
+    *lower = (uint64_t)(HIST_SUB + (i & (HIST_SUB - 1))) << shift;
+    *width = 1ull << shift;
+}
+
+static int nshards(void)
+{
+    return __atomic_load_n(&s_nshards, __ATOMIC_ACQUIRE);
+}
+
+static int register_def(metric_def_t *defs, int *n, int max,
+                        const char *name, const char *help)
+{
+    pthread_mutex_lock(&s_metrics_mutex);
+    int id = -1;
+    if (*n < max) {
+        id = *n;
+        defs[id].name = name;
+        defs[id].help = help;
+        __atomic_store_n(n, id + 1, __ATOMIC_RELEASE);
+    } else {
+        log_warn("metrics: registry full, dropping %s", name);
+    }
+    pthread_mutex_unlock(&s_metrics_mutex);
+    return id;
+}
+
+/*
+ * Emit "# HELP" / "# TYPE" when `name` starts a new family (the part
+ * before any '{').  `last` remembers the previous family across calls.
+ */
+static void emit_family(FILE *fp, const char *name, const char *help,
+                        const char *type, const char **last)
+{
+    size_t len = strcspn(name, "{");
+    if (*last && strcspn(*last, "{") == len && strncmp(*last, name, len) == 0)
+        return;
+
+    fprintf(fp, "# HELP %.*s %s\n", (int)len, name, help);
+    fprintf(fp, "# TYPE %.*s %s\n", (int)len, name, type);
+    *last = name;
+}
+
+/** Set a file descriptor to non-blocking mode. */
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static time_t now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static void close_client(client_t *c)
+{
+    reactor_del_fd(s_reactor, c->fd);
+    close(c->fd);
+    free(c->out);
+    c->used = 0;
+    c->out  = NULL;
+}
+
+/*
+ * Send as much of the pending reply as the socket takes.
+ * @return 1 when all of it is out, 0 when the rest must wait for
+ *         EPOLLOUT, -1 on error.
+ */
+static int flush_client(client_t *c)
+{
+    while (c->off < c->len) {
+        ssize_t w = send(c->fd, c->out + c->off, c->len - c->off,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+        c->off += (size_t)w;
+    }
+    return 1;
+}
+
+/*
+ * Build the reply for a request: a line starting with "GET " gets an
+ * HTTP/1.0 response, anything else the bare exposition text.
+ * @return 0, or -1 if rendering failed or the reply is over the cap.
+ */
+static int build_reply(client_t *c, const char *req, size_t n)
+{
+    char *body = metrics_render();
+    if (!body) return -1;
+
+    size_t body_len = strlen(body);
+    char   hdr[160];
+    int    hdr_len  = 0;
+
+    if (n >= 4 && memcmp(req, "GET ", 4) == 0) {
+        hdr_len = snprintf(hdr, sizeof(hdr),
+                           "HTTP/1.0 200 OK\r\n"
+                           "Content-Type: text/plain; version=0.0.4\r\n"
+                           "Content-Length: %zu\r\n"
+                           "Connection: close\r\n\r\n", body_len);
+    }
+
+    size_t len = (size_t)hdr_len + body_len;
+    if (len > METRICS_CLIENT_MAX_BYTES) {
+        log_warn_rl("metrics: reply of %zu bytes over the %u byte cap",
+                    len, METRICS_CLIENT_MAX_BYTES);
+        free(body);
+        return -1;
+    }
+
+    /* Prepend the header in place: the body is already the bulk of it. */
+    char *out = realloc(body, len + 1);
+    if (!out) {
+        free(body);
+        return -1;
+    }
+    memmove(out + hdr_len, out, body_len + 1);
+    memcpy(out, hdr, (size_t)hdr_len);
+
+    c->out = out;
+    c->len = len;
+    c->off = 0;
+    return 0;
+}
+
+/*
+ * Reactor callback for a scraper.  The request is read once and not
+ * parsed.  The socket stays non-blocking: whatever of the reply does not
+ * fit in the socket buffer is kept on the client and drained on EPOLLOUT,
+ * so a slow reader never holds up the reactor.
+ */
+static void on_client_ready(int fd, uint32_t events, void *arg)
+{
+    (void)fd;
+    client_t *c = arg;
+
+    if (!c->out) {
+        char req[512];
+        ssize_t n = read(c->fd, req, sizeof(req));
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0 || build_reply(c, req, (size_t)n) != 0) {
+            close_client(c);
+            return;
+        }
+    } else if (events & (EPOLLERR | EPOLLHUP)) {
+        close_client(c);
+        return;
+    }
+
+    int rc = flush_client(c);
+    if (rc != 0) {
+        close_client(c);
+        return;
+    }
+    if (!(events & EPOLLOUT) &&
+        reactor_mod_fd(s_reactor, c->fd, EPOLLOUT | EPOLLRDHUP) != 0)
+        close_client(c);
+}
+
+/*
+ * A free client slot, or failing that the slot of a scraper that has
+ * been draining its reply for over METRICS_CLIENT_STALL_S (closed).
+ */
+static client_t *claim_slot(void)
+{
+    time_t    now   = now_s();
+    client_t *stale = NULL;
+
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        client_t *c = &s_clients[i];
+        if (!c->used) return c;
+        if (!stale && now - c->since > METRICS_CLIENT_STALL_S) stale = c;
+    }
+    if (stale) {
+        log_warn_rl("metrics: dropping scraper stalled for over %ds",
+                    METRICS_CLIENT_STALL_S);
+        close_client(stale);
+    }
+    return stale;
+}
+
+/** Reactor callback for the listening socket. */
+static void on_listen_ready(int fd, uint32_t events, void *arg)
+{
+    (void)events;
+    (void)arg;
+
+    for (;;) {
+        int client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                log_warn_rl("metrics: accept(): %s", strerror(errno));
+            return;
+        }
+
+        client_t *c = claim_slot();
+        if (!c || reactor_add_fd(s_reactor, client_fd, EPOLLIN | EPOLLRDHUP,
+                                 on_client_ready, c) != 0) {
+            close(client_fd);
+            continue;
+        }
+        c->used  = 1;
+        c->fd    = client_fd;
+        c->since = now_s();
+    }
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+int metrics_counter(const char *name, const char *help)
+{
+    return register_def(s_counters, &s_ncounters, METRICS_MAX_COUNTERS,
+                        name, help);
+}
+
+int metrics_histogram(const char *name, const char *help)
+{
+    return register_def(s_hists, &s_nhists, METRICS_MAX_HISTOGRAMS,
+                        name, help);
+}
+
+int metrics_sampled(const char *name, const char *help,
+                    metrics_type_t type, metrics_sample_fn fn, void *arg)
+{
+    if (!fn) return -1;
+
+    pthread_mutex_lock(&s_metrics_mutex);
+    int id = -1;
+    if (s_nsampled < METRICS_MAX_SAMPLED) {
+        id = s_nsampled;
+        s_sampled[id] = (sampled_def_t){ name, help, type, fn, arg };
+        __atomic_store_n(&s_nsampled, id + 1, __ATOMIC_RELEASE);
+    } else {
+        log_warn("metrics: registry full, dropping %s", name);
+    }
+    pthread_mutex_unlock(&s_metrics_mutex);
+    return id;
+}
+
+void metrics_add(int counter_id, uint64_t n)
+{
+    if ((unsigned)counter_id >= METRICS_MAX_COUNTERS) return;
+
+    shard_t *s = shard_get();
+    bump(s, &s->counters[counter_id], n);
+}
+
+void metrics_observe_ns(int hist_id, uint64_t ns)
+{
+    if ((unsigned)hist_id >= METRICS_MAX_HISTOGRAMS) return;
+
+    shard_t      *s = shard_get();
+    hist_shard_t *h = &s->hist[hist_id];
+    bump(s, &h->buckets[hist_index(ns)], 1);
+    bump(s, &h->sum_ns, ns);
+    bump(s, &h->count, 1);
+}
+
+uint64_t metrics_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t metrics_counter_value(int counter_id)
+{
+    if ((unsigned)counter_id >= METRICS_MAX_COUNTERS) return 0;
+
+    uint64_t total = __atomic_load_n(&s_shared.counters[counter_id],
+                                     __ATOMIC_RELAXED);
+    int n = nshards();
+    for (int i = 0; i < n; i++)
+        total += __atomic_load_n(&s_shards[i]->counters[counter_id],
+                                 __ATOMIC_RELAXED);
+    return total;
+}
+
+int metrics_hist_snapshot(int hist_id, metrics_hist_snapshot_t *out)
+{
+    if ((unsigned)hist_id >= METRICS_MAX_HISTOGRAMS || !out) return -1;
+
+    memset(out, 0, sizeof(*out));
+
+    int n = nshards();
+    for (int i = -1; i < n; i++) {
+        const hist_shard_t *h = (i < 0) ? &s_shared.hist[hist_id]
+                                        : &s_shards[i]->hist[hist_id];
+        out->count  += __atomic_load_n(&h->count,  __ATOMIC_RELAXED);
+        out->sum_ns += __atomic_load_n(&h->sum_ns, __ATOMIC_RELAXED);
+        for (unsigned b = 0; b < METRICS_HIST_BUCKETS; b++)
+            out->buckets[b] += __atomic_load_n(&h->buckets[b], __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+uint64_t metrics_hist_quantile(const metrics_hist_snapshot_t *snap, double q)
+{
+    if (!snap) return 0;
+
+    /* Use the bucket total, not `count`: they may differ by in-flight adds. */
+    uint64_t total = 0;
+    for (unsigned b = 0; b < METRICS_HIST_BUCKETS; b++) total += snap->buckets[b];
+    if (total == 0) return 0;
+
+    if (q < 0.0) q = 0.0;
+    if (q > 1.0) q = 1.0;
+    uint64_t rank = (uint64_t)(q * (double)(total - 1)) + 1;
+
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < METRICS_HIST_BUCKETS; b++) {
+        seen += snap->buckets[b];
+        if (seen >= rank) {
+            uint64_t lower, width;
+            hist_bucket_range(b, &lower, &width);
+            return lower + width / 2;
+        }
+    }
+    return 0;
+}
+
+char *metrics_render(void)
+{
+    char  *buf = NULL;
+    size_t len = 0;
+    FILE  *fp  = open_memstream(&buf, &len);
+    if (!fp) return NULL;
+
+    const char *last = NULL;
+
+    int nc = __atomic_load_n(&s_ncounters, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < nc; i++) {
+        emit_family(fp, s_counters[i].name, s_counters[i].help, "counter", &last);
+        fprintf(fp, "%s %llu\n", s_counters[i].name,
+                (unsigned long long)metrics_counter_value(i));
+    }
+
+    int ns = __atomic_load_n(&s_nsampled, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < ns; i++) {
+        const sampled_def_t *d = &s_sampled[i];
+        emit_family(fp, d->name, d->help,
+                    d->type == METRICS_COUNTER ? "counter" : "gauge", &last);
+        fprintf(fp, "%s %.17g\n", d->name, d->fn(d->arg));
+    }
+
+    metrics_hist_snapshot_t *snap = malloc(sizeof(*snap));
+    int nh = __atomic_load_n(&s_nhists, __ATOMIC_ACQUIRE);
+    for (int i = 0; snap && i < nh; i++) {
+        const char *name = s_hists[i].name;
+        emit_family(fp, name, s_hists[i].help, "histogram", &last);
+        metrics_hist_snapshot(i, snap);
+
+        /* Split "family{labels}" so `le` can join the series' labels. */
+        int         blen   = (int)strcspn(name, "{");
+        const char *labels = name[blen] ? name + blen + 1 : "";
+        int         llen   = (int)strcspn(labels, "}");
+        const char *sep    = llen ? "," : "";
+
+        /* Export cumulative counts at every power of two (exact, since
+         * HDR buckets never straddle one). */
+        uint64_t cum = 0;
+        for (unsigned b = 0; b < METRICS_HIST_BUCKETS; b++) {
+            if (b >= HIST_SUB && (b & (HIST_SUB - 1)) == 0) {
+                uint64_t lower, width;
+                hist_bucket_range(b, &lower, &width);
+                if (lower >= (1ull << HIST_EXPORT_MIN_MSB))
+                    fprintf(fp, "%.*s_bucket{%.*s%sle=\"%.9g\"} %llu\n",
+                            blen, name, llen, labels, sep,
+                            (double)lower / 1e9, (unsigned long long)cum);
+            }
+            cum += snap->buckets[b];
+        }
+        fprintf(fp, "%.*s_bucket{%.*s%sle=\"+Inf\"} %llu\n",
+                blen, name, llen, labels, sep, (unsigned long long)cum);
+        fprintf(fp, "%.*s_sum%s%.*s%s %.9f\n", blen, name,
+                llen ? "{" : "", llen, labels, llen ? "}" : "",
+                (double)snap->sum_ns / 1e9);
+        fprintf(fp, "%.*s_count%s%.*s%s %llu\n", blen, name,
+                llen ? "{" : "", llen, labels, llen ? "}" : "",
+                (unsigned long long)cum);
+    }
+    free(snap);
+
+    if (fclose(fp) != 0) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+int metrics_server_init(const char *socket_path)
+{
+    const char *path = socket_path ? socket_path : METRICS_SOCKET_PATH;
+    snprintf(s_socket_path, sizeof(s_socket_path), "%s", path);
+
+    /* Remove stale socket file if it exists. */
+    unlink(s_socket_path);
+
+    s_listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s_listen_fd < 0) {
+        log_error("socket(AF_UNIX): %s", strerror(errno));
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", s_socket_path);
+
+    if (bind(s_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        log_error("bind(%s): %s", s_socket_path, strerror(errno));
+        close(s_listen_fd);
+        s_listen_fd = -1;
+        return -1;
+    }
+
+    /* Root plus the socket's group (e.g. a node-exporter sidecar). */
+    if (chmod(s_socket_path, METRICS_SOCKET_PERMS) != 0) {
+        log_warn("chmod(%s, 0%o): %s", s_socket_path, METRICS_SOCKET_PERMS,
+                 strerror(errno));
+    }
+
+    if (listen(s_listen_fd, METRICS_MAX_CLIENTS) < 0) {
+        log_error("listen(%s): %s", s_socket_path, strerror(errno));
+        close(s_listen_fd);
+        unlink(s_socket_path);
+        s_listen_fd = -1;
+        return -1;
+    }
+
+    set_nonblocking(s_listen_fd);
+
+    log_info("Metrics endpoint listening on %s", s_socket_path);
+    return 0;
+}
+
+int metrics_server_attach(reactor_t *r)
+{
+    if (!r || s_listen_fd < 0) return -1;
+    s_reactor = r;
+    return reactor_add_fd(r, s_listen_fd, EPOLLIN, on_listen_ready, NULL);
+}
+
+void metrics_server_export(handover_msg_t *msg)
+{
+    /* The endpoint is optional: it may never have been bound. */
+    handover_put_u32(msg, HANDOVER_TAG_METRICS);
+    handover_put_u32(msg, s_listen_fd >= 0);
+    if (s_listen_fd < 0) return;
+    handover_put_str(msg, s_socket_path);
+    handover_put_fd(msg, s_listen_fd);
+}
+
+int metrics_server_adopt(handover_msg_t *msg)
+{
+    uint32_t present = 0;
+    if (handover_expect(msg, HANDOVER_TAG_METRICS) != 0 ||
+        handover_get_u32(msg, &present) != 0) {
+        log_error("Malformed metrics state in handover");
+        return -1;
+    }
+    if (!present) return -1;    /* Predecessor had no endpoint either */
+    if (handover_get_str(msg, s_socket_path, sizeof(s_socket_path)) != 0 ||
+        handover_get_fd(msg, &s_listen_fd) != 0) {
+        log_error("Malformed metrics state in handover");
+        return -1;
+    }
+
+    log_info("Metrics endpoint adopted on %s", s_socket_path);
+    return 0;
+}
+
+void metrics_server_shutdown(void)
+{
+    if (s_listen_fd < 0) return;
+
+    metrics_server_release();
+    unlink(s_socket_path);
+}
+
+void metrics_server_release(void)
+{
+    if (s_listen_fd < 0) return;
+
+    reactor_del_fd(s_reactor, s_listen_fd);
+    close(s_listen_fd);
+    s_listen_fd = -1;
+
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++)
+        if (s_clients[i].used) close_client(&s_clients[i]);
+}
@@ -2,7 +2,9 @@
  * monitor.c — Recursive inotify file-system watcher with graceful limits.
  *
  * Watches configured directories for IN_CLOSE_WRITE and IN_CREATE events
- * and dispatches file paths to the registered callback.
+ * and dispatches file paths to the registered callback.  The inotify fd
+ * is non-blocking and driven by the daemon's reactor: when it becomes
+ * readable, monitor_process_events() drains it.
  *
  * Fix 3: Handles ENOSPC (watch limit exhaustion) gracefully by logging
  * a clear warning with instructions rather than crashing.
@@ -32,6 +34,10 @@
 
 #include "monitor.h"
 #include "logger.h"
+#include "flightrec.h"
+#include "evtrace.h"
+#include "metrics.h"
+#include "probes.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,7 +48,6 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/inotify.h>
-#include <poll.h>
 #include <pthread.h>
 
 /* ── Internal types ─────────────────────────────────────────────────────── */
@@ -58,7 +63,6 @@ typedef struct wd_entry {
 
 struct monitor_ctx {
     int                inotify_fd;
-    volatile int       running;
 
     monitor_callback_t callback;
     void              *user_data;
@@ -69,6 +73,17 @@ struct monitor_ctx {
     int                watches_added;   /* Successfully registered watches  */
     int                watches_failed;  /* Watches that hit ENOSPC          */
     int                enospc_logged;   /* Have we already logged the hint? */
+
+    /* ── Event buffer, kept across calls for MONITOR_CB_BUSY redelivery ─ */
+    char               ev_buf[8192]
+                       __attribute__((aligned(__alignof__(struct inotify_event))));
+    size_t             ev_len;          /* Valid bytes in ev_buf            */
+    size_t             ev_pos;          /* Next undelivered event           */
+    uint64_t           ev_ts;           /* When ev_buf was read (mono ns)   */
+
+    /* ── Metric IDs ───────────────────────────────────────────────── */
+    int                m_events;        /* File events handed to callback   */
+    int                m_overflows;     /* IN_Q_OVERFLOW seen               */
 };
 
 /* ── Watch-descriptor map helpers ───────────────────────────────────────── */
@@ -178,6 +193,23 @@ static int add_watch_recursive(monitor_ctx_t *ctx, const char *dir_path)
     return 0;
 }
 
+/* Context with callback and metrics set; the caller supplies the fd. */
+static monitor_ctx_t *ctx_new(monitor_callback_t callback, void *user_data)
+{
+    monitor_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) return NULL;
+
+    ctx->inotify_fd = -1;
+    ctx->callback   = callback;
+    ctx->user_data  = user_data;
+
+    ctx->m_events    = metrics_counter("sentinel_inotify_events_total",
+                           "File events delivered to the scan pipeline");
+    ctx->m_overflows = metrics_counter("sentinel_inotify_overflows_total",
+                           "Kernel inotify queue overflows (events lost)");
+    return ctx;
+}
+
 /* ── Public API ─────────────────────────────────────────────────────────── */
 
 monitor_ctx_t *monitor_create(const char **dirs,
@@ -186,13 +218,9 @@ monitor_ctx_t *monitor_create(const char **dirs,
 {
     if (!dirs || !callback) return NULL;
 
-    monitor_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    monitor_ctx_t *ctx = ctx_new(callback, user_data);
     if (!ctx) return NULL;
 
-    ctx->callback  = callback;
-    ctx->user_data = user_data;
-    ctx->running   = 1;
-
     ctx->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     if (ctx->inotify_fd < 0) {
         log_error("inotify_init1(): %s", strerror(errno));
@@ -200,6 +228,7 @@ monitor_ctx_t *monitor_create(const char **dirs,
         return NULL;
     }
 
+    uint64_t t0 = metrics_now_ns();
     for (int i = 0; dirs[i]; i++) {
         log_info("Adding recursive watch on: %s", dirs[i]);
         if (add_watch_recursive(ctx, dirs[i]) < 0) {
@@ -208,8 +237,11 @@ monitor_ctx_t *monitor_create(const char **dirs,
     }
 
     /* ── Fix 3: Print watch summary ───────────────────────────────── */
-    log_info("Inotify watch summary: %d added, %d failed (ENOSPC)",
-             ctx->watches_added, ctx->watches_failed);
+    double secs = (double)(metrics_now_ns() - t0) / 1e9;
+    int    dirs_seen = ctx->watches_added + ctx->watches_failed;
+    log_info("Inotify watch summary: %d added, %d failed (ENOSPC) in %.2f s "
+             "(%.0f dirs/s)", ctx->watches_added, ctx->watches_failed, secs,
+             secs > 0 ? dirs_seen / secs : 0.0);
 
     if (ctx->watches_failed > 0) {
         log_warn("%d directories are NOT being monitored due to watch "
@@ -220,76 +252,175 @@ monitor_ctx_t *monitor_create(const char **dirs,
     return ctx;
 }
 
-int monitor_run(monitor_ctx_t *ctx)
+int monitor_get_fd(monitor_ctx_t *ctx)
+{
+    return ctx ? ctx->inotify_fd : -1;
+}
+
+int monitor_get_watch_count(monitor_ctx_t *ctx)
+{
+    return ctx ? ctx->watches_added : 0;
+}
+
+int monitor_process_events(monitor_ctx_t *ctx)
 {
     if (!ctx) return -1;
 
-    /*
-     * Aligned buffer for inotify events.
-     * Each event is sizeof(struct inotify_event) + name_len.
-     */
-    char buf[8192] __attribute__((aligned(__alignof__(struct inotify_event))));
-
-    struct pollfd pfd = {
-        .fd     = ctx->inotify_fd,
-        .events = POLLIN
-    };
-
-    log_info("Monitor event loop started.");
-
-    while (ctx->running) {
-        int ret = poll(&pfd, 1, 500);    /* 500 ms timeout for shutdown check */
-        if (ret < 0) {
-            if (errno == EINTR) continue;
-            log_error("poll(): %s", strerror(errno));
-            return -1;
+    for (;;) {
+        /* Refill only once everything from the last read was delivered. */
+        if (ctx->ev_pos >= ctx->ev_len) {
+            ssize_t len = read(ctx->inotify_fd, ctx->ev_buf, sizeof(ctx->ev_buf));
+            if (len < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+                if (errno == EINTR) continue;
+                log_error("read(inotify): %s", strerror(errno));
+                return -1;
+            }
+            if (len == 0) return 0;
+            ctx->ev_len = (size_t)len;
+            ctx->ev_pos = 0;
+            ctx->ev_ts  = metrics_now_ns();
         }
-        if (ret == 0) continue;          /* timeout — loop back */
 
-        ssize_t len = read(ctx->inotify_fd, buf, sizeof(buf));
-        if (len <= 0) continue;
+        while (ctx->ev_pos < ctx->ev_len) {
+            const struct inotify_event *event =
+                (const struct inotify_event *)(ctx->ev_buf + ctx->ev_pos);
+            size_t next = ctx->ev_pos + sizeof(struct inotify_event) + event->len;
 
-        const struct inotify_event *event;
-        for (char *ptr = buf; ptr < buf + len;
-             ptr += sizeof(struct inotify_event) + event->len) {
-
-            event = (const struct inotify_event *)ptr;
-            if (event->len == 0) continue;
+            if (event->mask & IN_Q_OVERFLOW) {
+                metrics_inc(ctx->m_overflows);
+                evtrace_record(ctx->ev_ts, "", event->mask, -1);
+                log_warn_rl("inotify queue overflowed — some file events "
+                            "were lost (raise fs.inotify.max_queued_events)");
+            }
 
-            /* Skip hidden files and directories */
-            if (event->name[0] == '.') continue;
+            if (event->len == 0 || event->name[0] == '.') {
+                /* No name, or a hidden file/directory — skip. */
+                ctx->ev_pos = next;
+                continue;
+            }
 
             const char *parent = wd_map_get(ctx, event->wd);
-            if (!parent) continue;
+            if (!parent) {
+                ctx->ev_pos = next;
+                continue;
+            }
 
             char fullpath[8192];
             snprintf(fullpath, sizeof(fullpath), "%s/%s", parent, event->name);
+            fr_record(FR_EV_EVENT_RECEIVED, fullpath, event->mask);
 
             /* If a new sub-directory is created, add a recursive watch. */
             if (event->mask & IN_ISDIR) {
+                evtrace_record(ctx->ev_ts, fullpath, event->mask, -1);
                 if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
                     add_watch_recursive(ctx, fullpath);
-                    log_info("New directory watch added: %s", fullpath);
+                    log_info_rl("New directory watch added: %s", fullpath);
                 }
+                ctx->ev_pos = next;
                 continue;   /* Don't scan directories themselves. */
             }
 
             /* Regular file event → invoke callback. */
             struct stat st;
             if (stat(fullpath, &st) == 0 && S_ISREG(st.st_mode)) {
-                log_info("File event detected: %s", fullpath);
-                ctx->callback(fullpath, ctx->user_data);
+                log_info_rl("File event detected: %s", fullpath);
+                SENTINEL_PROBE3(event_received, fullpath, event->mask,
+                                (int64_t)st.st_size);
+                monitor_event_t ev = {
+                    .path  = fullpath,
+                    .mask  = event->mask,
+                    .ts_ns = ctx->ev_ts,
+                    .size  = (int64_t)st.st_size
+                };
+                if (ctx->callback(&ev, ctx->user_data) == MONITOR_CB_BUSY)
+                    return MONITOR_BUSY;      /* Keep ev_pos: redeliver. */
+                metrics_inc(ctx->m_events);
+                /* Recorded once delivered, so redeliveries are not doubled. */
+                evtrace_record(ctx->ev_ts, fullpath, event->mask, ev.size);
+            } else {
+                evtrace_record(ctx->ev_ts, fullpath, event->mask, -1);
             }
+            ctx->ev_pos = next;
         }
     }
+}
 
-    log_info("Monitor event loop exited.");
-    return 0;
+void monitor_export(monitor_ctx_t *ctx, handover_msg_t *msg)
+{
+    uint32_t entries = 0;
+    for (int i = 0; i < WD_MAP_BUCKETS; i++) {
+        for (wd_entry_t *e = ctx->wd_map[i]; e; e = e->next) entries++;
+    }
+
+    handover_put_u32(msg, HANDOVER_TAG_MONITOR);
+    handover_put_fd(msg, ctx->inotify_fd);
+    handover_put_u32(msg, (uint32_t)ctx->watches_added);
+    handover_put_u32(msg, (uint32_t)ctx->watches_failed);
+    handover_put_u32(msg, entries);
+    for (int i = 0; i < WD_MAP_BUCKETS; i++) {
+        for (wd_entry_t *e = ctx->wd_map[i]; e; e = e->next) {
+            handover_put_u32(msg, (uint32_t)e->wd);
+            handover_put_str(msg, e->path);
+        }
+    }
+
+    /* Events read from the kernel but not delivered yet (pushback). */
+    handover_put_u64(msg, ctx->ev_ts);
+    handover_put_u32(msg, (uint32_t)(ctx->ev_len - ctx->ev_pos));
+    handover_put_bytes(msg, ctx->ev_buf + ctx->ev_pos,
+                       ctx->ev_len - ctx->ev_pos);
 }
 
-void monitor_stop(monitor_ctx_t *ctx)
+monitor_ctx_t *monitor_adopt(handover_msg_t *msg,
+                             monitor_callback_t callback,
+                             void *user_data)
 {
-    if (ctx) ctx->running = 0;
+    if (!msg || !callback) return NULL;
+    if (handover_expect(msg, HANDOVER_TAG_MONITOR) != 0) return NULL;
+
+    monitor_ctx_t *ctx = ctx_new(callback, user_data);
+    if (!ctx) return NULL;
+
+    uint32_t added = 0, failed = 0, entries = 0, pending = 0;
+    if (handover_get_fd(msg, &ctx->inotify_fd) != 0 ||
+        handover_get_u32(msg, &added) != 0 ||
+        handover_get_u32(msg, &failed) != 0 ||
+        handover_get_u32(msg, &entries) != 0)
+        goto fail;
+
+    ctx->watches_added  = (int)added;
+    ctx->watches_failed = (int)failed;
+    ctx->enospc_logged  = failed > 0;
+
+    char path[sizeof(((wd_entry_t *)0)->path)];
+    for (uint32_t i = 0; i < entries; i++) {
+        uint32_t wd;
+        if (handover_get_u32(msg, &wd) != 0 ||
+            handover_get_str(msg, path, sizeof(path)) != 0)
+            goto fail;
+        wd_map_put(ctx, (int)wd, path);
+    }
+
+    const void *ev;
+    if (handover_get_u64(msg, &ctx->ev_ts) != 0 ||
+        handover_get_u32(msg, &pending) != 0 ||
+        pending > sizeof(ctx->ev_buf) ||
+        handover_get_bytes(msg, &ev, pending) != 0)
+        goto fail;
+    memcpy(ctx->ev_buf, ev, pending);
+    ctx->ev_len = pending;
+    ctx->ev_pos = 0;
+
+    log_info("Adopted inotify fd: %d watches (%d failed), %u bytes of "
+             "events pending", ctx->watches_added, ctx->watches_failed,
+             pending);
+    return ctx;
+
+fail:
+    log_error("Malformed monitor state in handover");
+    monitor_destroy(ctx);
+    return NULL;
 }
 
 void monitor_destroy(monitor_ctx_t *ctx)
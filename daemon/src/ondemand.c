@@ -0,0 +1,492 @@
+/*
+ * ondemand.c — On-demand scans requested over IPC (see ondemand.h).
+ *
+ * Each scan owns a slot.  Crawler threads count what they find and feed
+ * the pool's background lane with try-submit, backing off while it is
+ * full, so cancelling is always quick; workers report every finished
+ * job back by scan ID.  A slot is reaped by the reactor tick once its
+ * crawl has ended and every job it queued has come back, so a late job
+ * can never land in a slot reused by another scan.
+ *
+ * Counters are updated with atomics; s_mutex guards slot ownership and
+ * the crawl handles.  Nothing here calls into alert.c with s_mutex held:
+ * a failed send closes the client, which calls ondemand_client_gone().
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "ondemand.h"
+#include "alert.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <json-c/json.h>
+
+/* Pseudo filesystems not worth walking when asked to scan "/". */
+static const char *const PRUNED_DIRS[] = { "/proc", "/sys", "/dev", "/run" };
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+typedef struct {
+    uint32_t    id;              /* 0: free slot                          */
+    int         client_fd;       /* -1 once the client has gone           */
+    char        path[PATH_MAX];
+    crawl_t    *crawl;           /* NULL for a single file, or joined     */
+    int         file_pending;    /* Single file not yet in the lane       */
+    int         crawl_done;      /* Crawl ended (or nothing to crawl)     */
+    int         cancelled;
+    int         reported;        /* scan_complete already sent            */
+    const char *reason;          /* Why it was cancelled                  */
+    uint64_t    t0_ns;
+    uint64_t    dirs;            /* From the crawl, once done             */
+
+    /* Crawler side */
+    uint64_t    files;           /* Regular files found                   */
+    uint64_t    ignored;         /* Rejected by the filter                */
+    uint64_t    queued;
+    uint64_t    bytes_queued;
+
+    /* Worker side */
+    uint64_t    finished;        /* Every outcome                         */
+    uint64_t    scanned;         /* Clean, infected or error              */
+    uint64_t    bytes_done;      /* Bytes of finished jobs                */
+    uint64_t    bytes_scanned;
+    uint64_t    detections;
+    uint64_t    errors;
+} scan_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static threadpool_t       *s_pool    = NULL;
+static ondemand_filter_fn  s_filter  = NULL;
+static scan_t              s_scans[ONDEMAND_MAX_SCANS];
+static uint32_t            s_next_id = 0;
+static pthread_mutex_t     s_mutex   = PTHREAD_MUTEX_INITIALIZER;
+
+static int                 s_m_scans = -1;
+static int                 s_m_files = -1;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static uint64_t ld(const uint64_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static void add(uint64_t *p, uint64_t n)
+{
+    __atomic_fetch_add(p, n, __ATOMIC_RELAXED);
+}
+
+/* Slot running scan `id`.  Caller holds s_mutex. */
+static scan_t *find_locked(uint32_t id)
+{
+    if (!id) return NULL;
+    for (int i = 0; i < ONDEMAND_MAX_SCANS; i++)
+        if (s_scans[i].id == id) return &s_scans[i];
+    return NULL;
+}
+
+/* Stop feeding the pool.  Caller holds s_mutex. */
+static void cancel_locked(scan_t *s, const char *reason)
+{
+    if (!s->cancelled) s->reason = reason;
+    __atomic_store_n(&s->cancelled, 1, __ATOMIC_RELAXED);
+    if (s->crawl) crawl_cancel(s->crawl);
+    if (s->file_pending) {
+        s->file_pending = 0;
+        __atomic_store_n(&s->crawl_done, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static void send_error(int client_fd, const char *path, const char *error)
+{
+    struct json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "event", json_object_new_string("scan_error"));
+    json_object_object_add(jobj, "path", json_object_new_string(path));
+    json_object_object_add(jobj, "error", json_object_new_string(error));
+    alert_send_to_client(client_fd, json_object_to_json_string(jobj));
+    json_object_put(jobj);
+}
+
+/*
+ * Progress or completion event for `s`, as a malloc()ed string.  Caller
+ * holds s_mutex (for the slot fields; the counters are atomics).
+ */
+static char *render_locked(const scan_t *s, int final)
+{
+    uint64_t now     = metrics_now_ns();
+    double   elapsed = (double)(now - s->t0_ns) / 1e9;
+    uint64_t queued  = ld(&s->bytes_queued);
+    uint64_t done    = ld(&s->bytes_done);
+    int      crawling = !__atomic_load_n(&s->crawl_done, __ATOMIC_ACQUIRE);
+
+    struct json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "event", json_object_new_string(
+        final ? "scan_complete" : "scan_progress"));
+    json_object_object_add(jobj, "scan_id", json_object_new_int64(s->id));
+    json_object_object_add(jobj, "path", json_object_new_string(s->path));
+    if (final) {
+        json_object_object_add(jobj, "status", json_object_new_string(
+            s->cancelled ? "cancelled" : "done"));
+        if (s->cancelled)
+            json_object_object_add(jobj, "reason",
+                json_object_new_string(s->reason ? s->reason : "client"));
+        json_object_object_add(jobj, "dirs",
+            json_object_new_int64((int64_t)s->dirs));
+    } else {
+        json_object_object_add(jobj, "crawling",
+            json_object_new_boolean(crawling));
+    }
+    json_object_object_add(jobj, "files",
+        json_object_new_int64((int64_t)ld(&s->files)));
+    json_object_object_add(jobj, "ignored",
+        json_object_new_int64((int64_t)ld(&s->ignored)));
+    json_object_object_add(jobj, "queued",
+        json_object_new_int64((int64_t)ld(&s->queued)));
+    json_object_object_add(jobj, "scanned",
+        json_object_new_int64((int64_t)ld(&s->scanned)));
+    json_object_object_add(jobj, "bytes_queued",
+        json_object_new_int64((int64_t)queued));
+    json_object_object_add(jobj, "bytes_scanned",
+        json_object_new_int64((int64_t)ld(&s->bytes_scanned)));
+    json_object_object_add(jobj, "detections",
+        json_object_new_int64((int64_t)ld(&s->detections)));
+    json_object_object_add(jobj, "errors",
+        json_object_new_int64((int64_t)ld(&s->errors)));
+    json_object_object_add(jobj, "elapsed_s",
+        json_object_new_double(elapsed));
+    if (!final) {
+        /* Bytes still queued at the rate so far; a lower bound while
+         * the crawl is still finding files.  -1: no rate yet. */
+        double eta = -1.0;
+        if (done > 0 && elapsed > 0.0)
+            eta = (double)(queued > done ? queued - done : 0) /
+                  ((double)done / elapsed);
+        json_object_object_add(jobj, "eta_s", json_object_new_double(eta));
+    }
+
+    char *out = strdup(json_object_to_json_string(jobj));
+    json_object_put(jobj);
+    return out;
+}
+
+/* ── Crawl callbacks (crawler threads) ──────────────────────────────────── */
+
+static int on_dir(const char *path, const struct statx *stx, void *arg)
+{
+    (void)stx;
+    (void)arg;
+    for (size_t i = 0; i < sizeof(PRUNED_DIRS) / sizeof(PRUNED_DIRS[0]); i++)
+        if (strcmp(path, PRUNED_DIRS[i]) == 0) return CRAWL_PRUNE;
+    return CRAWL_ENTER;
+}
+
+static int on_file(const char *path, const struct statx *stx, void *arg)
+{
+    scan_t *s = arg;
+    add(&s->files, 1);
+
+    if (!s_filter(path, (int64_t)stx->stx_size)) {
+        add(&s->ignored, 1);
+        return 0;
+    }
+
+    for (;;) {
+        if (__atomic_load_n(&s->cancelled, __ATOMIC_RELAXED)) return -1;
+
+        int rc = threadpool_try_submit_bg(s_pool, path, s->id);
+        if (rc < 0)  return -1;                /* Pool shutting down */
+        if (rc == 0) break;
+
+        struct timespec ts = { 0, ONDEMAND_THROTTLE_MS * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    add(&s->queued, 1);
+    add(&s->bytes_queued, stx->stx_size);
+    metrics_inc(s_m_files);
+    return 0;
+}
+
+static void on_done(const crawl_stats_t *st, void *arg)
+{
+    scan_t *s = arg;
+    s->dirs = st->dirs;
+    __atomic_store_n(&s->crawl_done, 1, __ATOMIC_RELEASE);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+int ondemand_init(threadpool_t *pool, ondemand_filter_fn filter)
+{
+    if (!pool || !filter) return -1;
+    s_pool   = pool;
+    s_filter = filter;
+
+    if (s_m_scans < 0) {
+        s_m_scans = metrics_counter("sentinel_ondemand_scans_total",
+                        "On-demand scans started over IPC");
+        s_m_files = metrics_counter("sentinel_ondemand_files_total",
+                        "Files queued by on-demand scans");
+    }
+    return 0;
+}
+
+int ondemand_start(int client_fd, const char *path)
+{
+    if (!s_pool) {
+        send_error(client_fd, path ? path : "", "on-demand scans unavailable");
+        return -1;
+    }
+    if (!path || path[0] != '/') {
+        send_error(client_fd, path ? path : "", "path must be absolute");
+        return -1;
+    }
+
+    char        real[PATH_MAX];
+    struct stat st;
+    if (!realpath(path, real) || stat(real, &st) != 0) {
+        send_error(client_fd, path, strerror(errno));
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) {
+        send_error(client_fd, path, "not a regular file or directory");
+        return -1;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+    scan_t *s = NULL;
+    for (int i = 0; i < ONDEMAND_MAX_SCANS && !s; i++)
+        if (!s_scans[i].id) s = &s_scans[i];
+    if (!s) {
+        pthread_mutex_unlock(&s_mutex);
+        send_error(client_fd, path, "too many scans running");
+        return -1;
+    }
+
+    memset(s, 0, sizeof(*s));
+    if (++s_next_id == 0) s_next_id = 1;
+    s->id        = s_next_id;
+    s->client_fd = client_fd;
+    s->t0_ns     = metrics_now_ns();
+    snprintf(s->path, sizeof(s->path), "%s", real);
+
+    if (S_ISREG(st.st_mode)) {
+        /* Queued below, or from the tick if the lane is full. */
+        s->files = 1;
+        if (s_filter(real, (int64_t)st.st_size)) {
+            s->file_pending = 1;
+            s->bytes_queued = (uint64_t)st.st_size;
+        } else {
+            s->ignored    = 1;
+            s->crawl_done = 1;
+        }
+    } else {
+        const char  *roots[] = { s->path, NULL };
+        crawl_opts_t o = {
+            .threads   = ONDEMAND_THREADS,
+            .file_mask = STATX_SIZE,
+            .on_dir    = on_dir,
+            .on_file   = on_file,
+            .on_done   = on_done,
+            .arg       = s,
+        };
+        s->crawl = crawl_start(roots, &o);
+        if (!s->crawl) {
+            s->id = 0;
+            pthread_mutex_unlock(&s_mutex);
+            send_error(client_fd, path, "cannot start the crawl");
+            return -1;
+        }
+    }
+    if (s->file_pending &&
+        threadpool_try_submit_bg(s_pool, s->path, s->id) == 0) {
+        s->file_pending = 0;
+        s->queued       = 1;
+        s->crawl_done   = 1;
+        metrics_inc(s_m_files);
+    }
+    uint32_t id = s->id;
+    pthread_mutex_unlock(&s_mutex);
+
+    metrics_inc(s_m_scans);
+    log_info("On-demand scan %u of %s started (fd=%d).", id, real, client_fd);
+
+    struct json_object *jobj = json_object_new_object();
+    json_object_object_add(jobj, "event", json_object_new_string("scan_started"));
+    json_object_object_add(jobj, "scan_id", json_object_new_int64(id));
+    json_object_object_add(jobj, "path", json_object_new_string(real));
+    alert_send_to_client(client_fd, json_object_to_json_string(jobj));
+    json_object_put(jobj);
+    return (int)id;
+}
+
+int ondemand_cancel(int client_fd, uint32_t id)
+{
+    int n = 0;
+    pthread_mutex_lock(&s_mutex);
+    for (int i = 0; i < ONDEMAND_MAX_SCANS; i++) {
+        scan_t *s = &s_scans[i];
+        if (!s->id || s->cancelled || s->client_fd != client_fd) continue;
+        if (id && s->id != id) continue;
+        cancel_locked(s, "client");
+        n++;
+    }
+    pthread_mutex_unlock(&s_mutex);
+    return n;
+}
+
+void ondemand_client_gone(int client_fd)
+{
+    pthread_mutex_lock(&s_mutex);
+    for (int i = 0; i < ONDEMAND_MAX_SCANS; i++) {
+        scan_t *s = &s_scans[i];
+        if (!s->id || s->client_fd != client_fd) continue;
+        cancel_locked(s, "disconnected");
+        s->client_fd = -1;
+        log_info("On-demand scan %u cancelled: client went away.", s->id);
+    }
+    pthread_mutex_unlock(&s_mutex);
+}
+
+int ondemand_cancelled(uint32_t id)
+{
+    pthread_mutex_lock(&s_mutex);
+    scan_t *s = find_locked(id);
+    int c = !s || __atomic_load_n(&s->cancelled, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s_mutex);
+    return c;
+}
+
+void ondemand_file_done(uint32_t id, ondemand_outcome_t outcome,
+                        int64_t bytes)
+{
+    if (!id) return;
+    uint64_t b = bytes > 0 ? (uint64_t)bytes : 0;
+
+    pthread_mutex_lock(&s_mutex);
+    scan_t *s = find_locked(id);
+    if (s) {
+        add(&s->bytes_done, b);
+        switch (outcome) {
+        case ONDEMAND_INFECTED: add(&s->detections, 1); /* fall through */
+        case ONDEMAND_CLEAN:
+            add(&s->scanned, 1);
+            add(&s->bytes_scanned, b);
+            break;
+        case ONDEMAND_ERROR:
+            add(&s->scanned, 1);
+            add(&s->errors, 1);
+            break;
+        case ONDEMAND_GONE:
+        case ONDEMAND_SKIPPED:
+            break;
+        }
+        /* Last: the tick reaps the slot once this reaches `queued`. */
+        __atomic_fetch_add(&s->finished, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&s_mutex);
+}
+
+void ondemand_tick(void)
+{
+    int   fds[ONDEMAND_MAX_SCANS];
+    char *msgs[ONDEMAND_MAX_SCANS];
+    int   n = 0;
+
+    pthread_mutex_lock(&s_mutex);
+    for (int i = 0; i < ONDEMAND_MAX_SCANS; i++) {
+        scan_t *s = &s_scans[i];
+        if (!s->id) continue;
+
+        if (s->file_pending) {
+            int rc = threadpool_try_submit_bg(s_pool, s->path, s->id);
+            if (rc <= 0) {
+                if (rc == 0) {
+                    s->queued = 1;
+                    metrics_inc(s_m_files);
+                }
+                s->file_pending = 0;
+                __atomic_store_n(&s->crawl_done, 1, __ATOMIC_RELEASE);
+            }
+        }
+
+        /* Crawlers never take s_mutex, so joining here cannot deadlock. */
+        if (s->crawl && __atomic_load_n(&s->crawl_done, __ATOMIC_ACQUIRE)) {
+            crawl_join(s->crawl);
+            s->crawl = NULL;
+        }
+
+        int over = !s->crawl && !s->file_pending &&
+                   __atomic_load_n(&s->crawl_done, __ATOMIC_ACQUIRE) &&
+                   __atomic_load_n(&s->finished, __ATOMIC_ACQUIRE) >=
+                   ld(&s->queued);
+        if (s->client_fd >= 0 && !s->reported) {
+            char *msg = render_locked(s, over);
+            if (msg) {
+                fds[n]    = s->client_fd;
+                msgs[n++] = msg;
+            }
+        }
+        if (over) {
+            if (!s->reported)
+                log_info("On-demand scan %u of %s %s: %llu files scanned, "
+                         "%llu detections, %llu errors.", s->id, s->path,
+                         s->cancelled ? "cancelled" : "done",
+                         (unsigned long long)ld(&s->scanned),
+                         (unsigned long long)ld(&s->detections),
+                         (unsigned long long)ld(&s->errors));
+            s->id = 0;
+        }
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    for (int i = 0; i < n; i++) {
+        alert_send_to_client(fds[i], msgs[i]);
+        free(msgs[i]);
+    }
+}
+
+void ondemand_stop_all(const char *reason)
+{
+    int   fds[ONDEMAND_MAX_SCANS];
+    char *msgs[ONDEMAND_MAX_SCANS];
+    int   n = 0;
+
+    pthread_mutex_lock(&s_mutex);
+    for (int i = 0; i < ONDEMAND_MAX_SCANS; i++) {
+        scan_t *s = &s_scans[i];
+        if (!s->id) continue;
+        cancel_locked(s, reason);
+        if (s->client_fd >= 0 && !s->reported) {
+            char *msg = render_locked(s, 1);
+            if (msg) {
+                fds[n]    = s->client_fd;
+                msgs[n++] = msg;
+            }
+            log_info("On-demand scan %u of %s cancelled (%s).", s->id,
+                     s->path, reason);
+        }
+        s->reported = 1;
+
+        /* Cancelled crawlers exit within one throttle sleep. */
+        if (s->crawl) {
+            crawl_join(s->crawl);
+            s->crawl = NULL;
+        }
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    for (int i = 0; i < n; i++) {
+        alert_send_to_client(fds[i], msgs[i]);
+        free(msgs[i]);
+    }
+}
@@ -1,12 +1,16 @@
 /*
  * quarantine.c — File quarantine: isolate, restore, and delete infected files.
  *
- * Manages a JSON manifest at /opt/quarantine/.manifest.json using json-c.
+ * Manages a JSON manifest (.manifest.json in the quarantine directory,
+ * /opt/quarantine by default) using json-c.
  * Part of the Sentinel Endpoint Security daemon.
  */
 
 #include "quarantine.h"
 #include "logger.h"
+#include "flightrec.h"
+#include "metrics.h"
+#include "probes.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,6 +26,8 @@
 /* ── Private state ──────────────────────────────────────────────────────── */
 
 static json_object       *s_manifest = NULL;     /* JSON array */
+static char               s_dir[QR_MAX_PATH / 4] = QUARANTINE_DIR;
+static char               s_manifest_path[QR_MAX_PATH];
 static pthread_mutex_t    s_qr_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* ── Helpers ────────────────────────────────────────────────────────────── */
@@ -55,7 +61,7 @@ static int manifest_save(void)
     const char *json_str = json_object_to_json_string_ext(
         s_manifest, JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_NOSLASHESCAPE);
 
-    FILE *fp = fopen(QUARANTINE_MANIFEST, "w");
+    FILE *fp = fopen(s_manifest_path, "w");
     if (!fp) {
         log_error("Cannot write manifest: %s", strerror(errno));
         return -1;
@@ -77,13 +83,13 @@ static int manifest_load(void)
     }
 
     struct stat st;
-    if (stat(QUARANTINE_MANIFEST, &st) != 0) {
+    if (stat(s_manifest_path, &st) != 0) {
         /* No manifest yet — create empty array. */
         s_manifest = json_object_new_array();
         return 0;
     }
 
-    s_manifest = json_object_from_file(QUARANTINE_MANIFEST);
+    s_manifest = json_object_from_file(s_manifest_path);
     if (!s_manifest || !json_object_is_type(s_manifest, json_type_array)) {
         log_warn("Corrupt manifest file — reinitialising.");
         if (s_manifest) json_object_put(s_manifest);
@@ -140,21 +146,33 @@ static int copy_file(const char *src, const char *dst)
 
 /* ── Public API ─────────────────────────────────────────────────────────── */
 
-int quarantine_init(void)
+int quarantine_init(const char *dir)
 {
+    if (!dir) dir = QUARANTINE_DIR;
+    if (strlen(dir) >= sizeof(s_dir)) {
+        log_error("Quarantine dir path too long: %s", dir);
+        return -1;
+    }
+    snprintf(s_dir, sizeof(s_dir), "%s", dir);
+    snprintf(s_manifest_path, sizeof(s_manifest_path), "%s/%s",
+             s_dir, QUARANTINE_MANIFEST_NAME);
+
     struct stat st;
-    if (stat(QUARANTINE_DIR, &st) != 0) {
-        if (mkdir(QUARANTINE_DIR, 0700) != 0) {
+    if (stat(s_dir, &st) != 0) {
+        if (mkdir(s_dir, 0700) != 0) {
             log_error("Cannot create quarantine dir: %s", strerror(errno));
             return -1;
         }
-        log_info("Created quarantine directory: %s", QUARANTINE_DIR);
+        log_info("Created quarantine directory: %s", s_dir);
     }
 
+    uint64_t t0 = metrics_now_ns();
     if (manifest_load() != 0) return -1;
 
     int count = (int)json_object_array_length(s_manifest);
-    log_info("Quarantine initialised — %d existing entries.", count);
+    log_info("Quarantine initialised — %d existing entries (manifest "
+             "loaded in %.1f ms).", count,
+             (double)(metrics_now_ns() - t0) / 1e6);
     return 0;
 }
 
@@ -162,6 +180,8 @@ int quarantine_file(const char *filepath, const char *threat_name)
 {
     if (!filepath || !threat_name) return -1;
 
+    uint64_t t0 = metrics_now_ns();
+
     pthread_mutex_lock(&s_qr_mutex);
 
     /* 1. Strip all permissions immediately. */
@@ -179,7 +199,7 @@ int quarantine_file(const char *filepath, const char *threat_name)
     basename = basename ? basename + 1 : filepath;
 
     char qpath[QR_MAX_PATH];
-    snprintf(qpath, sizeof(qpath), "%s/%s_%s", QUARANTINE_DIR, qid, basename);
+    snprintf(qpath, sizeof(qpath), "%s/%s_%s", s_dir, qid, basename);
 
     /* 3. Move (or copy + delete) the file. */
     int moved = 0;
@@ -200,6 +220,9 @@ int quarantine_file(const char *filepath, const char *threat_name)
 
     if (!moved) {
         pthread_mutex_unlock(&s_qr_mutex);
+        fr_record(FR_EV_QUARANTINE, filepath, 1);
+        SENTINEL_PROBE4(quarantine, filepath, threat_name, -1,
+                        metrics_now_ns() - t0);
         return -1;
     }
 
@@ -223,21 +246,23 @@ int quarantine_file(const char *filepath, const char *threat_name)
     manifest_save();
 
     log_info("Quarantined: %s → %s [%s]", filepath, qpath, threat_name);
+    fr_record(FR_EV_QUARANTINE, filepath, 0);
+    SENTINEL_PROBE4(quarantine, filepath, threat_name, 0,
+                    metrics_now_ns() - t0);
 
     pthread_mutex_unlock(&s_qr_mutex);
     return 0;
 }
 
-int quarantine_restore(const char *quarantine_id)
+/*
+ * Move entry `quarantine_id` back to where it came from and drop it from
+ * the in-memory manifest (the caller saves).  Caller holds s_qr_mutex.
+ */
+static int restore_locked(const char *quarantine_id)
 {
-    if (!quarantine_id) return -1;
-
-    pthread_mutex_lock(&s_qr_mutex);
-
     int idx = manifest_find(quarantine_id);
     if (idx < 0) {
         log_error("Quarantine ID not found: %s", quarantine_id);
-        pthread_mutex_unlock(&s_qr_mutex);
         return -1;
     }
 
@@ -265,33 +290,27 @@ int quarantine_restore(const char *quarantine_id)
     if (!restored) {
         log_error("Failed to restore %s → %s", qpath, orig);
         chmod(qpath, 0000);   /* Re-lock it. */
-        pthread_mutex_unlock(&s_qr_mutex);
+        SENTINEL_PROBE2(restore, quarantine_id, -1);
         return -1;
     }
 
     /* Restore sensible permissions (owner rw). */
     chmod(orig, 0644);
 
-    /* Remove entry from manifest. */
-    json_object_array_del_idx(s_manifest, (size_t)idx, 1);
-    manifest_save();
-
     log_info("Restored quarantined file: %s → %s", qpath, orig);
 
-    pthread_mutex_unlock(&s_qr_mutex);
+    /* Remove entry from manifest (frees the strings logged above). */
+    json_object_array_del_idx(s_manifest, (size_t)idx, 1);
+    SENTINEL_PROBE2(restore, quarantine_id, 0);
     return 0;
 }
 
-int quarantine_delete(const char *quarantine_id)
+/* Unlink entry `quarantine_id` and drop it from the in-memory manifest. */
+static int delete_locked(const char *quarantine_id)
 {
-    if (!quarantine_id) return -1;
-
-    pthread_mutex_lock(&s_qr_mutex);
-
     int idx = manifest_find(quarantine_id);
     if (idx < 0) {
         log_error("Quarantine ID not found: %s", quarantine_id);
-        pthread_mutex_unlock(&s_qr_mutex);
         return -1;
     }
 
@@ -305,17 +324,82 @@ int quarantine_delete(const char *quarantine_id)
 
     if (unlink(qpath) != 0) {
         log_error("Failed to delete %s: %s", qpath, strerror(errno));
-        pthread_mutex_unlock(&s_qr_mutex);
+        SENTINEL_PROBE2(delete, quarantine_id, -1);
         return -1;
     }
 
+    log_info("Permanently deleted quarantined file: %s", qpath);
+
     json_object_array_del_idx(s_manifest, (size_t)idx, 1);
-    manifest_save();
+    SENTINEL_PROBE2(delete, quarantine_id, 0);
+    return 0;
+}
 
-    log_info("Permanently deleted quarantined file: %s", qpath);
+/* Apply `op` to each ID, saving the manifest once if anything changed. */
+static int apply_many(int (*op)(const char *), const char *const *ids,
+                      int n, int *ok)
+{
+    int done = 0;
 
+    pthread_mutex_lock(&s_qr_mutex);
+    for (int i = 0; i < n; i++) {
+        int r = ids[i] ? op(ids[i]) : -1;
+        if (ok) ok[i] = r == 0;
+        if (r == 0) done++;
+    }
+    if (done) manifest_save();
     pthread_mutex_unlock(&s_qr_mutex);
-    return 0;
+    return done;
+}
+
+int quarantine_restore(const char *quarantine_id)
+{
+    if (!quarantine_id) return -1;
+    return apply_many(restore_locked, &quarantine_id, 1, NULL) == 1 ? 0 : -1;
+}
+
+int quarantine_restore_many(const char *const *ids, int n, int *ok)
+{
+    if (!ids || n < 0) return -1;
+    return apply_many(restore_locked, ids, n, ok);
+}
+
+int quarantine_delete(const char *quarantine_id)
+{
+    if (!quarantine_id) return -1;
+    return apply_many(delete_locked, &quarantine_id, 1, NULL) == 1 ? 0 : -1;
+}
+
+int quarantine_delete_many(const char *const *ids, int n, int *ok)
+{
+    if (!ids || n < 0) return -1;
+    return apply_many(delete_locked, ids, n, ok);
+}
+
+/* Copy manifest entry `e` into `out`. */
+static void entry_get(json_object *e, quarantine_entry_t *out)
+{
+    json_object *jval;
+    memset(out, 0, sizeof(*out));
+
+    if (json_object_object_get_ex(e, "id", &jval))
+        snprintf(out->id, sizeof(out->id), "%s",
+                 json_object_get_string(jval));
+
+    if (json_object_object_get_ex(e, "original_path", &jval))
+        snprintf(out->original_path, sizeof(out->original_path), "%s",
+                 json_object_get_string(jval));
+
+    if (json_object_object_get_ex(e, "quarantine_path", &jval))
+        snprintf(out->quarantine_path, sizeof(out->quarantine_path), "%s",
+                 json_object_get_string(jval));
+
+    if (json_object_object_get_ex(e, "threat_name", &jval))
+        snprintf(out->threat_name, sizeof(out->threat_name), "%s",
+                 json_object_get_string(jval));
+
+    if (json_object_object_get_ex(e, "timestamp", &jval))
+        out->timestamp = (time_t)json_object_get_int64(jval);
 }
 
 int quarantine_list(quarantine_entry_t **entries, int *count)
@@ -338,35 +422,34 @@ int quarantine_list(quarantine_entry_t **entries, int *count)
         return -1;
     }
 
-    for (int i = 0; i < n; i++) {
-        json_object *e = json_object_array_get_idx(s_manifest, (size_t)i);
-        json_object *jval;
+    for (int i = 0; i < n; i++)
+        entry_get(json_object_array_get_idx(s_manifest, (size_t)i), &arr[i]);
 
-        if (json_object_object_get_ex(e, "id", &jval))
-            snprintf(arr[i].id, sizeof(arr[i].id), "%s",
-                     json_object_get_string(jval));
+    *entries = arr;
+    *count = n;
 
-        if (json_object_object_get_ex(e, "original_path", &jval))
-            snprintf(arr[i].original_path, sizeof(arr[i].original_path), "%s",
-                     json_object_get_string(jval));
+    pthread_mutex_unlock(&s_qr_mutex);
+    return 0;
+}
 
-        if (json_object_object_get_ex(e, "quarantine_path", &jval))
-            snprintf(arr[i].quarantine_path, sizeof(arr[i].quarantine_path), "%s",
-                     json_object_get_string(jval));
+int quarantine_foreach(int offset, int max, quarantine_visit_fn fn, void *arg)
+{
+    if (!fn || offset < 0 || max < 0) return -1;
 
-        if (json_object_object_get_ex(e, "threat_name", &jval))
-            snprintf(arr[i].threat_name, sizeof(arr[i].threat_name), "%s",
-                     json_object_get_string(jval));
+    quarantine_entry_t *e = malloc(sizeof(*e));
+    if (!e) return -1;
 
-        if (json_object_object_get_ex(e, "timestamp", &jval))
-            arr[i].timestamp = (time_t)json_object_get_int64(jval);
+    pthread_mutex_lock(&s_qr_mutex);
+    int n = s_manifest ? (int)json_object_array_length(s_manifest) : 0;
+    int visited = 0;
+    for (int i = offset; i < n && visited < max; i++, visited++) {
+        entry_get(json_object_array_get_idx(s_manifest, (size_t)i), e);
+        fn(e, arg);
     }
-
-    *entries = arr;
-    *count = n;
-
     pthread_mutex_unlock(&s_qr_mutex);
-    return 0;
+
+    free(e);
+    return visited;
 }
 
 void quarantine_shutdown(void)
@@ -382,3 +465,16 @@ void quarantine_shutdown(void)
     pthread_mutex_unlock(&s_qr_mutex);
     log_info("Quarantine subsystem shut down.");
 }
+
+const char *quarantine_get_dir(void)
+{
+    return s_dir;
+}
+
+int quarantine_count(void)
+{
+    pthread_mutex_lock(&s_qr_mutex);
+    int n = s_manifest ? (int)json_object_array_length(s_manifest) : 0;
+    pthread_mutex_unlock(&s_qr_mutex);
+    return n;
+}
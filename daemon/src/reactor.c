@@ -0,0 +1,337 @@
+/*
+ * reactor.c — epoll + timerfd + signalfd event loop.
+ *
+ * Handlers live in a table indexed by fd, so registration needs no
+ * per-handler allocation and the epoll cookie is simply the fd.  The
+ * table is guarded by a mutex because worker threads may deregister
+ * IPC clients (broken pipe during a broadcast) while the loop runs;
+ * the loop copies the handler out under the lock before calling it.
+ *
+ * Timers are timerfds registered like any other fd.  Signals arrive on a
+ * single signalfd and are dispatched by number.  An eventfd lets other
+ * threads wake the loop for reactor_stop().
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "reactor.h"
+#include "logger.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+#define REACTOR_MAX_EVENTS  64
+#define REACTOR_MAX_SIGNAL  64
+
+typedef enum {
+    H_NONE = 0,
+    H_FD,                          /* Plain fd readiness callback        */
+    H_TIMER                        /* timerfd owned by the reactor       */
+} handler_kind_t;
+
+typedef struct {
+    handler_kind_t    kind;
+    reactor_fd_cb     fd_cb;
+    reactor_timer_cb  timer_cb;
+    void             *arg;
+} handler_t;
+
+typedef struct {
+    reactor_signal_cb cb;
+    void             *arg;
+} sig_handler_t;
+
+struct reactor {
+    int               epfd;
+    int               wake_fd;     /* eventfd for reactor_stop()         */
+    int               sig_fd;      /* signalfd (-1 until first signal)   */
+    sigset_t          sig_mask;
+    sig_handler_t     sig[REACTOR_MAX_SIGNAL + 1];
+
+    handler_t        *handlers;    /* Indexed by fd                      */
+    int               nhandlers;
+    pthread_mutex_t   mutex;       /* Protects handlers / nhandlers      */
+
+    volatile int      running;
+};
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+/* Make sure handlers[fd] exists.  Caller holds r->mutex. */
+static int ensure_slot(reactor_t *r, int fd)
+{
+    if (fd < r->nhandlers) return 0;
+
+    int n = r->nhandlers ? r->nhandlers : 64;
+    while (n <= fd) n *= 2;
+
+    handler_t *h = realloc(r->handlers, (size_t)n * sizeof(*h));
+    if (!h) return -1;
+    memset(h + r->nhandlers, 0, (size_t)(n - r->nhandlers) * sizeof(*h));
+
+    r->handlers  = h;
+    r->nhandlers = n;
+    return 0;
+}
+
+static int register_handler(reactor_t *r, int fd, uint32_t events,
+                            const handler_t *h)
+{
+    pthread_mutex_lock(&r->mutex);
+    if (ensure_slot(r, fd) != 0) {
+        pthread_mutex_unlock(&r->mutex);
+        return -1;
+    }
+    r->handlers[fd] = *h;
+    pthread_mutex_unlock(&r->mutex);
+
+    struct epoll_event ev = { .events = events, .data.fd = fd };
+    if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        log_error("epoll_ctl(ADD, fd=%d): %s", fd, strerror(errno));
+        pthread_mutex_lock(&r->mutex);
+        memset(&r->handlers[fd], 0, sizeof(handler_t));
+        pthread_mutex_unlock(&r->mutex);
+        return -1;
+    }
+    return 0;
+}
+
+static void ms_to_timespec(unsigned ms, struct timespec *ts)
+{
+    ts->tv_sec  = ms / 1000;
+    ts->tv_nsec = (long)(ms % 1000) * 1000000L;
+}
+
+static void dispatch_signals(reactor_t *r)
+{
+    struct signalfd_siginfo si;
+    while (read(r->sig_fd, &si, sizeof(si)) == (ssize_t)sizeof(si)) {
+        int signo = (int)si.ssi_signo;
+        if (signo > 0 && signo <= REACTOR_MAX_SIGNAL && r->sig[signo].cb)
+            r->sig[signo].cb(signo, r->sig[signo].arg);
+    }
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+reactor_t *reactor_create(void)
+{
+    reactor_t *r = calloc(1, sizeof(*r));
+    if (!r) return NULL;
+
+    r->sig_fd  = -1;
+    r->running = 1;
+    sigemptyset(&r->sig_mask);
+    pthread_mutex_init(&r->mutex, NULL);
+
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epfd < 0) {
+        log_error("epoll_create1(): %s", strerror(errno));
+        free(r);
+        return NULL;
+    }
+
+    r->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->wake_fd < 0) {
+        log_error("eventfd(): %s", strerror(errno));
+        close(r->epfd);
+        free(r);
+        return NULL;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = r->wake_fd };
+    epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->wake_fd, &ev);
+
+    return r;
+}
+
+int reactor_add_fd(reactor_t *r, int fd, uint32_t events,
+                   reactor_fd_cb cb, void *arg)
+{
+    if (!r || fd < 0 || !cb) return -1;
+
+    handler_t h = { .kind = H_FD, .fd_cb = cb, .arg = arg };
+    return register_handler(r, fd, events, &h);
+}
+
+int reactor_mod_fd(reactor_t *r, int fd, uint32_t events)
+{
+    if (!r || fd < 0) return -1;
+
+    struct epoll_event ev = { .events = events, .data.fd = fd };
+    if (epoll_ctl(r->epfd, EPOLL_CTL_MOD, fd, &ev) != 0) {
+        log_error("epoll_ctl(MOD, fd=%d): %s", fd, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void reactor_del_fd(reactor_t *r, int fd)
+{
+    if (!r || fd < 0) return;
+
+    epoll_ctl(r->epfd, EPOLL_CTL_DEL, fd, NULL);
+
+    pthread_mutex_lock(&r->mutex);
+    if (fd < r->nhandlers)
+        memset(&r->handlers[fd], 0, sizeof(handler_t));
+    pthread_mutex_unlock(&r->mutex);
+}
+
+int reactor_add_timer(reactor_t *r, unsigned initial_ms, unsigned interval_ms,
+                      reactor_timer_cb cb, void *arg)
+{
+    if (!r || !cb) return -1;
+
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0) {
+        log_error("timerfd_create(): %s", strerror(errno));
+        return -1;
+    }
+
+    handler_t h = { .kind = H_TIMER, .timer_cb = cb, .arg = arg };
+    if (register_handler(r, tfd, EPOLLIN, &h) != 0) {
+        close(tfd);
+        return -1;
+    }
+
+    if (initial_ms > 0 && reactor_arm_timer(r, tfd, initial_ms, interval_ms) != 0) {
+        reactor_del_fd(r, tfd);
+        close(tfd);
+        return -1;
+    }
+    return tfd;
+}
+
+int reactor_arm_timer(reactor_t *r, int timer_id,
+                      unsigned initial_ms, unsigned interval_ms)
+{
+    if (!r || timer_id < 0) return -1;
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    ms_to_timespec(initial_ms,  &its.it_value);
+    ms_to_timespec(interval_ms, &its.it_interval);
+
+    if (timerfd_settime(timer_id, 0, &its, NULL) != 0) {
+        log_error("timerfd_settime(): %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void reactor_block_signals(const int *signals)
+{
+    sigset_t set;
+    sigemptyset(&set);
+    for (int i = 0; signals && signals[i]; i++)
+        sigaddset(&set, signals[i]);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+}
+
+int reactor_add_signal(reactor_t *r, int signo, reactor_signal_cb cb, void *arg)
+{
+    if (!r || !cb || signo <= 0 || signo > REACTOR_MAX_SIGNAL) return -1;
+
+    sigaddset(&r->sig_mask, signo);
+    r->sig[signo].cb  = cb;
+    r->sig[signo].arg = arg;
+
+    if (r->sig_fd < 0) {
+        r->sig_fd = signalfd(-1, &r->sig_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (r->sig_fd < 0) {
+            log_error("signalfd(): %s", strerror(errno));
+            return -1;
+        }
+        struct epoll_event ev = { .events = EPOLLIN, .data.fd = r->sig_fd };
+        if (epoll_ctl(r->epfd, EPOLL_CTL_ADD, r->sig_fd, &ev) != 0) {
+            log_error("epoll_ctl(ADD, signalfd): %s", strerror(errno));
+            return -1;
+        }
+    } else if (signalfd(r->sig_fd, &r->sig_mask, 0) < 0) {
+        log_error("signalfd(update): %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int reactor_run(reactor_t *r)
+{
+    if (!r) return -1;
+
+    struct epoll_event evs[REACTOR_MAX_EVENTS];
+
+    while (r->running) {
+        int n = epoll_wait(r->epfd, evs, REACTOR_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_error("epoll_wait(): %s", strerror(errno));
+            return -1;
+        }
+
+        for (int i = 0; i < n && r->running; i++) {
+            int fd = evs[i].data.fd;
+
+            if (fd == r->wake_fd) {
+                uint64_t v;
+                while (read(r->wake_fd, &v, sizeof(v)) > 0) { }
+                continue;
+            }
+            if (fd == r->sig_fd) {
+                dispatch_signals(r);
+                continue;
+            }
+
+            handler_t h;
+            pthread_mutex_lock(&r->mutex);
+            if (fd < r->nhandlers) h = r->handlers[fd];
+            else                   h.kind = H_NONE;
+            pthread_mutex_unlock(&r->mutex);
+
+            if (h.kind == H_FD) {
+                h.fd_cb(fd, evs[i].events, h.arg);
+            } else if (h.kind == H_TIMER) {
+                uint64_t expirations;
+                if (read(fd, &expirations, sizeof(expirations)) > 0)
+                    h.timer_cb(h.arg);
+            }
+        }
+    }
+    return 0;
+}
+
+void reactor_stop(reactor_t *r)
+{
+    if (!r) return;
+    r->running = 0;
+
+    uint64_t one = 1;
+    if (write(r->wake_fd, &one, sizeof(one)) < 0) {
+        /* Counter saturated — the loop is already due to wake. */
+    }
+}
+
+void reactor_destroy(reactor_t *r)
+{
+    if (!r) return;
+
+    for (int fd = 0; fd < r->nhandlers; fd++) {
+        if (r->handlers[fd].kind == H_TIMER) close(fd);
+    }
+    if (r->sig_fd >= 0) close(r->sig_fd);
+    close(r->wake_fd);
+    close(r->epfd);
+
+    pthread_mutex_destroy(&r->mutex);
+    free(r->handlers);
+    free(r);
+}
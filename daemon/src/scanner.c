@@ -1,97 +1,464 @@
 /*
- * scanner.c — ClamAV clamd UNIX-socket scanner.
+ * scanner.c — Engine chain: runs each file through the configured scan
+ * engines (engine.h) until one decides.
+ *
+ * A chain is an immutable array of engine instances built from a spec
+ * string ("allowlist:/etc/sentinel/allow.sha256,cache,clamd").  Workers
+ * take a reference for the length of one file; replacing the chain
+ * publishes a new one and the old one is torn down when its last scan
+ * finishes, so reconfiguring never waits for or interrupts a scan.
+ *
+ * Racing: engines joined with '|' ("blocklist:/etc/b.sha256|clamd")
+ * form a group that runs concurrently on race threads, sharing the
+ * file's fd.  The worker only waits.  The first INFECTED verdict ends
+ * the group at once — the worker goes on to quarantine while the other
+ * engines are told to stop and finish in the background.  Otherwise the
+ * group's verdict is known when every member has answered: OFFLINE if
+ * any was unreachable, else ERROR if any failed, else CLEAN if any found
+ * the file clean, else PASS to the next group.  Race threads are started
+ * on demand, up to SCANNER_RACE_THREADS, and kept.
  *
- * Sends SCAN commands to the running clamd daemon and parses responses.
  * Part of the Sentinel Endpoint Security daemon.
  */
 
 #include "scanner.h"
-#include "quarantine.h"
+#include "engine.h"
 #include "logger.h"
+#include "flightrec.h"
+#include "metrics.h"
+#include "probes.h"
 
+#include <json-c/json.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <stdint.h>
-#include <arpa/inet.h>
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <sys/stat.h>
+
+/* ── Engine kinds ───────────────────────────────────────────────────────── */
+
+static const engine_ops_t *const KINDS[] = {
+    &engine_allowlist, &engine_blocklist, &engine_cache, &engine_clamd,
+    &engine_ioc,
+};
+#define NKINDS ((int)(sizeof(KINDS) / sizeof(KINDS[0])))
+
+/* Per-kind metric names, in KINDS order (literals: not copied). */
+#define VERDICT_NAMES(k) {                                                    \
+    "sentinel_engine_verdicts_total{engine=\"" k "\",verdict=\"pass\"}",      \
+    "sentinel_engine_verdicts_total{engine=\"" k "\",verdict=\"clean\"}",     \
+    "sentinel_engine_verdicts_total{engine=\"" k "\",verdict=\"infected\"}",  \
+    "sentinel_engine_verdicts_total{engine=\"" k "\",verdict=\"error\"}",     \
+    "sentinel_engine_verdicts_total{engine=\"" k "\",verdict=\"offline\"}" }
+
+static const char *const VERDICT_METRICS[][ENGINE_VERDICTS] = {
+    VERDICT_NAMES("allowlist"), VERDICT_NAMES("blocklist"),
+    VERDICT_NAMES("cache"),     VERDICT_NAMES("clamd"),
+    VERDICT_NAMES("ioc"),
+};
+
+static const char *const DURATION_METRICS[] = {
+    "sentinel_engine_scan_duration_seconds{engine=\"allowlist\"}",
+    "sentinel_engine_scan_duration_seconds{engine=\"blocklist\"}",
+    "sentinel_engine_scan_duration_seconds{engine=\"cache\"}",
+    "sentinel_engine_scan_duration_seconds{engine=\"clamd\"}",
+    "sentinel_engine_scan_duration_seconds{engine=\"ioc\"}",
+};
+
+static const char *const VERDICT_KEYS[ENGINE_VERDICTS] = {
+    "pass", "clean", "infected", "error", "offline",
+};
 
 /* ── Private state ──────────────────────────────────────────────────────── */
 
-static char s_socket_path[108];  /* Matches sizeof(sun_path) */
+typedef struct {
+    const engine_ops_t *ops;
+    int                 kind;            /* Index into KINDS              */
+    void               *self;
+    char                arg[256];
+
+    /* Atomic counters for this instance (metrics cover the kind). */
+    uint64_t            verdicts[ENGINE_VERDICTS];
+    uint64_t            cancelled;       /* Stopped: lost a race          */
+    uint64_t            ns;
+} engine_inst_t;
+
+typedef struct {
+    int           refs;                  /* Atomic; s_chain holds one     */
+    int           n;
+    int           learns;                /* Some engine has learn()       */
+    engine_inst_t inst[SCANNER_MAX_ENGINES];
+    int           group[SCANNER_MAX_ENGINES];  /* inst[i]'s group number  */
+    char          spec[SCANNER_SPEC_MAX];
+} chain_t;
+
+/* One file's run of a racing group. */
+typedef struct {
+    pthread_mutex_t  lock;
+    pthread_cond_t   decided_cv;
+    int              refs;               /* Worker + members still running */
+    int              pending;            /* Members still running          */
+    int              decided;
+    int              cancel;             /* Atomic, see engine_cancelled() */
+    engine_verdict_t verdict;
+    int              winner;             /* Member whose report stands     */
+    chain_t         *chain;              /* Keeps the engines alive        */
+    int              first, n;           /* Members: chain->inst[first..]  */
+    engine_file_t    file;               /* Own dup() of the worker's fd   */
+    pthread_mutex_t  hash_lock;
+    engine_verdict_t results[SCANNER_MAX_ENGINES];
+    scan_report_t    reports[];          /* One per member                 */
+} race_t;
+
+typedef struct race_job {
+    struct race_job *next;
+    race_t          *race;
+    int              member;
+} race_job_t;
+
+static chain_t         *s_chain      = NULL;
+static pthread_mutex_t  s_chain_lock = PTHREAD_MUTEX_INITIALIZER;
+static char             s_clamd_socket[108];  /* Matches sizeof(sun_path) */
+
+/* Race threads and their job queue. */
+static pthread_mutex_t  s_race_lock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   s_race_cv    = PTHREAD_COND_INITIALIZER;
+static race_job_t      *s_race_head  = NULL;
+static race_job_t      *s_race_tail  = NULL;
+static int              s_race_queued  = 0;
+static int              s_race_idle    = 0;
+static int              s_race_nthreads = 0;
+static int              s_race_stop    = 0;
+static pthread_t        s_race_threads[SCANNER_RACE_THREADS];
+
+/* Metric IDs (registered in scanner_init). */
+static int s_m_verdicts[NKINDS][ENGINE_VERDICTS];
+static int s_m_seconds[NKINDS];
 
 /* ── Helpers ────────────────────────────────────────────────────────────── */
 
-/**
- * Open a UNIX-domain connection to clamd.
- * Returns the fd on success, -1 on failure.
- */
-static int clamd_connect(void)
+static void chain_free(chain_t *c)
 {
-    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (fd < 0) {
-        log_error("socket(): %s", strerror(errno));
-        return -1;
+    for (int i = 0; i < c->n; i++)
+        c->inst[i].ops->shutdown(c->inst[i].self);
+    free(c);
+}
+
+static chain_t *chain_get(void)
+{
+    pthread_mutex_lock(&s_chain_lock);
+    chain_t *c = s_chain;
+    if (c) __atomic_add_fetch(&c->refs, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&s_chain_lock);
+    return c;
+}
+
+static void chain_put(chain_t *c)
+{
+    if (c && __atomic_sub_fetch(&c->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        chain_free(c);
+}
+
+/* Build a chain from `spec`.  @return the chain (refs 1), or NULL. */
+static chain_t *chain_build(const char *spec, char *err, size_t errlen)
+{
+    chain_t *c = calloc(1, sizeof(*c));
+    if (!c) {
+        snprintf(err, errlen, "out of memory");
+        return NULL;
     }
+    c->refs = 1;
 
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", s_socket_path);
+    char buf[SCANNER_SPEC_MAX];
+    if (strlen(spec) >= sizeof(buf)) {
+        snprintf(err, errlen, "engine spec too long");
+        free(c);
+        return NULL;
+    }
+    snprintf(buf, sizeof(buf), "%s", spec);
+
+    int   terminal = 0, ngroups = 0;
+    char *gsave = NULL;
+    for (char *grp = strtok_r(buf, ",", &gsave); grp;
+         grp = strtok_r(NULL, ",", &gsave), ngroups++) {
+        char *save = NULL;
+        for (char *tok = strtok_r(grp, "|", &save); tok;
+             tok = strtok_r(NULL, "|", &save)) {
+            while (*tok == ' ') tok++;
+            char *arg = strchr(tok, ':');
+            if (arg) *arg++ = '\0';
+            tok[strcspn(tok, " ")] = '\0';
+
+            int k = 0;
+            while (k < NKINDS && strcmp(KINDS[k]->name, tok) != 0) k++;
+            if (k == NKINDS) {
+                snprintf(err, errlen, "unknown engine \"%s\"", tok);
+                chain_free(c);
+                return NULL;
+            }
+            if (c->n == SCANNER_MAX_ENGINES) {
+                snprintf(err, errlen, "at most %d engines",
+                         SCANNER_MAX_ENGINES);
+                chain_free(c);
+                return NULL;
+            }
+
+            engine_inst_t *e = &c->inst[c->n];
+            e->ops  = KINDS[k];
+            e->kind = k;
+            snprintf(e->arg, sizeof(e->arg), "%s", arg ? arg : "");
+            if (!(e->self = e->ops->init(arg, err, errlen))) {
+                chain_free(c);
+                return NULL;
+            }
+            c->group[c->n++] = ngroups;
+            if (e->ops->learn)                       c->learns  = 1;
+            if (e->ops->flags & ENGINE_F_TERMINAL)   terminal   = 1;
+        }
+    }
 
-    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        log_error("connect(%s): %s", s_socket_path, strerror(errno));
-        close(fd);
-        return -1;
+    if (c->n == 0) {
+        snprintf(err, errlen, "no engines");
+        free(c);
+        return NULL;
     }
+    if (!terminal)
+        log_warn("Engine chain \"%s\" has no full scanner — files no engine "
+                 "recognises are treated as clean.", spec);
+
+    /* Canonical spec, as given minus whitespace. */
+    size_t len = 0;
+    for (int i = 0; i < c->n && len < sizeof(c->spec); i++)
+        len += (size_t)snprintf(c->spec + len, sizeof(c->spec) - len,
+                                "%s%s%s%s",
+                                !i ? "" : c->group[i] == c->group[i - 1]
+                                        ? "|" : ",",
+                                c->inst[i].ops->name,
+                                c->inst[i].arg[0] ? ":" : "", c->inst[i].arg);
+    return c;
+}
+
+/* Run one engine on `file`, with its counters. */
+static engine_verdict_t run_engine(engine_inst_t *e, engine_file_t *file,
+                                   scan_report_t *report)
+{
+    uint64_t         t = metrics_now_ns();
+    engine_verdict_t v = e->ops->scan(e->self, file, report);
+    t = metrics_now_ns() - t;
 
-    return fd;
+    if (engine_cancelled(file)) {
+        __atomic_add_fetch(&e->cancelled, 1, __ATOMIC_RELAXED);
+        return ENGINE_PASS;
+    }
+    __atomic_add_fetch(&e->verdicts[v], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&e->ns, t, __ATOMIC_RELAXED);
+    metrics_inc(s_m_verdicts[e->kind][v]);
+    metrics_observe_ns(s_m_seconds[e->kind], t);
+    return v;
 }
 
-/**
- * Send a command to clamd and read the response.
- * @param fd    Connected socket fd.
- * @param cmd   Command string (e.g. "PING\n" or "SCAN /path\n").
- * @param resp  Buffer for the response.
- * @param rlen  Size of resp buffer.
- * @return Number of bytes read, or -1 on error.
- */
-static ssize_t clamd_command(int fd, const char *cmd, char *resp, size_t rlen)
+/* ── Racing ─────────────────────────────────────────────────────────────── */
+
+static void race_put(race_t *r)
 {
-    size_t cmd_len = strlen(cmd);
-    ssize_t sent = write(fd, cmd, cmd_len);
-    if (sent < 0 || (size_t)sent != cmd_len) {
-        log_error("clamd write error: %s", strerror(errno));
+    if (__atomic_sub_fetch(&r->refs, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+    close(r->file.fd);
+    chain_put(r->chain);
+    pthread_mutex_destroy(&r->hash_lock);
+    pthread_cond_destroy(&r->decided_cv);
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+}
+
+/* The group's verdict once every member answered.  Lock held. */
+static void race_combine(race_t *r)
+{
+    static const engine_verdict_t ORDER[] = {
+        ENGINE_OFFLINE, ENGINE_ERROR, ENGINE_CLEAN,
+    };
+
+    r->verdict = ENGINE_PASS;
+    r->winner  = -1;
+    for (size_t o = 0; o < sizeof(ORDER) / sizeof(ORDER[0]); o++) {
+        for (int m = 0; m < r->n; m++) {
+            if (r->results[m] != ORDER[o]) continue;
+            /* A clean verdict from a full scanner carries the most. */
+            if (r->winner < 0 ||
+                (r->chain->inst[r->first + m].ops->flags & ENGINE_F_TERMINAL &&
+                 !(r->chain->inst[r->first + r->winner].ops->flags &
+                   ENGINE_F_TERMINAL)))
+                r->winner = m;
+        }
+        if (r->winner >= 0) {
+            r->verdict = ORDER[o];
+            return;
+        }
+    }
+}
+
+static void race_member(race_t *r, int m)
+{
+    engine_inst_t   *e = &r->chain->inst[r->first + m];
+    engine_verdict_t v = ENGINE_PASS;
+    if (!engine_cancelled(&r->file))
+        v = run_engine(e, &r->file, &r->reports[m]);
+    else                                 /* Decided before it started */
+        __atomic_add_fetch(&e->cancelled, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&r->lock);
+    r->results[m] = v;
+    r->pending--;
+    if (!r->decided && (v == ENGINE_INFECTED || r->pending == 0)) {
+        if (v == ENGINE_INFECTED) {
+            r->verdict = v;
+            r->winner  = m;
+        } else {
+            race_combine(r);
+        }
+        r->decided = 1;
+        __atomic_store_n(&r->cancel, 1, __ATOMIC_RELAXED);
+        pthread_cond_signal(&r->decided_cv);
+    }
+    pthread_mutex_unlock(&r->lock);
+    race_put(r);
+}
+
+static void *race_thread(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&s_race_lock);
+    for (;;) {
+        while (!s_race_head && !s_race_stop) {
+            s_race_idle++;
+            pthread_cond_wait(&s_race_cv, &s_race_lock);
+            s_race_idle--;
+        }
+        race_job_t *job = s_race_head;
+        if (!job) break;                     /* Stopping, queue drained */
+        s_race_head = job->next;
+        if (!s_race_head) s_race_tail = NULL;
+        s_race_queued--;
+
+        pthread_mutex_unlock(&s_race_lock);
+        race_member(job->race, job->member);
+        free(job);
+        pthread_mutex_lock(&s_race_lock);
+    }
+    pthread_mutex_unlock(&s_race_lock);
+    return NULL;
+}
+
+/* Queue member `m` for a race thread.  @return 0, or -1: run it inline. */
+static int race_submit(race_t *r, int m)
+{
+    race_job_t *job = malloc(sizeof(*job));
+    if (!job) return -1;
+    job->next   = NULL;
+    job->race   = r;
+    job->member = m;
+
+    pthread_mutex_lock(&s_race_lock);
+    if (s_race_queued >= s_race_idle && !s_race_stop &&
+        s_race_nthreads < SCANNER_RACE_THREADS &&
+        pthread_create(&s_race_threads[s_race_nthreads], NULL,
+                       race_thread, NULL) == 0)
+        s_race_nthreads++;
+    if (s_race_nthreads == 0 || s_race_stop) {
+        pthread_mutex_unlock(&s_race_lock);
+        free(job);
         return -1;
     }
+    if (s_race_tail) s_race_tail->next = job;
+    else             s_race_head       = job;
+    s_race_tail = job;
+    s_race_queued++;
+    pthread_cond_signal(&s_race_cv);
+    pthread_mutex_unlock(&s_race_lock);
+    return 0;
+}
 
-    /* Shutdown write side so clamd knows the command is complete. */
-    shutdown(fd, SHUT_WR);
+/*
+ * Race chain->inst[first .. first+n-1] on `file`.  Returns the group's
+ * verdict as soon as it is known, with the deciding member's report in
+ * `report` and its index in `*winner` (-1 if none).
+ */
+static engine_verdict_t race(chain_t *c, int first, int n,
+                             engine_file_t *file, scan_report_t *report,
+                             int *winner)
+{
+    *winner = -1;
+    race_t *r = calloc(1, sizeof(*r) + (size_t)n * sizeof(scan_report_t));
+    int     fd = r ? dup(file->fd) : -1;
+    if (fd < 0) {
+        log_error_rl("Cannot start engine race for %s: %s", file->path,
+                     strerror(errno));
+        free(r);
+        return ENGINE_OFFLINE;
+    }
 
-    ssize_t total = 0;
-    while ((size_t)total < rlen - 1) {
-        ssize_t n = read(fd, resp + total, rlen - 1 - (size_t)total);
-        if (n <= 0) break;
-        total += n;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->decided_cv, NULL);
+    pthread_mutex_init(&r->hash_lock, NULL);
+    r->file           = *file;
+    r->file.fd        = fd;
+    r->file.cancel    = &r->cancel;
+    r->file.hash_lock = &r->hash_lock;
+    r->chain   = c;
+    r->first   = first;
+    r->n       = n;
+    r->pending = n;
+    r->refs    = n + 1;
+    __atomic_add_fetch(&c->refs, 1, __ATOMIC_RELAXED);
+
+    for (int m = 0; m < n; m++)
+        if (race_submit(r, m) != 0)
+            race_member(r, m);
+
+    pthread_mutex_lock(&r->lock);
+    while (!r->decided)
+        pthread_cond_wait(&r->decided_cv, &r->lock);
+    engine_verdict_t v = r->verdict;
+    if (r->winner >= 0) {
+        *report = r->reports[r->winner];
+        *winner = first + r->winner;
+    }
+    if (r->pending == 0) {                   /* Keep a hash for later groups */
+        file->hashed = r->file.hashed;
+        memcpy(file->sha256, r->file.sha256, sizeof(file->sha256));
     }
-    resp[total] = '\0';
+    pthread_mutex_unlock(&r->lock);
 
-    return total;
+    race_put(r);
+    return v;
 }
 
 /* ── Public API ─────────────────────────────────────────────────────────── */
 
-int scanner_init(const char *socket_path)
+int scanner_init(const char *socket_path, const char *engines)
 {
     const char *path = socket_path ? socket_path : CLAMD_SOCKET_PATH;
-    snprintf(s_socket_path, sizeof(s_socket_path), "%s", path);
-
-    log_info("Scanner initialising with clamd socket: %s", s_socket_path);
+    snprintf(s_clamd_socket, sizeof(s_clamd_socket), "%s", path);
+
+    for (int k = 0; k < NKINDS; k++)
+        for (int v = 0; v < ENGINE_VERDICTS; v++)
+            s_m_verdicts[k][v] = metrics_counter(VERDICT_METRICS[k][v],
+                "Files each scan engine passed on or decided, by verdict");
+    for (int k = 0; k < NKINDS; k++)
+        s_m_seconds[k] = metrics_histogram(DURATION_METRICS[k],
+            "Time each scan engine spent per file");
+
+    char err[256];
+    const char *spec = engines ? engines : SCANNER_DEFAULT_ENGINES;
+    chain_t *c = chain_build(spec, err, sizeof(err));
+    if (!c) {
+        log_error("Engine chain \"%s\": %s", spec, err);
+        return -1;
+    }
+    s_chain = c;
+    log_info("Scanner initialising with engines: %s", c->spec);
 
     if (!scanner_ping()) {
         log_warn("clamd is not responding — scans will fail until it starts.");
@@ -103,155 +470,270 @@ int scanner_init(const char *socket_path)
     return 0;
 }
 
-int scanner_scan_file(const char *filepath, scan_report_t *report)
+int scanner_scan_file(const char *filepath, const risk_t *risk,
+                      scan_report_t *report)
 {
     if (!filepath || !report) return -1;
 
     memset(report, 0, sizeof(*report));
     report->result = SCAN_RESULT_ERROR;
 
-    /*
-     * Use clamd's zINSTREAM protocol instead of SCAN.
-     *
-     * SCAN requires clamd (which runs as the unprivileged user "clamav")
-     * to open the target file itself.  On most Linux systems the user's
-     * home directory has mode 700, so clamd gets "Permission denied".
-     *
-     * zINSTREAM solves this: our daemon (running as root) opens and reads
-     * the file, then streams the raw bytes to clamd over the socket.
-     * clamd never touches the filesystem — it scans pure byte content.
-     *
-     * Protocol:
-     *   1. Send "zINSTREAM\0"  (null-terminated z-prefix command).
-     *   2. For each chunk: send 4-byte big-endian length + chunk data.
-     *   3. Send 4-byte zero (0x00000000) to signal end-of-data.
-     *   4. Read the response (same format as SCAN: "... OK\n" / "... FOUND\n").
-     */
-
-    /* Step 1: Open the file ourselves (we're root). */
-    int file_fd = open(filepath, O_RDONLY);
-    if (file_fd < 0) {
+    fr_record(FR_EV_SCAN_START, filepath, 0);
+    SENTINEL_PROBE1(scan_start, filepath);
+
+    /* Open the file once (we're root); every engine reads this fd. */
+    engine_file_t file = { .path = filepath };
+    file.fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (file.fd < 0) {
         log_error("Cannot open %s for scanning: %s", filepath, strerror(errno));
         return -1;
     }
-
-    int sock_fd = clamd_connect();
-    if (sock_fd < 0) {
-        close(file_fd);
+    if (fstat(file.fd, &file.st) != 0) {
+        log_error("Cannot stat %s for scanning: %s", filepath, strerror(errno));
+        close(file.fd);
         return -1;
     }
 
-    /* Step 2: Send the zINSTREAM command (null-terminated). */
-    const char cmd[] = "zINSTREAM";
-    if (write(sock_fd, cmd, sizeof(cmd)) < 0) {  /* sizeof includes the '\0' */
-        log_error("clamd write zINSTREAM cmd error: %s", strerror(errno));
-        close(file_fd);
-        close(sock_fd);
+    chain_t *c = chain_get();
+    if (!c) {
+        close(file.fd);
         return -1;
     }
+    file.want_sha256 = c->learns;
+
+    /* Triage the first chunk unless the queue did; engines then read it
+     * from the page cache. */
+    uint8_t first[RISK_HEAD_BYTES];
+    ssize_t nfirst = -1;
+    risk_t  scored;
+    if (!risk) {
+        nfirst = pread(file.fd, first, sizeof(first), 0);
+        if (nfirst < 0) nfirst = 0;
+        risk_assess(first, (size_t)nfirst, &scored);
+        risk = &scored;
+    }
+
+    uint64_t t0 = metrics_now_ns();
+    int      rc = 0, decided = -1;
+    for (int i = 0, j; i < c->n && rc == 0 && decided < 0; i = j) {
+        for (j = i + 1; j < c->n && c->group[j] == c->group[i]; j++)
+            ;
+
+        int              who = i;
+        engine_verdict_t v   = j - i == 1
+                             ? run_engine(&c->inst[i], &file, report)
+                             : race(c, i, j - i, &file, report, &who);
 
-    /* Step 3: Stream file contents in 8 KB chunks. */
-    #define CHUNK_SIZE 8192
-    char buf[CHUNK_SIZE];
-    ssize_t nread;
-    int stream_ok = 1;
-
-    while ((nread = read(file_fd, buf, sizeof(buf))) > 0) {
-        /* 4-byte big-endian chunk length. */
-        uint32_t chunk_len = htonl((uint32_t)nread);
-        if (write(sock_fd, &chunk_len, 4) < 0 ||
-            write(sock_fd, buf, (size_t)nread) < 0) {
-            log_error("clamd INSTREAM write error: %s", strerror(errno));
-            stream_ok = 0;
+        if (v == ENGINE_PASS) continue;
+        if (v == ENGINE_OFFLINE) {
+            rc = -1;
             break;
         }
+        report->result = v == ENGINE_CLEAN    ? SCAN_RESULT_CLEAN
+                       : v == ENGINE_INFECTED ? SCAN_RESULT_INFECTED
+                       :                        SCAN_RESULT_ERROR;
+        report->engine = c->inst[who].ops->name;
+        decided = who;
+    }
+    if (rc == 0 && decided < 0) {
+        report->result = SCAN_RESULT_CLEAN;        /* Nobody objected */
+        report->engine = "none";
     }
-    close(file_fd);
 
-    if (!stream_ok) {
-        close(sock_fd);
-        return -1;
+    /* Engines that decided without reading the whole file. */
+    if (report->head_len == 0) {
+        if (nfirst < 0) {
+            nfirst = pread(file.fd, first, sizeof(report->head), 0);
+            if (nfirst < 0) nfirst = 0;
+        }
+        report->head_len = (size_t)nfirst < sizeof(report->head)
+                         ? (size_t)nfirst : sizeof(report->head);
+        memcpy(report->head, first, report->head_len);
     }
+    report->risk = *risk;
 
-    /* Step 4: Send end-of-data marker (4 zero bytes). */
-    uint32_t zero = 0;
-    if (write(sock_fd, &zero, 4) < 0) {
-        log_error("clamd INSTREAM end marker error: %s", strerror(errno));
-        close(sock_fd);
+    if (rc == 0)
+        for (int i = 0; i < c->n; i++)
+            if (i != decided && c->inst[i].ops->learn)
+                c->inst[i].ops->learn(c->inst[i].self, &file, report);
+
+    chain_put(c);
+    close(file.fd);
+
+    uint64_t dt = metrics_now_ns() - t0;
+    fr_record(FR_EV_SCAN_END, filepath, report->bytes);
+    SENTINEL_PROBE4(scan_end, filepath, report->bytes, dt,
+                    rc == 0 ? (int)report->result : -1);
+    return rc;
+}
+
+int scanner_ping(void)
+{
+    chain_t *c = chain_get();
+    if (!c) return 0;
+
+    int up = 1;
+    for (int i = 0; i < c->n && up; i++)
+        if (c->inst[i].ops->ping)
+            up = c->inst[i].ops->ping(c->inst[i].self);
+    chain_put(c);
+    return up;
+}
+
+uint32_t scanner_db_version(void)
+{
+    chain_t *c = chain_get();
+    if (!c) return 0;
+
+    uint32_t v = 0;
+    for (int i = 0; i < c->n && !v; i++)
+        if (c->inst[i].ops->version)
+            v = c->inst[i].ops->version(c->inst[i].self);
+    chain_put(c);
+    return v;
+}
+
+int scanner_set_engines(const char *spec, char *err, size_t errlen)
+{
+    chain_t *c = chain_build(spec, err, errlen);
+    if (!c) {
+        log_warn("Engine chain \"%s\" rejected: %s", spec, err);
         return -1;
     }
 
-    /* Step 5: Read the response. */
-    char resp[1024];
-    ssize_t total = 0;
-    while ((size_t)total < sizeof(resp) - 1) {
-        ssize_t n = read(sock_fd, resp + total, sizeof(resp) - 1 - (size_t)total);
-        if (n <= 0) break;
-        total += n;
-    }
-    resp[total] = '\0';
-    close(sock_fd);
+    pthread_mutex_lock(&s_chain_lock);
+    chain_t *old = s_chain;
+    s_chain = c;
+    pthread_mutex_unlock(&s_chain_lock);
+
+    log_info("Engine chain is now: %s", c->spec);
+    chain_put(old);
+    return 0;
+}
 
-    if (total <= 0) {
-        log_error("No response from clamd for file: %s", filepath);
+int scanner_reload_engines(char *err, size_t errlen)
+{
+    chain_t *c = chain_get();
+    if (!c) {
+        snprintf(err, errlen, "no engine chain");
         return -1;
     }
 
-    log_info("clamd response: %s", resp);
-
-    /*
-     * Response format:
-     *   stream: OK\n                          → clean
-     *   stream: <signature> FOUND\n           → infected
-     *   stream: <reason> ERROR\n              → error
-     *
-     * With INSTREAM the prefix is "stream:" instead of the filepath.
-     */
-    char *found_ptr = strstr(resp, " FOUND");
-    char *ok_ptr    = strstr(resp, " OK");
-    char *err_ptr   = strstr(resp, " ERROR");
-
-    if (found_ptr) {
-        report->result = SCAN_RESULT_INFECTED;
-
-        /* Extract threat name: text between ": " and " FOUND" */
-        char *colon = strstr(resp, ": ");
-        if (colon) {
-            colon += 2; /* skip ": " */
-            size_t len = (size_t)(found_ptr - colon);
-            if (len >= sizeof(report->threat_name))
-                len = sizeof(report->threat_name) - 1;
-            memcpy(report->threat_name, colon, len);
-            report->threat_name[len] = '\0';
+    int rc = 0, n = 0;
+    for (int i = 0; i < c->n; i++) {
+        engine_inst_t *e = &c->inst[i];
+        if (!e->ops->reload) continue;
+
+        char why[256];
+        if (e->ops->reload(e->self, why, sizeof(why)) != 0) {
+            log_warn("Engine %s:%s not reloaded: %s", e->ops->name, e->arg,
+                     why);
+            if (rc == 0) snprintf(err, errlen, "%s: %s", e->ops->name, why);
+            rc = -1;
+            continue;
         }
+        n++;
+    }
+    chain_put(c);
+    log_info("Reloaded %d scan engine(s)%s.", n, rc ? ", with errors" : "");
+    return rc;
+}
 
-        log_warn("THREAT DETECTED in %s: %s", filepath, report->threat_name);
-    } else if (ok_ptr) {
-        report->result = SCAN_RESULT_CLEAN;
-    } else if (err_ptr) {
-        report->result = SCAN_RESULT_ERROR;
-        log_error("clamd error scanning %s: %s", filepath, resp);
+void scanner_engines_spec(char *out, size_t len)
+{
+    chain_t *c = chain_get();
+    snprintf(out, len, "%s", c ? c->spec : "");
+    chain_put(c);
+}
+
+struct json_object *scanner_engines_json(void)
+{
+    struct json_object *arr = json_object_new_array();
+    chain_t *c = chain_get();
+    if (!c) return arr;
+
+    for (int i = 0; i < c->n; i++) {
+        engine_inst_t *e = &c->inst[i];
+        struct json_object *o = json_object_new_object();
+        uint64_t scans = 0;
+
+        json_object_object_add(o, "engine", json_object_new_string(e->ops->name));
+        json_object_object_add(o, "arg", json_object_new_string(e->arg));
+        for (int v = 0; v < ENGINE_VERDICTS; v++) {
+            uint64_t n = __atomic_load_n(&e->verdicts[v], __ATOMIC_RELAXED);
+            json_object_object_add(o, VERDICT_KEYS[v],
+                                   json_object_new_int64((int64_t)n));
+            scans += n;
+        }
+        json_object_object_add(o, "scans", json_object_new_int64((int64_t)scans));
+        json_object_object_add(o, "cancelled", json_object_new_int64(
+            (int64_t)__atomic_load_n(&e->cancelled, __ATOMIC_RELAXED)));
+        uint64_t ns = __atomic_load_n(&e->ns, __ATOMIC_RELAXED);
+        json_object_object_add(o, "mean_ms", json_object_new_double(
+            scans ? (double)(ns / scans) / 1e6 : 0.0));
+        if (e->ops->stats) e->ops->stats(e->self, o);
+        json_object_array_add(arr, o);
     }
+    chain_put(c);
+    return arr;
+}
 
-    return 0;
+void scanner_get_stats(scanner_stats_t *out)
+{
+    if (!out) return;
+    engine_clamd_get_stats(out);
+    engine_cache_get_stats(out);
 }
 
-int scanner_ping(void)
+void scanner_shutdown(void)
 {
-    int fd = clamd_connect();
-    if (fd < 0) return 0;
+    /* Race threads finish what is queued (losers winding down). */
+    pthread_mutex_lock(&s_race_lock);
+    s_race_stop = 1;
+    pthread_cond_broadcast(&s_race_cv);
+    pthread_mutex_unlock(&s_race_lock);
+    for (int i = 0; i < s_race_nthreads; i++)
+        pthread_join(s_race_threads[i], NULL);
+
+    pthread_mutex_lock(&s_chain_lock);
+    chain_t *c = s_chain;
+    s_chain = NULL;
+    pthread_mutex_unlock(&s_chain_lock);
+
+    chain_put(c);
+    log_info("Scanner shut down.");
+}
 
-    char resp[64];
-    ssize_t n = clamd_command(fd, "PING\n", resp, sizeof(resp));
-    close(fd);
+/* ── Helpers for engines ────────────────────────────────────────────────── */
 
-    if (n > 0 && strstr(resp, "PONG")) {
-        return 1;
+const uint8_t *engine_file_sha256(engine_file_t *file)
+{
+    if (file->hash_lock) pthread_mutex_lock(file->hash_lock);
+    if (file->hashed == 0) {
+        sha256_ctx_t ctx;
+        char         buf[32768];
+        off_t        off = 0;
+        ssize_t      n;
+
+        sha256_init(&ctx);
+        while ((n = pread(file->fd, buf, sizeof(buf), off)) > 0 &&
+               !engine_cancelled(file)) {
+            sha256_update(&ctx, buf, (size_t)n);
+            off += n;
+        }
+        if (n < 0)
+            file->hashed = -1;
+        else if (n == 0) {                   /* Not cut short by a race */
+            sha256_final(&ctx, file->sha256);
+            file->hashed = 1;
+        }
     }
-    return 0;
+    int ok = file->hashed > 0;
+    if (file->hash_lock) pthread_mutex_unlock(file->hash_lock);
+    return ok ? file->sha256 : NULL;
 }
 
-void scanner_shutdown(void)
+const char *engine_clamd_default_socket(void)
 {
-    log_info("Scanner shut down.");
+    return s_clamd_socket;
 }
@@ -0,0 +1,337 @@
+/*
+ * scanprof.c — Scan cost profiler (see scanprof.h).
+ *
+ * One mutex guards the table.  It is taken once per completed scan,
+ * which already cost a clamd round trip, so contention is negligible.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "scanprof.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+typedef struct {
+    const char   *type;
+    size_t        offset;
+    size_t        len;
+    const char   *magic;
+} magic_def_t;
+
+/* First match wins; more specific signatures come first. */
+static const magic_def_t MAGICS[] = {
+    { "elf",      0, 4,  "\x7f" "ELF"                  },
+    { "pe",       0, 2,  "MZ"                          },
+    { "pdf",      0, 5,  "%PDF-"                       },
+    { "zip",      0, 4,  "PK\x03\x04"                  },
+    { "zip",      0, 4,  "PK\x05\x06"                  },
+    { "ole",      0, 8,  "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1" },
+    { "gzip",     0, 2,  "\x1f\x8b"                    },
+    { "bzip2",    0, 3,  "BZh"                         },
+    { "xz",       0, 6,  "\xfd" "7zXZ\x00"             },
+    { "7z",       0, 6,  "7z\xbc\xaf\x27\x1c"          },
+    { "rar",      0, 4,  "Rar!"                        },
+    { "tar",      257, 5, "ustar"                      },
+    { "java",     0, 4,  "\xca\xfe\xba\xbe"            },
+    { "macho",    0, 4,  "\xcf\xfa\xed\xfe"            },
+    { "png",      0, 4,  "\x89PNG"                     },
+    { "jpeg",     0, 3,  "\xff\xd8\xff"                },
+    { "gif",      0, 4,  "GIF8"                        },
+    { "sqlite",   0, 15, "SQLite format 3"             },
+    { "script",   0, 2,  "#!"                          },
+};
+
+#define NMAGICS (sizeof(MAGICS) / sizeof(MAGICS[0]))
+
+typedef struct {
+    int            used;
+    scanprof_row_t row;
+} slot_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static slot_t          s_slots[SCANPROF_SLOTS];
+static int             s_used  = 0;
+static int             s_dim_used[SCANPROF_DIM_COUNT];
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *DIM_NAMES[SCANPROF_DIM_COUNT] = { "ext", "magic", "dir" };
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+/* FNV-1a over the dimension and key. */
+static uint32_t key_hash(scanprof_dim_t dim, const char *key)
+{
+    uint32_t h = 2166136261u ^ (uint32_t)dim;
+    for (; *key; key++) {
+        h ^= (unsigned char)*key;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void ext_key(const char *path, char *out, size_t outlen)
+{
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    const char *dot = strrchr(base, '.');
+    if (!dot || dot == base || !dot[1]) {      /* "Makefile", ".bashrc" */
+        snprintf(out, outlen, "(none)");
+        return;
+    }
+
+    size_t n = 0;
+    for (dot++; dot[n]; n++) {
+        if (n + 1 >= outlen || n >= 12 || !isalnum((unsigned char)dot[n])) {
+            snprintf(out, outlen, "(other)");  /* Hashes, backups, junk */
+            return;
+        }
+        out[n] = (char)tolower((unsigned char)dot[n]);
+    }
+    out[n] = '\0';
+}
+
+static void dir_key(const char *path, char *out, size_t outlen)
+{
+    const char *end = strrchr(path, '/');
+    const char *p = path;
+    int depth = 0;
+
+    if (!end) {                                /* Not absolute */
+        snprintf(out, outlen, "(none)");
+        return;
+    }
+
+    /* Stop after SCANPROF_DIR_DEPTH components, or at the file's own dir. */
+    while (p < end && depth < SCANPROF_DIR_DEPTH) {
+        const char *next = strchr(p + 1, '/');
+        if (!next || next > end) break;
+        p = next;
+        depth++;
+    }
+
+    size_t n = (size_t)(p - path);
+    if (n == 0) {
+        snprintf(out, outlen, "/");
+        return;
+    }
+    if (n >= outlen) n = outlen - 1;
+    memcpy(out, path, n);
+    out[n] = '\0';
+}
+
+static const char *magic_type(const unsigned char *head, size_t len,
+                              uint64_t size)
+{
+    if (size == 0) return "empty";
+
+    for (size_t i = 0; i < NMAGICS; i++) {
+        const magic_def_t *m = &MAGICS[i];
+        if (m->offset + m->len <= len &&
+            memcmp(head + m->offset, m->magic, m->len) == 0)
+            return m->type;
+    }
+
+    /* Text: no NULs and (almost) nothing outside printable / UTF-8. */
+    size_t odd = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = head[i];
+        if (c == 0) return "data";
+        if (c < 0x20 && c != '\n' && c != '\r' && c != '\t' && c != '\f')
+            odd++;
+    }
+    return odd * 10 <= len ? "text" : "data";
+}
+
+/* Find or claim the row for (dim, key).  Caller holds s_mutex. */
+static scanprof_row_t *lookup_locked(scanprof_dim_t dim, const char *key)
+{
+    uint32_t mask = SCANPROF_SLOTS - 1;
+    uint32_t i = key_hash(dim, key) & mask;
+
+    for (uint32_t probes = 0; probes < SCANPROF_SLOTS; probes++) {
+        slot_t *s = &s_slots[(i + probes) & mask];
+        if (!s->used) {
+            /* Past the quota, keys fold into "(other)" (which always fits:
+             * the quotas keep the table at most ~75 % full). */
+            if (s_dim_used[dim] >= SCANPROF_DIM_KEYS &&
+                strcmp(key, "(other)") != 0)
+                return lookup_locked(dim, "(other)");
+            s->used = 1;
+            s_used++;
+            s_dim_used[dim]++;
+            memset(&s->row, 0, sizeof(s->row));
+            s->row.dim = dim;
+            snprintf(s->row.key, sizeof(s->row.key), "%s", key);
+            return &s->row;
+        }
+        if (s->row.dim == dim && strcmp(s->row.key, key) == 0)
+            return &s->row;
+    }
+    return NULL;
+}
+
+static void account(scanprof_row_t *row, const scan_report_t *report,
+                    uint64_t scan_ns)
+{
+    if (!row) return;
+    row->scans++;
+    row->bytes   += report->bytes;
+    row->scan_ns += scan_ns;
+    if (report->result == SCAN_RESULT_INFECTED) row->detections++;
+    if (report->result == SCAN_RESULT_ERROR)    row->errors++;
+}
+
+static int cmp_cost_desc(const void *a, const void *b)
+{
+    const scanprof_row_t *ra = a, *rb = b;
+    if (ra->scan_ns != rb->scan_ns) return ra->scan_ns < rb->scan_ns ? 1 : -1;
+    if (ra->dim != rb->dim) return (int)ra->dim - (int)rb->dim;
+    return strcmp(ra->key, rb->key);
+}
+
+/* CSV field: quoted, with embedded quotes doubled. */
+static void csv_field(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"') fputc('"', fp);
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+void scanprof_record(const char *path, const scan_report_t *report)
+{
+    if (!path || !report) return;
+
+    char ext[SCANPROF_KEY_MAX], dir[SCANPROF_KEY_MAX];
+    ext_key(path, ext, sizeof(ext));
+    dir_key(path, dir, sizeof(dir));
+    const char *magic = magic_type(report->head, report->head_len,
+                                   report->bytes);
+
+    uint64_t scan_ns = report->t_verdict > report->t_connected
+                     ? report->t_verdict - report->t_connected : 0;
+
+    pthread_mutex_lock(&s_mutex);
+    account(lookup_locked(SCANPROF_EXT,   ext),   report, scan_ns);
+    account(lookup_locked(SCANPROF_MAGIC, magic), report, scan_ns);
+    account(lookup_locked(SCANPROF_DIR,   dir),   report, scan_ns);
+    pthread_mutex_unlock(&s_mutex);
+}
+
+int scanprof_snapshot(int dim, scanprof_row_t **rows, int *count)
+{
+    if (!rows || !count) return -1;
+    *rows = NULL;
+    *count = 0;
+
+    pthread_mutex_lock(&s_mutex);
+    if (s_used == 0) {
+        pthread_mutex_unlock(&s_mutex);
+        return 0;
+    }
+
+    scanprof_row_t *out = malloc((size_t)s_used * sizeof(*out));
+    if (!out) {
+        pthread_mutex_unlock(&s_mutex);
+        return -1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < SCANPROF_SLOTS; i++) {
+        if (s_slots[i].used && (dim < 0 || (int)s_slots[i].row.dim == dim))
+            out[n++] = s_slots[i].row;
+    }
+    pthread_mutex_unlock(&s_mutex);
+
+    qsort(out, (size_t)n, sizeof(*out), cmp_cost_desc);
+    if (n == 0) {
+        free(out);
+        out = NULL;
+    }
+    *rows = out;
+    *count = n;
+    return 0;
+}
+
+int scanprof_dump_csv(const char *path)
+{
+    const char *p = path ? path : SCANPROF_CSV_PATH;
+
+    scanprof_row_t *rows;
+    int count;
+    if (scanprof_snapshot(-1, &rows, &count) != 0) return -1;
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", p);
+    FILE *fp = fopen(tmp, "we");
+    if (!fp) {
+        log_error("Cannot write scan profile %s: %s", tmp, strerror(errno));
+        free(rows);
+        return -1;
+    }
+
+    fputs("dimension,key,scans,bytes,scan_ms,detections,errors,"
+          "ms_per_scan,ms_per_mib,detections_per_1k\n", fp);
+    for (int i = 0; i < count; i++) {
+        const scanprof_row_t *r = &rows[i];
+        double ms = (double)r->scan_ns / 1e6;
+        fprintf(fp, "%s,", scanprof_dim_name(r->dim));
+        csv_field(fp, r->key);
+        fprintf(fp, ",%llu,%llu,%.3f,%llu,%llu,%.3f,%.3f,%.3f\n",
+                (unsigned long long)r->scans, (unsigned long long)r->bytes,
+                ms, (unsigned long long)r->detections,
+                (unsigned long long)r->errors,
+                r->scans ? ms / (double)r->scans : 0.0,
+                r->bytes ? ms / ((double)r->bytes / 1048576.0) : 0.0,
+                r->scans ? 1000.0 * (double)r->detections / (double)r->scans
+                         : 0.0);
+    }
+    free(rows);
+
+    if (fclose(fp) != 0 || rename(tmp, p) != 0) {
+        log_error("Cannot write scan profile %s: %s", p, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+
+    log_info("Scan profile (%d rows) written to %s", count, p);
+    return 0;
+}
+
+void scanprof_reset(void)
+{
+    pthread_mutex_lock(&s_mutex);
+    memset(s_slots, 0, sizeof(s_slots));
+    memset(s_dim_used, 0, sizeof(s_dim_used));
+    s_used = 0;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+const char *scanprof_dim_name(scanprof_dim_t dim)
+{
+    return (unsigned)dim < SCANPROF_DIM_COUNT ? DIM_NAMES[dim] : "unknown";
+}
+
+int scanprof_dim_parse(const char *name)
+{
+    if (!name) return -1;
+    for (int i = 0; i < SCANPROF_DIM_COUNT; i++) {
+        if (strcmp(name, DIM_NAMES[i]) == 0) return i;
+    }
+    return -1;
+}
@@ -3,7 +3,7 @@
  *
  * Workers block on a condition variable when the queue is empty and wake
  * up via pthread_cond_signal() when work is submitted.  The queue is a
- * circular buffer of heap-allocated file-path strings.
+ * circular buffer of heap-allocated jobs (path + latency trace).
  *
  * Fix 2: The producer (threadpool_submit) now BLOCKS when the queue is
  *        full instead of dropping entries.  A `not_full` condition variable
@@ -12,18 +12,41 @@
  *        could be silently skipped under load.
  *
  * Memory management:
- *   - threadpool_submit() strdup()s the incoming path.
- *   - The worker function receives ownership and MUST free() the path.
- *   - threadpool_shutdown() frees any paths remaining in the queue.
+ *   - threadpool_submit() copies the incoming path into a new job
+ *     (one allocation: the path is stored inline).
+ *   - The pool frees each job after the worker function returns.
+ *   - threadpool_shutdown() frees any jobs remaining in the queue.
+ *
+ * Journal: every accepted job is recorded (journal_add) and marked done
+ * once work_fn returns, so jobs that are dropped, freed at shutdown or
+ * lost in a crash stay outstanding for the next start.
+ *
+ * Triage: a job that has to wait behind another is read and scored by a
+ * triage thread (risk_assess_path), newest first, since those wait the
+ * longest.  One scoring RISK_PRIORITY_SCORE or more is moved to the
+ * front of the queue.  The worker hands the score to the scanner, which
+ * then does not score the file again.  The head is read off the event
+ * loop and only for files that actually wait.
+ *
+ * Background lane: on-demand scans queue in a second, smaller ring that
+ * workers only look at when the main queue is empty, with at most
+ * `bg_limit` of them busy on it, so a large requested scan never delays
+ * live events by more than the job in hand.  It is neither journaled nor
+ * drained at shutdown: the requester is told the scan was cut short.
  *
  * Part of the Sentinel Endpoint Security daemon.
  */
 
 #include "threadpool.h"
 #include "logger.h"
+#include "flightrec.h"
+#include "metrics.h"
+#include "probes.h"
+#include "journal.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <pthread.h>
 
 /* ── Internal types ─────────────────────────────────────────────────────── */
@@ -34,19 +57,34 @@ struct threadpool {
     int              num_threads;   /* Number of workers                   */
 
     /* --- Bounded circular queue ---------------------------------------- */
-    char           **queue;         /* Array of heap-allocated path strings */
+    scan_job_t     **queue;         /* Array of heap-allocated jobs        */
     int              capacity;      /* Maximum queue depth                 */
     int              head;          /* Next write position                 */
     int              tail;          /* Next read position                  */
     int              count;         /* Current number of queued items      */
 
+    /* --- Background lane (same layout) --------------------------------- */
+    scan_job_t     **bg_queue;
+    int              bg_head;
+    int              bg_tail;
+    int              bg_count;
+    int              bg_active;     /* Workers running a background job    */
+    int              bg_limit;      /* Most workers on background jobs     */
+
     /* --- Synchronisation ---------------------------------------------- */
     pthread_mutex_t  mutex;         /* Protects queue + shutdown flag      */
     pthread_cond_t   not_empty;     /* Signalled when work is available    */
     pthread_cond_t   not_full;      /* Fix 2: signalled when a slot frees  */
+    pthread_cond_t   triage;        /* Signalled when a job waits unscored */
+
+    /* --- Triage -------------------------------------------------------- */
+    pthread_t        triager;
+    int              has_triager;
+    uint64_t         next_seq;      /* Last scan_job_t.seq handed out      */
 
     /* --- Lifecycle ----------------------------------------------------- */
     volatile int     shutdown;      /* Set to 1 to stop all workers       */
+    int              paused;        /* Workers take no new job while set   */
 
     /* --- Callback ------------------------------------------------------ */
     threadpool_work_fn work_fn;     /* Scan pipeline function              */
@@ -55,19 +93,41 @@ struct threadpool {
     /* --- Stats --------------------------------------------------------- */
     unsigned long     submitted;    /* Total paths submitted               */
     unsigned long     processed;    /* Paths successfully dequeued         */
+    int               active;       /* Workers currently inside work_fn    */
+    int               high_water;   /* Peak depth since last take          */
 };
 
+/* Metric IDs (registered in threadpool_create). */
+static int s_m_jumped = -1;
+
 /* ── Worker thread entry point ──────────────────────────────────────────── */
 
 static void *worker_main(void *arg)
 {
     threadpool_t *pool = (threadpool_t *)arg;
+    int busy = 0;
+    int bg   = 0;
 
     for (;;) {
         pthread_mutex_lock(&pool->mutex);
 
-        /* Wait until there is work or a shutdown signal. */
-        while (pool->count == 0 && !pool->shutdown) {
+        /* The previous item is done; account for it under this lock. */
+        if (busy) {
+            pool->active--;
+            busy = 0;
+        }
+        if (bg) {
+            /* A background slot freed up: another worker may take it. */
+            pool->bg_active--;
+            bg = 0;
+            if (pool->bg_count > 0) pthread_cond_signal(&pool->not_empty);
+        }
+
+        /* Wait until there is work (and we may take it) or a shutdown. */
+        while ((pool->paused ||
+                (pool->count == 0 &&
+                 (pool->bg_count == 0 || pool->bg_active >= pool->bg_limit))) &&
+               !pool->shutdown) {
             pthread_cond_wait(&pool->not_empty, &pool->mutex);
         }
 
@@ -77,32 +137,173 @@ static void *worker_main(void *arg)
             break;
         }
 
-        /* Dequeue the oldest path. */
-        char *filepath = pool->queue[pool->tail];
-        pool->queue[pool->tail] = NULL;
-        pool->tail = (pool->tail + 1) % pool->capacity;
-        pool->count--;
+        /* Dequeue the oldest job; live work before the background lane. */
+        scan_job_t *job;
+        int depth;
+        if (pool->count > 0) {
+            job = pool->queue[pool->tail];
+            pool->queue[pool->tail] = NULL;
+            pool->tail = (pool->tail + 1) % pool->capacity;
+            pool->count--;
+            depth = pool->count;
+
+            /*
+             * Fix 2: Signal the producer (inotify thread) that a queue slot
+             * has been freed.  This unblocks threadpool_submit() if it was
+             * waiting on a full queue.
+             */
+            pthread_cond_signal(&pool->not_full);
+        } else {
+            job = pool->bg_queue[pool->bg_tail];
+            pool->bg_queue[pool->bg_tail] = NULL;
+            pool->bg_tail = (pool->bg_tail + 1) % THREADPOOL_BG_CAPACITY;
+            pool->bg_count--;
+            pool->bg_active++;
+            bg    = 1;
+            depth = pool->bg_count;
+        }
         pool->processed++;
-
-        /*
-         * Fix 2: Signal the producer (inotify thread) that a queue slot
-         * has been freed.  This unblocks threadpool_submit() if it was
-         * waiting on a full queue.
-         */
-        pthread_cond_signal(&pool->not_full);
+        pool->active++;
+        busy = 1;
 
         pthread_mutex_unlock(&pool->mutex);
 
-        /* Execute the work function (scan → quarantine → alert).
-         * The work_fn is responsible for free()ing filepath.           */
-        if (filepath) {
-            pool->work_fn(filepath, pool->user_data);
+        /* Execute the work function (scan → quarantine → alert). */
+        if (job) {
+            trace_stamp(&job->trace, TRACE_TS_DEQUEUED);
+            fr_record(FR_EV_DEQUEUED, job->path, (uint64_t)depth);
+            SENTINEL_PROBE3(dequeue, job->path, depth,
+                            job->trace.ts[TRACE_TS_DEQUEUED] -
+                            job->trace.ts[TRACE_TS_ENQUEUED]);
+            pool->work_fn(job, pool->user_data);
+            journal_done(job->jid);
+            free(job);
         }
     }
 
     return NULL;
 }
 
+/* ── Triage thread ──────────────────────────────────────────────────────── */
+
+/*
+ * The newest job still to be scored, skipping the oldest (a worker takes
+ * it next anyway).  Caller holds pool->mutex.
+ */
+static scan_job_t *triage_pick(threadpool_t *pool)
+{
+    for (int i = pool->count - 1; i > 0; i--) {
+        scan_job_t *job = pool->queue[(pool->tail + i) % pool->capacity];
+        if (job->triage == JOB_TRIAGE_PENDING) return job;
+    }
+    return NULL;
+}
+
+/*
+ * Record the score of job `seq` if it is still queued, and move it to the
+ * front if it is risky.  Caller holds pool->mutex.
+ */
+static void triage_done(threadpool_t *pool, uint64_t seq, const risk_t *risk)
+{
+    for (int i = 0; i < pool->count; i++) {
+        int idx = (pool->tail + i) % pool->capacity;
+        scan_job_t *job = pool->queue[idx];
+        if (job->seq != seq) continue;
+
+        job->risk   = *risk;
+        job->triage = JOB_TRIAGE_DONE;
+        if (i == 0 || risk->score < RISK_PRIORITY_SCORE) return;
+
+        for (; i > 0; i--) {
+            int prev = (idx + pool->capacity - 1) % pool->capacity;
+            pool->queue[idx] = pool->queue[prev];
+            idx = prev;
+        }
+        pool->queue[idx] = job;
+        metrics_inc(s_m_jumped);
+        return;
+    }
+    /* Dequeued meanwhile: the scanner scores it itself. */
+}
+
+static void *triage_main(void *arg)
+{
+    threadpool_t *pool = (threadpool_t *)arg;
+    char path[PATH_MAX];
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        scan_job_t *job = NULL;
+        while (!pool->shutdown && !(job = triage_pick(pool)))
+            pthread_cond_wait(&pool->triage, &pool->mutex);
+        if (pool->shutdown) break;
+
+        /* Claimed: copied out so the job may be dequeued meanwhile. */
+        job->triage  = JOB_TRIAGE_SKIP;
+        uint64_t seq = job->seq;
+        size_t   len = strlen(job->path);
+        if (len >= sizeof(path)) continue;
+        memcpy(path, job->path, len + 1);
+        pthread_mutex_unlock(&pool->mutex);
+
+        risk_t risk;
+        int    rc = risk_assess_path(path, &risk);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (rc == 0) triage_done(pool, seq, &risk);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+/* Allocate a job for `filepath`, continuing `trace` or starting a new one. */
+static scan_job_t *job_new(const char *filepath, const trace_t *trace)
+{
+    size_t len = strlen(filepath);
+    scan_job_t *job = malloc(sizeof(*job) + len + 1);
+    if (!job) return NULL;
+
+    if (trace) job->trace = *trace;
+    else       trace_begin(&job->trace, metrics_now_ns());
+    job->jid    = 0;
+    job->seq    = 0;
+    job->tag    = 0;
+    job->triage = JOB_TRIAGE_PENDING;
+    memcpy(job->path, filepath, len + 1);
+    return job;
+}
+
+/*
+ * Add a job at the back (or, for recovered work, the front) of the queue
+ * and wake one worker, and the triage thread if the job has to wait.
+ * Caller holds pool->mutex and has checked for room.
+ */
+static void enqueue_locked(threadpool_t *pool, scan_job_t *job, int front)
+{
+    trace_stamp(&job->trace, TRACE_TS_ENQUEUED);
+    if (!job->jid) job->jid = journal_add(job->path);
+    job->seq = ++pool->next_seq;
+
+    if (front) {
+        pool->tail = (pool->tail + pool->capacity - 1) % pool->capacity;
+        pool->queue[pool->tail] = job;
+    } else {
+        pool->queue[pool->head] = job;
+        pool->head = (pool->head + 1) % pool->capacity;
+    }
+    pool->count++;
+    pool->submitted++;
+    if (pool->count > pool->high_water) pool->high_water = pool->count;
+    fr_record(FR_EV_ENQUEUED, job->path, (uint64_t)pool->count);
+    SENTINEL_PROBE2(enqueue, job->path, pool->count);
+
+    pthread_cond_signal(&pool->not_empty);
+    if (pool->count > 1 && job->triage == JOB_TRIAGE_PENDING)
+        pthread_cond_signal(&pool->triage);
+}
+
 /* ── Public API ─────────────────────────────────────────────────────────── */
 
 threadpool_t *threadpool_create(int num_threads,
@@ -121,12 +322,19 @@ threadpool_t *threadpool_create(int num_threads,
 
     pool->num_threads = num_threads;
     pool->capacity    = capacity;
+    pool->bg_limit    = num_threads > 1 ? num_threads - 1 : 1;
     pool->work_fn     = work_fn;
     pool->user_data   = user_data;
 
+    s_m_jumped = metrics_counter("sentinel_queue_jumps_total",
+                     "Queued files moved ahead of others for their risk score");
+
     /* Allocate the circular queue. */
-    pool->queue = calloc((size_t)capacity, sizeof(char *));
-    if (!pool->queue) {
+    pool->queue    = calloc((size_t)capacity, sizeof(scan_job_t *));
+    pool->bg_queue = calloc(THREADPOOL_BG_CAPACITY, sizeof(scan_job_t *));
+    if (!pool->queue || !pool->bg_queue) {
+        free(pool->queue);
+        free(pool->bg_queue);
         free(pool);
         return NULL;
     }
@@ -134,8 +342,10 @@ threadpool_t *threadpool_create(int num_threads,
     /* Initialise synchronisation primitives. */
     if (pthread_mutex_init(&pool->mutex, NULL) != 0 ||
         pthread_cond_init(&pool->not_empty, NULL) != 0 ||
-        pthread_cond_init(&pool->not_full, NULL) != 0) {  /* Fix 2 */
+        pthread_cond_init(&pool->not_full, NULL) != 0 ||   /* Fix 2 */
+        pthread_cond_init(&pool->triage, NULL) != 0) {
         free(pool->queue);
+        free(pool->bg_queue);
         free(pool);
         return NULL;
     }
@@ -146,7 +356,9 @@ threadpool_t *threadpool_create(int num_threads,
         pthread_mutex_destroy(&pool->mutex);
         pthread_cond_destroy(&pool->not_empty);
         pthread_cond_destroy(&pool->not_full);
+        pthread_cond_destroy(&pool->triage);
         free(pool->queue);
+        free(pool->bg_queue);
         free(pool);
         return NULL;
     }
@@ -161,6 +373,12 @@ threadpool_t *threadpool_create(int num_threads,
         }
     }
 
+    /* Without triage, files are scanned in order; not fatal. */
+    if (pthread_create(&pool->triager, NULL, triage_main, pool) == 0)
+        pool->has_triager = 1;
+    else
+        log_warn("threadpool: failed to create the triage thread");
+
     log_info("Thread pool created: %d workers, queue capacity %d",
              num_threads, capacity);
     return pool;
@@ -176,13 +394,14 @@ threadpool_t *threadpool_create(int num_threads,
  * may grow if ClamAV is slow, but this is strictly better than silently
  * bypassing the antivirus.
  */
-int threadpool_submit(threadpool_t *pool, const char *filepath)
+int threadpool_submit(threadpool_t *pool, const char *filepath,
+                      const trace_t *trace)
 {
     if (!pool || !filepath) return -1;
 
-    char *dup = strdup(filepath);
-    if (!dup) {
-        log_error("threadpool_submit: strdup failed for %s", filepath);
+    scan_job_t *job = job_new(filepath, trace);
+    if (!job) {
+        log_error("threadpool_submit: allocation failed for %s", filepath);
         return -1;
     }
 
@@ -191,7 +410,7 @@ int threadpool_submit(threadpool_t *pool, const char *filepath)
     /* If we're shutting down, reject immediately. */
     if (pool->shutdown) {
         pthread_mutex_unlock(&pool->mutex);
-        free(dup);
+        free(job);
         return -1;
     }
 
@@ -202,27 +421,129 @@ int threadpool_submit(threadpool_t *pool, const char *filepath)
      * threadpool_shutdown() can unblock a stuck producer via
      * pthread_cond_broadcast(&pool->not_full).
      */
+    if (pool->count >= pool->capacity && !pool->shutdown) {
+        /* Rate-limited: during a storm this fires once per submitted path. */
+        log_warn_rl("threadpool: queue full (%d/%d) — blocking producer "
+                    "until a worker frees a slot", pool->count, pool->capacity);
+    }
     while (pool->count >= pool->capacity && !pool->shutdown) {
-        log_warn("threadpool: queue full (%d/%d) — blocking producer "
-                 "until a worker frees a slot", pool->count, pool->capacity);
         pthread_cond_wait(&pool->not_full, &pool->mutex);
     }
 
     /* Re-check shutdown after waking up. */
     if (pool->shutdown) {
         pthread_mutex_unlock(&pool->mutex);
-        free(dup);
+        free(job);
         return -1;
     }
 
-    /* Enqueue the new path. */
-    pool->queue[pool->head] = dup;
-    pool->head = (pool->head + 1) % pool->capacity;
-    pool->count++;
+    enqueue_locked(pool, job, 0);
+
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+/*
+ * Non-blocking variant for the reactor thread, which must never sleep on
+ * `not_full`.  The caller keeps the path and retries later on 1.
+ */
+int threadpool_try_submit(threadpool_t *pool, const char *filepath,
+                          const trace_t *trace)
+{
+    if (!pool || !filepath) return -1;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->shutdown) {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+    if (pool->count >= pool->capacity) {
+        pthread_mutex_unlock(&pool->mutex);
+        return 1;
+    }
+
+    scan_job_t *job = job_new(filepath, trace);
+    if (!job) {
+        pthread_mutex_unlock(&pool->mutex);
+        log_error("threadpool_try_submit: allocation failed for %s", filepath);
+        return -1;
+    }
+
+    enqueue_locked(pool, job, 0);
+
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+int threadpool_try_requeue(threadpool_t *pool, const char *filepath,
+                           uint64_t jid)
+{
+    if (!pool || !filepath) return -1;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->shutdown) {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+    if (pool->count >= pool->capacity) {
+        pthread_mutex_unlock(&pool->mutex);
+        return 1;
+    }
+
+    scan_job_t *job = job_new(filepath, NULL);
+    if (!job) {
+        pthread_mutex_unlock(&pool->mutex);
+        log_error("threadpool_try_requeue: allocation failed for %s",
+                  filepath);
+        return -1;
+    }
+    job->jid    = jid;
+    job->triage = JOB_TRIAGE_SKIP;       /* Already at the front */
+
+    enqueue_locked(pool, job, 1);
+
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+int threadpool_try_submit_bg(threadpool_t *pool, const char *filepath,
+                             uint32_t tag)
+{
+    if (!pool || !filepath) return -1;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->shutdown) {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+    if (pool->bg_count >= THREADPOOL_BG_CAPACITY) {
+        pthread_mutex_unlock(&pool->mutex);
+        return 1;
+    }
+
+    scan_job_t *job = job_new(filepath, NULL);
+    if (!job) {
+        pthread_mutex_unlock(&pool->mutex);
+        log_error("threadpool_try_submit_bg: allocation failed for %s",
+                  filepath);
+        return -1;
+    }
+    job->tag    = tag;
+    job->triage = JOB_TRIAGE_SKIP;
+    trace_stamp(&job->trace, TRACE_TS_ENQUEUED);
+
+    pool->bg_queue[pool->bg_head] = job;
+    pool->bg_head = (pool->bg_head + 1) % THREADPOOL_BG_CAPACITY;
+    pool->bg_count++;
     pool->submitted++;
+    fr_record(FR_EV_ENQUEUED, job->path, (uint64_t)pool->bg_count);
+    SENTINEL_PROBE2(enqueue, job->path, pool->bg_count);
 
-    /* Wake one sleeping worker. */
-    pthread_cond_signal(&pool->not_empty);
+    if (pool->bg_active < pool->bg_limit)
+        pthread_cond_signal(&pool->not_empty);
 
     pthread_mutex_unlock(&pool->mutex);
     return 0;
@@ -240,35 +561,110 @@ void threadpool_shutdown(threadpool_t *pool)
     pool->shutdown = 1;
     pthread_cond_broadcast(&pool->not_empty);  /* Wake all workers.    */
     pthread_cond_broadcast(&pool->not_full);   /* Fix 2: unblock submit. */
+    pthread_cond_signal(&pool->triage);
     pthread_mutex_unlock(&pool->mutex);
 
     /* Join all worker threads. */
     for (int i = 0; i < pool->num_threads; i++) {
         pthread_join(pool->threads[i], NULL);
     }
+    if (pool->has_triager) pthread_join(pool->triager, NULL);
 
-    /* Free any paths still in the queue. */
+    /* Free any jobs still in the queue. */
     for (int i = 0; i < pool->capacity; i++) {
         if (pool->queue[i]) {
             free(pool->queue[i]);
             pool->queue[i] = NULL;
         }
     }
+    for (int i = 0; i < THREADPOOL_BG_CAPACITY; i++)
+        free(pool->bg_queue[i]);
 
     /* Clean up all synchronisation primitives. */
     pthread_mutex_destroy(&pool->mutex);
     pthread_cond_destroy(&pool->not_empty);
     pthread_cond_destroy(&pool->not_full);    /* Fix 2 */
+    pthread_cond_destroy(&pool->triage);
     free(pool->threads);
     free(pool->queue);
+    free(pool->bg_queue);
     free(pool);
 
     log_info("Thread pool destroyed.");
 }
 
+void threadpool_pause(threadpool_t *pool, int paused)
+{
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->paused = paused;
+    if (!paused) pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void threadpool_foreach_queued(threadpool_t *pool,
+                               void (*fn)(const scan_job_t *job, void *arg),
+                               void *arg)
+{
+    if (!pool || !fn) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0, idx = pool->tail; i < pool->count;
+         i++, idx = (idx + 1) % pool->capacity)
+        fn(pool->queue[idx], arg);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int threadpool_drop_queued(threadpool_t *pool)
+{
+    if (!pool) return 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    int dropped = pool->count;
+    while (pool->count > 0) {
+        free(pool->queue[pool->tail]);
+        pool->queue[pool->tail] = NULL;
+        pool->tail = (pool->tail + 1) % pool->capacity;
+        pool->count--;
+    }
+    pthread_cond_broadcast(&pool->not_full);
+    pthread_mutex_unlock(&pool->mutex);
+    return dropped;
+}
+
 int threadpool_queue_size(threadpool_t *pool)
 {
     if (!pool) return 0;
     /* Non-atomic read — approximate is fine for monitoring. */
     return pool->count;
 }
+
+void threadpool_get_stats(threadpool_t *pool, threadpool_stats_t *out)
+{
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    out->depth     = pool->count;
+    out->capacity  = pool->capacity;
+    out->threads   = pool->num_threads;
+    out->active    = pool->active;
+    out->bg_depth  = pool->bg_count;
+    out->bg_active = pool->bg_active;
+    out->submitted = pool->submitted;
+    out->processed = pool->processed;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int threadpool_take_high_water(threadpool_t *pool)
+{
+    if (!pool) return 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    int peak = pool->high_water;
+    pool->high_water = pool->count;
+    pthread_mutex_unlock(&pool->mutex);
+    return peak;
+}
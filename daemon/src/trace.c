@@ -0,0 +1,227 @@
+/*
+ * trace.c — Stage histograms and sampled Chrome-trace output.
+ *
+ * A stage is the gap between two consecutive stamps that were both
+ * reached; "total" is event → done.  Sampled items become "X" (complete)
+ * events on a row (tid) of their own, named after the file, so a slow
+ * item is visible at a glance in chrome://tracing or Perfetto.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "trace.h"
+#include "metrics.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+/* A stage ends at `to` and starts at the latest reached stamp before it. */
+typedef struct {
+    const char   *name;              /* Histogram series / trace event name */
+    trace_stamp_t to;
+} stage_def_t;
+
+static const stage_def_t STAGES[] = {
+    { "sentinel_stage_duration_seconds{stage=\"filter\"}",     TRACE_TS_FILTERED  },
+    { "sentinel_stage_duration_seconds{stage=\"submit\"}",     TRACE_TS_ENQUEUED  },
+    { "sentinel_stage_duration_seconds{stage=\"queue_wait\"}", TRACE_TS_DEQUEUED  },
+    { "sentinel_stage_duration_seconds{stage=\"connect\"}",    TRACE_TS_CONNECTED },
+    { "sentinel_stage_duration_seconds{stage=\"stream\"}",     TRACE_TS_STREAMED  },
+    { "sentinel_stage_duration_seconds{stage=\"clamd\"}",      TRACE_TS_VERDICT   },
+    { "sentinel_stage_duration_seconds{stage=\"finalize\"}",   TRACE_TS_DONE      },
+};
+
+#define NSTAGES (sizeof(STAGES) / sizeof(STAGES[0]))
+
+static const char *const OUTCOME_NAMES[TRACE_OUT_COUNT] = {
+    "verdict", "offline", "vanished",
+};
+
+static const char *const OUTCOME_METRICS[TRACE_OUT_COUNT] = {
+    "sentinel_files_finished_total{outcome=\"verdict\"}",
+    "sentinel_files_finished_total{outcome=\"offline\"}",
+    "sentinel_files_finished_total{outcome=\"vanished\"}",
+};
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static int             s_stage_hist[NSTAGES];
+static int             s_total_hist   = -1;
+static int             s_m_outcome[TRACE_OUT_COUNT];
+static unsigned        s_sample_every = 0;
+static uint64_t        s_next_id      = 0;
+
+static FILE           *s_trace_fp     = NULL;
+static int             s_trace_events = 0;    /* Events written so far */
+static pthread_mutex_t s_trace_mutex  = PTHREAD_MUTEX_INITIALIZER;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+/* Short stage label: the text between the quotes of the series name. */
+static void stage_label(const char *series, char *out, size_t outlen)
+{
+    const char *q = strchr(series, '"');
+    size_t n = 0;
+    if (q) {
+        q++;
+        while (q[n] && q[n] != '"') n++;
+    }
+    if (n >= outlen) n = outlen - 1;
+    memcpy(out, q ? q : "", n);
+    out[n] = '\0';
+}
+
+/* Write `s` as a JSON string body (no surrounding quotes). */
+static void json_escape(FILE *fp, const char *s)
+{
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(fp, "\\%c", c);
+        else if (c < 0x20)         fprintf(fp, "\\u%04x", c);
+        else                       fputc(c, fp);
+    }
+}
+
+static void event_sep(void)
+{
+    fputs(s_trace_events++ ? ",\n" : "\n", s_trace_fp);
+}
+
+static void write_sample(const trace_t *t, const char *path,
+                         trace_outcome_t outcome)
+{
+    int pid = (int)getpid();
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    pthread_mutex_lock(&s_trace_mutex);
+    if (!s_trace_fp) {
+        pthread_mutex_unlock(&s_trace_mutex);
+        return;
+    }
+
+    /* Name the row after the file, and how it ended if not scanned. */
+    event_sep();
+    fprintf(s_trace_fp,
+            "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%llu,"
+            "\"args\":{\"name\":\"", pid, (unsigned long long)t->id);
+    json_escape(s_trace_fp, base);
+    if (outcome != TRACE_OUT_VERDICT)
+        fprintf(s_trace_fp, " (%s)", OUTCOME_NAMES[outcome]);
+    fputs("\"}}", s_trace_fp);
+
+    uint64_t prev = t->ts[TRACE_TS_EVENT];
+    for (size_t i = 0; i < NSTAGES; i++) {
+        uint64_t end = t->ts[STAGES[i].to];
+        if (!end) continue;
+        if (prev && end >= prev) {
+            char label[32];
+            stage_label(STAGES[i].name, label, sizeof(label));
+            event_sep();
+            fprintf(s_trace_fp,
+                    "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":%d,\"tid\":%llu,"
+                    "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"path\":\"",
+                    label, pid, (unsigned long long)t->id,
+                    (double)prev / 1e3, (double)(end - prev) / 1e3);
+            json_escape(s_trace_fp, path);
+            fputs("\"}}", s_trace_fp);
+        }
+        prev = end;
+    }
+    fflush(s_trace_fp);
+    pthread_mutex_unlock(&s_trace_mutex);
+}
+
+/* ── Public API ─────────────────────────────────────────────────────────── */
+
+int trace_init(unsigned sample_every, const char *path)
+{
+    for (size_t i = 0; i < NSTAGES; i++) {
+        s_stage_hist[i] = metrics_histogram(STAGES[i].name,
+                              "Per-file time spent in each pipeline stage");
+    }
+    s_total_hist = metrics_histogram("sentinel_file_latency_seconds",
+                       "inotify event to final verdict, per file");
+    for (int i = 0; i < TRACE_OUT_COUNT; i++)
+        s_m_outcome[i] = metrics_counter(OUTCOME_METRICS[i],
+                             "Files that left the scan pipeline, by outcome");
+
+    s_sample_every = sample_every;
+    if (!sample_every) return 0;
+
+    const char *p = path ? path : TRACE_DEFAULT_PATH;
+    s_trace_fp = fopen(p, "we");
+    if (!s_trace_fp) {
+        log_error("Cannot open trace file %s: %s", p, strerror(errno));
+        s_sample_every = 0;
+        return -1;
+    }
+    fputc('[', s_trace_fp);
+
+    log_info("Latency tracing: sampling 1 in %u files → %s", sample_every, p);
+    return 0;
+}
+
+void trace_begin(trace_t *t, uint64_t event_ns)
+{
+    if (!t) return;
+
+    memset(t, 0, sizeof(*t));
+    t->id = __atomic_add_fetch(&s_next_id, 1, __ATOMIC_RELAXED);
+    t->ts[TRACE_TS_EVENT] = event_ns;
+    t->sampled = s_sample_every && (t->id % s_sample_every) == 0;
+}
+
+void trace_stamp(trace_t *t, trace_stamp_t stage)
+{
+    if (t && (unsigned)stage < TRACE_TS_COUNT)
+        t->ts[stage] = metrics_now_ns();
+}
+
+void trace_finish(const trace_t *t, const char *path,
+                  trace_outcome_t outcome)
+{
+    if (!t || !t->ts[TRACE_TS_EVENT]) return;
+    if ((unsigned)outcome >= TRACE_OUT_COUNT) outcome = TRACE_OUT_VERDICT;
+    metrics_inc(s_m_outcome[outcome]);
+
+    uint64_t prev = t->ts[TRACE_TS_EVENT];
+    for (size_t i = 0; i < NSTAGES; i++) {
+        uint64_t end = t->ts[STAGES[i].to];
+        if (!end) continue;                  /* Stage skipped (e.g. offline) */
+        if (prev && end >= prev)
+            metrics_observe_ns(s_stage_hist[i], end - prev);
+        prev = end;
+    }
+
+    /* A vanished file never got a verdict: keep it out of the latency. */
+    if (outcome != TRACE_OUT_VANISHED &&
+        t->ts[TRACE_TS_DONE] >= t->ts[TRACE_TS_EVENT])
+        metrics_observe_ns(s_total_hist,
+                           t->ts[TRACE_TS_DONE] - t->ts[TRACE_TS_EVENT]);
+
+    if (t->sampled && path) write_sample(t, path, outcome);
+}
+
+int trace_latency_snapshot(metrics_hist_snapshot_t *out)
+{
+    return metrics_hist_snapshot(s_total_hist, out);
+}
+
+void trace_shutdown(void)
+{
+    pthread_mutex_lock(&s_trace_mutex);
+    if (s_trace_fp) {
+        fputs("\n]\n", s_trace_fp);
+        fclose(s_trace_fp);
+        s_trace_fp = NULL;
+    }
+    pthread_mutex_unlock(&s_trace_mutex);
+}
@@ -0,0 +1,933 @@
+/*
+ * bench.c — End-to-end pipeline benchmark for the Sentinel daemon.
+ *
+ * Starts a private daemon (isolated sockets, log, quarantine and watch
+ * root under a temp directory) against a mock or real clamd, connects to
+ * it as a GUI client, then generates file-event storms under the watch
+ * root and matches each file to its verdict event:
+ *
+ *   small   many small files in a flat tree
+ *   build   bursts of object files into freshly created directories,
+ *           plus archives written via a hidden temp file and rename
+ *   large   a few large files written in 1 MiB chunks
+ *   rename  downloads written as NAME.part and renamed when complete
+ *   deep    directory chains created and populated level by level
+ *
+ * For each workload it reports throughput, time-to-verdict percentiles
+ * (file closed or renamed → verdict event received), missing verdicts,
+ * inotify overflows, queue pushback, dropped IPC messages and the
+ * daemon's CPU time and RSS, as one JSON document on stdout (or -o), so
+ * runs of different daemon builds can be diffed on the same machine.
+ *
+ * Usage:
+ *   sentinel-bench [options]
+ *     -d PATH     daemon binary            (default ./sentinel-daemon)
+ *     -m PATH     mock clamd binary        (default ./sentinel-mockclamd)
+ *     -c PATH     use this clamd socket instead of starting the mock
+ *     -l DIST     mock clamd latency, see sentinel-mockclamd -l
+ *     -w LIST     workloads, comma separated (default all)
+ *     -n N        base file count          (default 2000)
+ *     -L BYTES    size of "large" files    (default 16 MiB)
+ *     -E PCT      percentage of files carrying the EICAR test string
+ *     -j N        daemon worker threads    (default: daemon's)
+ *     -Q N        daemon queue capacity    (default: daemon's)
+ *     -T SEC      give up on a workload after SEC s without a verdict
+ *                 (default 10)
+ *     -r DIR      create the temp root under DIR (default /tmp)
+ *     -o FILE     write the JSON report to FILE
+ *     -S SEED     random seed
+ *     -k          keep the temp root
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+/* ── Limits & defaults ──────────────────────────────────────────────────── */
+
+#define BENCH_FILES          2000
+#define BENCH_LARGE_SIZE     (16u << 20)
+#define BENCH_IDLE_TIMEOUT_S 10
+#define BENCH_CHUNK          (1u << 20)
+#define BENCH_BURST          200          /* build: files per directory    */
+#define BENCH_DEPTH          8            /* deep: levels per chain        */
+#define BENCH_START_TIMEOUT  10000        /* ms to wait for daemon / mock  */
+#define BENCH_LINE_MAX       8192
+
+static const char EICAR[] =
+    "X5O!P%@AP[4\\PZX54(P^)7CC)7}$EICAR-STANDARD-ANTIVIRUS-TEST-FILE!$H+H*";
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+enum { V_NONE, V_CLEAN, V_THREAT, V_ERROR };
+
+typedef struct {
+    char     *path;
+    uint64_t  t_written;      /* 0 until closed / renamed into place      */
+    uint64_t  t_done;         /* First verdict at or after t_written      */
+    int       verdict;
+    int       expect_threat;
+} file_rec_t;
+
+typedef struct {
+    const char *name;
+    void      (*run)(const char *dir);
+} workload_t;
+
+typedef struct {
+    uint64_t overflows, pushback, ipc_dropped;
+} daemon_counters_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static const char *s_daemon_bin = "./sentinel-daemon";
+static const char *s_mock_bin   = "./sentinel-mockclamd";
+static const char *s_clamd      = NULL;
+static const char *s_latency    = NULL;
+static const char *s_parent     = "/tmp";
+static int         s_nfiles     = BENCH_FILES;
+static uint64_t    s_large_size = BENCH_LARGE_SIZE;
+static double      s_eicar_pct  = 0.0;
+static int         s_workers    = 0;
+static int         s_queue      = 0;
+static int         s_idle_s     = BENCH_IDLE_TIMEOUT_S;
+static uint64_t    s_seed       = 0;
+static int         s_keep       = 0;
+
+static char        s_root[256];
+static char        s_gui_sock[300], s_metrics_sock[300], s_mock_sock[300];
+static pid_t       s_daemon_pid = -1, s_mock_pid = -1;
+static int         s_gui_fd     = -1;
+
+/* Registry of the current workload's files, keyed by path. */
+static pthread_mutex_t s_mutex = PTHREAD_MUTEX_INITIALIZER;
+static file_rec_t     *s_table     = NULL;
+static size_t          s_table_cap = 0;
+static size_t          s_nrecs     = 0;
+static uint64_t        s_unmatched = 0;   /* Verdicts for untracked paths  */
+static uint64_t        s_last_verdict_ns = 0;
+
+static unsigned char  *s_junk = NULL;     /* BENCH_CHUNK of random bytes  */
+static uint64_t        s_bytes = 0;       /* Bytes written this workload  */
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ms(unsigned ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+/* xorshift64* — reproducible with -S. */
+static uint64_t rnd(void)
+{
+    s_seed ^= s_seed >> 12;
+    s_seed ^= s_seed << 25;
+    s_seed ^= s_seed >> 27;
+    return s_seed * 2685821657736338717ull;
+}
+
+static uint64_t rnd_range(uint64_t lo, uint64_t hi)
+{
+    return lo + rnd() % (hi - lo + 1);
+}
+
+static void die(const char *what)
+{
+    fprintf(stderr, "sentinel-bench: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static uint32_t path_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Caller holds s_mutex. */
+static file_rec_t *lookup_locked(const char *path, int create)
+{
+    size_t mask = s_table_cap - 1;
+    for (size_t i = path_hash(path) & mask;; i = (i + 1) & mask) {
+        file_rec_t *r = &s_table[i];
+        if (!r->path) {
+            if (!create || s_nrecs * 2 >= s_table_cap) return NULL;
+            r->path = strdup(path);
+            if (!r->path) return NULL;
+            s_nrecs++;
+            return r;
+        }
+        if (strcmp(r->path, path) == 0) return r;
+    }
+}
+
+static void table_reset(size_t expected)
+{
+    for (size_t i = 0; i < s_table_cap; i++) free(s_table[i].path);
+    free(s_table);
+
+    s_table_cap = 1024;
+    while (s_table_cap < expected * 2 + 16) s_table_cap <<= 1;
+    s_table = calloc(s_table_cap, sizeof(*s_table));
+    if (!s_table) die("calloc");
+    s_nrecs = 0;
+    s_unmatched = 0;
+    s_bytes = 0;
+}
+
+/* Register before creating, so a verdict racing the write is not "untracked". */
+static void track(const char *path, int expect_threat)
+{
+    pthread_mutex_lock(&s_mutex);
+    file_rec_t *r = lookup_locked(path, 1);
+    if (r) {
+        r->t_written = 0;
+        r->t_done = 0;
+        r->verdict = V_NONE;
+        r->expect_threat = expect_threat;
+    }
+    pthread_mutex_unlock(&s_mutex);
+}
+
+static void mark_written(const char *path)
+{
+    uint64_t t = now_ns();
+    pthread_mutex_lock(&s_mutex);
+    file_rec_t *r = lookup_locked(path, 0);
+    if (r) r->t_written = t;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+static int pick_eicar(void)
+{
+    return s_eicar_pct > 0 && (double)(rnd() % 10000) < s_eicar_pct * 100.0;
+}
+
+/* Write `size` bytes (or the EICAR string) to path in `chunk` pieces. */
+static void write_file(const char *path, uint64_t size, size_t chunk,
+                       int eicar)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) die(path);
+
+    if (eicar) {
+        if (write(fd, EICAR, sizeof(EICAR) - 1) < 0) die(path);
+        s_bytes += sizeof(EICAR) - 1;
+    } else {
+        uint64_t left = size;
+        while (left > 0) {
+            size_t n = left < chunk ? (size_t)left : chunk;
+            size_t off = (size_t)(rnd() % (BENCH_CHUNK - n + 1));
+            ssize_t w = write(fd, s_junk + off, n);
+            if (w < 0) die(path);
+            left -= (uint64_t)w;
+        }
+        s_bytes += size;
+    }
+    if (close(fd) != 0) die(path);
+}
+
+/* Write a tracked file in place. */
+static void emit_file(const char *path, uint64_t size)
+{
+    int eicar = pick_eicar();
+    track(path, eicar);
+    write_file(path, size, BENCH_CHUNK, eicar);
+    mark_written(path);
+}
+
+static void make_dir(const char *path)
+{
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) die(path);
+}
+
+/* ── Workloads ──────────────────────────────────────────────────────────── */
+
+static void wl_small(const char *dir)
+{
+    char path[512];
+    for (int i = 0; i < s_nfiles; i++) {
+        snprintf(path, sizeof(path), "%s/f-%06d.dat", dir, i);
+        emit_file(path, rnd_range(64, 4096));
+    }
+}
+
+static void wl_build(const char *dir)
+{
+    char sub[512], path[600], tmp[600];
+    int  ndirs = (s_nfiles + BENCH_BURST - 1) / BENCH_BURST;
+
+    for (int d = 0, left = s_nfiles; d < ndirs; d++) {
+        snprintf(sub, sizeof(sub), "%s/obj-%03d", dir, d);
+        make_dir(sub);
+
+        int burst = left < BENCH_BURST ? left : BENCH_BURST;
+        for (int i = 0; i < burst; i++) {
+            snprintf(path, sizeof(path), "%s/unit-%04d.o", sub, i);
+            emit_file(path, rnd_range(1024, 65536));
+        }
+        left -= burst;
+
+        /* ar(1)-style: hidden temp file renamed over the archive. */
+        snprintf(path, sizeof(path), "%s/libobj-%03d.a", sub, d);
+        snprintf(tmp, sizeof(tmp), "%s/.libobj-%03d.a.tmp", sub, d);
+        int eicar = pick_eicar();
+        track(path, eicar);
+        write_file(tmp, rnd_range(65536, 1u << 20), 65536, eicar);
+        if (rename(tmp, path) != 0) die(path);
+        mark_written(path);
+
+        sleep_ms(10);                       /* Gap between compile steps */
+    }
+}
+
+static void wl_large(const char *dir)
+{
+    char path[512];
+    int  n = s_nfiles / 100 < 4 ? 4 : s_nfiles / 100;
+    for (int i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/big-%03d.img", dir, i);
+        emit_file(path, s_large_size);
+    }
+}
+
+static void wl_rename(const char *dir)
+{
+    char path[512], part[520];
+    int  n = s_nfiles / 10 < 8 ? 8 : s_nfiles / 10;
+    for (int i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/dl-%05d.bin", dir, i);
+        snprintf(part, sizeof(part), "%s.part", path);
+        int eicar = pick_eicar();
+        track(path, eicar);
+        write_file(part, rnd_range(256 << 10, 4u << 20),
+                   (size_t)rnd_range(64 << 10, BENCH_CHUNK), eicar);
+        if (rename(part, path) != 0) die(path);
+        mark_written(path);
+    }
+}
+
+static void wl_deep(const char *dir)
+{
+    char path[4096], file[4200];
+    int  chains = s_nfiles / 50 < 4 ? 4 : s_nfiles / 50;
+    for (int c = 0; c < chains; c++) {
+        int len = snprintf(path, sizeof(path), "%s/tree-%04d", dir, c);
+        make_dir(path);
+        for (int level = 0; level < BENCH_DEPTH; level++) {
+            len += snprintf(path + len, sizeof(path) - (size_t)len,
+                            "/d%d", level);
+            make_dir(path);
+            /* Written immediately: races the daemon adding the watch. */
+            snprintf(file, sizeof(file), "%s/leaf.txt", path);
+            emit_file(file, rnd_range(256, 2048));
+        }
+    }
+}
+
+static const workload_t WORKLOADS[] = {
+    { "small",  wl_small  },
+    { "build",  wl_build  },
+    { "large",  wl_large  },
+    { "rename", wl_rename },
+    { "deep",   wl_deep   },
+};
+
+#define NWORKLOADS (sizeof(WORKLOADS) / sizeof(WORKLOADS[0]))
+
+/* ── Daemon plumbing ────────────────────────────────────────────────────── */
+
+static int unix_connect(const char *path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int wait_connect(const char *path, pid_t child)
+{
+    for (int waited = 0; waited < BENCH_START_TIMEOUT; waited += 20) {
+        int fd = unix_connect(path);
+        if (fd >= 0) return fd;
+        if (child > 0 && waitpid(child, NULL, WNOHANG) == child) return -1;
+        sleep_ms(20);
+    }
+    return -1;
+}
+
+static pid_t spawn(char *const argv[], const char *out_path)
+{
+    pid_t pid = fork();
+    if (pid < 0) die("fork");
+    if (pid == 0) {
+        int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execv(argv[0], argv);
+        fprintf(stderr, "exec %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+    return pid;
+}
+
+static void stop_child(pid_t *pid)
+{
+    if (*pid <= 0) return;
+    kill(*pid, SIGTERM);
+    for (int i = 0; i < 250; i++) {
+        if (waitpid(*pid, NULL, WNOHANG) == *pid) {
+            *pid = -1;
+            return;
+        }
+        sleep_ms(20);
+    }
+    kill(*pid, SIGKILL);
+    waitpid(*pid, NULL, 0);
+    *pid = -1;
+}
+
+/* Scrape the metrics socket.  Caller frees. */
+static char *scrape(void)
+{
+    int fd = unix_connect(s_metrics_sock);
+    if (fd < 0) return NULL;
+    if (write(fd, "metrics\n", 8) != 8) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t cap = 16384, len = 0;
+    char *buf = malloc(cap);
+    for (;;) {
+        if (!buf) break;
+        if (len + 4096 > cap) {
+            char *nb = realloc(buf, cap *= 2);
+            if (!nb) { free(buf); buf = NULL; break; }
+            buf = nb;
+        }
+        ssize_t n = read(fd, buf + len, cap - len - 1);
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    close(fd);
+    if (buf) buf[len] = '\0';
+    return buf;
+}
+
+static uint64_t metric(const char *text, const char *name)
+{
+    size_t nlen = strlen(name);
+    for (const char *p = text; p && *p; p = strchr(p, '\n'), p = p ? p + 1 : p) {
+        if (strncmp(p, name, nlen) == 0 && p[nlen] == ' ')
+            return strtoull(p + nlen + 1, NULL, 10);
+    }
+    return 0;
+}
+
+static void read_counters(daemon_counters_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    char *m = scrape();
+    if (!m) return;
+    c->overflows   = metric(m, "sentinel_inotify_overflows_total");
+    c->pushback    = metric(m, "sentinel_queue_full_pauses_total");
+    c->ipc_dropped = metric(m, "sentinel_ipc_dropped_messages_total");
+    free(m);
+}
+
+/* Daemon CPU seconds (user + system) from /proc/<pid>/stat. */
+static double daemon_cpu_s(void)
+{
+    char path[64], buf[1024];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)s_daemon_pid);
+    FILE *fp = fopen(path, "re");
+    if (!fp) return 0;
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+    fclose(fp);
+    buf[n] = '\0';
+
+    /* Fields after the parenthesised comm: state is field 3, utime 14. */
+    char *p = strrchr(buf, ')');
+    unsigned long long ut = 0, st = 0;
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u "
+                     "%llu %llu", &ut, &st) != 2)
+        return 0;
+    return (double)(ut + st) / (double)sysconf(_SC_CLK_TCK);
+}
+
+static long daemon_status_kib(const char *field)
+{
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)s_daemon_pid);
+    FILE *fp = fopen(path, "re");
+    if (!fp) return 0;
+    long v = 0;
+    size_t flen = strlen(field);
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, field, flen) == 0 && line[flen] == ':') {
+            v = strtol(line + flen + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(fp);
+    return v;
+}
+
+/* ── Event reader ───────────────────────────────────────────────────────── */
+
+/* Copy the string value of "key" out of a flat JSON line. */
+static int json_str(const char *line, const char *key, char *out, size_t outlen)
+{
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\":\"", key);
+    const char *p = strstr(line, pat);
+    if (!p) return -1;
+    p += strlen(pat);
+    const char *end = strchr(p, '"');
+    if (!end || (size_t)(end - p) >= outlen) return -1;
+    memcpy(out, p, (size_t)(end - p));
+    out[end - p] = '\0';
+    return 0;
+}
+
+static void on_line(const char *line)
+{
+    char event[32], path[4096];
+    if (json_str(line, "event", event, sizeof(event)) != 0) return;
+
+    int verdict;
+    if (strcmp(event, "scan_clean") == 0)       verdict = V_CLEAN;
+    else if (strcmp(event, "scan_threat") == 0) verdict = V_THREAT;
+    else if (strcmp(event, "status") == 0 && strstr(line, "locked down"))
+        verdict = V_ERROR;                      /* Scan error / offline */
+    else return;
+
+    if (json_str(line, "filename", path, sizeof(path)) != 0) return;
+
+    uint64_t t = now_ns();
+    pthread_mutex_lock(&s_mutex);
+    file_rec_t *r = s_table ? lookup_locked(path, 0) : NULL;
+    if (r && r->t_written && !r->t_done) {
+        r->t_done  = t;
+        r->verdict = verdict;
+    } else if (!r) {
+        s_unmatched++;
+    }
+    s_last_verdict_ns = t;
+    pthread_mutex_unlock(&s_mutex);
+}
+
+static void *reader_main(void *arg)
+{
+    (void)arg;
+    static char buf[BENCH_LINE_MAX * 4];
+    size_t len = 0;
+
+    for (;;) {
+        ssize_t n = read(s_gui_fd, buf + len, sizeof(buf) - len - 1);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;
+        }
+        len += (size_t)n;
+        buf[len] = '\0';
+
+        char *start = buf, *nl;
+        while ((nl = strchr(start, '\n')) != NULL) {
+            *nl = '\0';
+            on_line(start);
+            start = nl + 1;
+        }
+        len -= (size_t)(start - buf);
+        memmove(buf, start, len);
+        if (len >= sizeof(buf) - 1) len = 0;    /* Oversized line */
+    }
+    return NULL;
+}
+
+/* ── Reporting ──────────────────────────────────────────────────────────── */
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double pct_ms(const uint64_t *v, size_t n, double q)
+{
+    if (!n) return 0;
+    size_t i = (size_t)(q * (double)n + 0.5);
+    if (i > 0) i--;
+    if (i >= n) i = n - 1;
+    return (double)v[i] / 1e6;
+}
+
+/* Wait until every file has a verdict, or the daemon goes quiet. */
+static void drain(void)
+{
+    for (;;) {
+        size_t pending = 0;
+        pthread_mutex_lock(&s_mutex);
+        for (size_t i = 0; i < s_table_cap; i++) {
+            if (s_table[i].path && !s_table[i].t_done) pending++;
+        }
+        uint64_t last = s_last_verdict_ns;
+        pthread_mutex_unlock(&s_mutex);
+
+        if (pending == 0) return;
+        if (now_ns() - last > (uint64_t)s_idle_s * 1000000000ull) return;
+        sleep_ms(50);
+    }
+}
+
+static void run_workload(FILE *out, const workload_t *wl, int first)
+{
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/watch/%s", s_root, wl->name);
+
+    daemon_counters_t c0, c1;
+    read_counters(&c0);
+    double cpu0 = daemon_cpu_s();
+
+    pthread_mutex_lock(&s_mutex);
+    table_reset((size_t)s_nfiles * 2);
+    pthread_mutex_unlock(&s_mutex);
+
+    uint64_t t0 = now_ns();
+    s_last_verdict_ns = t0;
+    wl->run(dir);
+    uint64_t t_written = now_ns();
+    pthread_mutex_lock(&s_mutex);
+    s_last_verdict_ns = t_written;
+    pthread_mutex_unlock(&s_mutex);
+    drain();
+
+    /* Collect results under the lock; the reader may still be running. */
+    pthread_mutex_lock(&s_mutex);
+    uint64_t *ttv = malloc((s_nrecs ? s_nrecs : 1) * sizeof(*ttv));
+    if (!ttv) die("malloc");
+    size_t nttv = 0, missing = 0, expect_threat = 0;
+    size_t counts[4] = { 0 };
+    uint64_t t_end = t_written, sum = 0;
+    for (size_t i = 0; i < s_table_cap; i++) {
+        const file_rec_t *r = &s_table[i];
+        if (!r->path) continue;
+        expect_threat += (size_t)r->expect_threat;
+        if (!r->t_done) {
+            missing++;
+            continue;
+        }
+        counts[r->verdict]++;
+        ttv[nttv++] = r->t_done - r->t_written;
+        sum += r->t_done - r->t_written;
+        if (r->t_done > t_end) t_end = r->t_done;
+    }
+    size_t   nfiles    = s_nrecs;
+    uint64_t unmatched = s_unmatched;
+    uint64_t bytes     = s_bytes;
+    pthread_mutex_unlock(&s_mutex);
+
+    qsort(ttv, nttv, sizeof(*ttv), cmp_u64);
+    read_counters(&c1);
+    double cpu = daemon_cpu_s() - cpu0;
+    double dur = (double)(t_end - t0) / 1e9;
+
+    fprintf(out,
+        "%s    {\"name\":\"%s\",\"files\":%zu,\"bytes\":%llu,"
+        "\"write_s\":%.3f,\"duration_s\":%.3f,"
+        "\"files_per_sec\":%.1f,\"mib_per_sec\":%.2f,\n"
+        "     \"verdicts\":{\"clean\":%zu,\"threat\":%zu,\"error\":%zu},"
+        "\"expected_threats\":%zu,\"missing\":%zu,\"untracked_verdicts\":%llu,\n"
+        "     \"ttv_ms\":{\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,"
+        "\"max\":%.3f,\"mean\":%.3f},\n"
+        "     \"events\":{\"inotify_overflows\":%llu,\"queue_full_pauses\":%llu,"
+        "\"ipc_dropped\":%llu},\n"
+        "     \"daemon\":{\"cpu_s\":%.3f,\"cpu_pct\":%.1f,"
+        "\"rss_kib\":%ld,\"rss_peak_kib\":%ld}}",
+        first ? "" : ",\n", wl->name, nfiles, (unsigned long long)bytes,
+        (double)(t_written - t0) / 1e9, dur,
+        dur > 0 ? (double)nfiles / dur : 0.0,
+        dur > 0 ? (double)bytes / 1048576.0 / dur : 0.0,
+        counts[V_CLEAN], counts[V_THREAT], counts[V_ERROR],
+        expect_threat, missing, (unsigned long long)unmatched,
+        pct_ms(ttv, nttv, 0.50), pct_ms(ttv, nttv, 0.90),
+        pct_ms(ttv, nttv, 0.99), pct_ms(ttv, nttv, 1.0),
+        nttv ? (double)sum / (double)nttv / 1e6 : 0.0,
+        (unsigned long long)(c1.overflows - c0.overflows),
+        (unsigned long long)(c1.pushback - c0.pushback),
+        (unsigned long long)(c1.ipc_dropped - c0.ipc_dropped),
+        cpu, dur > 0 ? 100.0 * cpu / dur : 0.0,
+        daemon_status_kib("VmRSS"), daemon_status_kib("VmHWM"));
+    fflush(out);
+
+    fprintf(stderr, "sentinel-bench: %-6s %zu files, %.2fs, p99 %.1f ms, "
+            "%zu missing\n", wl->name, nfiles, dur,
+            pct_ms(ttv, nttv, 0.99), missing);
+    free(ttv);
+}
+
+/* ── Setup & teardown ───────────────────────────────────────────────────── */
+
+static int rm_entry(const char *path, const struct stat *st, int flag,
+                    struct FTW *ftw)
+{
+    (void)st;
+    (void)ftw;
+    return flag == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void cleanup(void)
+{
+    if (s_gui_fd >= 0) shutdown(s_gui_fd, SHUT_RDWR);
+    stop_child(&s_daemon_pid);
+    stop_child(&s_mock_pid);
+    if (s_root[0] && !s_keep)
+        nftw(s_root, rm_entry, 16, FTW_DEPTH | FTW_PHYS);
+    else if (s_root[0])
+        fprintf(stderr, "sentinel-bench: kept %s\n", s_root);
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    cleanup();
+    _exit(130);
+}
+
+static void start_mock(void)
+{
+    snprintf(s_mock_sock, sizeof(s_mock_sock), "%s/clamd.sock", s_root);
+    char seed[32], out[300];
+    snprintf(seed, sizeof(seed), "%llu", (unsigned long long)s_seed);
+    snprintf(out, sizeof(out), "%s/mockclamd.out", s_root);
+
+    char *argv[12];
+    int   argc = 0;
+    argv[argc++] = (char *)s_mock_bin;
+    argv[argc++] = "-q";
+    argv[argc++] = "-s";
+    argv[argc++] = s_mock_sock;
+    argv[argc++] = "-S";
+    argv[argc++] = seed;
+    if (s_latency) {
+        argv[argc++] = "-l";
+        argv[argc++] = (char *)s_latency;
+    }
+    argv[argc] = NULL;
+
+    s_mock_pid = spawn(argv, out);
+    int fd = wait_connect(s_mock_sock, s_mock_pid);
+    if (fd < 0) {
+        fprintf(stderr, "sentinel-bench: mock clamd did not start (see %s)\n",
+                out);
+        cleanup();
+        exit(1);
+    }
+    close(fd);
+    s_clamd = s_mock_sock;
+}
+
+static void start_daemon(size_t nwatch_dirs)
+{
+    char watch[300], log[300], qdir[300], out[300], workers[16], queue[16];
+    snprintf(watch, sizeof(watch), "%s/watch", s_root);
+    snprintf(log, sizeof(log), "%s/sentinel.log", s_root);
+    snprintf(qdir, sizeof(qdir), "%s/quarantine", s_root);
+    snprintf(out, sizeof(out), "%s/daemon.out", s_root);
+    snprintf(s_gui_sock, sizeof(s_gui_sock), "%s/gui.sock", s_root);
+    snprintf(s_metrics_sock, sizeof(s_metrics_sock), "%s/metrics.sock", s_root);
+    snprintf(workers, sizeof(workers), "%d", s_workers);
+    snprintf(queue, sizeof(queue), "%d", s_queue);
+
+    char *argv[24];
+    int   argc = 0;
+    argv[argc++] = (char *)s_daemon_bin;
+    argv[argc++] = "--watch";          argv[argc++] = watch;
+    argv[argc++] = "--clamd-socket";   argv[argc++] = (char *)s_clamd;
+    argv[argc++] = "--ipc-socket";     argv[argc++] = s_gui_sock;
+    argv[argc++] = "--metrics-socket"; argv[argc++] = s_metrics_sock;
+    argv[argc++] = "--log-file";       argv[argc++] = log;
+    argv[argc++] = "--quarantine-dir"; argv[argc++] = qdir;
+    if (s_workers > 0) { argv[argc++] = "--workers"; argv[argc++] = workers; }
+    if (s_queue > 0)   { argv[argc++] = "--queue";   argv[argc++] = queue;   }
+    argv[argc] = NULL;
+
+    s_daemon_pid = spawn(argv, out);
+    s_gui_fd = wait_connect(s_gui_sock, s_daemon_pid);
+    if (s_gui_fd < 0) {
+        fprintf(stderr, "sentinel-bench: daemon did not start (see %s)\n", out);
+        cleanup();
+        exit(1);
+    }
+
+    /* The IPC socket is up before the monitor; wait for the watches. */
+    for (int waited = 0; waited < BENCH_START_TIMEOUT; waited += 20) {
+        char *m = scrape();
+        uint64_t watches = m ? metric(m, "sentinel_inotify_watches") : 0;
+        free(m);
+        if (watches >= nwatch_dirs + 1) return;
+        sleep_ms(20);
+    }
+    fprintf(stderr, "sentinel-bench: daemon watches not ready\n");
+    cleanup();
+    exit(1);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-d DAEMON] [-m MOCKCLAMD | -c CLAMD_SOCKET] [-l DIST]\n"
+            "       [-w small,build,large,rename,deep] [-n FILES] [-L BYTES]\n"
+            "       [-E PCT] [-j WORKERS] [-Q QUEUE] [-T SEC] [-r DIR]\n"
+            "       [-o FILE] [-S SEED] [-k]\n", prog);
+}
+
+/* ── Main ───────────────────────────────────────────────────────────────── */
+
+int main(int argc, char *argv[])
+{
+    const char *list = NULL, *out_path = NULL;
+    int opt;
+
+    s_seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+
+    while ((opt = getopt(argc, argv, "d:m:c:l:w:n:L:E:j:Q:T:r:o:S:k")) != -1) {
+        switch (opt) {
+        case 'd': s_daemon_bin = optarg; break;
+        case 'm': s_mock_bin   = optarg; break;
+        case 'c': s_clamd      = optarg; break;
+        case 'l': s_latency    = optarg; break;
+        case 'w': list         = optarg; break;
+        case 'n': s_nfiles     = atoi(optarg); break;
+        case 'L': s_large_size = strtoull(optarg, NULL, 10); break;
+        case 'E': s_eicar_pct  = strtod(optarg, NULL); break;
+        case 'j': s_workers    = atoi(optarg); break;
+        case 'Q': s_queue      = atoi(optarg); break;
+        case 'T': s_idle_s     = atoi(optarg); break;
+        case 'r': s_parent     = optarg; break;
+        case 'o': out_path     = optarg; break;
+        case 'S': s_seed       = strtoull(optarg, NULL, 0); break;
+        case 'k': s_keep       = 1; break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (s_nfiles < 1 || s_idle_s < 1 || optind < argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!s_seed) s_seed = 1;
+    uint64_t seed = s_seed;
+
+    /* Select workloads. */
+    const workload_t *run[NWORKLOADS];
+    size_t nrun = 0;
+    for (size_t i = 0; i < NWORKLOADS; i++) {
+        if (list) {
+            const char *p = strstr(list, WORKLOADS[i].name);
+            size_t n = strlen(WORKLOADS[i].name);
+            if (!p || (p != list && p[-1] != ',') || (p[n] && p[n] != ','))
+                continue;
+        }
+        run[nrun++] = &WORKLOADS[i];
+    }
+    if (nrun == 0) {
+        fprintf(stderr, "sentinel-bench: no workload matches \"%s\"\n", list);
+        return 2;
+    }
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) die(out_path);
+
+    s_junk = malloc(BENCH_CHUNK);
+    if (!s_junk) die("malloc");
+    for (size_t i = 0; i < BENCH_CHUNK; i += 8) {
+        uint64_t r = rnd();
+        memcpy(s_junk + i, &r, 8);
+    }
+
+    snprintf(s_root, sizeof(s_root), "%s/sentinel-bench.XXXXXX", s_parent);
+    if (!mkdtemp(s_root)) die(s_root);
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/watch", s_root);
+    make_dir(dir);
+    for (size_t i = 0; i < nrun; i++) {
+        snprintf(dir, sizeof(dir), "%s/watch/%s", s_root, run[i]->name);
+        make_dir(dir);
+    }
+
+    int mock = s_clamd == NULL;
+    if (mock) start_mock();
+    start_daemon(nrun);
+
+    pthread_t reader;
+    if (pthread_create(&reader, NULL, reader_main, NULL) != 0) die("pthread");
+
+    struct utsname uts;
+    uname(&uts);
+    time_t now = time(NULL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out,
+            "{\"tool\":\"sentinel-bench\",\"version\":1,\"started\":\"%s\",\n"
+            " \"host\":{\"kernel\":\"%s\",\"machine\":\"%s\",\"cpus\":%ld},\n"
+            " \"config\":{\"files\":%d,\"large_size\":%llu,\"eicar_pct\":%.2f,"
+            "\"workers\":%d,\"queue\":%d,\"seed\":%llu,"
+            "\"clamd\":\"%s\",\"mock_latency\":\"%s\"},\n"
+            " \"workloads\":[\n",
+            stamp, uts.release, uts.machine, sysconf(_SC_NPROCESSORS_ONLN),
+            s_nfiles, (unsigned long long)s_large_size, s_eicar_pct,
+            s_workers, s_queue, (unsigned long long)seed,
+            mock ? "mock" : s_clamd, s_latency ? s_latency : "fixed:0");
+
+    for (size_t i = 0; i < nrun; i++)
+        run_workload(out, run[i], i == 0);
+
+    fprintf(out, "\n ]}\n");
+    if (out != stdout) fclose(out);
+
+    cleanup();
+    pthread_join(reader, NULL);
+    return 0;
+}
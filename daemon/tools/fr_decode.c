@@ -0,0 +1,184 @@
+/*
+ * fr_decode.c — Decoder for Sentinel flight-recorder dumps.
+ *
+ * Reads a dump written by fr_dump() (SIGUSR2 or crash), merges every
+ * thread ring into one time-ordered stream and prints it as text:
+ *
+ *   2026-10-18 14:02:11.123456  +0.000000  tid=4711  EVENT_RECEIVED  \
+ *       arg=0x8  #1a2b3c4d  …/Downloads/report.pdf
+ *
+ * Usage:
+ *   sentinel-frdecode [-p SUBSTR] [-H HASH] [-s] DUMP
+ *     -p SUBSTR  only records whose path tail contains SUBSTR
+ *     -H HASH    only records for one file (hex path hash from a prior run)
+ *     -s         per-event counts only
+ *
+ * Following one file through the pipeline is `-H` with the hash printed
+ * next to its EVENT_RECEIVED line.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "flightrec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+typedef struct {
+    fr_record_t rec;
+    uint32_t    tid;
+    uint64_t    ns;                  /* CLOCK_MONOTONIC ns after conversion */
+} decoded_t;
+
+static const char *EVENT_NAMES[FR_EV_COUNT] = {
+    [FR_EV_NONE]           = "NONE",
+    [FR_EV_EVENT_RECEIVED] = "EVENT_RECEIVED",
+    [FR_EV_ENQUEUED]       = "ENQUEUED",
+    [FR_EV_DEQUEUED]       = "DEQUEUED",
+    [FR_EV_SCAN_START]     = "SCAN_START",
+    [FR_EV_SCAN_END]       = "SCAN_END",
+    [FR_EV_VERDICT]        = "VERDICT",
+    [FR_EV_QUARANTINE]     = "QUARANTINE",
+};
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static int cmp_ns(const void *a, const void *b)
+{
+    const decoded_t *x = a, *y = b;
+    return (x->ns > y->ns) - (x->ns < y->ns);
+}
+
+/* Convert a raw timestamp to CLOCK_MONOTONIC ns using the calibration. */
+static uint64_t to_mono_ns(const fr_dump_hdr_t *h, uint64_t ts)
+{
+    if (h->clock == FR_CLOCK_MONO) return ts;
+
+    double ticks = (double)(h->ts1 - h->ts0);
+    double ns    = (double)(h->mono1_ns - h->mono0_ns);
+    double scale = ticks > 0 ? ns / ticks : 1.0;
+    return h->mono0_ns + (uint64_t)((double)(int64_t)(ts - h->ts0) * scale);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-p SUBSTR] [-H HASH] [-s] DUMP\n", prog);
+}
+
+/* ── Main ───────────────────────────────────────────────────────────────── */
+
+int main(int argc, char *argv[])
+{
+    const char *substr    = NULL;
+    int         have_hash = 0;
+    uint32_t    want_hash = 0;
+    int         summary   = 0;
+    int         opt;
+
+    while ((opt = getopt(argc, argv, "p:H:s")) != -1) {
+        switch (opt) {
+        case 'p': substr = optarg; break;
+        case 'H': want_hash = (uint32_t)strtoul(optarg, NULL, 16);
+                  have_hash = 1; break;
+        case 's': summary = 1; break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (optind >= argc) { usage(argv[0]); return 2; }
+
+    FILE *fp = fopen(argv[optind], "rb");
+    if (!fp) { perror(argv[optind]); return 1; }
+
+    fr_dump_hdr_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != FR_DUMP_MAGIC ||
+        hdr.record_size != sizeof(fr_record_t) || hdr.ring_records == 0) {
+        fprintf(stderr, "%s: not a flight-recorder dump (or wrong version)\n",
+                argv[optind]);
+        fclose(fp);
+        return 1;
+    }
+
+    size_t     cap  = (size_t)hdr.nrings * hdr.ring_records;
+    decoded_t *out  = calloc(cap ? cap : 1, sizeof(*out));
+    fr_record_t *ring = malloc((size_t)hdr.ring_records * sizeof(fr_record_t));
+    if (!out || !ring) { fprintf(stderr, "out of memory\n"); return 1; }
+
+    size_t        n = 0;
+    unsigned long counts[FR_EV_COUNT] = { 0 };
+
+    for (uint32_t r = 0; r < hdr.nrings; r++) {
+        fr_ring_hdr_t rh;
+        if (fread(&rh, sizeof(rh), 1, fp) != 1 ||
+            fread(ring, sizeof(fr_record_t), hdr.ring_records, fp)
+                != hdr.ring_records) {
+            fprintf(stderr, "truncated dump (ring %u)\n", r);
+            break;
+        }
+
+        /* Oldest surviving record is at head - ring_records (if wrapped). */
+        uint64_t valid = rh.head < hdr.ring_records ? rh.head : hdr.ring_records;
+        for (uint64_t i = rh.head - valid; i < rh.head; i++) {
+            const fr_record_t *rec = &ring[i & (hdr.ring_records - 1)];
+            if (rec->event == FR_EV_NONE || rec->event >= FR_EV_COUNT) continue;
+            if (have_hash && rec->path_hash != want_hash) continue;
+            if (substr) {
+                char tail[FR_PATH_TAIL + 1];
+                memcpy(tail, rec->path_tail, FR_PATH_TAIL);
+                tail[FR_PATH_TAIL] = '\0';
+                if (!strstr(tail, substr)) continue;
+            }
+
+            counts[rec->event]++;
+            out[n].rec = *rec;
+            out[n].tid = rh.tid;
+            out[n].ns  = to_mono_ns(&hdr, rec->ts);
+            n++;
+        }
+    }
+    fclose(fp);
+
+    printf("# pid %u, %u thread ring(s), %zu record(s), clock=%s\n",
+           hdr.pid, hdr.nrings, n, hdr.clock == FR_CLOCK_TSC ? "tsc" : "mono");
+
+    if (summary) {
+        for (int e = 1; e < FR_EV_COUNT; e++)
+            printf("%-16s %lu\n", EVENT_NAMES[e], counts[e]);
+        free(out); free(ring);
+        return 0;
+    }
+
+    qsort(out, n, sizeof(*out), cmp_ns);
+
+    uint64_t first = n ? out[0].ns : 0;
+    for (size_t i = 0; i < n; i++) {
+        const decoded_t *d = &out[i];
+
+        /* Wall clock = real time at dump minus monotonic distance to dump. */
+        int64_t  back  = (int64_t)(hdr.mono1_ns - d->ns);
+        uint64_t real  = hdr.real1_ns - (uint64_t)back;
+        time_t   sec   = (time_t)(real / 1000000000ull);
+        long     usec  = (long)((real % 1000000000ull) / 1000);
+        struct tm tm_buf;
+        char     wall[32];
+        localtime_r(&sec, &tm_buf);
+        strftime(wall, sizeof(wall), "%Y-%m-%d %H:%M:%S", &tm_buf);
+
+        size_t tlen = d->rec.path_len < FR_PATH_TAIL ? d->rec.path_len
+                                                     : FR_PATH_TAIL;
+        printf("%s.%06ld  +%.6f  tid=%-6u %-15s arg=0x%-8llx #%08x  %s%.*s\n",
+               wall, usec, (double)(d->ns - first) / 1e9, d->tid,
+               EVENT_NAMES[d->rec.event], (unsigned long long)d->rec.arg,
+               d->rec.path_hash,
+               d->rec.path_len > FR_PATH_TAIL ? "…" : "",
+               (int)tlen, d->rec.path_tail);
+    }
+
+    free(out);
+    free(ring);
+    return 0;
+}
@@ -0,0 +1,732 @@
+/*
+ * mock_clamd.c — Lightweight clamd stand-in for benchmarks and perf tests.
+ *
+ * Speaks enough of the clamd socket protocol for the daemon and for
+ * clamdscan-style clients, without loading a signature database:
+ *
+ *   PING  VERSION  STATS  INSTREAM  FILDES  IDSESSION … END
+ *
+ * Commands may be sent bare (newline-terminated), 'n'-prefixed
+ * (newline-terminated) or 'z'-prefixed (NUL-terminated); replies use the
+ * same terminator.  Inside an IDSESSION every reply is prefixed with
+ * "<request id>: " and the connection stays open until END.
+ *
+ * Verdicts come from substring rules, not real signatures; the EICAR
+ * test string is detected as Win.Test.EICAR_HDB-1 unless -D is given.
+ * Timing is shaped by a latency distribution, a per-MiB scan cost and
+ * byte-rate limits, and faults can be injected, so a benchmark run is
+ * reproducible on any Linux box (use -S for a fixed random seed).
+ *
+ * Usage:
+ *   sentinel-mockclamd [options]
+ *     -s PATH        listen socket (default /tmp/sentinel-mockclamd.sock)
+ *     -l DIST        per-scan latency, ms: fixed:M  uniform:LO:HI
+ *                    normal:MEAN:SD  exp:MEAN            (default fixed:0)
+ *     -k MS          extra scan cost per MiB scanned
+ *     -r BYTES       per-connection INSTREAM/FILDES read rate, bytes/s
+ *     -R BYTES       aggregate read rate across all connections, bytes/s
+ *     -d NAME=TEXT   report NAME when TEXT occurs in the data (repeatable;
+ *                    TEXT may be hex:4d5a90…)
+ *     -D             no built-in EICAR rule
+ *     -e PCT         reply with an ERROR verdict to PCT % of scans
+ *     -x PCT         drop the connection instead of replying, PCT % of scans
+ *     -t N           serve at most N connections at once (clamd MaxThreads);
+ *                    others wait in the listen backlog   (default 10)
+ *     -m BYTES       StreamMaxLength                      (default 25 MiB)
+ *     -S SEED        random seed                          (default time)
+ *     -q             no startup banner
+ *
+ * Counters are reported by STATS and printed on exit (SIGINT / SIGTERM).
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* ── Limits & defaults ──────────────────────────────────────────────────── */
+
+#define MOCK_SOCKET_PATH    "/tmp/sentinel-mockclamd.sock"
+#define MOCK_VERSION        "ClamAV 1.0.0-mock/27000/Thu Jan  1 00:00:00 2026"
+#define MOCK_MAX_THREADS    10
+#define MOCK_STREAM_MAX     (25u * 1024 * 1024)
+#define MOCK_MAX_RULES      32
+#define MOCK_MAX_PATTERN    256
+#define MOCK_MAX_FDS        8        /* Unclaimed SCM_RIGHTS fds per conn  */
+#define MOCK_CMD_MAX        1024
+#define MOCK_IO_CHUNK       8192
+
+#define EICAR_STRING \
+    "X5O!P%@AP[4\\PZX54(P^)7CC)7}$EICAR-STANDARD-ANTIVIRUS-TEST-FILE!$H+H*"
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+typedef enum { DIST_FIXED, DIST_UNIFORM, DIST_NORMAL, DIST_EXP } dist_kind_t;
+
+typedef struct {
+    dist_kind_t kind;
+    double      a, b;                /* ms; meaning depends on kind       */
+} dist_t;
+
+typedef struct {
+    char          name[128];
+    unsigned char pat[MOCK_MAX_PATTERN];
+    size_t        len;
+} rule_t;
+
+/* Incremental rule matcher: keeps the tail of the previous piece so a
+ * pattern split across reads still matches. */
+typedef struct {
+    unsigned char win[MOCK_MAX_PATTERN - 1 + MOCK_IO_CHUNK];
+    size_t        keep;
+    const rule_t *hit;
+    uint64_t      bytes;
+} matcher_t;
+
+/* One client connection, served by its own thread. */
+typedef struct {
+    int           fd;
+    unsigned char buf[MOCK_IO_CHUNK];
+    size_t        len, pos;
+    int           fds[MOCK_MAX_FDS]; /* Received via SCM_RIGHTS, FIFO     */
+    int           nfds;
+    uint64_t      rng;
+    uint64_t      pace_next_ns;      /* Per-connection rate limiter       */
+    matcher_t     match;             /* Current scan                      */
+    unsigned char piece[MOCK_IO_CHUNK];
+} conn_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static const char      *s_socket_path = MOCK_SOCKET_PATH;
+static dist_t           s_latency     = { DIST_FIXED, 0, 0 };
+static double           s_ms_per_mib  = 0;
+static uint64_t         s_conn_rate   = 0;
+static uint64_t         s_total_rate  = 0;
+static double           s_error_pct   = 0;
+static double           s_drop_pct    = 0;
+static int              s_max_threads = MOCK_MAX_THREADS;
+static uint64_t         s_stream_max  = MOCK_STREAM_MAX;
+static uint64_t         s_seed        = 0;
+static int              s_quiet       = 0;
+
+static rule_t           s_rules[MOCK_MAX_RULES];
+static int              s_nrules      = 0;
+static size_t           s_max_pat     = 1;
+
+static sem_t            s_slots;
+static int              s_listen_fd   = -1;
+static volatile sig_atomic_t s_stop   = 0;
+
+static pthread_mutex_t  s_pace_mutex  = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t         s_pace_next_ns = 0;
+
+/* Counters (atomic adds). */
+static uint64_t s_n_conns, s_n_cmds, s_n_scans, s_n_bytes, s_n_found;
+static uint64_t s_n_errors, s_n_drops;
+static int      s_n_live;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ns(uint64_t ns)
+{
+    struct timespec ts = { (time_t)(ns / 1000000000ull),
+                           (long)(ns % 1000000000ull) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+static void sleep_until(uint64_t deadline_ns)
+{
+    uint64_t now = now_ns();
+    if (deadline_ns > now) sleep_ns(deadline_ns - now);
+}
+
+static void count(uint64_t *ctr, uint64_t n)
+{
+    __atomic_add_fetch(ctr, n, __ATOMIC_RELAXED);
+}
+
+/* splitmix64 */
+static uint64_t rng_next(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/* Uniform in (0, 1]. */
+static double rng_unit(uint64_t *state)
+{
+    return ((double)(rng_next(state) >> 11) + 1.0) / 9007199254740992.0;
+}
+
+static int rng_pct(uint64_t *state, double pct)
+{
+    return pct > 0 && rng_unit(state) * 100.0 <= pct;
+}
+
+static double dist_sample_ms(const dist_t *d, uint64_t *rng)
+{
+    double v;
+    switch (d->kind) {
+    case DIST_UNIFORM:
+        v = d->a + (d->b - d->a) * rng_unit(rng);
+        break;
+    case DIST_NORMAL: {                         /* Box–Muller */
+        double u1 = rng_unit(rng), u2 = rng_unit(rng);
+        v = d->a + d->b * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+        break;
+    }
+    case DIST_EXP:
+        v = -d->a * log(rng_unit(rng));
+        break;
+    default:
+        v = d->a;
+    }
+    return v > 0 ? v : 0;
+}
+
+static int parse_dist(const char *spec, dist_t *out)
+{
+    double a = 0, b = 0;
+    if (sscanf(spec, "fixed:%lf", &a) == 1) {
+        *out = (dist_t){ DIST_FIXED, a, 0 };
+    } else if (sscanf(spec, "uniform:%lf:%lf", &a, &b) == 2 && b >= a) {
+        *out = (dist_t){ DIST_UNIFORM, a, b };
+    } else if (sscanf(spec, "normal:%lf:%lf", &a, &b) == 2) {
+        *out = (dist_t){ DIST_NORMAL, a, b };
+    } else if (sscanf(spec, "exp:%lf", &a) == 1) {
+        *out = (dist_t){ DIST_EXP, a, 0 };
+    } else {
+        return -1;
+    }
+    return a >= 0 ? 0 : -1;
+}
+
+static int hexval(int c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int add_rule(const char *name, const char *text)
+{
+    if (s_nrules >= MOCK_MAX_RULES) return -1;
+    rule_t *r = &s_rules[s_nrules];
+
+    if (strncmp(text, "hex:", 4) == 0) {
+        const char *h = text + 4;
+        size_t n = strlen(h);
+        if (n == 0 || n % 2 || n / 2 > MOCK_MAX_PATTERN) return -1;
+        for (size_t i = 0; i < n / 2; i++) {
+            int hi = hexval(h[2 * i]), lo = hexval(h[2 * i + 1]);
+            if (hi < 0 || lo < 0) return -1;
+            r->pat[i] = (unsigned char)(hi << 4 | lo);
+        }
+        r->len = n / 2;
+    } else {
+        r->len = strlen(text);
+        if (r->len == 0 || r->len > MOCK_MAX_PATTERN) return -1;
+        memcpy(r->pat, text, r->len);
+    }
+
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    if (r->len > s_max_pat) s_max_pat = r->len;
+    s_nrules++;
+    return 0;
+}
+
+/* Block until `n` bytes may be consumed under both rate limits. */
+static void pace(conn_t *c, size_t n)
+{
+    uint64_t now = now_ns(), until = now;
+
+    if (s_conn_rate) {
+        uint64_t start = c->pace_next_ns > now ? c->pace_next_ns : now;
+        c->pace_next_ns = start + (uint64_t)n * 1000000000ull / s_conn_rate;
+        until = c->pace_next_ns;
+    }
+    if (s_total_rate) {
+        pthread_mutex_lock(&s_pace_mutex);
+        uint64_t start = s_pace_next_ns > now ? s_pace_next_ns : now;
+        s_pace_next_ns = start + (uint64_t)n * 1000000000ull / s_total_rate;
+        if (s_pace_next_ns > until) until = s_pace_next_ns;
+        pthread_mutex_unlock(&s_pace_mutex);
+    }
+    sleep_until(until);
+}
+
+/* ── Matcher ────────────────────────────────────────────────────────────── */
+
+static void matcher_reset(matcher_t *m)
+{
+    m->keep  = 0;
+    m->hit   = NULL;
+    m->bytes = 0;
+}
+
+static void matcher_feed(matcher_t *m, const unsigned char *data, size_t n)
+{
+    m->bytes += n;
+    if (m->hit || s_nrules == 0) return;
+
+    memcpy(m->win + m->keep, data, n);
+    size_t len = m->keep + n;
+
+    for (int i = 0; i < s_nrules && !m->hit; i++) {
+        if (memmem(m->win, len, s_rules[i].pat, s_rules[i].len))
+            m->hit = &s_rules[i];
+    }
+
+    m->keep = len < s_max_pat - 1 ? len : s_max_pat - 1;
+    memmove(m->win, m->win + len - m->keep, m->keep);
+}
+
+/* ── Connection I/O ─────────────────────────────────────────────────────── */
+
+/* Refill the read buffer, collecting any file descriptors passed along. */
+static int conn_fill(conn_t *c)
+{
+    if (c->pos < c->len) return 0;
+    c->pos = c->len = 0;
+
+    union {
+        struct cmsghdr align;
+        char           buf[CMSG_SPACE(sizeof(int) * MOCK_MAX_FDS)];
+    } ctrl;
+    struct iovec iov = { c->buf, sizeof(c->buf) };
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = ctrl.buf, .msg_controllen = sizeof(ctrl.buf),
+    };
+
+    ssize_t n;
+    do {
+        n = recvmsg(c->fd, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return -1;
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t nfds = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int *fds = (int *)CMSG_DATA(cm);
+        for (size_t i = 0; i < nfds; i++) {
+            if (c->nfds < MOCK_MAX_FDS) c->fds[c->nfds++] = fds[i];
+            else close(fds[i]);
+        }
+    }
+
+    c->len = (size_t)n;
+    return 0;
+}
+
+static int conn_read(conn_t *c, void *dst, size_t n)
+{
+    unsigned char *out = dst;
+    while (n) {
+        if (conn_fill(c) != 0) return -1;
+        size_t take = c->len - c->pos < n ? c->len - c->pos : n;
+        memcpy(out, c->buf + c->pos, take);
+        c->pos += take;
+        out += take;
+        n -= take;
+    }
+    return 0;
+}
+
+/*
+ * Read one command.  *delim receives the reply terminator ('\0' for
+ * z-commands, '\n' otherwise).  @return 0, or -1 on EOF / oversize.
+ */
+static int conn_read_cmd(conn_t *c, char *out, size_t outlen, char *delim)
+{
+    unsigned char ch;
+    if (conn_read(c, &ch, 1) != 0) return -1;
+
+    char end = '\n';
+    size_t n = 0;
+    if (ch == 'z') {
+        end = '\0';
+    } else if (ch != 'n') {
+        out[n++] = (char)ch;
+    }
+    *delim = end;
+
+    for (;;) {
+        if (conn_read(c, &ch, 1) != 0) return -1;
+        if ((char)ch == end) break;
+        if (n + 1 >= outlen) return -1;
+        out[n++] = (char)ch;
+    }
+    if (end == '\n' && n && out[n - 1] == '\r') n--;
+    out[n] = '\0';
+    return 0;
+}
+
+static int conn_reply(conn_t *c, unsigned session_id, char delim,
+                      const char *text)
+{
+    char line[2048];
+    int n = session_id
+          ? snprintf(line, sizeof(line), "%u: %s", session_id, text)
+          : snprintf(line, sizeof(line), "%s", text);
+    if (n < 0) return -1;
+    if ((size_t)n >= sizeof(line) - 1) n = (int)sizeof(line) - 2;
+    line[n++] = delim;
+
+    size_t off = 0;
+    while (off < (size_t)n) {
+        ssize_t w = send(c->fd, line + off, (size_t)n - off, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        off += (size_t)w;
+    }
+    return 0;
+}
+
+/* ── Commands ───────────────────────────────────────────────────────────── */
+
+/*
+ * Finish a scan: apply latency, fault injection and the verdict.
+ * @return 0 to keep serving, -1 to drop the connection.
+ */
+static int finish_scan(conn_t *c, unsigned sid, char delim,
+                       const char *subject, const matcher_t *m)
+{
+    double ms = dist_sample_ms(&s_latency, &c->rng) +
+                s_ms_per_mib * (double)m->bytes / 1048576.0;
+    if (ms > 0) sleep_ns((uint64_t)(ms * 1e6));
+
+    count(&s_n_scans, 1);
+    count(&s_n_bytes, m->bytes);
+
+    if (rng_pct(&c->rng, s_drop_pct)) {
+        count(&s_n_drops, 1);
+        return -1;
+    }
+
+    char reply[512];
+    if (rng_pct(&c->rng, s_error_pct)) {
+        count(&s_n_errors, 1);
+        snprintf(reply, sizeof(reply), "%s: Can't allocate memory ERROR",
+                 subject);
+    } else if (m->hit) {
+        count(&s_n_found, 1);
+        snprintf(reply, sizeof(reply), "%s: %s FOUND", subject, m->hit->name);
+    } else {
+        snprintf(reply, sizeof(reply), "%s: OK", subject);
+    }
+    return conn_reply(c, sid, delim, reply);
+}
+
+static int cmd_instream(conn_t *c, unsigned sid, char delim)
+{
+    matcher_t *m = &c->match;
+    matcher_reset(m);
+
+    for (;;) {
+        uint32_t be;
+        if (conn_read(c, &be, 4) != 0) return -1;
+        uint32_t len = ntohl(be);
+        if (len == 0) break;
+
+        if (m->bytes + len > s_stream_max) {
+            conn_reply(c, sid, delim, "INSTREAM size limit exceeded. ERROR");
+            return -1;
+        }
+        while (len) {
+            size_t take = len < sizeof(c->piece) ? len : sizeof(c->piece);
+            pace(c, take);
+            if (conn_read(c, c->piece, take) != 0) return -1;
+            matcher_feed(m, c->piece, take);
+            len -= (uint32_t)take;
+        }
+    }
+    return finish_scan(c, sid, delim, "stream", m);
+}
+
+static int cmd_fildes(conn_t *c, unsigned sid, char delim)
+{
+    /* The fd arrives as ancillary data on the command's own message. */
+    if (c->nfds == 0)
+        return conn_reply(c, sid, delim,
+                          "FILDES: didn't receive file descriptor. ERROR");
+
+    int fd = c->fds[0];
+    memmove(c->fds, c->fds + 1, (size_t)(--c->nfds) * sizeof(int));
+
+    matcher_t *m = &c->match;
+    matcher_reset(m);
+
+    ssize_t n;
+    off_t off = 0;
+    while ((n = pread(fd, c->piece, sizeof(c->piece), off)) > 0) {
+        pace(c, (size_t)n);
+        matcher_feed(m, c->piece, (size_t)n);
+        off += n;
+    }
+    close(fd);
+
+    char subject[32];
+    snprintf(subject, sizeof(subject), "fd[%d]", fd);
+    if (n < 0)
+        return conn_reply(c, sid, delim, "FILDES: can't read file. ERROR");
+    return finish_scan(c, sid, delim, subject, m);
+}
+
+static int cmd_stats(conn_t *c, unsigned sid, char delim)
+{
+    char text[1024];
+    snprintf(text, sizeof(text),
+             "POOLS: 1\n\nSTATE: VALID PRIMARY\n"
+             "THREADS: live %d  idle %d max %d idle-timeout 30\n"
+             "QUEUE: 0 items\n"
+             "MOCK: conns %llu commands %llu scans %llu bytes %llu "
+             "found %llu errors %llu drops %llu\n"
+             "MEMSTATS: heap N/A mmap N/A used N/A free N/A releasable N/A "
+             "pools 1 pools_used N/A pools_total N/A\nEND",
+             __atomic_load_n(&s_n_live, __ATOMIC_RELAXED),
+             s_max_threads - __atomic_load_n(&s_n_live, __ATOMIC_RELAXED),
+             s_max_threads,
+             (unsigned long long)s_n_conns, (unsigned long long)s_n_cmds,
+             (unsigned long long)s_n_scans, (unsigned long long)s_n_bytes,
+             (unsigned long long)s_n_found, (unsigned long long)s_n_errors,
+             (unsigned long long)s_n_drops);
+    return conn_reply(c, sid, delim, text);
+}
+
+/*
+ * Run one command.  @return 1 if the connection should stay open (only
+ * inside a session), 0 to close after the reply, -1 to drop it.
+ */
+static int dispatch(conn_t *c, const char *cmd, char delim, unsigned sid)
+{
+    count(&s_n_cmds, 1);
+
+    int rc;
+    if (strcmp(cmd, "PING") == 0)           rc = conn_reply(c, sid, delim, "PONG");
+    else if (strcmp(cmd, "VERSION") == 0)   rc = conn_reply(c, sid, delim, MOCK_VERSION);
+    else if (strcmp(cmd, "STATS") == 0)     rc = cmd_stats(c, sid, delim);
+    else if (strcmp(cmd, "INSTREAM") == 0)  rc = cmd_instream(c, sid, delim);
+    else if (strcmp(cmd, "FILDES") == 0)    rc = cmd_fildes(c, sid, delim);
+    else                                    rc = conn_reply(c, sid, delim,
+                                                        "UNKNOWN COMMAND");
+    if (rc != 0) return -1;
+    return sid ? 1 : 0;
+}
+
+static void serve(conn_t *c)
+{
+    char cmd[MOCK_CMD_MAX];
+    char delim;
+
+    if (conn_read_cmd(c, cmd, sizeof(cmd), &delim) != 0) return;
+
+    if (strcmp(cmd, "IDSESSION") != 0) {
+        dispatch(c, cmd, delim, 0);
+        return;
+    }
+
+    /* Session: replies carry the request number; END closes. */
+    for (unsigned id = 1; !s_stop; id++) {
+        if (conn_read_cmd(c, cmd, sizeof(cmd), &delim) != 0) return;
+        if (strcmp(cmd, "END") == 0) return;
+        if (strcmp(cmd, "IDSESSION") == 0) {
+            conn_reply(c, id, delim, "Command invalid inside IDSESSION. ERROR");
+            return;
+        }
+        if (dispatch(c, cmd, delim, id) < 0) return;
+    }
+}
+
+static void *conn_thread(void *arg)
+{
+    conn_t *c = arg;
+
+    __atomic_add_fetch(&s_n_live, 1, __ATOMIC_RELAXED);
+    serve(c);
+    __atomic_sub_fetch(&s_n_live, 1, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < c->nfds; i++) close(c->fds[i]);
+    close(c->fd);
+    free(c);
+    sem_post(&s_slots);
+    return NULL;
+}
+
+/* ── Setup ──────────────────────────────────────────────────────────────── */
+
+static void on_stop(int signo)
+{
+    (void)signo;
+    s_stop = 1;
+}
+
+static int listen_socket(const char *path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        close(fd);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(fd, 512) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    chmod(path, 0666);
+    return fd;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-s PATH] [-l DIST] [-k MS] [-r BYTES] [-R BYTES]\n"
+            "       [-d NAME=TEXT]... [-D] [-e PCT] [-x PCT] [-t N] [-m BYTES]\n"
+            "       [-S SEED] [-q]\n"
+            "DIST: fixed:MS | uniform:LO:HI | normal:MEAN:SD | exp:MEAN\n",
+            prog);
+}
+
+/* ── Main ───────────────────────────────────────────────────────────────── */
+
+int main(int argc, char *argv[])
+{
+    int no_eicar = 0;
+    int opt;
+
+    s_seed = (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32);
+
+    while ((opt = getopt(argc, argv, "s:l:k:r:R:d:De:x:t:m:S:q")) != -1) {
+        switch (opt) {
+        case 's': s_socket_path = optarg; break;
+        case 'l':
+            if (parse_dist(optarg, &s_latency) != 0) {
+                fprintf(stderr, "bad latency distribution: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'k': s_ms_per_mib = strtod(optarg, NULL); break;
+        case 'r': s_conn_rate  = strtoull(optarg, NULL, 10); break;
+        case 'R': s_total_rate = strtoull(optarg, NULL, 10); break;
+        case 'd': {
+            char *eq = strchr(optarg, '=');
+            if (!eq || eq == optarg) { usage(argv[0]); return 2; }
+            *eq = '\0';
+            if (add_rule(optarg, eq + 1) != 0) {
+                fprintf(stderr, "bad detection rule: %s\n", optarg);
+                return 2;
+            }
+            break;
+        }
+        case 'D': no_eicar = 1; break;
+        case 'e': s_error_pct   = strtod(optarg, NULL); break;
+        case 'x': s_drop_pct    = strtod(optarg, NULL); break;
+        case 't': s_max_threads = atoi(optarg); break;
+        case 'm': s_stream_max  = strtoull(optarg, NULL, 10); break;
+        case 'S': s_seed        = strtoull(optarg, NULL, 0); break;
+        case 'q': s_quiet       = 1; break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (optind < argc || s_max_threads < 1) { usage(argv[0]); return 2; }
+    if (!no_eicar) add_rule("Win.Test.EICAR_HDB-1", EICAR_STRING);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop;                 /* No SA_RESTART: break accept */
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    s_listen_fd = listen_socket(s_socket_path);
+    if (s_listen_fd < 0) return 1;
+    sem_init(&s_slots, 0, (unsigned)s_max_threads);
+
+    if (!s_quiet)
+        fprintf(stderr, "mock clamd listening on %s (%d threads, %d rules, "
+                "seed %llu)\n", s_socket_path, s_max_threads, s_nrules,
+                (unsigned long long)s_seed);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    for (uint64_t n = 0; !s_stop; ) {
+        /* MaxThreads: don't accept until a worker slot is free. */
+        if (sem_wait(&s_slots) != 0) continue;           /* EINTR */
+        if (s_stop) break;
+
+        int cfd = accept4(s_listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (cfd < 0) {
+            sem_post(&s_slots);
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            break;
+        }
+
+        conn_t *c = calloc(1, sizeof(*c));
+        if (!c) {
+            close(cfd);
+            sem_post(&s_slots);
+            continue;
+        }
+        c->fd  = cfd;
+        c->rng = s_seed + ++n * 0x9e3779b97f4a7c15ull;
+        count(&s_n_conns, 1);
+
+        pthread_t tid;
+        if (pthread_create(&tid, &attr, conn_thread, c) != 0) {
+            close(cfd);
+            free(c);
+            sem_post(&s_slots);
+        }
+    }
+
+    close(s_listen_fd);
+    unlink(s_socket_path);
+    fprintf(stderr,
+            "mock clamd: %llu connections, %llu commands, %llu scans, "
+            "%llu bytes, %llu found, %llu errors, %llu drops\n",
+            (unsigned long long)s_n_conns, (unsigned long long)s_n_cmds,
+            (unsigned long long)s_n_scans, (unsigned long long)s_n_bytes,
+            (unsigned long long)s_n_found, (unsigned long long)s_n_errors,
+            (unsigned long long)s_n_drops);
+    return 0;
+}
@@ -0,0 +1,613 @@
+/*
+ * sentinelctl.c — Command-line client for the daemon's IPC socket.
+ *
+ * Speaks the GUI protocol (newline-delimited JSON over the UNIX socket)
+ * and prints the daemon's replies on stdout as JSON lines, one object
+ * per line, for scripts and ops automation.
+ *
+ * Usage:
+ *   sentinelctl [-s SOCKET] [-a] [-q] COMMAND [ARG...]
+ *     scan PATH...          on-demand scans, streaming progress
+ *     cancel [SCAN_ID]      cancel one of this connection's scans (no ID: all)
+ *     list                  every quarantine entry
+ *     query KEY...          entries whose ID, original path or threat is KEY
+ *     restore ID...         restore from quarantine
+ *     delete ID...          delete from quarantine
+ *     stats                 counters and queue state
+ *     monitor on|off        resume or pause real-time protection
+ *     reload                live upgrade (like systemctl reload)
+ *     engines [SPEC]        show, or replace, the scan engine chain
+ *     engines reload        re-read the engines' files (IOC lists)
+ *     events                every broadcast, until interrupted
+ *     batch                 read "COMMAND ARG" lines from stdin
+ *   An ARG of "-" reads the arguments from stdin, one per line.
+ *     -s SOCKET  IPC socket (default ALERT_SOCKET_PATH)
+ *     -a         also print broadcasts (other files' verdicts, …)
+ *     -q         leave out scan_progress events
+ *
+ * Everything goes over one connection and is pipelined: requests are
+ * written while replies are read, with up to CTL_MAX_INFLIGHT answers
+ * outstanding, restores and deletes are packed many IDs to a request
+ * (the daemon writes its manifest once per request), and listings are
+ * fetched CTL_LIST_WINDOW pages ahead.  Memory use is fixed: one input
+ * buffer, one reply buffer, one request buffer.
+ *
+ * Exit status: 0 if every request succeeded, 1 if any failed, 2 on a
+ * usage or connection error.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include "alert.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/* Answers outstanding before further requests wait. */
+#define CTL_MAX_INFLIGHT   1024
+
+/* Listing pages requested ahead of the one being received. */
+#define CTL_LIST_WINDOW    4
+
+/* Bytes of IDs packed into one restore / delete request. */
+#define CTL_PACK_BYTES     (ALERT_MSG_MAX - 256)
+
+/* Longest reply line; quarantine entries carry two paths. */
+#define CTL_LINE_MAX       (256 << 10)
+
+/* Request and stdin buffers. */
+#define CTL_OUT_BUF        (64 << 10)
+#define CTL_IN_BUF         (64 << 10)
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static const char *s_socket  = ALERT_SOCKET_PATH;
+static int         s_all     = 0;
+static int         s_quiet   = 0;
+static int         s_fd      = -1;
+static int         s_failed  = 0;
+
+/* Command and argument source */
+static const char *s_cmd     = NULL;     /* NULL: "batch"                */
+static char      **s_args    = NULL;
+static int         s_nargs   = 0;
+static int         s_argi    = 0;
+static int         s_stdin   = 0;        /* Arguments come from stdin    */
+static int         s_stdin_eof = 0;
+static char        s_sbuf[CTL_IN_BUF];
+static size_t      s_slen    = 0;
+static char        s_held[CTL_IN_BUF];   /* Line taken but not yet sent  */
+static int         s_have_held = 0;
+static int         s_exhausted = 0;
+
+/* Requests not yet written */
+static char        s_obuf[CTL_OUT_BUF];
+static size_t      s_olen    = 0;
+static size_t      s_ooff    = 0;
+
+/* Replies */
+static char       *s_ibuf    = NULL;
+static size_t      s_ilen    = 0;
+static long        s_pending = 0;        /* Terminal replies awaited     */
+static int         s_monitor_wait = 0;
+
+/* Restore / delete pack */
+static char        s_pack[CTL_PACK_BYTES + 1];
+static size_t      s_pack_len = 0;
+static int         s_pack_n   = 0;
+static const char *s_pack_op  = NULL;
+
+/* Listing */
+static int         s_listing   = 0;
+static int         s_list_inflight = 0;
+static long        s_list_next = 0;      /* Next offset to request       */
+static long        s_list_total = -1;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static void die(const char *msg)
+{
+    fflush(stdout);
+    fprintf(stderr, "sentinelctl: %s\n", msg);
+    exit(2);
+}
+
+/* Append `s` to the request buffer as a JSON string. */
+static void put_json_str(const char *s)
+{
+    char  *o   = s_obuf + s_olen;
+    char  *end = s_obuf + sizeof(s_obuf) - 8;
+    *o++ = '"';
+    for (; *s && o < end; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            *o++ = '\\';
+            *o++ = (char)c;
+        } else if (c < 0x20) {
+            o += snprintf(o, (size_t)(end - o), "\\u%04x", c);
+        } else {
+            *o++ = (char)c;
+        }
+    }
+    *o++ = '"';
+    s_olen = (size_t)(o - s_obuf);
+}
+
+/* Queue {"action":action[,"id":id]}.  The caller checked for room. */
+static void request(const char *action, const char *id)
+{
+    s_olen += (size_t)snprintf(s_obuf + s_olen, sizeof(s_obuf) - s_olen,
+                               "{\"action\":\"%s\"", action);
+    if (id) {
+        memcpy(s_obuf + s_olen, ",\"id\":", 6);
+        s_olen += 6;
+        put_json_str(id);
+    }
+    memcpy(s_obuf + s_olen, "}\n", 2);
+    s_olen += 2;
+}
+
+/*
+ * Room for one more request of any size, keeping one request's worth
+ * spare for listing pages queued from the reply path.
+ */
+static int have_room(void)
+{
+    return sizeof(s_obuf) - s_olen >= 2 * ALERT_MSG_MAX;
+}
+
+static void request_page(void)
+{
+    char off[24];
+    snprintf(off, sizeof(off), "%ld", s_list_next);
+    request("list", off);
+    s_list_next += ALERT_LIST_PAGE;
+    s_list_inflight++;
+}
+
+static void flush_pack(void)
+{
+    if (!s_pack_n) return;
+    request(s_pack_op, s_pack);
+    s_pending += s_pack_n;
+    s_pack_len = 0;
+    s_pack_n   = 0;
+}
+
+/*
+ * Value of "key" in a JSON object line, or NULL.  Keys cannot match
+ * inside string values: a quote there is escaped.
+ */
+static const char *field(const char *line, const char *key)
+{
+    char pat[64];
+    int  n = snprintf(pat, sizeof(pat), "\"%s\"", key);
+    for (const char *p = strstr(line, pat); p; p = strstr(p + 1, pat)) {
+        const char *v = p + n;
+        while (*v == ' ') v++;
+        if (*v != ':') continue;
+        v++;
+        while (*v == ' ') v++;
+        return v;
+    }
+    return NULL;
+}
+
+/* Copy the plain string value of "key" (no escapes expected). */
+static int field_str(const char *line, const char *key, char *out, size_t cap)
+{
+    const char *v = field(line, key);
+    if (!v || *v != '"') return -1;
+    size_t i = 0;
+    for (v++; *v && *v != '"' && i + 1 < cap; v++) out[i++] = *v;
+    out[i] = '\0';
+    return 0;
+}
+
+static long field_long(const char *line, const char *key, long dflt)
+{
+    const char *v = field(line, key);
+    return v ? strtol(v, NULL, 10) : dflt;
+}
+
+static int field_true(const char *line, const char *key)
+{
+    const char *v = field(line, key);
+    return v && strncmp(v, "true", 4) == 0;
+}
+
+static void emit(const char *line, size_t len)
+{
+    fwrite(line, 1, len, stdout);
+    putchar('\n');
+}
+
+/* ── Replies ────────────────────────────────────────────────────────────── */
+
+static void on_reply(char *line, size_t len)
+{
+    char ev[64];
+    if (field_str(line, "event", ev, sizeof(ev)) != 0) {
+        if (s_all) emit(line, len);
+        return;
+    }
+
+    int print = s_all;
+    if (strcmp(ev, "scan_started") == 0) {
+        print = 1;
+    } else if (strcmp(ev, "scan_progress") == 0) {
+        print = !s_quiet;
+    } else if (strcmp(ev, "scan_complete") == 0) {
+        char status[16];
+        print = 1;
+        s_pending--;
+        /* A scan that did not run to the end fails "scan"; a batch that
+         * cancels its own scans knows what it asked for. */
+        if (s_cmd && strcmp(s_cmd, "scan") == 0 &&
+            field_str(line, "status", status, sizeof(status)) == 0 &&
+            strcmp(status, "done") != 0)
+            s_failed = 1;
+    } else if (strcmp(ev, "scan_error") == 0) {
+        print = 1;
+        s_pending--;
+        s_failed = 1;
+    } else if (strcmp(ev, "query_done") == 0 ||
+               strcmp(ev, "stats") == 0) {
+        print = 1;
+        s_pending--;
+    } else if (strcmp(ev, "cancel_result") == 0) {
+        print = 1;
+        s_pending--;
+        if (field_long(line, "cancelled", 0) == 0) s_failed = 1;
+    } else if (strcmp(ev, "restore_result") == 0 ||
+               strcmp(ev, "delete_result") == 0 ||
+               strcmp(ev, "reload_result") == 0 ||
+               strcmp(ev, "engines") == 0) {
+        print = 1;
+        s_pending--;
+        if (!field_true(line, "ok")) s_failed = 1;
+    } else if (strcmp(ev, "quarantine_entry") == 0) {
+        print = 1;
+    } else if (strcmp(ev, "list_page") == 0) {
+        s_pending--;
+        s_list_inflight--;
+        s_list_total = field_long(line, "total", 0);
+        long count   = field_long(line, "count", 0);
+        if (count > 0 && s_list_next < s_list_total) {
+            while (s_list_inflight < CTL_LIST_WINDOW &&
+                   s_list_next < s_list_total) {
+                request_page();
+                s_pending++;
+            }
+        }
+        if (s_list_inflight == 0) s_listing = 0;
+    } else if (strcmp(ev, "monitoring_state") == 0 && s_monitor_wait) {
+        print = 1;
+        s_monitor_wait--;
+        s_pending--;
+    }
+
+    if (print) emit(line, len);
+}
+
+/* Read what the daemon sent; handle every complete line. */
+static void read_replies(void)
+{
+    for (;;) {
+        if (s_ilen == CTL_LINE_MAX) die("reply line too long");
+        ssize_t n = read(s_fd, s_ibuf + s_ilen, CTL_LINE_MAX - s_ilen);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+            die(strerror(errno));
+        }
+        if (n == 0) {
+            if (s_pending > 0 || s_listing)
+                die("daemon closed the connection");
+            exit(s_failed);
+        }
+
+        size_t start = 0, end = s_ilen + (size_t)n;
+        for (size_t i = s_ilen; i < end; i++) {
+            if (s_ibuf[i] != '\n') continue;
+            s_ibuf[i] = '\0';
+            if (i > start) on_reply(s_ibuf + start, i - start);
+            start = i + 1;
+        }
+        memmove(s_ibuf, s_ibuf + start, end - start);
+        s_ilen = end - start;
+    }
+}
+
+/* ── Requests ───────────────────────────────────────────────────────────── */
+
+/* Next argument line: 1 found, 0 none yet (stdin), -1 no more. */
+static int next_line(char **out)
+{
+    if (s_have_held) {
+        *out = s_held;
+        return 1;
+    }
+    if (!s_stdin) {
+        if (s_argi >= s_nargs) return -1;
+        snprintf(s_held, sizeof(s_held), "%s", s_args[s_argi++]);
+    } else {
+        char *nl = memchr(s_sbuf, '\n', s_slen);
+        if (!nl) {
+            if (!s_stdin_eof) {
+                if (s_slen == sizeof(s_sbuf)) die("input line too long");
+                return 0;
+            }
+            if (s_slen == 0) return -1;
+            nl = s_sbuf + s_slen;            /* Last line, no newline */
+        }
+        size_t len = (size_t)(nl - s_sbuf);
+        memcpy(s_held, s_sbuf, len);
+        s_held[len] = '\0';
+        size_t used = len < s_slen ? len + 1 : len;
+        memmove(s_sbuf, s_sbuf + used, s_slen - used);
+        s_slen -= used;
+        if (len && s_held[len - 1] == '\r') s_held[len - 1] = '\0';
+    }
+    s_have_held = 1;
+    *out = s_held;
+    return 1;
+}
+
+/*
+ * Turn one command into requests.  @return 1 done, 0 try again later
+ * (listing still running), -1 unknown command.
+ */
+static int issue(const char *cmd, const char *arg)
+{
+    if (strcmp(cmd, "restore") == 0 || strcmp(cmd, "delete") == 0) {
+        if (!*arg) return 1;
+        size_t n = strlen(arg);
+        if (n >= CTL_PACK_BYTES) {
+            fflush(stdout);
+            fprintf(stderr, "sentinelctl: ID too long (%zu bytes): %.64s...\n",
+                    n, arg);
+            s_failed = 1;
+            return 1;
+        }
+        if (s_pack_n && (strcmp(s_pack_op, cmd) != 0 ||
+                         s_pack_len + 1 + n > CTL_PACK_BYTES))
+            flush_pack();
+        s_pack_op = strcmp(cmd, "restore") == 0 ? "restore" : "delete";
+        if (s_pack_n) s_pack[s_pack_len++] = ',';
+        memcpy(s_pack + s_pack_len, arg, n);
+        s_pack_len += n;
+        s_pack[s_pack_len] = '\0';
+        s_pack_n++;
+        return 1;
+    }
+    flush_pack();
+
+    if (strcmp(cmd, "list") == 0) {
+        if (s_listing) return 0;             /* One listing at a time */
+        s_listing    = 1;
+        s_list_next  = 0;
+        s_list_total = -1;
+        request_page();
+        s_pending++;
+        return 1;
+    }
+    if (strcmp(cmd, "scan") == 0) {
+        char real[PATH_MAX];
+        request("scan_path", *arg && realpath(arg, real) ? real : arg);
+    } else if (strcmp(cmd, "cancel") == 0) {
+        request("scan_cancel", arg);
+    } else if (strcmp(cmd, "query") == 0) {
+        request("query", arg);
+    } else if (strcmp(cmd, "stats") == 0) {
+        request("stats", NULL);
+    } else if (strcmp(cmd, "reload") == 0) {
+        request("reload", NULL);
+    } else if (strcmp(cmd, "engines") == 0) {
+        if (strcmp(arg, "reload") == 0)
+            request("engines_reload", NULL);
+        else
+            request("engines", arg);
+    } else if (strcmp(cmd, "monitor") == 0) {
+        if (strcmp(arg, "on") != 0 && strcmp(arg, "off") != 0) return -1;
+        request("set_monitoring", strcmp(arg, "on") == 0 ? "true" : "false");
+        s_monitor_wait++;
+    } else {
+        return -1;
+    }
+    s_pending++;
+    return 1;
+}
+
+/* Queue requests while there is room and the in-flight window allows. */
+static void pump_requests(void)
+{
+    while (!s_exhausted && s_pending < CTL_MAX_INFLIGHT && have_room()) {
+        char *line;
+        int   rc = next_line(&line);
+        if (rc == 0) {
+            flush_pack();                    /* Don't sit on a part pack */
+            return;
+        }
+        if (rc < 0) {
+            flush_pack();
+            s_exhausted = 1;
+            return;
+        }
+
+        char        cmdbuf[32];
+        const char *cmd = s_cmd, *arg = line;
+        if (!cmd) {                          /* batch: "COMMAND ARG" */
+            while (*line == ' ' || *line == '\t') line++;
+            size_t n = strcspn(line, " \t");
+            if (n == 0) {                    /* Blank line */
+                s_have_held = 0;
+                continue;
+            }
+            snprintf(cmdbuf, sizeof(cmdbuf), "%.*s", (int)n, line);
+            cmd = cmdbuf;
+            arg = line + n;
+            while (*arg == ' ' || *arg == '\t') arg++;
+        }
+
+        rc = issue(cmd, arg);
+        if (rc == 0) return;
+        if (rc < 0) {
+            fflush(stdout);
+            fprintf(stderr, "sentinelctl: bad command: %s %s\n", cmd, arg);
+            s_failed = 1;
+        }
+        s_have_held = 0;
+    }
+}
+
+static void write_requests(void)
+{
+    while (s_ooff < s_olen) {
+        ssize_t n = write(s_fd, s_obuf + s_ooff, s_olen - s_ooff);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            die(strerror(errno));
+        }
+        s_ooff += (size_t)n;
+    }
+    if (s_ooff == s_olen) {
+        s_ooff = s_olen = 0;
+    } else if (s_ooff > sizeof(s_obuf) / 2) {
+        memmove(s_obuf, s_obuf + s_ooff, s_olen - s_ooff);
+        s_olen -= s_ooff;
+        s_ooff  = 0;
+    }
+}
+
+/*
+ * One read() per poll() wake-up: stdin stays blocking, since O_NONBLOCK
+ * would be set on the open file description shared with the shell.
+ */
+static void read_stdin(void)
+{
+    ssize_t n;
+    do {
+        n = read(STDIN_FILENO, s_sbuf + s_slen, sizeof(s_sbuf) - s_slen);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) die(strerror(errno));
+    if (n == 0) s_stdin_eof = 1;
+    else        s_slen += (size_t)n;
+}
+
+/* ── Main ───────────────────────────────────────────────────────────────── */
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-s SOCKET] [-a] [-q] COMMAND [ARG...]\n"
+        "  scan PATH...  cancel [SCAN_ID]  list  query KEY...\n"
+        "  restore ID...  delete ID...  stats  monitor on|off  reload\n"
+        "  engines [SPEC|reload]  events  batch\n"
+        "An ARG of \"-\" reads arguments from stdin, one per line; batch\n"
+        "reads \"COMMAND ARG\" lines.  Replies are printed as JSON lines.\n"
+        "  -s SOCKET  IPC socket (default %s)\n"
+        "  -a         also print broadcasts\n"
+        "  -q         leave out scan_progress events\n",
+        prog, ALERT_SOCKET_PATH);
+}
+
+int main(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "s:aqh")) != -1) {
+        switch (opt) {
+        case 's': s_socket = optarg; break;
+        case 'a': s_all    = 1;      break;
+        case 'q': s_quiet  = 1;      break;
+        default:  usage(argv[0]);    return 2;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const char *cmd = argv[optind];
+    s_args  = argv + optind + 1;
+    s_nargs = argc - optind - 1;
+
+    int events = strcmp(cmd, "events") == 0;
+    if (strcmp(cmd, "batch") == 0) {
+        s_stdin = 1;
+    } else if (events) {
+        s_all       = 1;
+        s_exhausted = 1;
+    } else {
+        s_cmd = cmd;
+        if (s_nargs == 1 && strcmp(s_args[0], "-") == 0) {
+            s_stdin = 1;
+        } else if (s_nargs == 0) {
+            static char *none[] = { "" };    /* One request, no argument */
+            if (!strcmp(cmd, "scan") || !strcmp(cmd, "query") ||
+                !strcmp(cmd, "restore") || !strcmp(cmd, "delete") ||
+                !strcmp(cmd, "monitor")) {
+                usage(argv[0]);
+                return 2;
+            }
+            s_args  = none;
+            s_nargs = 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+    static char outbuf[64 << 10];
+    setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+    if (!(s_ibuf = malloc(CTL_LINE_MAX))) die("out of memory");
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(s_socket) >= sizeof(addr.sun_path)) die("socket path too long");
+    strcpy(addr.sun_path, s_socket);
+    s_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (s_fd < 0 || connect(s_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        char msg[PATH_MAX + 64];
+        snprintf(msg, sizeof(msg), "cannot connect to %s: %s", s_socket,
+                 strerror(errno));
+        die(msg);
+    }
+    fcntl(s_fd, F_SETFL, fcntl(s_fd, F_GETFL) | O_NONBLOCK);
+
+    for (;;) {
+        pump_requests();
+        write_requests();
+        if (s_exhausted && !events && s_olen == 0 && s_pending <= 0 &&
+            !s_listing)
+            break;
+
+        struct pollfd pfd[2] = {
+            { .fd = s_fd, .events = POLLIN | (s_olen ? POLLOUT : 0) },
+            { .fd = -1,   .events = POLLIN },
+        };
+        if (s_stdin && !s_stdin_eof && s_slen < sizeof(s_sbuf))
+            pfd[1].fd = STDIN_FILENO;
+
+        fflush(stdout);
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            die(strerror(errno));
+        }
+        if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR)) read_replies();
+        if (pfd[0].revents & POLLOUT) write_requests();
+        if (pfd[1].revents) read_stdin();
+    }
+
+    fflush(stdout);
+    close(s_fd);
+    free(s_ibuf);
+    return s_failed;
+}
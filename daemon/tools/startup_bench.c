@@ -0,0 +1,647 @@
+/*
+ * startup_bench.c — Cold-start scalability benchmark for the Sentinel daemon.
+ *
+ * Builds synthetic watch trees (balanced, FANOUT directories per level)
+ * and quarantine vaults (a manifest of N entries), starts a private
+ * daemon on each and reports how long it takes to come up, phase by
+ * phase, as exported in sentinel_startup_seconds{phase=…}:
+ *
+ *   logger, quarantine (manifest load), scanner (clamd ping), pool,
+ *   ipc (GUI + metrics sockets, event loop), watches (recursive inotify
+ *   walk), total
+ *
+ * plus the time from exec to the first metrics reply ("ready"), the
+ * watch count, walk rate, RSS once up, and the SIGTERM-to-exit time
+ * (which includes the manifest save).  Tree sizes are swept with an
+ * empty vault and vault sizes with an empty watch root, so each sweep
+ * isolates one phase.  Every point is run REPEATS times and each figure
+ * is the median.
+ *
+ * Trees are expensive to build (10^7 directories take minutes and ~40 GB
+ * of inodes on ext4), so they are cached under the work directory and
+ * reused by later runs; -x removes them at the end.
+ *
+ * Usage:
+ *   sentinel-startbench [options]
+ *     -d PATH     daemon binary              (default ./sentinel-daemon)
+ *     -D LIST     tree sizes in directories  (default 1e4,1e5)
+ *     -V LIST     vault sizes in entries     (default 1e3,1e4,1e5)
+ *     -F N        directories per level      (default 16)
+ *     -f N        empty files per directory  (default 0)
+ *     -n N        runs per point             (default 3)
+ *     -c PATH     clamd socket (default: none, so the ping fails fast)
+ *     -C          drop the page cache before each run (root only)
+ *     -T SEC      give up on a start after SEC s (default 600)
+ *     -r DIR      work directory (default /var/tmp/sentinel-startbench)
+ *     -o FILE     write the JSON report to FILE
+ *     -x          delete the cached trees and vaults when done
+ *
+ * LIST is comma separated; 1e6 style and plain integers both work.  Pass
+ * an empty LIST ("") to skip a sweep.
+ *
+ * Part of the Sentinel Endpoint Security daemon.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+
+/* ── Limits & defaults ──────────────────────────────────────────────────── */
+
+#define SB_TREES          "1e4,1e5"
+#define SB_VAULTS         "1e3,1e4,1e5"
+#define SB_FANOUT         16
+#define SB_REPEATS        3
+#define SB_TIMEOUT_S      600
+#define SB_WORKDIR        "/var/tmp/sentinel-startbench"
+#define SB_MAX_POINTS     16
+#define SB_MAX_REPEATS    32
+#define SB_SOCK_TIMEOUT   10000        /* ms for the metrics socket to bind */
+
+/* Must match the daemon's manifest name (quarantine.h). */
+#define SB_MANIFEST       ".manifest.json"
+
+/* Marks a fully built tree or vault; hidden, so the daemon skips it. */
+#define SB_COMPLETE       ".complete"
+
+/* ── Internal types ─────────────────────────────────────────────────────── */
+
+enum {
+    PH_LOGGER, PH_QUARANTINE, PH_SCANNER, PH_POOL, PH_IPC, PH_WATCHES,
+    PH_TOTAL, PH_COUNT
+};
+
+static const char *const PHASES[PH_COUNT] = {
+    "logger", "quarantine", "scanner", "pool", "ipc", "watches", "total",
+};
+
+/* One daemon start. */
+typedef struct {
+    double ready_ms;                 /* exec → first metrics reply        */
+    double phase_ms[PH_COUNT];
+    double watches;
+    double rss_kib;
+    double stop_ms;                  /* SIGTERM → exit                    */
+} run_t;
+
+/* ── Private state ──────────────────────────────────────────────────────── */
+
+static const char *s_daemon_bin = "./sentinel-daemon";
+static const char *s_clamd      = NULL;
+static const char *s_workdir    = SB_WORKDIR;
+static int         s_fanout     = SB_FANOUT;
+static int         s_files      = 0;
+static int         s_repeats    = SB_REPEATS;
+static int         s_cold       = 0;
+static int         s_timeout_s  = SB_TIMEOUT_S;
+static int         s_purge      = 0;
+
+static char        s_run_dir[512];       /* Sockets, logs of one start   */
+static char        s_metrics_sock[600];
+static pid_t       s_daemon_pid = -1;
+
+/* ── Helpers ────────────────────────────────────────────────────────────── */
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ms(unsigned ms)
+{
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void die(const char *what)
+{
+    fprintf(stderr, "sentinel-startbench: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static void make_dir(const char *path)
+{
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) die(path);
+}
+
+static int exists(const char *dir, const char *name)
+{
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    return access(path, F_OK) == 0;
+}
+
+static void touch(const char *dir, const char *name)
+{
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) die(path);
+    close(fd);
+}
+
+/* Parse "1e4,100000" into `out`.  @return number of values. */
+static int parse_list(const char *list, long *out, int max)
+{
+    int n = 0;
+    for (const char *p = list; *p && n < max;) {
+        char *end;
+        double v = strtod(p, &end);
+        if (end == p || v < 1) {
+            fprintf(stderr, "sentinel-startbench: bad size list \"%s\"\n",
+                    list);
+            exit(2);
+        }
+        out[n++] = (long)v;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median(double *v, int n)
+{
+    qsort(v, (size_t)n, sizeof(*v), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+static double median_at(const run_t *runs, int n, size_t off)
+{
+    double v[SB_MAX_REPEATS];
+    for (int i = 0; i < n; i++)
+        v[i] = *(const double *)((const char *)&runs[i] + off);
+    return median(v, n);
+}
+
+static long read_long(const char *path)
+{
+    FILE *fp = fopen(path, "re");
+    if (!fp) return -1;
+    long v = -1;
+    if (fscanf(fp, "%ld", &v) != 1) v = -1;
+    fclose(fp);
+    return v;
+}
+
+static void drop_caches(void)
+{
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || write(fd, "3\n", 2) != 2) {
+        fprintf(stderr, "sentinel-startbench: cannot drop caches (%s) — "
+                "results are warm-cache\n", strerror(errno));
+        s_cold = 0;
+    }
+    if (fd >= 0) close(fd);
+}
+
+/* ── Fixtures ───────────────────────────────────────────────────────────── */
+
+/*
+ * Directory i (1-based) lives under directory (i - 1) / FANOUT, so the
+ * tree is filled level by level and every parent exists before its
+ * children.  Its path is rebuilt from the index: cheap next to mkdir,
+ * and no queue of 10^7 paths to hold.
+ */
+static void tree_path(const char *root, long i, char *out, size_t outlen)
+{
+    long idx[64];
+    int  depth = 0;
+    for (; i > 0 && depth < 64; i = (i - 1) / s_fanout)
+        idx[depth++] = i;
+
+    size_t off = (size_t)snprintf(out, outlen, "%s", root);
+    while (depth-- > 0 && off < outlen)
+        off += (size_t)snprintf(out + off, outlen - off, "/d%ld",
+                                (idx[depth] - 1) % s_fanout);
+}
+
+static void build_tree(const char *root, long ndirs)
+{
+    if (exists(root, SB_COMPLETE)) return;
+
+    fprintf(stderr, "sentinel-startbench: building %ld-directory tree in "
+            "%s ...\n", ndirs, root);
+    make_dir(root);
+
+    uint64_t t0 = now_ns();
+    char path[1024];
+    for (long i = 1; i <= ndirs; i++) {
+        tree_path(root, i, path, sizeof(path));
+        make_dir(path);
+        for (int f = 0; f < s_files; f++) {
+            char name[32];
+            snprintf(name, sizeof(name), "f%d", f);
+            touch(path, name);
+        }
+        if (i % 1000000 == 0)
+            fprintf(stderr, "  %ld / %ld\n", i, ndirs);
+    }
+    touch(root, SB_COMPLETE);
+    fprintf(stderr, "sentinel-startbench: built in %.1f s\n",
+            (double)(now_ns() - t0) / 1e9);
+}
+
+/* A manifest in the daemon's format; the vault files themselves are not
+ * needed, quarantine_init() only loads the manifest. */
+static void build_vault(const char *dir, long entries)
+{
+    if (exists(dir, SB_COMPLETE)) return;
+
+    fprintf(stderr, "sentinel-startbench: writing %ld-entry vault in %s\n",
+            entries, dir);
+    make_dir(dir);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, SB_MANIFEST);
+    FILE *fp = fopen(path, "we");
+    if (!fp) die(path);
+
+    fputs("[\n", fp);
+    for (long i = 0; i < entries; i++) {
+        fprintf(fp,
+                "  {\n"
+                "    \"id\":\"%08lx-0000-4000-8000-%012lx\",\n"
+                "    \"original_path\":\"/home/user/Downloads/dir%ld/"
+                "sample-%ld.exe\",\n"
+                "    \"quarantine_path\":\"%s/%08lx-0000-4000-8000-%012lx\",\n"
+                "    \"threat_name\":\"Win.Test.EICAR_HDB-1\",\n"
+                "    \"timestamp\":%ld\n"
+                "  }%s\n",
+                i, i, i % 1000, i, dir, i, i, 1700000000L + i,
+                i + 1 < entries ? "," : "");
+    }
+    fputs("]\n", fp);
+    if (fclose(fp) != 0) die(path);
+    touch(dir, SB_COMPLETE);
+}
+
+/* ── Daemon plumbing ────────────────────────────────────────────────────── */
+
+static int unix_connect(const char *path)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    size_t len = strlen(path);
+    if (len >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(addr.sun_path, path, len + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static pid_t spawn(char *const argv[], const char *out_path)
+{
+    pid_t pid = fork();
+    if (pid < 0) die("fork");
+    if (pid == 0) {
+        int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execv(argv[0], argv);
+        fprintf(stderr, "exec %s: %s\n", argv[0], strerror(errno));
+        _exit(127);
+    }
+    return pid;
+}
+
+/* @return ms from SIGTERM to exit, or -1 if it had to be killed. */
+static double stop_daemon(void)
+{
+    if (s_daemon_pid <= 0) return -1;
+
+    uint64_t t0 = now_ns();
+    kill(s_daemon_pid, SIGTERM);
+    for (int i = 0; i < s_timeout_s * 100; i++) {
+        if (waitpid(s_daemon_pid, NULL, WNOHANG) == s_daemon_pid) {
+            s_daemon_pid = -1;
+            return (double)(now_ns() - t0) / 1e6;
+        }
+        sleep_ms(10);
+    }
+    kill(s_daemon_pid, SIGKILL);
+    waitpid(s_daemon_pid, NULL, 0);
+    s_daemon_pid = -1;
+    return -1;
+}
+
+/*
+ * The metrics socket is bound before the watch walk but only served from
+ * the event loop, so the first reply doubles as the readiness signal.
+ * Caller frees.
+ */
+static char *scrape_when_ready(void)
+{
+    int fd = -1;
+    for (int waited = 0; fd < 0 && waited < SB_SOCK_TIMEOUT; waited += 5) {
+        fd = unix_connect(s_metrics_sock);
+        if (fd >= 0) break;
+        if (waitpid(s_daemon_pid, NULL, WNOHANG) == s_daemon_pid) {
+            s_daemon_pid = -1;
+            return NULL;
+        }
+        sleep_ms(5);
+    }
+    if (fd < 0) return NULL;
+
+    struct timeval tv = { .tv_sec = s_timeout_s };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (write(fd, "metrics\n", 8) != 8) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t cap = 16384, len = 0;
+    char *buf = malloc(cap);
+    for (;;) {
+        if (!buf) break;
+        if (len + 4096 > cap) {
+            char *nb = realloc(buf, cap *= 2);
+            if (!nb) { free(buf); buf = NULL; break; }
+            buf = nb;
+        }
+        ssize_t n = read(fd, buf + len, cap - len - 1);
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    close(fd);
+    if (buf && len == 0) { free(buf); buf = NULL; }
+    if (buf) buf[len] = '\0';
+    return buf;
+}
+
+static double metric(const char *text, const char *name)
+{
+    size_t nlen = strlen(name);
+    for (const char *p = text; p && *p; p = strchr(p, '\n'), p = p ? p + 1 : p) {
+        if (strncmp(p, name, nlen) == 0 && p[nlen] == ' ')
+            return strtod(p + nlen + 1, NULL);
+    }
+    return 0;
+}
+
+static double daemon_rss_kib(void)
+{
+    char path[64], line[256];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)s_daemon_pid);
+    FILE *fp = fopen(path, "re");
+    if (!fp) return 0;
+    double v = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            v = strtod(line + 6, NULL);
+            break;
+        }
+    }
+    fclose(fp);
+    return v;
+}
+
+static int start_once(const char *watch, const char *qdir, run_t *r)
+{
+    char log[600], out[600], ipc[600], clamd[600];
+    snprintf(log, sizeof(log), "%s/sentinel.log", s_run_dir);
+    snprintf(out, sizeof(out), "%s/daemon.out", s_run_dir);
+    snprintf(ipc, sizeof(ipc), "%s/gui.sock", s_run_dir);
+    snprintf(clamd, sizeof(clamd), "%s/no-clamd.sock", s_run_dir);
+    snprintf(s_metrics_sock, sizeof(s_metrics_sock), "%s/metrics.sock",
+             s_run_dir);
+    unlink(s_metrics_sock);
+
+    char *argv[] = {
+        (char *)s_daemon_bin,
+        "--watch",          (char *)watch,
+        "--quarantine-dir", (char *)qdir,
+        "--clamd-socket",   s_clamd ? (char *)s_clamd : clamd,
+        "--ipc-socket",     ipc,
+        "--metrics-socket", s_metrics_sock,
+        "--log-file",       log,
+        NULL
+    };
+
+    if (s_cold) drop_caches();
+
+    uint64_t t0 = now_ns();
+    s_daemon_pid = spawn(argv, out);
+    char *m = scrape_when_ready();
+    uint64_t t1 = now_ns();
+    if (!m) {
+        fprintf(stderr, "sentinel-startbench: daemon did not come up "
+                "(see %s and %s)\n", out, log);
+        stop_daemon();
+        return -1;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->ready_ms = (double)(t1 - t0) / 1e6;
+    for (int i = 0; i < PH_COUNT; i++) {
+        char name[96];
+        snprintf(name, sizeof(name), "sentinel_startup_seconds{phase=\"%s\"}",
+                 PHASES[i]);
+        r->phase_ms[i] = metric(m, name) * 1e3;
+    }
+    r->watches = metric(m, "sentinel_inotify_watches");
+    r->rss_kib = daemon_rss_kib();
+    free(m);
+
+    r->stop_ms = stop_daemon();
+    return 0;
+}
+
+/* Run one point `s_repeats` times and print its JSON object. */
+static void run_point(FILE *out, const char *key, long n, const char *watch,
+                      const char *qdir, int first)
+{
+    run_t runs[SB_MAX_REPEATS];
+    int   ok = 0;
+    for (int i = 0; i < s_repeats; i++) {
+        if (start_once(watch, qdir, &runs[ok]) == 0) ok++;
+    }
+
+    fprintf(out, "%s  {\"%s\":%ld", first ? "" : ",\n", key, n);
+    if (ok == 0) {
+        fprintf(out, ",\"error\":\"daemon did not start\"}");
+        fflush(out);
+        return;
+    }
+
+#define MEDIAN(field) median_at(runs, ok, offsetof(run_t, field))
+
+    double watches = MEDIAN(watches);
+    double walk_ms = MEDIAN(phase_ms[PH_WATCHES]);
+    fprintf(out, ",\"runs\":%d,\"ready_ms\":%.1f,\"watches\":%.0f,"
+            "\"dirs_per_s\":%.0f,\"rss_kib\":%.0f,\"stop_ms\":%.1f,"
+            "\"phases_ms\":{",
+            ok, MEDIAN(ready_ms), watches,
+            walk_ms > 0 ? watches / (walk_ms / 1e3) : 0.0,
+            MEDIAN(rss_kib), MEDIAN(stop_ms));
+    for (int p = 0; p < PH_COUNT; p++)
+        fprintf(out, "%s\"%s\":%.2f", p ? "," : "", PHASES[p],
+                MEDIAN(phase_ms[p]));
+    fprintf(out, "}}");
+#undef MEDIAN
+    fflush(out);
+
+    fprintf(stderr, "  %s=%ld: ready %.1f ms, watches %.1f ms, "
+            "quarantine %.1f ms\n", key, n, runs[0].ready_ms,
+            runs[0].phase_ms[PH_WATCHES], runs[0].phase_ms[PH_QUARANTINE]);
+}
+
+/* ── Setup & teardown ───────────────────────────────────────────────────── */
+
+static int rm_entry(const char *path, const struct stat *st, int flag,
+                    struct FTW *ftw)
+{
+    (void)st;
+    (void)ftw;
+    return flag == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void rm_tree(const char *path)
+{
+    nftw(path, rm_entry, 64, FTW_DEPTH | FTW_PHYS);
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    if (s_daemon_pid > 0) kill(s_daemon_pid, SIGKILL);
+    _exit(130);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-d DAEMON] [-D DIRS,...] [-V ENTRIES,...] [-F FANOUT]\n"
+            "       [-f FILES] [-n RUNS] [-c CLAMD_SOCKET] [-C] [-T SEC]\n"
+            "       [-r DIR] [-o FILE] [-x]\n", prog);
+}
+
+/* ── Main ───────────────────────────────────────────────────────────────── */
+
+int main(int argc, char *argv[])
+{
+    const char *trees = SB_TREES, *vaults = SB_VAULTS, *out_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:D:V:F:f:n:c:CT:r:o:x")) != -1) {
+        switch (opt) {
+        case 'd': s_daemon_bin = optarg; break;
+        case 'D': trees        = optarg; break;
+        case 'V': vaults       = optarg; break;
+        case 'F': s_fanout     = atoi(optarg); break;
+        case 'f': s_files      = atoi(optarg); break;
+        case 'n': s_repeats    = atoi(optarg); break;
+        case 'c': s_clamd      = optarg; break;
+        case 'C': s_cold       = 1; break;
+        case 'T': s_timeout_s  = atoi(optarg); break;
+        case 'r': s_workdir    = optarg; break;
+        case 'o': out_path     = optarg; break;
+        case 'x': s_purge      = 1; break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (s_fanout < 2 || s_files < 0 || s_repeats < 1 ||
+        s_repeats > SB_MAX_REPEATS || s_timeout_s < 1 || optind < argc) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    long tree_n[SB_MAX_POINTS], vault_n[SB_MAX_POINTS];
+    int  ntrees  = parse_list(trees, tree_n, SB_MAX_POINTS);
+    int  nvaults = parse_list(vaults, vault_n, SB_MAX_POINTS);
+
+    if (access(s_daemon_bin, X_OK) != 0) die(s_daemon_bin);
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) die(out_path);
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    char empty[600];
+    make_dir(s_workdir);
+    snprintf(s_run_dir, sizeof(s_run_dir), "%s/run", s_workdir);
+    make_dir(s_run_dir);
+    snprintf(empty, sizeof(empty), "%s/empty", s_workdir);
+    make_dir(empty);
+
+    long watch_limit = read_long("/proc/sys/fs/inotify/max_user_watches");
+    for (int i = 0; i < ntrees; i++) {
+        if (watch_limit > 0 && tree_n[i] + 1 > watch_limit)
+            fprintf(stderr, "sentinel-startbench: %ld dirs exceed "
+                    "fs.inotify.max_user_watches (%ld); the walk will hit "
+                    "ENOSPC\n", tree_n[i], watch_limit);
+    }
+
+    struct utsname uts;
+    uname(&uts);
+    time_t now = time(NULL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out,
+            "{\"tool\":\"sentinel-startbench\",\"version\":1,\"started\":\"%s\",\n"
+            " \"host\":{\"kernel\":\"%s\",\"machine\":\"%s\",\"cpus\":%ld,"
+            "\"max_user_watches\":%ld},\n"
+            " \"config\":{\"fanout\":%d,\"files_per_dir\":%d,\"runs\":%d,"
+            "\"cold_cache\":%s,\"clamd\":\"%s\"},\n"
+            " \"trees\":[\n",
+            stamp, uts.release, uts.machine, sysconf(_SC_NPROCESSORS_ONLN),
+            watch_limit, s_fanout, s_files, s_repeats,
+            s_cold ? "true" : "false", s_clamd ? s_clamd : "none");
+
+    char fixture[600];
+    for (int i = 0; i < ntrees; i++) {
+        snprintf(fixture, sizeof(fixture), "%s/tree-%ld-F%d-f%d", s_workdir,
+                 tree_n[i], s_fanout, s_files);
+        build_tree(fixture, tree_n[i]);
+        run_point(out, "dirs", tree_n[i], fixture, empty, i == 0);
+    }
+
+    fprintf(out, "\n ],\n \"vaults\":[\n");
+    for (int i = 0; i < nvaults; i++) {
+        snprintf(fixture, sizeof(fixture), "%s/vault-%ld", s_workdir,
+                 vault_n[i]);
+        build_vault(fixture, vault_n[i]);
+        run_point(out, "entries", vault_n[i], empty, fixture, i == 0);
+    }
+    fprintf(out, "\n ]}\n");
+    if (out != stdout) fclose(out);
+
+    rm_tree(s_run_dir);
+    if (s_purge) rm_tree(s_workdir);
+    return 0;
+}
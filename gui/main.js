@@ -88,7 +88,9 @@ function connectDaemon() {
             if (!line.trim()) continue;
             try {
                 const payload = JSON.parse(line);
-                console.log('[IPC] Event:', payload.event);
+                if (payload.event !== 'perf_stats') {
+                    console.log('[IPC] Event:', payload.event);
+                }
                 sendToRenderer('alert', payload);
             } catch (err) {
                 console.error('[IPC] Parse error:', err.message, 'raw:', line);
@@ -22,6 +22,7 @@ const state = {
     vaultEntries: [],       /* { id, filename, threat, timestamp } */
     maxLogEntries: 200,
     syncing: false,         /* True while receiving sync_entry batch */
+    perfTimer: null,        /* Marks the perf panel stale if updates stop */
 };
 
 /* ── DOM References ─────────────────────────────────────────────────────── */
@@ -40,6 +41,18 @@ const dom = {
     btnToggle: document.getElementById('btn-toggle-protection'),
     shieldIcon: document.getElementById('shield-icon'),
     protectionCard: document.getElementById('protection-card'),
+    perfUpdated: document.getElementById('perf-updated'),
+    perfScans: document.getElementById('perf-scans'),
+    perfBytes: document.getElementById('perf-bytes'),
+    perfQueue: document.getElementById('perf-queue'),
+    perfQueueFill: document.getElementById('perf-queue-fill'),
+    perfQueuePeak: document.getElementById('perf-queue-peak'),
+    perfWorkers: document.getElementById('perf-workers'),
+    perfLatency: document.getElementById('perf-latency'),
+    perfClamd: document.getElementById('perf-clamd'),
+    perfCache: document.getElementById('perf-cache'),
+    perfCacheLookups: document.getElementById('perf-cache-lookups'),
+    perfWatches: document.getElementById('perf-watches'),
 };
 
 /* ── Helpers ────────────────────────────────────────────────────────────── */
@@ -82,6 +95,29 @@ function animateCounter(element, targetValue) {
     requestAnimationFrame(step);
 }
 
+function formatBytes(bytes) {
+    const units = ['B', 'KB', 'MB', 'GB'];
+    let value = bytes;
+    let i = 0;
+    while (value >= 1024 && i < units.length - 1) {
+        value /= 1024;
+        i++;
+    }
+    return (i === 0 ? value.toFixed(0) : value.toFixed(1)) + ' ' + units[i];
+}
+
+function formatMs(ms) {
+    if (ms === null || ms === undefined) return '—';
+    return ms < 10 ? ms.toFixed(1) : Math.round(ms).toString();
+}
+
+/** Map a 0..1 load fraction to a severity class. */
+function loadClass(fraction) {
+    if (fraction >= 0.9) return 'crit';
+    if (fraction >= 0.6) return 'warn';
+    return 'ok';
+}
+
 /* ── UI Update Functions ────────────────────────────────────────────────── */
 
 function updateConnectionStatus(connected) {
@@ -152,6 +188,62 @@ function updateStats() {
     dom.vaultCount.textContent = state.vaultEntries.length;
 }
 
+/* ── Live Performance ───────────────────────────────────────────────────── */
+
+/**
+ * Render a perf_stats event.  Rates, the queue peak, the latency
+ * quantiles and the cache hit ratio cover the daemon's last broadcast
+ * interval.
+ */
+function updatePerfPanel(stats) {
+    const capacity = stats.queue_capacity || 1;
+    const peakLoad = stats.queue_high_water / capacity;
+
+    dom.perfScans.textContent = stats.scans_per_sec.toFixed(1);
+    dom.perfBytes.textContent = formatBytes(stats.bytes_per_sec) + '/s';
+
+    dom.perfQueue.textContent = `${stats.queue_depth} / ${stats.queue_capacity}`;
+    dom.perfQueue.className = 'perf-value ' + loadClass(stats.queue_depth / capacity);
+    dom.perfQueueFill.style.width = Math.min(100, (stats.queue_depth / capacity) * 100) + '%';
+    dom.perfQueueFill.className = 'perf-bar-fill ' + loadClass(peakLoad);
+    dom.perfQueuePeak.textContent = `peak ${stats.queue_high_water}`;
+
+    dom.perfWorkers.textContent = `${stats.workers_busy} / ${stats.workers}`;
+    dom.perfWorkers.className = 'perf-value ' +
+        loadClass(stats.workers ? stats.workers_busy / stats.workers : 0);
+
+    dom.perfLatency.textContent =
+        `${formatMs(stats.verdict_p50_ms)} / ${formatMs(stats.verdict_p99_ms)} ms`;
+
+    const clamdClass = { ok: 'ok', degraded: 'warn', down: 'crit' }[stats.clamd] || '';
+    dom.perfClamd.textContent = stats.clamd_errors
+        ? `${stats.clamd} (${stats.clamd_errors} err)`
+        : stats.clamd;
+    dom.perfClamd.className = 'perf-value ' + clamdClass;
+
+    /* Null ratio: no lookups this interval (or no cache in the chain). */
+    const lookups = (stats.cache_hits || 0) + (stats.cache_misses || 0);
+    dom.perfCache.textContent = stats.cache_hit_ratio === null ||
+                                stats.cache_hit_ratio === undefined
+        ? '—'
+        : (stats.cache_hit_ratio * 100).toFixed(1) + '%';
+    dom.perfCacheLookups.textContent = `${lookups.toLocaleString()} lookups`;
+
+    dom.perfWatches.textContent = stats.watches.toLocaleString();
+
+    dom.perfUpdated.textContent = 'Updated ' + formatTime(null);
+    dom.perfUpdated.className = 'perf-updated';
+
+    /* Flag the panel if three broadcasts in a row go missing. */
+    clearTimeout(state.perfTimer);
+    state.perfTimer = setTimeout(markPerfStale, (stats.interval_ms || 2000) * 3);
+}
+
+function markPerfStale() {
+    dom.perfUpdated.textContent = state.connected ? 'No recent data' : 'Disconnected';
+    dom.perfUpdated.className = 'perf-updated stale';
+}
+
 /* ── Scan Log ───────────────────────────────────────────────────────────── */
 
 function addLogEntry(alert) {
@@ -407,6 +499,12 @@ function escapeAttr(str) {
 
 /* Alerts from daemon (real-time events + sync entries) */
 window.sentinel.onAlert((alert) => {
+    /* perf_stats arrives every few seconds — keep it out of the console. */
+    if (alert.event === 'perf_stats') {
+        updatePerfPanel(alert);
+        return;
+    }
+
     console.log('[Alert]', alert);
 
     switch (alert.event) {
@@ -492,6 +590,7 @@ window.sentinel.onAlert((alert) => {
 window.sentinel.onStatus((status) => {
     console.log('[Status]', status);
     updateConnectionStatus(status.connected);
+    if (!status.connected) markPerfStale();
 });
 
 /* Clear log button */
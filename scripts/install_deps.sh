@@ -42,6 +42,7 @@ install_system_packages() {
         build-essential \
         pkg-config \
         libjson-c-dev \
+        systemtap-sdt-dev \
         clamav \
         clamav-daemon \
         curl \